@@ -0,0 +1,194 @@
+//-----------------------------------------------------------------------------
+//
+//	Main.cpp
+//
+//	Throughput benchmark of the driver against a simulated controller
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+//
+//	Usage: Benchmark [iterations] [replay script] [options]
+//
+//	The driver is started on ControllerInterface_Simulator, and once its
+//	nodes have been queried every multilevel switch level is set once per
+//	iteration.  Unsolicited reports come from the SimulatorReportInterval
+//	option, and from the replay script if one is given.  The options are
+//	passed to Options::Create as a command line, for example
+//	"--SimulatorNodes 50 --SimulatorCANRate 5".
+//
+//	When the send queues have drained, the simulator's statistics are
+//	printed: messages per second, round trip times and CPU per message.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <list>
+#include <string>
+#include "Options.h"
+#include "Manager.h"
+#include "Driver.h"
+#include "Notification.h"
+#include "value_classes/ValueID.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/SimulatorController.h"
+#include "platform/Wait.h"
+
+using namespace OpenZWave;
+
+static Mutex* g_mutex = NULL;
+static Event* g_readyEvent = NULL;
+static uint32 g_homeId = 0;
+static bool g_failed = false;
+static list<ValueID> g_levels;
+static uint32 g_changed = 0;
+
+//-----------------------------------------------------------------------------
+// <OnNotification>
+// Note the home id, the level values and the changes reported
+//-----------------------------------------------------------------------------
+void OnNotification
+(
+	Notification const* _notification,
+	void* _context
+)
+{
+	g_mutex->Lock();
+	switch( _notification->GetType() )
+	{
+		case Notification::Type_DriverReady:
+		{
+			g_homeId = _notification->GetHomeId();
+			break;
+		}
+		case Notification::Type_DriverFailed:
+		{
+			g_failed = true;
+			g_readyEvent->Set();
+			break;
+		}
+		case Notification::Type_AwakeNodesQueried:
+		case Notification::Type_AllNodesQueried:
+		case Notification::Type_AllNodesQueriedSomeDead:
+		{
+			g_readyEvent->Set();
+			break;
+		}
+		case Notification::Type_ValueAdded:
+		{
+			ValueID const& id = _notification->GetValueID();
+			// Level of a multilevel switch
+			if( id.GetCommandClassId() == 0x26 && id.GetIndex() == 0 && id.GetType() == ValueID::ValueType_Byte )
+			{
+				g_levels.push_back( id );
+			}
+			break;
+		}
+		case Notification::Type_ValueChanged:
+		{
+			++g_changed;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	g_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <main>
+// Run the benchmark
+//-----------------------------------------------------------------------------
+int main
+(
+	int argc,
+	char* argv[]
+)
+{
+	int32 iterations = ( argc > 1 ) ? atoi( argv[1] ) : 100;
+	string script = ( argc > 2 ) ? argv[2] : "";
+	string commandLine = string( "--ConsoleOutput false --SaveConfiguration false " ) + ( ( argc > 3 ) ? argv[3] : "" );
+
+	g_mutex = new Mutex();
+	g_readyEvent = new Event();
+	Event* sleepEvent = new Event();
+
+	Options::Create( "../../../config/", "", commandLine );
+	Options::Get()->Lock();
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	Manager::Get()->AddDriver( script, Driver::ControllerInterface_Simulator );
+
+	int result = 0;
+	if( Wait::Single( g_readyEvent, 60000 ) != 0 || g_failed )
+	{
+		printf( "The simulated network did not become ready\n" );
+		result = 1;
+	}
+	else
+	{
+		g_mutex->Lock();
+		list<ValueID> levels = g_levels;
+		uint32 homeId = g_homeId;
+		g_mutex->Unlock();
+		printf( "Home 0x%08x: %d level values, %d iterations\n", homeId, (int32)levels.size(), iterations );
+
+		Manager::Get()->ResetSimulatorStatistics( homeId );
+		for( int32 i=0; i<iterations; ++i )
+		{
+			for( list<ValueID>::iterator it = levels.begin(); it != levels.end(); ++it )
+			{
+				Manager::Get()->SetValue( *it, (uint8)( ( i * 7 ) % 100 ) );
+			}
+		}
+
+		// Wait for the queues to drain, for at most ten minutes
+		for( int32 i=0; i<60000 && Manager::Get()->GetSendQueueCount( homeId ) > 0; ++i )
+		{
+			Wait::Single( sleepEvent, 10 );
+		}
+
+		SimulatorData data;
+		Manager::Get()->GetSimulatorStatistics( homeId, &data );
+		printf( "Frames received %u, sent %u, transactions %u\n", data.m_framesReceived, data.m_framesSent, data.m_transactions );
+		printf( "Reports injected %u, CAN %u, NAK %u, bad checksums %u\n", data.m_reportsInjected, data.m_CANInjected, data.m_NAKInjected, data.m_badChecksum );
+		printf( "Elapsed %u ms: %u msgs/sec, %u us CPU per message\n", data.m_elapsed, data.m_msgsPerSec, data.m_cpuPerMsg );
+		printf( "Round trip min %u ms, p50 %u ms, p99 %u ms, max %u ms\n", data.m_rttMin, data.m_rttP50, data.m_rttP99, data.m_rttMax );
+
+		g_mutex->Lock();
+		printf( "Values changed %u\n", g_changed );
+		g_mutex->Unlock();
+	}
+
+	Manager::Get()->RemoveDriver( script );
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	Options::Destroy();
+
+	sleepEvent->Release();
+	g_readyEvent->Release();
+	g_mutex->Release();
+	return result;
+}
@@ -0,0 +1,556 @@
+//-----------------------------------------------------------------------------
+//
+//	ConfigWriter.cpp
+//
+//	Incremental, debounced saving of the zwcfg network file
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "ConfigWriter.h"
+#include "Driver.h"
+#include "Node.h"
+#include "Notification.h"
+#include "Options.h"
+#include "NetworkCache.h"
+#include "Utils.h"
+#include "platform/Event.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+#include "platform/TimeStamp.h"
+#include "platform/Wait.h"
+#include "platform/WaitSet.h"
+#include "value_classes/Value.h"
+#include "value_classes/ValueID.h"
+#include "value_classes/ValueStore.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::ConfigWriter>
+// Constructor
+//-----------------------------------------------------------------------------
+ConfigWriter::ConfigWriter
+(
+	Driver* _driver,
+	int32 const _delay
+):
+	m_driver( _driver ),
+	m_delay( _delay ),
+	m_writeMutex( new Mutex() ),
+	m_dirtyMutex( new Mutex() ),
+	m_requested( false ),
+	m_written( false ),
+	m_thread( NULL ),
+	m_requestEvent( NULL )
+{
+	for( int i=0; i<256; ++i )
+	{
+		m_fragments[i].m_holder = NULL;
+		m_fragments[i].m_element = NULL;
+	}
+	memset( m_nodeDirty, 0, sizeof(m_nodeDirty) );
+
+	if( m_delay > 0 )
+	{
+		m_requestEvent = new Event();
+		m_thread = new Thread( "config" );
+		m_thread->Start( ConfigWriter::WriterThreadEntryPoint, this );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::~ConfigWriter>
+// Destructor
+//-----------------------------------------------------------------------------
+ConfigWriter::~ConfigWriter
+(
+)
+{
+	if( m_thread != NULL )
+	{
+		m_thread->Stop();
+		m_thread->Release();
+		m_requestEvent->Release();
+	}
+
+	for( int i=0; i<256; ++i )
+	{
+		DeleteFragment( i );
+	}
+
+	m_dirtyMutex->Release();
+	m_writeMutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::Notify>
+// Mark whatever a notification reports as changed
+//-----------------------------------------------------------------------------
+void ConfigWriter::Notify
+(
+	Notification const* _notification
+)
+{
+	switch( _notification->GetType() )
+	{
+		case Notification::Type_ValueChanged:
+		case Notification::Type_PollingEnabled:
+		case Notification::Type_PollingDisabled:
+		{
+			ValueChanged( _notification->GetValueID() );
+			break;
+		}
+		case Notification::Type_ValueAdded:
+		case Notification::Type_ValueRemoved:
+		case Notification::Type_Group:
+		case Notification::Type_NodeNew:
+		case Notification::Type_NodeAdded:
+		case Notification::Type_NodeRemoved:
+		case Notification::Type_NodeProtocolInfo:
+		case Notification::Type_NodeNaming:
+		case Notification::Type_CreateButton:
+		case Notification::Type_DeleteButton:
+		case Notification::Type_EssentialNodeQueriesComplete:
+		case Notification::Type_NodeQueriesComplete:
+		{
+			NodeChanged( _notification->GetNodeId() );
+			break;
+		}
+		case Notification::Type_DriverReset:
+		{
+			m_dirtyMutex->Lock();
+			memset( m_nodeDirty, 1, sizeof(m_nodeDirty) );
+			m_dirtyMutex->Unlock();
+			break;
+		}
+		default:
+		{
+			// Nothing that is saved has changed
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::NodeChanged>
+// Mark a node for rebuilding at the next save
+//-----------------------------------------------------------------------------
+void ConfigWriter::NodeChanged
+(
+	uint8 const _nodeId
+)
+{
+	m_dirtyMutex->Lock();
+	m_nodeDirty[_nodeId] = true;
+	m_valueDirty[_nodeId].clear();
+	m_dirtyMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::ValueChanged>
+// Mark a value for rewriting at the next save
+//-----------------------------------------------------------------------------
+void ConfigWriter::ValueChanged
+(
+	ValueID const& _valueId
+)
+{
+	uint8 nodeId = _valueId.GetNodeId();
+	m_dirtyMutex->Lock();
+	if( !m_nodeDirty[nodeId] )
+	{
+		m_valueDirty[nodeId].insert( _valueId.GetValueStoreKey() );
+	}
+	m_dirtyMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::RequestWrite>
+// Ask for a save, to be made once requests stop arriving
+//-----------------------------------------------------------------------------
+void ConfigWriter::RequestWrite
+(
+)
+{
+	if( m_thread == NULL )
+	{
+		Write();
+		return;
+	}
+
+	m_dirtyMutex->Lock();
+	m_requested = true;
+	m_dirtyMutex->Unlock();
+	m_requestEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::IsDirty>
+// Determine whether anything has changed since the last save
+//-----------------------------------------------------------------------------
+bool ConfigWriter::IsDirty
+(
+)
+{
+	LockGuard LG( m_dirtyMutex );
+	if( m_requested || !m_written )
+	{
+		return true;
+	}
+	for( int i=0; i<256; ++i )
+	{
+		if( m_nodeDirty[i] || !m_valueDirty[i].empty() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::Stop>
+// Stop the background thread, making any save that is still outstanding
+//-----------------------------------------------------------------------------
+void ConfigWriter::Stop
+(
+)
+{
+	if( m_thread != NULL )
+	{
+		m_thread->Stop();
+	}
+
+	m_dirtyMutex->Lock();
+	bool requested = m_requested;
+	m_dirtyMutex->Unlock();
+	if( requested )
+	{
+		Write();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::WriterThreadEntryPoint>
+// Entry point of the thread that makes requested saves
+//-----------------------------------------------------------------------------
+void ConfigWriter::WriterThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	ConfigWriter* writer = (ConfigWriter*)_context;
+	if( writer )
+	{
+		writer->WriterThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::WriterThreadProc>
+// Wait for a request, let any further requests gather, then save
+//-----------------------------------------------------------------------------
+void ConfigWriter::WriterThreadProc
+(
+	Event* _exitEvent
+)
+{
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;		// Thread must exit.
+	waitObjects[1] = m_requestEvent;	// A save has been requested.
+	WaitSet waitSet( waitObjects, 2 );
+
+	while( true )
+	{
+		if( waitSet.Any() == 0 )
+		{
+			// Exit has been called
+			return;
+		}
+
+		// Keep waiting until no request has arrived for the whole delay, but
+		// save anyway once the first request has waited c_maxDelays delays
+		TimeStamp deadline;
+		deadline.SetTime( m_delay * c_maxDelays );
+		do
+		{
+			m_requestEvent->Reset();
+			int32 wait = deadline.TimeRemaining();
+			if( wait <= 0 )
+			{
+				break;
+			}
+			if( Wait::Single( _exitEvent, ( wait < m_delay ) ? wait : m_delay ) == 0 )
+			{
+				// Any outstanding save is made by Stop
+				return;
+			}
+		}
+		while( Wait::Single( m_requestEvent, 0 ) == 0 );
+
+		Write();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::Write>
+// Save the network file, serializing only what has changed
+//-----------------------------------------------------------------------------
+bool ConfigWriter::Write
+(
+	bool const _full		// = false
+)
+{
+	uint32 homeId = m_driver->GetHomeId();
+	if( !homeId )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Tried to write driver config with no home ID set" );
+		return false;
+	}
+
+	m_writeMutex->Lock();
+
+	// Take the changes made so far.  Anything changed after this is saved next time.
+	bool nodeDirty[256];
+	set<uint32> valueDirty[256];
+	m_dirtyMutex->Lock();
+	memcpy( nodeDirty, m_nodeDirty, sizeof(nodeDirty) );
+	memset( m_nodeDirty, 0, sizeof(m_nodeDirty) );
+	for( int i=0; i<256; ++i )
+	{
+		valueDirty[i].swap( m_valueDirty[i] );
+	}
+	m_requested = false;
+	m_dirtyMutex->Unlock();
+
+	TiXmlElement driverElement( "Driver" );
+	vector<TiXmlElement const*> nodeElements;
+	uint32 rebuilt = 0;
+	uint32 updated = 0;
+	{
+		LockGuard LG( m_driver->m_nodeMutex );
+		m_driver->WriteXML( &driverElement );
+	}
+
+	// Each node is only locked while its own fragment is brought up to date
+	for( int i=0; i<256; ++i )
+	{
+		NodeLockGuard NLG( m_driver->m_nodeMutex, (uint8)i, false );
+		if( m_driver->m_nodes[i] == NULL )
+		{
+			DeleteFragment( i );
+			continue;
+		}
+
+		if( _full || nodeDirty[i] || ( m_fragments[i].m_element == NULL ) )
+		{
+			BuildFragment( i );
+			++rebuilt;
+		}
+		else if( !valueDirty[i].empty() )
+		{
+			if( UpdateFragment( i, valueDirty[i] ) )
+			{
+				updated += (uint32)valueDirty[i].size();
+			}
+			else
+			{
+				BuildFragment( i );
+				++rebuilt;
+			}
+		}
+		nodeElements.push_back( m_fragments[i].m_element );
+	}
+
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+
+	char str[32];
+	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", homeId );
+	string filename = userPath + string(str);
+	string tempFilename = filename + ".tmp";
+
+	// Laid out exactly as TiXmlDocument::SaveFile would lay out the whole document
+	bool res = false;
+	if( FILE* fp = fopen( tempFilename.c_str(), "w" ) )
+	{
+		fprintf( fp, "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n<Driver" );
+		for( TiXmlAttribute const* attribute = driverElement.FirstAttribute(); attribute; attribute = attribute->Next() )
+		{
+			fprintf( fp, " " );
+			attribute->Print( fp, 0 );
+		}
+		if( nodeElements.empty() )
+		{
+			fprintf( fp, " />\n" );
+		}
+		else
+		{
+			fprintf( fp, ">" );
+			for( uint32 i=0; i<nodeElements.size(); ++i )
+			{
+				fprintf( fp, "\n" );
+				nodeElements[i]->Print( fp, 1 );
+			}
+			fprintf( fp, "\n</Driver>\n" );
+		}
+		res = ( ferror( fp ) == 0 );
+		res = ( fclose( fp ) == 0 ) && res;
+	}
+
+	if( res )
+	{
+		res = FileOps::RenameFile( tempFilename, filename );
+	}
+
+	if( !res )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Unable to write network file %s", filename.c_str() );
+		remove( tempFilename.c_str() );
+
+		// The changes taken above were not saved, so save everything next time
+		m_dirtyMutex->Lock();
+		memset( m_nodeDirty, 1, sizeof(m_nodeDirty) );
+		m_dirtyMutex->Unlock();
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, "Wrote %s: %d nodes rebuilt, %d values updated", filename.c_str(), rebuilt, updated );
+		m_dirtyMutex->Lock();
+		m_written = true;
+		m_dirtyMutex->Unlock();
+		if( m_driver->m_bNetworkCache )
+		{
+			snprintf( str, sizeof(str), "zwcfg_0x%08x.cache", homeId );
+			NetworkCache::Write( userPath + string(str), filename, &driverElement, nodeElements, homeId, Driver::c_configVersion );
+		}
+	}
+
+	m_writeMutex->Unlock();
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::BuildFragment>
+// Serialize a node and index its value elements
+//-----------------------------------------------------------------------------
+void ConfigWriter::BuildFragment
+(
+	uint8 const _nodeId
+)
+{
+	DeleteFragment( _nodeId );
+
+	Fragment& fragment = m_fragments[_nodeId];
+	fragment.m_holder = new TiXmlElement( "Driver" );
+	m_driver->m_nodes[_nodeId]->WriteXML( fragment.m_holder );
+	fragment.m_element = fragment.m_holder->FirstChildElement();
+
+	TiXmlElement* ccsElement = fragment.m_element->FirstChildElement( "CommandClasses" );
+	if( ccsElement == NULL )
+	{
+		return;
+	}
+
+	for( TiXmlElement* ccElement = ccsElement->FirstChildElement( "CommandClass" ); ccElement; ccElement = ccElement->NextSiblingElement( "CommandClass" ) )
+	{
+		int commandClassId;
+		if( ccElement->QueryIntAttribute( "id", &commandClassId ) != TIXML_SUCCESS )
+		{
+			continue;
+		}
+
+		for( TiXmlElement* valueElement = ccElement->FirstChildElement( "Value" ); valueElement; valueElement = valueElement->NextSiblingElement( "Value" ) )
+		{
+			int instance;
+			int index;
+			if( ( valueElement->QueryIntAttribute( "instance", &instance ) == TIXML_SUCCESS ) && ( valueElement->QueryIntAttribute( "index", &index ) == TIXML_SUCCESS ) )
+			{
+				fragment.m_values[ValueID::GetValueStoreKey( (uint8)commandClassId, (uint8)instance, (uint8)index )] = valueElement;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::UpdateFragment>
+// Rewrite the elements of a node's changed values in place
+//-----------------------------------------------------------------------------
+bool ConfigWriter::UpdateFragment
+(
+	uint8 const _nodeId,
+	set<uint32> const& _values
+)
+{
+	Fragment& fragment = m_fragments[_nodeId];
+	ValueStore* store = m_driver->m_nodes[_nodeId]->GetValueStore();
+
+	for( set<uint32>::const_iterator it = _values.begin(); it != _values.end(); ++it )
+	{
+		map<uint32,TiXmlElement*>::iterator vit = fragment.m_values.find( *it );
+		if( vit == fragment.m_values.end() )
+		{
+			// The value is new, so its element has to be placed by rebuilding the node
+			return false;
+		}
+
+		Value* value = store->GetValue( *it );
+		if( value == NULL )
+		{
+			return false;
+		}
+
+		// Clear the element out and let the value write it again from scratch, so
+		// that its attributes come out in the same order as in a full rebuild
+		TiXmlElement* valueElement = vit->second;
+		while( TiXmlAttribute const* attribute = valueElement->FirstAttribute() )
+		{
+			valueElement->RemoveAttribute( attribute->Name() );
+		}
+		valueElement->Clear();
+		value->WriteXML( valueElement );
+		value->Release();
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigWriter::DeleteFragment>
+// Discard the saved XML of a node
+//-----------------------------------------------------------------------------
+void ConfigWriter::DeleteFragment
+(
+	uint8 const _nodeId
+)
+{
+	Fragment& fragment = m_fragments[_nodeId];
+	delete fragment.m_holder;
+	fragment.m_holder = NULL;
+	fragment.m_element = NULL;
+	fragment.m_values.clear();
+}
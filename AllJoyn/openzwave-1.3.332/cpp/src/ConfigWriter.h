@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------------------
+//
+//	ConfigWriter.h
+//
+//	Incremental, debounced saving of the zwcfg network file
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ConfigWriter_H
+#define _ConfigWriter_H
+
+#include <map>
+#include <set>
+#include "Defs.h"
+
+class TiXmlElement;
+
+namespace OpenZWave
+{
+	class Driver;
+	class Event;
+	class Mutex;
+	class Notification;
+	class Thread;
+	class ValueID;
+
+	/** \brief Saves a driver's zwcfg network file.
+	 *
+	 *  The XML for each node is kept between saves.  Nodes and values are marked
+	 *  as changed from the notifications the driver sends out, and from changes
+	 *  (such as the query stage or a value's label) that are saved without a
+	 *  notification.  A save only serializes the nodes that have changed, and
+	 *  for a node whose values alone have changed, only those value elements are
+	 *  rewritten.  The file is written to a temporary file which then replaces
+	 *  the original, so an interrupted save never leaves a truncated file.
+	 *
+	 *  Saves requested through RequestWrite are made on a background thread,
+	 *  once no further request has arrived within the configured delay, so a
+	 *  burst of requests results in a single write.  Requests that keep coming
+	 *  put the save off for at most c_maxDelays delays after the first of them.
+	 */
+	class ConfigWriter
+	{
+	public:
+		/**
+		 * Constructor.
+		 * \param _driver the driver whose network is saved.
+		 * \param _delay milliseconds to wait for further requests before saving.  Zero
+		 * makes RequestWrite save at once, on the calling thread.
+		 */
+		ConfigWriter( Driver* _driver, int32 const _delay );
+		~ConfigWriter();
+
+		/**
+		 * Record any change to the saved network that a notification represents.
+		 * Called for each notification as it is sent to the watchers, after the
+		 * change it reports has been made.
+		 */
+		void Notify( Notification const* _notification );
+
+		/**
+		 * Mark a node as changed, so that all of its XML is rebuilt at the next save.
+		 */
+		void NodeChanged( uint8 const _nodeId );
+
+		/**
+		 * Mark a value as changed, so that its element is rewritten at the next save.
+		 */
+		void ValueChanged( ValueID const& _valueId );
+
+		/**
+		 * Ask for the network file to be saved.  Requests are coalesced and
+		 * written by the background thread, unless the delay is zero.
+		 */
+		void RequestWrite();
+
+		/**
+		 * Save the network file now, on the calling thread.
+		 * \param _full if true, the XML of every node is rebuilt, whether or not it
+		 * is known to have changed.
+		 * \return true if the file was written.
+		 */
+		bool Write( bool const _full = false );
+
+		/**
+		 * Determine whether the saved file is out of date: something has changed
+		 * since the last save, a save is pending, or nothing has been saved yet.
+		 */
+		bool IsDirty();
+
+		/**
+		 * Stop the background thread.  Any save that was requested but not yet
+		 * made is made before returning.
+		 */
+		void Stop();
+
+	private:
+		ConfigWriter( ConfigWriter const& );					// prevent copy
+		ConfigWriter& operator = ( ConfigWriter const& );		// prevent assignment
+
+		static void WriterThreadEntryPoint( Event* _exitEvent, void* _context );
+		void WriterThreadProc( Event* _exitEvent );
+
+		// The saved XML of a node.  TinyXML elements cannot be unlinked from their
+		// parent, so each node element is kept under a holder element of its own.
+		struct Fragment
+		{
+			TiXmlElement*				m_holder;
+			TiXmlElement*				m_element;
+			map<uint32,TiXmlElement*>	m_values;			// Value elements, by value store key
+		};
+
+		void BuildFragment( uint8 const _nodeId );
+		bool UpdateFragment( uint8 const _nodeId, set<uint32> const& _values );
+		void DeleteFragment( uint8 const _nodeId );
+
+		Driver*						m_driver;
+		int32						m_delay;
+		static int32 const			c_maxDelays = 5;		// Longest a save is put off by further requests, in delays
+		Fragment					m_fragments[256];
+		Mutex*						m_writeMutex;			// Held for the whole of a save, and protects m_fragments
+
+		Mutex*						m_dirtyMutex;			// Protects the members below.  Never held while another lock is taken.
+		bool						m_nodeDirty[256];
+		set<uint32>					m_valueDirty[256];		// Changed values of each node, by value store key
+		bool						m_requested;			// A save has been requested and not yet made
+		bool						m_written;				// The file has been saved at least once
+
+		Thread*						m_thread;
+		Event*						m_requestEvent;
+	};
+
+} // namespace OpenZWave
+
+#endif //_ConfigWriter_H
@@ -252,6 +252,7 @@ namespace OpenZWave
 
 #define FUNC_ID_ZW_SEND_NODE_INFORMATION				0x12
 #define FUNC_ID_ZW_SEND_DATA						0x13
+#define FUNC_ID_ZW_SEND_DATA_MULTI					0x14
 #define FUNC_ID_ZW_GET_VERSION						0x15
 #define FUNC_ID_ZW_R_F_POWER_LEVEL_SET					0x17
 #define FUNC_ID_ZW_GET_RANDOM						0x1c
@@ -32,13 +32,18 @@
 #include "Msg.h"
 #include "Notification.h"
 #include "Scene.h"
+#include "NetworkCache.h"
+#include "ConfigWriter.h"
+#include "SendQueue.h"
 #include "ZWSecurity.h"
 
 #include "platform/Event.h"
 #include "platform/Mutex.h"
 #include "platform/SerialController.h"
 #include "platform/HidController.h"
+#include "platform/SimulatorController.h"
 #include "platform/Thread.h"
+#include "platform/WaitSet.h"
 #include "platform/Log.h"
 #include "platform/TimeStamp.h"
 
@@ -49,6 +54,7 @@
 #include "command_classes/WakeUp.h"
 #include "command_classes/SwitchAll.h"
 #include "command_classes/ManufacturerSpecific.h"
+#include "command_classes/MultiCmd.h"
 #include "command_classes/NoOperation.h"
 
 #include "value_classes/ValueID.h"
@@ -68,8 +74,17 @@
 #include <algorithm>
 #include <iostream>
 
+#ifdef WIN32
+#define OZW_THREAD_LOCAL __declspec(thread)
+#else
+#define OZW_THREAD_LOCAL __thread
+#endif
+
 using namespace OpenZWave;
 
+// Each thread has its own copy, so its address identifies the calling thread
+static OZW_THREAD_LOCAL char t_threadMarker = 0;
+
 // Version numbering for saved configurations. Any change that will invalidate
 // previously saved configurations must be accompanied by an increment to the
 // version number, and a comment explaining the date of, and reason for, the change.
@@ -78,7 +93,7 @@ using namespace OpenZWave;
 // 02: 01-12-2011 - Command class m_afterMark sense corrected, and attribute named to match.
 // 03: 08-04-2011 - Changed command class instance handling for non-sequential MultiChannel endpoints.
 //
-uint32 const c_configVersion = 3;
+uint32 const Driver::c_configVersion = 3;
 
 static char const* c_libraryTypeNames[] =
 {
@@ -142,6 +157,13 @@ m_init( false ),
 m_awakeNodesQueried( false ),
 m_allNodesQueried( false ),
 m_notifytransactions( false ),
+m_bMultiCmd( true ),
+m_bNetworkCache( true ),
+m_bMulticast( true ),
+m_bMulticastVerify( true ),
+m_bAdaptiveTimeout( true ),
+m_minReplyTimeout( 20 ),
+m_configWriter( NULL ),
 m_controllerInterfaceType( _interface ),
 m_controllerPath( _controllerPath ),
 m_controller( NULL ),
@@ -156,7 +178,8 @@ m_initVersion( 0 ),
 m_initCaps( 0 ),
 m_controllerCaps( 0 ),
 m_Controller_nodeId ( 0 ),
-m_nodeMutex( new Mutex() ),
+m_nodeMutex( new NodeLocks() ),
+m_valueSnapshots( new ValueSnapshotTable() ),
 m_controllerReplication( NULL ),
 m_transmitOptions( TRANSMIT_OPTION_ACK | TRANSMIT_OPTION_AUTO_ROUTE | TRANSMIT_OPTION_EXPLORE ),
 m_waitingForAck( false ),
@@ -165,6 +188,7 @@ m_expectedReply( 0 ),
 m_expectedCommandClassId( 0 ),
 m_expectedNodeId( 0 ),
 m_pollThread( new Thread( "poll" ) ),
+m_pollScheduler( new PollScheduler() ),
 m_pollMutex( new Mutex() ),
 m_pollInterval( 0 ),
 m_bIntervalBetweenPolls( false ),				// if set to true (via SetPollInterval), the pollInterval will be interspersed between each poll (so a much smaller m_pollInterval like 100, 500, or 1,000 may be appropriate)
@@ -173,7 +197,14 @@ m_SUCNodeId( 0 ),
 m_controllerResetEvent( NULL ),
 m_sendMutex( new Mutex() ),
 m_currentMsg( NULL ),
+m_topology( new Topology() ),
+m_latencyStats( NULL ),
 m_virtualNeighborsReceived( false ),
+m_multicastMutex( new Mutex() ),
+m_multicastMsgs( NULL ),
+m_multicastOwner( NULL ),
+m_maxInterviews( 8 ),
+m_interviewCount( 0 ),
 m_notificationsEvent( new Event() ),
 m_SOFCnt( 0 ),
 m_ACKWaiting( 0 ),
@@ -196,20 +227,34 @@ m_nondelivery( 0 ),
 m_routedbusy( 0 ),
 m_broadcastReadCnt( 0 ),
 m_broadcastWriteCnt( 0 ),
+m_multiCmdFrames( 0 ),
+m_multiCmdMessages( 0 ),
+m_multicastFrames( 0 ),
+m_multicastMessages( 0 ),
+m_prefetchedNonces( 0 ),
+m_neighborUpdates( 0 ),
 m_nonceReportSent( 0 ),
-m_nonceReportSentAttempt( 0 )
+m_nonceReportSentAttempt( 0 ),
+m_awaitingNonce( false ),
+AuthKey( NULL ),
+EncryptKey( NULL )
 {
 	// set a timestamp to indicate when this driver started
 	TimeStamp m_startTime;
 
-	// Create the message queue events
+	// Create the message queues and their events.  The command, security and
+	// controller queues hold steps that must run in the order they were queued,
+	// whatever node they are for.  In the others, nodes take turns.
 	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
+		bool perNode = ( MsgQueue_Command != i && MsgQueue_Security != i && MsgQueue_Controller != i );
+		m_msgQueue[i] = new SendQueue( perNode, ( perNode && MsgQueue_NoOp != i ) ? SendQueue::Merge_Messages : SendQueue::Merge_None );
 		m_queueEvent[i] = new Event();
 	}
 
 	// Clear the nodes array
 	memset( m_nodes, 0, sizeof(Node*) * 256 );
+	memset( m_interviewing, 0, sizeof(m_interviewing) );
 
 	// Clear the virtual neighbors array
 	memset( m_virtualNeighbors, 0, NUM_NODE_BITFIELD_BYTES );
@@ -222,15 +267,44 @@ m_nonceReportSentAttempt( 0 )
 	{
 		m_controller = new HidController();
 	}
+	else if( ControllerInterface_Simulator == _interface )
+	{
+		m_controller = new SimulatorController();
+	}
 	else
 	{
 		m_controller = new SerialController();
 	}
-	m_controller->SetSignalThreshold( 1 );
 
 	Options::Get()->GetOptionAsBool( "NotifyTransactions", &m_notifytransactions );
+	Options::Get()->GetOptionAsBool( "MultiCmdEncapsulation", &m_bMultiCmd );
+	Options::Get()->GetOptionAsBool( "NetworkCache", &m_bNetworkCache );
+	Options::Get()->GetOptionAsBool( "Multicast", &m_bMulticast );
+	Options::Get()->GetOptionAsBool( "MulticastVerify", &m_bMulticastVerify );
+	Options::Get()->GetOptionAsBool( "AdaptiveTimeout", &m_bAdaptiveTimeout );
+	Options::Get()->GetOptionAsInt( "MinReplyTimeout", &m_minReplyTimeout );
+	Options::Get()->GetOptionAsInt( "MaxInterviews", &m_maxInterviews );
 	Options::Get()->GetOptionAsInt( "PollInterval", &m_pollInterval );
 	Options::Get()->GetOptionAsBool( "IntervalBetweenPolls", &m_bIntervalBetweenPolls );
+
+	bool checkLocks = false;
+	Options::Get()->GetOptionAsBool( "CheckNodeLocks", &checkLocks );
+	m_nodeMutex->SetChecked( checkLocks );
+
+	int32 neighborUpdateInterval = 0;
+	Options::Get()->GetOptionAsInt( "NeighborUpdateInterval", &neighborUpdateInterval );
+	m_topology->SetUpdateInterval( neighborUpdateInterval );
+
+	bool latencyStatistics = true;
+	Options::Get()->GetOptionAsBool( "LatencyStatistics", &latencyStatistics );
+	if( latencyStatistics )
+	{
+		m_latencyStats = new LatencyStats( c_sendQueueNames, MsgQueue_Count );
+	}
+
+	int32 writeDelay = 0;
+	Options::Get()->GetOptionAsInt( "SaveConfigurationDelay", &writeDelay );
+	m_configWriter = new ConfigWriter( this, writeDelay );
 }
 
 //-----------------------------------------------------------------------------
@@ -247,18 +321,25 @@ Driver::~Driver
 	notification->SetHomeAndNodeIds( m_homeId, 0 );
 	QueueNotification( notification );
 	NotifyWatchers();
+	Manager::Get()->FlushNotifications();
 
 
 	// append final driver stats output to the log file
 	LogDriverStatistics();
 
-	// Save the driver config before deleting anything else
+	// Save the driver config before deleting anything else.  Stopping the
+	// writer makes any save that the application asked for and is still pending,
+	// so the file only needs writing again if something has changed since.
+	m_configWriter->Stop();
 	bool save;
 	if( Options::Get()->GetOptionAsBool( "SaveConfiguration", &save) )
 	{
 		if( save )
 		{
-			WriteConfig();
+			if( m_configWriter->IsDirty() )
+			{
+				WriteConfig( true );
+			}
 			Scene::WriteXML( "zwscene.xml" );
 		}
 	}
@@ -275,6 +356,7 @@ Driver::~Driver
 	m_driverThread->Release();
 
 	m_sendMutex->Release();
+	m_multicastMutex->Release();
 
 	m_controller->Close();
 	m_controller->Release();
@@ -301,13 +383,20 @@ Driver::~Driver
 	}
 	// Don't release until all nodes have removed their poll values
 	m_pollMutex->Release();
+	delete m_pollScheduler;
+	delete m_topology;
+	delete m_latencyStats;
+	delete m_valueSnapshots;
+	delete m_configWriter;
+	delete AuthKey;
+	delete EncryptKey;
 
 	// Clear the send Queue
 	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
-		while( !m_msgQueue[i].empty() )
+		while( !m_msgQueue[i]->IsEmpty() )
 		{
-			MsgQueueItem const& item = m_msgQueue[i].front();
+			MsgQueueItem const& item = m_msgQueue[i]->Front();
 			if( MsgQueueCmd_SendMsg == item.m_command )
 			{
 				delete item.m_msg;
@@ -316,8 +405,9 @@ Driver::~Driver
 			{
 				delete item.m_cci;
 			}
-			m_msgQueue[i].pop_front();
+			m_msgQueue[i]->PopFront();
 		}
+		delete m_msgQueue[i];
 
 		m_queueEvent[i]->Release();
 	}
@@ -335,6 +425,7 @@ Driver::~Driver
 		if( notify )
 		{
 			NotifyWatchers();
+			Manager::Get()->FlushNotifications();
 		}
 	}
 
@@ -403,7 +494,11 @@ void Driver::DriverThreadProc
 			waitObjects[9] = m_queueEvent[MsgQueue_Query];		// Node queries are pending.
 			waitObjects[10] = m_queueEvent[MsgQueue_Poll];		// Poll request is waiting.
 
+			// Register with the objects once, rather than on every pass through the loop
+			WaitSet waitSet( waitObjects, 11 );
+
 			TimeStamp retryTimeStamp;
+			TimeStamp replyTimeStamp;
 			int retryTimeout = RETRY_TIMEOUT;
 			Options::Get()->GetOptionAsInt( "RetryTimeout", &retryTimeout );
 			//retryTimeout = RETRY_TIMEOUT * 10;
@@ -412,6 +507,7 @@ void Driver::DriverThreadProc
 				Log::Write( LogLevel_StreamDetail, "      Top of DriverThreadProc loop." );
 				uint32 count = 11;
 				int32 timeout = Wait::Timeout_Infinite;
+				bool replyTimeout = false;
 
 				// If we're waiting for a message to complete, we can only
 				// handle incoming data, notifications and exit events.
@@ -419,6 +515,17 @@ void Driver::DriverThreadProc
 				{
 					count = 3;
 					timeout = m_waitingForAck ? ACK_TIMEOUT : retryTimeStamp.TimeRemaining();
+					if( !m_waitingForAck && !m_expectedCallbackId && FUNC_ID_APPLICATION_COMMAND_HANDLER == m_expectedReply )
+					{
+						// The controller has delivered the message, so the node's reply
+						// is due within its own round trip time
+						int32 remaining = replyTimeStamp.TimeRemaining();
+						if( remaining < timeout )
+						{
+							timeout = remaining;
+							replyTimeout = true;
+						}
+					}
 					if( timeout < 0 )
 					{
 						timeout = 0;
@@ -431,10 +538,11 @@ void Driver::DriverThreadProc
 				else
 				{
 					Log::QueueClear();							// clear the log queue when starting a new message
+					ScheduleNeighborUpdate();
 				}
 
 				// Wait for something to do
-				int32 res = Wait::Multiple( waitObjects, count, timeout );
+				int32 res = waitSet.Multiple( count, timeout );
 
 				switch( res )
 				{
@@ -448,9 +556,14 @@ void Driver::DriverThreadProc
 							notification->SetNotification( Notification::Code_Timeout );
 							QueueNotification( notification );
 						}
+						if( replyTimeout )
+						{
+							ReplyTimedOut();
+						}
 						if( WriteMsg( "Wait Timeout" ) )
 						{
 							retryTimeStamp.SetTime( retryTimeout );
+							replyTimeStamp.SetTime( GetReplyTimeout( retryTimeout ) );
 						}
 						break;
 					}
@@ -477,6 +590,7 @@ void Driver::DriverThreadProc
 						if( WriteNextMsg( (MsgQueue)(res-3) ) )
 						{
 							retryTimeStamp.SetTime( retryTimeout );
+							replyTimeStamp.SetTime( GetReplyTimeout( retryTimeout ) );
 						}
 						break;
 					}
@@ -574,39 +688,73 @@ void Driver::RemoveQueues
 	// Clear the send Queue
 	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
-		list<MsgQueueItem>::iterator it = m_msgQueue[i].begin();
-		while( it != m_msgQueue[i].end() )
+		list<MsgQueueItem> items;
+		m_msgQueue[i]->Extract( _nodeId, &items, m_currentControllerCommand );
+		for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
 		{
-			bool remove = false;
-			MsgQueueItem const& item = *it;
-			if( MsgQueueCmd_SendMsg == item.m_command && _nodeId == item.m_msg->GetTargetNodeId() )
-			{
-				delete item.m_msg;
-				remove = true;
-			}
-			else if( MsgQueueCmd_QueryStageComplete == item.m_command && _nodeId == item.m_nodeId )
-			{
-				remove = true;
-			}
-			else if( MsgQueueCmd_Controller == item.m_command && _nodeId == item.m_cci->m_controllerCommandNode && m_currentControllerCommand != item.m_cci )
-			{
-				delete item.m_cci;
-				remove = true;
-			}
-			if( remove )
+			if( MsgQueueCmd_SendMsg == it->m_command )
 			{
-				it = m_msgQueue[i].erase( it );
+				delete it->m_msg;
 			}
-			else
+			else if( MsgQueueCmd_Controller == it->m_command )
 			{
-				++it;
+				delete it->m_cci;
 			}
 		}
-		if( m_msgQueue[i].empty() )
+		if( m_msgQueue[i]->IsEmpty() )
+		{
+			m_queueEvent[i]->Reset();
+		}
+	}
+
+	EndInterview( _nodeId );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RemoveValueMsgs>
+// Remove the messages that a newer Set of the same value supersedes
+//-----------------------------------------------------------------------------
+void Driver::RemoveValueMsgs
+(
+		Msg const* _msg
+)
+{
+	uint8 nodeId = _msg->GetTargetNodeId();
+
+	m_sendMutex->Lock();
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		if( m_msgQueue[i]->RemoveValueMsgs( _msg ) && m_msgQueue[i]->IsEmpty() )
 		{
 			m_queueEvent[i]->Reset();
 		}
 	}
+	m_sendMutex->Unlock();
+
+	// Messages for a sleeping node wait in its wake-up queue
+	if( Node* node = GetNodeUnsafe( nodeId ) )
+	{
+		if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+		{
+			wakeUp->RemoveValueMsgs( _msg );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetSendQueueCount>
+// Number of items waiting in the send queues
+//-----------------------------------------------------------------------------
+int32 Driver::GetSendQueueCount
+(
+)const
+{
+	int32 count = 0;
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		count += (int32)m_msgQueue[i]->Size();
+	}
+	return count;
 }
 
 //-----------------------------------------------------------------------------
@@ -631,10 +779,17 @@ bool Driver::ReadConfig
 	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", m_homeId );
 	string filename =  userPath + string(str);
 
+	snprintf( str, sizeof(str), "zwcfg_0x%08x.cache", m_homeId );
+	string cacheFilename = userPath + string(str);
+
+	// Prefer the binary cache, which skips parsing the XML text
 	TiXmlDocument doc;
-	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	if( !m_bNetworkCache || !NetworkCache::Read( cacheFilename, filename, m_homeId, c_configVersion, &doc ) )
 	{
-		return false;
+		if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+		{
+			return false;
+		}
 	}
 
 	TiXmlElement const* driverElement = doc.RootElement();
@@ -718,6 +873,7 @@ bool Driver::ReadConfig
 				uint8 nodeId = (uint8)intVal;
 				Node* node = new Node( m_homeId, nodeId );
 				m_nodes[nodeId] = node;
+				m_topology->AddNode( nodeId );
 
 				Notification* notification = new Notification( Notification::Type_NodeAdded );
 				notification->SetHomeAndNodeIds( m_homeId, nodeId );
@@ -753,67 +909,49 @@ bool Driver::ReadConfig
 
 //-----------------------------------------------------------------------------
 // <Driver::WriteConfig>
-// Write ourselves to an XML document
+// Save the configuration to a file now
 //-----------------------------------------------------------------------------
 void Driver::WriteConfig
 (
+	bool const _full	// = false
 )
 {
-	char str[32];
-
-	if (!m_homeId) {
-		Log::Write( LogLevel_Warning, "WARNING: Tried to write driver config with no home ID set");
-		return;
-	}
+	m_configWriter->Write( _full );
+}
 
-	// Create a new XML document to contain the driver configuration
-	TiXmlDocument doc;
-	TiXmlDeclaration* decl = new TiXmlDeclaration( "1.0", "utf-8", "" );
-	TiXmlElement* driverElement = new TiXmlElement( "Driver" );
-	doc.LinkEndChild( decl );
-	doc.LinkEndChild( driverElement );
+//-----------------------------------------------------------------------------
+// <Driver::WriteXML>
+// Write the attributes of the driver element of the configuration file
+//-----------------------------------------------------------------------------
+void Driver::WriteXML
+(
+	TiXmlElement* _driverElement
+)
+{
+	char str[32];
 
-	driverElement->SetAttribute( "xmlns", "http://code.google.com/p/open-zwave/" );
+	_driverElement->SetAttribute( "xmlns", "http://code.google.com/p/open-zwave/" );
 
 	snprintf( str, sizeof(str), "%d", c_configVersion );
-	driverElement->SetAttribute( "version", str );
+	_driverElement->SetAttribute( "version", str );
 
 	snprintf( str, sizeof(str), "0x%.8x", m_homeId );
-	driverElement->SetAttribute( "home_id", str );
+	_driverElement->SetAttribute( "home_id", str );
 
 	snprintf( str, sizeof(str), "%d", m_Controller_nodeId );
-	driverElement->SetAttribute( "node_id", str );
+	_driverElement->SetAttribute( "node_id", str );
 
 	snprintf( str, sizeof(str), "%d", m_initCaps );
-	driverElement->SetAttribute( "api_capabilities", str );
+	_driverElement->SetAttribute( "api_capabilities", str );
 
 	snprintf( str, sizeof(str), "%d", m_controllerCaps );
-	driverElement->SetAttribute( "controller_capabilities", str );
+	_driverElement->SetAttribute( "controller_capabilities", str );
 
 	snprintf( str, sizeof(str), "%d", m_pollInterval );
-	driverElement->SetAttribute( "poll_interval", str );
+	_driverElement->SetAttribute( "poll_interval", str );
 
 	snprintf( str, sizeof(str), "%s", m_bIntervalBetweenPolls ? "true" : "false" );
-	driverElement->SetAttribute( "poll_interval_between", str );
-
-	{
-		LockGuard LG(m_nodeMutex);
-
-		for( int i=0; i<256; ++i )
-		{
-			if( m_nodes[i] )
-			{
-				m_nodes[i]->WriteXML( driverElement );
-			}
-		}
-	}
-	string userPath;
-	Options::Get()->GetOptionAsString( "UserPath", &userPath );
-
-	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", m_homeId );
-	string filename =  userPath + string(str);
-
-	doc.SaveFile( filename.c_str() );
+	_driverElement->SetAttribute( "poll_interval_between", str );
 }
 
 //-----------------------------------------------------------------------------
@@ -846,7 +984,7 @@ Node* Driver::GetNode
 		uint8 _nodeId
 )
 {
-	if (m_nodeMutex->IsSignalled()) {
+	if (!m_nodeMutex->IsLocked(_nodeId)) {
 		Log::Write(LogLevel_Error, _nodeId, "Driver Thread is Not Locked during Call to GetNode");
 		return NULL;
 	}
@@ -878,7 +1016,7 @@ void Driver::SendQueryStageComplete
 	item.m_queryStage = _stage;
 	item.m_retry = false;
 
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		if( !node->IsListeningDevice() )
@@ -899,7 +1037,7 @@ void Driver::SendQueryStageComplete
 		// Non-sleeping node
 		Log::Write( LogLevel_Detail, node->GetNodeId(), "Queuing (%s) Query Stage Complete (%s)", c_sendQueueNames[MsgQueue_Query], node->GetQueryStageName( _stage ).c_str() );
 		m_sendMutex->Lock();
-		m_msgQueue[MsgQueue_Query].push_back( item );
+		m_msgQueue[MsgQueue_Query]->PushBack( item );
 		m_queueEvent[MsgQueue_Query]->Set();
 		m_sendMutex->Unlock();
 
@@ -923,13 +1061,9 @@ void Driver::RetryQueryStageComplete
 
 	m_sendMutex->Lock();
 
-	for( list<MsgQueueItem>::iterator it = m_msgQueue[MsgQueue_Query].begin(); it != m_msgQueue[MsgQueue_Query].end(); ++it )
+	if( MsgQueueItem* queued = m_msgQueue[MsgQueue_Query]->Find( item ) )
 	{
-		if( *it == item )
-		{
-			(*it).m_retry = true;
-			break;
-		}
+		queued->m_retry = true;
 	}
 	m_sendMutex->Unlock();
 }
@@ -951,10 +1085,22 @@ void Driver::SendMsg
 	/* make sure the HomeId is Set on this message */
 	_msg->SetHomeId(m_homeId);
 	_msg->Finalize();
+	if( m_latencyStats != NULL && _msg->GetQueuedTime() == 0 )
 	{
-		LockGuard LG(m_nodeMutex);
+		_msg->SetQueuedTime( m_latencyStats->Now() );
+	}
+	{
+		NodeLockGuard NLG( m_nodeMutex, _msg->GetTargetNodeId(), false );
 		if( Node* node = GetNode(_msg->GetTargetNodeId()) )
 		{
+			// Tag messages queued by Value::Set, so that a later Set of the same value can replace them,
+			// and replace any that this message makes out of date
+			if( node->m_setValueKey != 0 )
+			{
+				_msg->SetValueKey( node->m_setValueKey );
+				RemoveValueMsgs( _msg );
+			}
+
 			/* if the node Supports the Security Class - check if this message is meant to be encapsulated */
 			if ( node->GetCommandClass(Security::StaticGetCommandClassId() ) )
 			{
@@ -995,9 +1141,17 @@ void Driver::SendMsg
 			}
 		}
 	}
-	Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[_queue], _msg->GetAsString().c_str() );
 	m_sendMutex->Lock();
-	m_msgQueue[_queue].push_back( item );
+	if( m_multicastMsgs != NULL && MsgQueue_Send == _queue && 0xff != _msg->GetTargetNodeId() && m_multicastOwner == &t_threadMarker )
+	{
+		// Queued by the thread collecting the batch.  Held until EndMulticast, which decides how it is sent.
+		Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Holding for multicast %s", _msg->GetAsString().c_str() );
+		m_multicastMsgs->push_back( _msg );
+		m_sendMutex->Unlock();
+		return;
+	}
+	Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[_queue], _msg->GetAsString().c_str() );
+	m_msgQueue[_queue]->PushBack( item );
 	m_queueEvent[_queue]->Set();
 	m_sendMutex->Unlock();
 }
@@ -1014,15 +1168,19 @@ bool Driver::WriteNextMsg
 
 	// There are messages to send, so get the one at the front of the queue
 	m_sendMutex->Lock();
-	MsgQueueItem item = m_msgQueue[_queue].front();
+	MsgQueueItem item = m_msgQueue[_queue]->Front();
 
 	if( MsgQueueCmd_SendMsg == item.m_command )
 	{
 		// Send a message
 		m_currentMsg = item.m_msg;
 		m_currentMsgQueueSource = _queue;
-		m_msgQueue[_queue].pop_front();
-		if( m_msgQueue[_queue].empty() )
+		m_msgQueue[_queue]->PopFront();
+		if( m_bMultiCmd && ( MsgQueue_WakeUp == _queue || MsgQueue_Send == _queue || MsgQueue_Query == _queue || MsgQueue_Poll == _queue ) )
+		{
+			m_currentMsg = EncapsulateMultiCmd( _queue, m_currentMsg );
+		}
+		if( m_msgQueue[_queue]->IsEmpty() )
 		{
 			m_queueEvent[_queue]->Reset();
 		}
@@ -1035,8 +1193,8 @@ bool Driver::WriteNextMsg
 		// Move to the next query stage
 		m_currentMsg = NULL;
 		Node::QueryStage stage = item.m_queryStage;
-		m_msgQueue[_queue].pop_front();
-		if( m_msgQueue[_queue].empty() )
+		m_msgQueue[_queue]->PopFront();
+		if( m_msgQueue[_queue]->IsEmpty() )
 		{
 			m_queueEvent[_queue]->Reset();
 		}
@@ -1064,8 +1222,8 @@ bool Driver::WriteNextMsg
 		if ( m_currentControllerCommand->m_controllerCommandDone )
 		{
 			m_sendMutex->Lock();
-			m_msgQueue[_queue].pop_front();
-			if( m_msgQueue[_queue].empty() )
+			m_msgQueue[_queue]->PopFront();
+			if( m_msgQueue[_queue]->IsEmpty() )
 			{
 				m_queueEvent[_queue]->Reset();
 			}
@@ -1104,6 +1262,63 @@ bool Driver::WriteNextMsg
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::EncapsulateMultiCmd>
+// Pack the messages at the front of a queue for one node into a single frame
+//-----------------------------------------------------------------------------
+Msg* Driver::EncapsulateMultiCmd
+(
+		MsgQueue const _queue,
+		Msg* _msg
+)
+{
+	// Called with m_sendMutex held
+	uint8 nodeId = _msg->GetTargetNodeId();
+	Node* node = GetNodeUnsafe( nodeId );
+	if( node == NULL )
+	{
+		return _msg;
+	}
+	CommandClass* cc = node->GetCommandClass( MultiCmd::StaticGetCommandClassId() );
+	if( cc == NULL || cc->IsAfterMark() )
+	{
+		return _msg;
+	}
+
+	uint32 length = 0;
+	if( !MultiCmd::CanEncapsulate( _msg, &length ) )
+	{
+		return _msg;
+	}
+
+	// Only messages that immediately follow this one in the node's queue are
+	// taken, so that the order of commands and query stage markers is not changed.
+	list<Msg*> msgs;
+	msgs.push_back( _msg );
+	MsgQueueItem* item = m_msgQueue[_queue]->NodeFront( nodeId );
+	while( item != NULL && MsgQueueCmd_SendMsg == item->m_command && MultiCmd::CanEncapsulate( item->m_msg, &length ) )
+	{
+		msgs.push_back( item->m_msg );
+		m_msgQueue[_queue]->PopNodeFront( nodeId );
+		item = m_msgQueue[_queue]->NodeFront( nodeId );
+	}
+	if( msgs.size() < 2 )
+	{
+		return _msg;
+	}
+
+	Msg* msg = MultiCmd::Encapsulate( m_homeId, msgs );
+	msg->SetQueuedTime( _msg->GetQueuedTime() );
+	Log::Write( LogLevel_Detail, nodeId, "Encapsulating %d messages in %s", (int)msgs.size(), msg->GetAsString().c_str() );
+	for( list<Msg*>::iterator mit = msgs.begin(); mit != msgs.end(); ++mit )
+	{
+		delete *mit;
+	}
+	m_multiCmdFrames++;
+	m_multiCmdMessages += (uint32)msgs.size();
+	return msg;
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::WriteMsg>
 // Transmit the current message to the Z-Wave controller
@@ -1137,7 +1352,7 @@ bool Driver::WriteMsg
 		attempts = m_currentMsg->GetSendAttempts();
 		nodeId = m_currentMsg->GetTargetNodeId();
 	}
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, nodeId, true );
 	Node* node = GetNode( nodeId );
 	if( attempts >= m_currentMsg->GetMaxSendAttempts() ||
 			(node != NULL && !node->IsNodeAlive() && !m_currentMsg->IsNoOperation() ) )
@@ -1151,6 +1366,11 @@ bool Driver::WriteMsg
 			// That's it - already tried to send GetMaxSendAttempt() times.
 			Log::Write( LogLevel_Error, nodeId, "ERROR: Dropping command, expected response not received after %d attempt(s)", m_currentMsg->GetMaxSendAttempts() );
 		}
+		if( MsgQueue_Poll == m_currentMsgQueueSource )
+		{
+			// A report that arrives later is not the reply to this poll
+			m_pollScheduler->Unanswered( m_homeId, m_currentMsg->GetTargetNodeId() );
+		}
 		RemoveCurrentMsg();
 		m_dropped++;
 		return false;
@@ -1202,8 +1422,22 @@ bool Driver::WriteMsg
 			Log::Write( LogLevel_Info, nodeId, "Processing (%s) Encrypted message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
 			SendEncryptedMessage();
 		} else {
-			Log::Write( LogLevel_Info, nodeId, "Processing (%s) Nonce Request message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x)", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply);
-			SendNonceRequest(m_currentMsg->GetLogText());
+			uint8 nonce[8];
+			if( node != NULL && node->TakePeerNonce( nonce ) )
+			{
+				// The node sent a nonce with its reply to our last message, so
+				// there is no need to ask for one
+				m_prefetchedNonces++;
+				m_currentMsg->setNonce( nonce );
+				m_expectedCallbackId = m_currentMsg->GetCallbackId();
+				Log::Write( LogLevel_Info, nodeId, "Processing (%s) Encrypted message with prefetched nonce (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
+				SendEncryptedMessage();
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, nodeId, "Processing (%s) Nonce Request message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x)", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply);
+				SendNonceRequest(m_currentMsg->GetLogText());
+			}
 		}
 	} else {
 		Log::Write( LogLevel_Info, nodeId, "Sending (%s) message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
@@ -1211,6 +1445,12 @@ bool Driver::WriteMsg
 	}
 	m_writeCnt++;
 
+	if( m_latencyStats != NULL && m_nonceReportSent == 0 )
+	{
+		// Only the first attempt has waited in the queue
+		m_latencyStats->Sent( nodeId, m_currentMsg->GetSendingCommandClass(), m_currentMsgQueueSource, attempts == 1 ? m_currentMsg->GetQueuedTime() : 0 );
+	}
+
 	if( nodeId == 0xff )
 	{
 		m_broadcastWriteCnt++; // not accurate since library uses 0xff for the controller too
@@ -1245,9 +1485,20 @@ void Driver::RemoveCurrentMsg
 	Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Removing current message" );
 	if( m_currentMsg != NULL)
 	{
+		if( m_currentMsg->GetSendAttempts() > 1 )
+		{
+			// Charge the node for its retries, so that other nodes get their turns
+			m_sendMutex->Lock();
+			m_msgQueue[m_currentMsgQueueSource]->Charge( m_currentMsg->GetTargetNodeId(), m_currentMsg->GetSendAttempts() - 1 );
+			m_sendMutex->Unlock();
+		}
 		delete m_currentMsg;
 		m_currentMsg = NULL;
 	}
+	if( m_latencyStats != NULL )
+	{
+		m_latencyStats->Finished();
+	}
 
 	m_expectedCallbackId = 0;
 	m_expectedCommandClassId = 0;
@@ -1256,6 +1507,7 @@ void Driver::RemoveCurrentMsg
 	m_waitingForAck = false;
 	m_nonceReportSent = 0;
 	m_nonceReportSentAttempt = 0;
+	m_awaitingNonce = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -1325,61 +1577,40 @@ bool Driver::MoveMessagesToWakeUpQueue
 					// Now the message queues
 					for( int i=0; i<MsgQueue_Count; ++i )
 					{
-						list<MsgQueueItem>::iterator it = m_msgQueue[i].begin();
-						while( it != m_msgQueue[i].end() )
+						list<MsgQueueItem> items;
+						m_msgQueue[i]->Extract( _targetNodeId, &items );
+						for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
 						{
-							bool remove = false;
 							MsgQueueItem const& item = *it;
 							if( MsgQueueCmd_SendMsg == item.m_command )
 							{
-								if( _targetNodeId == item.m_msg->GetTargetNodeId() )
-								{
-									// This message is for the unresponsive node
-									// We do not move any "Wake Up No More Information"
-									// commands or NoOperations to the pending queue.
-									if( !item.m_msg->IsWakeUpNoMoreInformationCommand() && !item.m_msg->IsNoOperation() )
-									{
-										Log::Write( LogLevel_Info, item.m_msg->GetTargetNodeId(), "Node not responding - moving message to Wake-Up queue: %s", item.m_msg->GetAsString().c_str() );
-										wakeUp->QueueMsg( item );
-									}
-									else
-									{
-										delete item.m_msg;
-									}
-									remove = true;
-								}
-							}
-							if( MsgQueueCmd_QueryStageComplete == item.m_command )
-							{
-								if( _targetNodeId == item.m_nodeId )
+								// This message is for the unresponsive node
+								// We do not move any "Wake Up No More Information"
+								// commands or NoOperations to the pending queue.
+								if( !item.m_msg->IsWakeUpNoMoreInformationCommand() && !item.m_msg->IsNoOperation() )
 								{
-									Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving QueryStageComplete command to Wake-Up queue" );
+									Log::Write( LogLevel_Info, item.m_msg->GetTargetNodeId(), "Node not responding - moving message to Wake-Up queue: %s", item.m_msg->GetAsString().c_str() );
 									wakeUp->QueueMsg( item );
-									remove = true;
 								}
-							}
-							if( MsgQueueCmd_Controller == item.m_command )
-							{
-								if( _targetNodeId == item.m_cci->m_controllerCommandNode )
+								else
 								{
-									Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving controller command to Wake-Up queue: %s", c_controllerCommandNames[item.m_cci->m_controllerCommand] );
-									wakeUp->QueueMsg( item );
-									remove = true;
+									delete item.m_msg;
 								}
 							}
-
-							if( remove )
+							if( MsgQueueCmd_QueryStageComplete == item.m_command )
 							{
-								it = m_msgQueue[i].erase( it );
+								Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving QueryStageComplete command to Wake-Up queue" );
+								wakeUp->QueueMsg( item );
 							}
-							else
+							if( MsgQueueCmd_Controller == item.m_command )
 							{
-								++it;
+								Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving controller command to Wake-Up queue: %s", c_controllerCommandNames[item.m_cci->m_controllerCommand] );
+								wakeUp->QueueMsg( item );
 							}
 						}
 
 						// If the queue is now empty, we need to clear its event
-						if( m_msgQueue[i].empty() )
+						if( m_msgQueue[i]->IsEmpty() )
 						{
 							m_queueEvent[i]->Reset();
 						}
@@ -1393,7 +1624,7 @@ bool Driver::MoveMessagesToWakeUpQueue
 						item.m_command = MsgQueueCmd_Controller;
 						item.m_cci = new ControllerCommandItem( *m_currentControllerCommand );
 						m_currentControllerCommand = item.m_cci;
-						m_msgQueue[MsgQueue_Controller].push_back( item );
+						m_msgQueue[MsgQueue_Controller]->PushBack( item );
 						m_queueEvent[MsgQueue_Controller]->Set();
 					}
 
@@ -1538,6 +1769,108 @@ void Driver::CheckCompletedNodeQueries
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::GetReplyTimeout>
+// Time to wait for the node's reply to the current message
+//-----------------------------------------------------------------------------
+int32 Driver::GetReplyTimeout
+(
+		int32 const _retryTimeout
+)
+{
+	// Encrypted messages wait for a nonce before the message itself is sent,
+	// so their round trip is not comparable
+	if( !m_bAdaptiveTimeout || m_currentMsg == NULL || FUNC_ID_APPLICATION_COMMAND_HANDLER != m_expectedReply || m_currentMsg->isEncrypted() )
+	{
+		return _retryTimeout;
+	}
+
+	NodeLockGuard NLG( m_nodeMutex, m_expectedNodeId, false );
+	Node* node = GetNode( m_expectedNodeId );
+	if( node == NULL || 0 == node->m_smoothedResponseRTT )
+	{
+		// Nothing has been measured yet
+		return _retryTimeout;
+	}
+
+	int32 timeout = ( node->m_smoothedResponseRTT >> 3 ) + node->m_responseRTTDeviation;
+	// A node with no known route may be at any distance
+	uint8 hops = m_topology->GetHopCount( m_expectedNodeId );
+	int32 minimum = m_minReplyTimeout * ( hops ? hops : Topology::c_maxHops );
+	if( timeout < minimum )
+	{
+		timeout = minimum;
+	}
+
+	// Back off on each further attempt
+	for( uint8 i=1; i<m_currentMsg->GetSendAttempts() && timeout < _retryTimeout; ++i )
+	{
+		timeout <<= 1;
+	}
+	if( timeout > _retryTimeout )
+	{
+		timeout = _retryTimeout;
+	}
+	return timeout;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::UpdateReplyRTT>
+// Add a measured response round trip time to a node's estimate
+//-----------------------------------------------------------------------------
+void Driver::UpdateReplyRTT
+(
+		Node* _node,
+		int32 const _rtt
+)
+{
+	int32 rtt = ( _rtt > 0 ) ? _rtt : 1;
+	if( _node->m_smoothedResponseRTT )
+	{
+		// As RFC 6298, with gains of 1/8 for the average and 1/4 for the deviation.
+		// The average is kept scaled by 8 and the deviation by 4.
+		int32 error = rtt - ( _node->m_smoothedResponseRTT >> 3 );
+		_node->m_smoothedResponseRTT += error;
+		if( error < 0 )
+		{
+			error = -error;
+		}
+		_node->m_responseRTTDeviation += error - ( _node->m_responseRTTDeviation >> 2 );
+	}
+	else
+	{
+		_node->m_smoothedResponseRTT = rtt << 3;
+		_node->m_responseRTTDeviation = rtt << 1;
+	}
+	Log::Write( LogLevel_Detail, _node->GetNodeId(), "Smoothed Response RTT %d Deviation %d", _node->m_smoothedResponseRTT >> 3, _node->m_responseRTTDeviation >> 2 );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReplyTimedOut>
+// Widen the estimate of a node that did not reply within its adaptive timeout
+//-----------------------------------------------------------------------------
+void Driver::ReplyTimedOut
+(
+)
+{
+	if( m_currentMsg == NULL )
+	{
+		return;
+	}
+
+	NodeLockGuard NLG( m_nodeMutex, m_currentMsg->GetTargetNodeId(), true );
+	if( Node* node = GetNode( m_currentMsg->GetTargetNodeId() ) )
+	{
+		// The reply to a retransmission is not measured, so a node that has become
+		// slower would otherwise keep timing out at the old estimate
+		Log::Write( LogLevel_Info, node->GetNodeId(), "No reply within the adaptive timeout" );
+		if( node->m_responseRTTDeviation < ( RETRY_TIMEOUT << 2 ) )
+		{
+			node->m_responseRTTDeviation <<= 1;
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::IsExpectedReply>
 // Determine if the reply is from the node we are expecting.
@@ -1587,14 +1920,15 @@ bool Driver::ReadMsg
 (
 )
 {
-	uint8 buffer[1024] = {0};
-
-	if( !m_controller->Read( buffer, 1 ) )
+	// The controller's read thread has already assembled and checked the frame
+	FrameQueue::Frame* frame = m_controller->GetFrame();
+	if( frame == NULL )
 	{
 		// Nothing to read
 		return false;
 	}
 
+	uint8* buffer = frame->m_data;
 	switch( buffer[0] )
 	{
 		case SOF:
@@ -1609,59 +1943,24 @@ bool Driver::ReadMsg
 				m_ACKWaiting++;
 			}
 
-			// Read the length byte.  Keep trying until we get it.
-			m_controller->SetSignalThreshold( 1 );
-			int32 response = Wait::Single( m_controller, 50 );
-			if( response < 0 )
-			{
-				Log::Write( LogLevel_Warning, "WARNING: 50ms passed without finding the length byte...aborting frame read");
-				m_readAborts++;
-				break;
-			}
-
-			m_controller->Read( &buffer[1], 1 );
-			m_controller->SetSignalThreshold( buffer[1] );
-			if( Wait::Single( m_controller, 500 ) < 0 )
+			if( frame->m_status == FrameQueue::Frame::Status_Aborted )
 			{
-				Log::Write( LogLevel_Warning, "WARNING: 500ms passed without reading the rest of the frame...aborting frame read" );
+				Log::Write( LogLevel_Warning, "WARNING: %dms passed without reading the rest of the frame...aborting frame read", FrameQueue::c_frameTimeout );
 				m_readAborts++;
-				m_controller->SetSignalThreshold( 1 );
 				break;
 			}
 
-			m_controller->Read( &buffer[2], buffer[1] );
-			m_controller->SetSignalThreshold( 1 );
-
-			uint32 length = buffer[1] + 2;
-
-			// Log the data
-			string str = "";
-			for( uint32 i=0; i<length; ++i )
-			{
-				if( i )
-				{
-					str += ", ";
-				}
+			uint32 length = frame->m_length;
 
-				char byteStr[8];
-				snprintf( byteStr, sizeof(byteStr), "0x%.2x", buffer[i] );
-				str += byteStr;
-			}
+			// Log the data.  The bytes are only rendered if Detail is being logged.
 			uint8 nodeId = NodeFromMessage( buffer );
 			if( nodeId == 0 )
 			{
 				nodeId = GetNodeNumber( m_currentMsg );
 			}
-			Log::Write( LogLevel_Detail, nodeId, "  Received: %s", str.c_str() );
-
-			// Verify checksum
-			uint8 checksum = 0xff;
-			for( uint32 i=1; i<(length-1); ++i )
-			{
-				checksum ^= buffer[i];
-			}
+			Log::WriteFrame( LogLevel_Detail, nodeId, "  Received: ", buffer, length );
 
-			if( buffer[length-1] == checksum )
+			if( frame->m_status == FrameQueue::Frame::Status_Ok )
 			{
 				// Checksum correct - send ACK
 				uint8 ack = ACK;
@@ -1723,6 +2022,10 @@ bool Driver::ReadMsg
 			else
 			{
 				Log::Write( LogLevel_StreamDetail, GetNodeNumber( m_currentMsg ), "  ACK received CallbackId 0x%.2x Reply 0x%.2x", m_expectedCallbackId, m_expectedReply );
+				if( m_latencyStats != NULL )
+				{
+					m_latencyStats->Acked();
+				}
 				if( ( 0 == m_expectedCallbackId ) && ( 0 == m_expectedReply ) )
 				{
 					// Remove the message from the queue, now that it has been acknowledged.
@@ -1743,6 +2046,7 @@ bool Driver::ReadMsg
 		}
 	}
 
+	m_controller->ReleaseFrame( frame );
 	return true;
 }
 
@@ -1765,9 +2069,22 @@ void Driver::ProcessMsg
 		if (SecurityCmd_NonceReport == _data[6]) {
 			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceReport from node %d", _data[3] );
 
-			// No Need to triger a WriteMsg here - It should be handled automatically
-			m_currentMsg->setNonce(&_data[7]);
-			this->SendEncryptedMessage();
+			if( m_awaitingNonce && m_currentMsg != NULL && m_currentMsg->GetTargetNodeId() == _data[3] )
+			{
+				// No Need to triger a WriteMsg here - It should be handled automatically
+				m_currentMsg->setNonce(&_data[7]);
+				this->SendEncryptedMessage();
+			}
+			else
+			{
+				// Not asked for by the current message, so it is the reply to a
+				// MessageEncapNonceGet.  Keep it for the next message to the node.
+				NodeLockGuard NLG( m_nodeMutex, _data[3], true );
+				if( Node* node = GetNode( _data[3] ) )
+				{
+					node->SetPeerNonce( &_data[7] );
+				}
+			}
 			return;
 
 			/* if this is a NONCE Get - Then call to the CC directly, process it, and then bail out. */
@@ -1775,7 +2092,7 @@ void Driver::ProcessMsg
 			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceGet from node %d", _data[3] );
 			{
 				uint8 *nonce = NULL;
-				LockGuard LG(m_nodeMutex);
+				NodeLockGuard NLG( m_nodeMutex, _data[3], true );
 				Node* node = GetNode( _data[3] );
 				if( node ) {
 					nonce = node->GenerateNonceKey();
@@ -1802,7 +2119,7 @@ void Driver::ProcessMsg
 
 			/* make sure the Node Exists, and it has the Security CC */
 			{
-				LockGuard LG(m_nodeMutex);
+				NodeLockGuard NLG( m_nodeMutex, _data[3], false );
 				Node* node = GetNode( _data[3] );
 				if( node ) {
 					_nonce = node->GetNonceKey(_data[_data[4]-4]);
@@ -1829,7 +2146,7 @@ void Driver::ProcessMsg
 				if (SecurityCmd_MessageEncapNonceGet == _data[6])
 				{
 					Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_MessageEncapNonceGet from node %d - Sending New Nonce", _data[3] );
-					LockGuard LG(m_nodeMutex);
+					NodeLockGuard NLG( m_nodeMutex, _data[3], true );
 					Node* node = GetNode( _data[3] );
 					if( node ) {
 						_nonce = node->GenerateNonceKey();
@@ -1886,6 +2203,19 @@ void Driver::ProcessMsg
 				handleCallback = false;			// Skip the callback handling - a subsequent FUNC_ID_ZW_SEND_DATA request will deal with that
 				break;
 			}
+			case FUNC_ID_ZW_SEND_DATA_MULTI:
+			{
+				HandleSendDataMultiResponse( _data );
+				if( _data[2] )
+				{
+					handleCallback = false;		// Skip the callback handling - a subsequent FUNC_ID_ZW_SEND_DATA_MULTI request will deal with that
+				}
+				else
+				{
+					m_expectedCallbackId = 0;		// The callback message won't be coming, so this response completes the transaction
+				}
+				break;
+			}
 			case FUNC_ID_ZW_GET_VERSION:
 			{
 				Log::Write( LogLevel_Detail, "" );
@@ -2096,6 +2426,11 @@ void Driver::ProcessMsg
 				HandleSendDataRequest( _data, false );
 				break;
 			}
+			case FUNC_ID_ZW_SEND_DATA_MULTI:
+			{
+				HandleSendDataMultiRequest( _data );
+				break;
+			}
 			case FUNC_ID_ZW_REPLICATION_COMMAND_COMPLETE:
 			{
 				if( m_controllerReplication )
@@ -2239,6 +2574,10 @@ void Driver::ProcessMsg
 				{
 					Log::Write( LogLevel_Detail, _data[3], "  Expected callbackId was received" );
 					m_expectedCallbackId = 0;
+					if( m_latencyStats != NULL )
+					{
+						m_latencyStats->CalledBack();
+					}
 				} else if (_data[2] == 0x02 || _data[2] == 0x01) {
 					/* it was a NONCE request/reply. Drop it */
 					return;
@@ -2250,9 +2589,14 @@ void Driver::ProcessMsg
 				{
 					if( m_expectedCommandClassId && ( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER ) )
 					{
-						if( m_expectedCallbackId == 0 && m_expectedCommandClassId == _data[5] && m_expectedNodeId == _data[3] )
+						bool match = ( m_expectedCommandClassId == _data[5] ) || ( MultiCmd::StaticGetCommandClassId() == _data[5] && MultiCmd::Contains( &_data[6], _data[4]-1, m_expectedCommandClassId ) );
+						if( m_expectedCallbackId == 0 && match && m_expectedNodeId == _data[3] )
 						{
 							Log::Write( LogLevel_Detail, _data[3], "  Expected reply and command class was received" );
+							if( m_latencyStats != NULL )
+							{
+								m_latencyStats->Reported();
+							}
 							m_waitingForAck = false;
 							m_expectedReply = 0;
 							m_expectedCommandClassId = 0;
@@ -2265,6 +2609,10 @@ void Driver::ProcessMsg
 
 						{
 							Log::Write( LogLevel_Detail, _data[3], "  Expected reply was received" );
+							if( m_latencyStats != NULL && m_expectedCallbackId == 0 )
+							{
+								m_latencyStats->Reported();
+							}
 							m_expectedReply = 0;
 							m_expectedNodeId = 0;
 						}
@@ -2541,6 +2889,20 @@ void Driver::HandleMemoryGetIdResponse
 	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_MEMORY_GET_ID. Home ID = 0x%02x%02x%02x%02x.  Our node ID = %d", _data[2], _data[3], _data[4], _data[5], _data[6] );
 	m_homeId = ( ( (uint32)_data[2] )<<24 ) | ( ( (uint32)_data[3] )<<16 ) | ( ( (uint32)_data[4] )<<8 ) | ( (uint32)_data[5] );
 	m_Controller_nodeId = _data[6];
+	m_topology->SetController( m_Controller_nodeId );
+	if( m_latencyStats != NULL )
+	{
+		string exportPath;
+		Options::Get()->GetOptionAsString( "LatencyExportPath", &exportPath );
+		int32 exportInterval = 0;
+		Options::Get()->GetOptionAsInt( "LatencyExportInterval", &exportInterval );
+		if( !exportPath.empty() )
+		{
+			char str[32];
+			snprintf( str, sizeof(str), "ozw_latency_0x%08x.prom", m_homeId );
+			m_latencyStats->StartExport( exportPath + string(str), exportInterval, m_homeId );
+		}
+	}
 	m_controllerReplication = static_cast<ControllerReplication*>(ControllerReplication::Create( m_homeId, m_Controller_nodeId ));
 }
 
@@ -2627,6 +2989,7 @@ void Driver::HandleSerialAPIGetInitDataResponse
 						Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Removed", nodeId );
 						delete m_nodes[nodeId];
 						m_nodes[nodeId] = NULL;
+						m_topology->RemoveNode( nodeId );
 						Notification* notification = new Notification( Notification::Type_NodeRemoved );
 						notification->SetHomeAndNodeIds( m_homeId, nodeId );
 						QueueNotification( notification );
@@ -2878,6 +3241,7 @@ void Driver::HandleGetRoutingInfoResponse
 	{
 		// copy the 29-byte bitmap received (29*8=232 possible nodes) into this node's neighbors member variable
 		memcpy( node->m_neighbors, &_data[2], 29 );
+		m_topology->SetNeighbors( node->GetNodeId(), &_data[2] );
 		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Neighbors of this node are:" );
 		bool bNeighbors = false;
 		for( int by=0; by<29; by++ )
@@ -2925,10 +3289,12 @@ void Driver::HandleSendDataRequest
 			if( _data[3] != 0 )
 			{
 				node->m_sentFailed++;
+				m_topology->Failed( nodeId );
 			}
 			else
 			{
 				node->m_lastRequestRTT = -node->m_sentTS.TimeRemaining();
+				m_topology->Delivered( nodeId, (int32)node->m_lastRequestRTT );
 
 				if( node->m_averageRequestRTT )
 				{
@@ -3173,6 +3539,7 @@ void Driver::HandleRemoveNodeFromNetworkRequest
 					LockGuard LG(m_nodeMutex);
 					delete m_nodes[m_currentControllerCommand->m_controllerCommandNode];
 					m_nodes[m_currentControllerCommand->m_controllerCommandNode] = NULL;
+					m_topology->RemoveNode( m_currentControllerCommand->m_controllerCommandNode );
 					LG.Unlock();
 
 					Notification* notification = new Notification( Notification::Type_NodeRemoved );
@@ -3322,6 +3689,7 @@ void Driver::HandleRemoveFailedNodeRequest
 			LockGuard LG(m_nodeMutex);
 			delete m_nodes[m_currentControllerCommand->m_controllerCommandNode];
 			m_nodes[m_currentControllerCommand->m_controllerCommandNode] = NULL;
+			m_topology->RemoveNode( m_currentControllerCommand->m_controllerCommandNode );
 			LG.Unlock();
 
 			Notification* notification = new Notification( Notification::Type_NodeRemoved );
@@ -3445,6 +3813,11 @@ void Driver::HandleApplicationCommandHandlerRequest
 				node->m_averageResponseRTT = node->m_lastResponseRTT;
 			}
 			Log::Write(LogLevel_Info, nodeId, "Response RTT %d Average Response RTT %d", node->m_lastResponseRTT, node->m_averageResponseRTT );
+			if( m_currentMsg != NULL && 1 == m_currentMsg->GetSendAttempts() )
+			{
+				// A reply after a retransmission could be to either attempt, so it is not measured
+				UpdateReplyRTT( node, (int32)node->m_lastResponseRTT );
+			}
 		}
 		else
 		{
@@ -3667,6 +4040,7 @@ bool Driver::HandleApplicationUpdateRequest
 			LockGuard LG(m_nodeMutex);
 			delete m_nodes[nodeId];
 			m_nodes[nodeId] = NULL;
+			m_topology->RemoveNode( nodeId );
 			LG.Unlock();
 
 			Notification* notification = new Notification( Notification::Type_NodeRemoved );
@@ -3900,25 +4274,17 @@ bool Driver::EnablePoll
 			// update the value's pollIntensity
 			value->SetPollIntensity( _intensity );
 
-			// Add the valueid to the polling list
-			// See if the node is already in the poll list.
-			for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+			// Add the valueid to the poll schedule
+			if( !m_pollScheduler->Add( _valueId, value->GetPollIntensity() ) )
 			{
-				if( (*it).m_id == _valueId )
-				{
-					// It is already in the poll list, so we have nothing to do.
-					Log::Write( LogLevel_Detail, "EnablePoll not required to do anything (value is already in the poll list)" );
-					value->Release();
-					m_pollMutex->Unlock();
-					return true;
-				}
+				// It is already being polled, so we only need to pass on the new intensity.
+				m_pollScheduler->SetIntensity( _valueId, value->GetPollIntensity() );
+				Log::Write( LogLevel_Detail, "EnablePoll not required to do anything (value is already in the poll list)" );
+				value->Release();
+				m_pollMutex->Unlock();
+				return true;
 			}
 
-			// Not in the list, so we add it
-			PollEntry pe;
-			pe.m_id = _valueId;
-			pe.m_pollCounter = value->GetPollIntensity();
-			m_pollList.push_back( pe );
 			value->Release();
 			m_pollMutex->Unlock();
 
@@ -3927,7 +4293,7 @@ bool Driver::EnablePoll
 			notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
 			QueueNotification( notification );
 			Log::Write( LogLevel_Info, nodeId, "EnablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
-					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollList.size() );
+					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollScheduler->Size() );
 			return true;
 		}
 
@@ -3963,31 +4329,24 @@ bool Driver::DisablePoll
 	Node* node = GetNode( nodeId );
 	if( node != NULL)
 	{
-		// See if the value is already in the poll list.
-		for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+		// Remove the value from the poll schedule
+		if( m_pollScheduler->Remove( _valueId ) )
 		{
-			if( (*it).m_id == _valueId )
+			// get the value object and reset pollIntensity to zero (indicating no polling)
+			if( Value* value = GetValue( _valueId ) )
 			{
-				// Found it
-				// remove it from the poll list
-				m_pollList.erase( it );
-
-				// get the value object and reset pollIntensity to zero (indicating no polling)
-				Value* value = GetValue( _valueId );
-				if (!value)
-					continue;
 				value->SetPollIntensity( 0 );
 				value->Release();
-				m_pollMutex->Unlock();
-
-				// send notification to indicate polling is disabled
-				Notification* notification = new Notification( Notification::Type_PollingDisabled );
-				notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
-				QueueNotification( notification );
-				Log::Write( LogLevel_Info, nodeId, "DisablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
-						_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollList.size() );
-				return true;
 			}
+			m_pollMutex->Unlock();
+
+			// send notification to indicate polling is disabled
+			Notification* notification = new Notification( Notification::Type_PollingDisabled );
+			notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
+			QueueNotification( notification );
+			Log::Write( LogLevel_Info, nodeId, "DisablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
+					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollScheduler->Size() );
+			return true;
 		}
 
 		// Not in the list
@@ -4031,7 +4390,7 @@ bool Driver::isPolled
 
 	/*
 	 * This code is retained for the moment as a belt-and-suspenders test to confirm that
-	 * the pollIntensity member of each value and the pollList contents do not get out
+	 * the pollIntensity member of each value and the poll schedule do not get out
 	 * of sync.
 	 */
 	// confirm that this node exists
@@ -4040,22 +4399,18 @@ bool Driver::isPolled
 	Node* node = GetNode( nodeId );
 	if( node != NULL)
 	{
-
-		// See if the value is already in the poll list.
-		for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+		// See if the value is in the poll schedule.
+		if( m_pollScheduler->Contains( _valueId ) )
 		{
-			if( (*it).m_id == _valueId )
+			// Found it
+			if( bPolled )
 			{
-				// Found it
-				if( bPolled )
-				{
-					m_pollMutex->Unlock();
-					return true;
-				}
-				else
-				{
-					Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
-				}
+				m_pollMutex->Unlock();
+				return true;
+			}
+			else
+			{
+				Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
 			}
 		}
 
@@ -4094,13 +4449,64 @@ void Driver::SetPollIntensity
 
 	Value* value = GetValue( _valueId );
 	if (!value)
+	{
+		m_pollMutex->Unlock();
 		return;
+	}
 	value->SetPollIntensity( _intensity );
+	m_pollScheduler->SetIntensity( _valueId, _intensity );
+	m_configWriter->ValueChanged( _valueId );
 
 	value->Release();
 	m_pollMutex->Unlock();
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::SetPollPeriod>
+// Give a polled value its own period and jitter
+//-----------------------------------------------------------------------------
+bool Driver::SetPollPeriod
+(
+		ValueID const &_valueId,
+		int32 const _period,
+		int32 const _jitter
+)
+{
+	if( !m_pollScheduler->SetPeriod( _valueId, _period, _jitter ) )
+	{
+		Log::Write( LogLevel_Info, _valueId.GetNodeId(), "SetPollPeriod failed - value is not being polled" );
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, _valueId.GetNodeId(), "SetPollPeriod for value(cc=0x%02x,in=0x%02x,id=0x%02x) to %dms with %dms jitter",
+			_valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), _period, _jitter );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetPollStatistics>
+// Retrieve the poll scheduler statistics
+//-----------------------------------------------------------------------------
+void Driver::GetPollStatistics
+(
+		PollScheduler::PollData* _data
+)
+{
+	m_pollScheduler->GetStatistics( _data );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PollValueRefreshed>
+// A polled value has been reported by its node
+//-----------------------------------------------------------------------------
+void Driver::PollValueRefreshed
+(
+		ValueID const &_valueId
+)
+{
+	m_pollScheduler->Refreshed( _valueId );
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::PollThreadEntryPoint>
 // Entry point of the thread for poll Z-Wave devices
@@ -4127,135 +4533,135 @@ void Driver::PollThreadProc
 		Event* _exitEvent
 )
 {
+	Wait* exitObject = _exitEvent;
+	WaitSet exitWaitSet( &exitObject, 1 );
+
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;						// Thread must exit.
+	waitObjects[1] = m_pollScheduler->GetEvent();		// A value has been added to the schedule.
+	WaitSet waitSet( waitObjects, 2 );
+
+	list<ValueID> valueIds;
 	while( 1 )
 	{
-		int32 pollInterval = m_pollInterval;
-
-		if( m_awakeNodesQueried && !m_pollList.empty() )
+		// Don't poll until the awake nodes have been fully queried
+		int32 timeout = 500;
+		if( m_awakeNodesQueried )
 		{
-			// We only bother getting the lock if the pollList is not empty
-			m_pollMutex->Lock();
-
-			// Get the next value to be polled
-			PollEntry pe = m_pollList.front();
-			m_pollList.pop_front();
-			ValueID  valueId = pe.m_id;
+			m_pollScheduler->GetEvent()->Reset();
+			m_pollScheduler->SetInterval( m_pollInterval, m_bIntervalBetweenPolls );
+			timeout = m_pollScheduler->GetDuePolls( valueIds );
+		}
 
-			// only execute this poll if pe.m_pollCounter == 1; otherwise decrement the counter and process the next polled value
-			if( pe.m_pollCounter != 1)
+		if( valueIds.empty() )
+		{
+			// Sleep until the next poll is due, or the schedule changes
+			if( waitSet.Any( timeout ) == 0 )
 			{
-				pe.m_pollCounter--;
-				m_pollList.push_back( pe );
-				m_pollMutex->Unlock();
-				continue;
+				// Exit has been called
+				return;
 			}
+			continue;
+		}
 
-			// reset the poll counter to the full pollIntensity value and push it at the end of the list
-			// release the value object referenced; call GetNode to ensure the node objects are locked during this period
-			{
-				LockGuard LG(m_nodeMutex);
-				(void)GetNode( valueId.GetNodeId() );
-				Value* value = GetValue( valueId );
-				if (!value)
-					continue;
-				pe.m_pollCounter = value->GetPollIntensity();
-				m_pollList.push_back( pe );
-				value->Release();
-			}
-			// If the polling interval is for the whole poll list, calculate the time before the next poll,
-			// so that all polls can take place within the user-specified interval.
-			if( !m_bIntervalBetweenPolls )
+		m_pollMutex->Lock();
+		{
+			// Request the state of the values from the node to which they belong.
+			// The scheduler only groups values of the same node and command class.
+			ValueID const& first = valueIds.front();
+			NodeLockGuard NLG( m_nodeMutex, first.GetNodeId(), true );
+			Node* node = NLG.IsLocked() ? GetNode( first.GetNodeId() ) : NULL;
+			CommandClass* cc = NULL;
+			if( node )
 			{
-				if( pollInterval < 100 )
+				cc = node->GetCommandClass( first.GetCommandClassId() );
+				if( !node->IsListeningDevice() )
 				{
-					Log::Write( LogLevel_Info, "The pollInterval setting is only %d, which appears to be a legacy setting.  Multiplying by 1000 to convert to ms.", pollInterval );
-					pollInterval *= 1000;
+					// The device is not awake all the time.  If it is not awake, we mark it
+					// as requiring a poll.  The poll will be done next time the node wakes up.
+					if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+					{
+						if( !wakeUp->IsAwake() )
+						{
+							wakeUp->SetPollRequired();
+							cc = NULL;
+						}
+					}
 				}
-				pollInterval /= (int32) m_pollList.size();
 			}
 
+			if( cc )
 			{
-				LockGuard LG(m_nodeMutex);
-				// Request the state of the value from the node to which it belongs
-				if( Node* node = GetNode( valueId.GetNodeId() ) )
+				for( list<ValueID>::iterator it = valueIds.begin(); it != valueIds.end(); ++it )
 				{
-					bool requestState = true;
-					if( !node->IsListeningDevice() )
+					// Values that share an index and instance are reported by the same Get
+					bool requested = false;
+					for( list<ValueID>::iterator prev = valueIds.begin(); prev != it; ++prev )
 					{
-						// The device is not awake all the time.  If it is not awake, we mark it
-						// as requiring a poll.  The poll will be done next time the node wakes up.
-						if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+						if( ( prev->GetIndex() == it->GetIndex() ) && ( prev->GetInstance() == it->GetInstance() ) )
 						{
-							if( !wakeUp->IsAwake() )
-							{
-								wakeUp->SetPollRequired();
-								requestState = false;
-							}
+							requested = true;
+							break;
 						}
 					}
+					if( requested )
+					{
+						continue;
+					}
 
-					if( requestState )
+					// Request an update of the value
+					uint8 index = it->GetIndex();
+					uint8 instance = it->GetInstance();
+					Log::Write( LogLevel_Detail, node->m_nodeId, "Polling: %s index = %d instance = %d (poll queue has %d messages)", cc->GetCommandClassName().c_str(), index, instance, m_msgQueue[MsgQueue_Poll]->Size() );
+					if( !cc->RequestValue( 0, index, instance, MsgQueue_Poll ) )
 					{
-						// Request an update of the value
-						CommandClass* cc = node->GetCommandClass( valueId.GetCommandClassId() );
-						if (cc) {
-							uint8 index = valueId.GetIndex();
-							uint8 instance = valueId.GetInstance();
-							Log::Write( LogLevel_Detail, node->m_nodeId, "Polling: %s index = %d instance = %d (poll queue has %d messages)", cc->GetCommandClassName().c_str(), index, instance, m_msgQueue[MsgQueue_Poll].size() );
-							cc->RequestValue( 0, index, instance, MsgQueue_Poll );
+						// No Get was queued, so neither this value nor those sharing its Get will be answered
+						for( list<ValueID>::iterator same = it; same != valueIds.end(); ++same )
+						{
+							if( ( same->GetIndex() == index ) && ( same->GetInstance() == instance ) )
+							{
+								m_pollScheduler->Unanswered( *same );
+							}
 						}
 					}
-
-				}
-			}
-
-			m_pollMutex->Unlock();
-
-			// Polling messages are only sent when there are no other messages waiting to be sent
-			// While this makes the polls much more variable and uncertain if some other activity dominates
-			// a send queue, that may be appropriate
-			// TODO we can have a debate about whether to test all four queues or just the Poll queue
-			// Wait until the library isn't actively sending messages (or in the midst of a transaction)
-			int i32;
-			int loopCount = 0;
-			while( !m_msgQueue[MsgQueue_Poll].empty()
-					|| !m_msgQueue[MsgQueue_Send].empty()
-					|| !m_msgQueue[MsgQueue_Command].empty()
-					|| !m_msgQueue[MsgQueue_Query].empty()
-					|| m_currentMsg != NULL )
-			{
-				i32 = Wait::Single( _exitEvent, 10);		// test conditions every 10ms
-				if( i32 == 0 )
-				{
-					// Exit has been called
-					return;
-				}
-				loopCount++;
-				if( loopCount == 3000*10 )		// 300 seconds worth of delay?  Something unusual is going on
-				{
-					Log::Write( LogLevel_Warning, "Poll queue hasn't been able to execute for 300 secs or more" );
-					Log::QueueDump();
-					//					assert( 0 );
 				}
 			}
-
-			// ready for next poll...insert the pollInterval delay
-			i32 = Wait::Single( _exitEvent, pollInterval );
-			if( i32 == 0 )
+			else
 			{
-				// Exit has been called
-				return;
+				// The node is gone, could not be locked, is asleep or lacks the command
+				// class.  Nothing was sent, so no reply is coming.
+				m_pollScheduler->Unanswered( m_homeId, first.GetNodeId() );
 			}
 		}
-		else		// poll list is empty or awake nodes haven't been fully queried yet
-		{
-			// don't poll just yet, wait for the pollInterval or exit before re-checking to see if the pollList has elements
-			int32 i32 = Wait::Single( _exitEvent, 500 );
+		m_pollMutex->Unlock();
+		valueIds.clear();
+
+		// Polling messages are only sent when there are no other messages waiting to be sent
+		// While this makes the polls much more variable and uncertain if some other activity dominates
+		// a send queue, that may be appropriate
+		// TODO we can have a debate about whether to test all four queues or just the Poll queue
+		// Wait until the library isn't actively sending messages (or in the midst of a transaction)
+		int i32;
+		int loopCount = 0;
+		while( !m_msgQueue[MsgQueue_Poll]->IsEmpty()
+				|| !m_msgQueue[MsgQueue_Send]->IsEmpty()
+				|| !m_msgQueue[MsgQueue_Command]->IsEmpty()
+				|| !m_msgQueue[MsgQueue_Query]->IsEmpty()
+				|| m_currentMsg != NULL )
+		{
+			i32 = exitWaitSet.Any( 10);		// test conditions every 10ms
 			if( i32 == 0 )
 			{
 				// Exit has been called
 				return;
 			}
+			loopCount++;
+			if( loopCount == 3000*10 )		// 300 seconds worth of delay?  Something unusual is going on
+			{
+				Log::Write( LogLevel_Warning, "Poll queue hasn't been able to execute for 300 secs or more" );
+				Log::QueueDump();
+				//					assert( 0 );
+			}
 		}
 	}
 }
@@ -4282,6 +4688,7 @@ void Driver::InitAllNodes
 			m_nodes[i] = NULL;
 		}
 	}
+	m_topology->Clear();
 	LG.Unlock();
 
 	// Fetch new node data from the Z-Wave network
@@ -4316,6 +4723,7 @@ void Driver::InitNode
 		// Add the new node
 		m_nodes[_nodeId] = new Node( m_homeId, _nodeId );
 		if (newNode == true) static_cast<Node *>(m_nodes[_nodeId])->SetAddingNode();
+		m_topology->AddNode( _nodeId );
 	}
 
 	Notification* notification = new Notification( Notification::Type_NodeAdded );
@@ -4345,7 +4753,7 @@ bool Driver::IsNodeListeningDevice
 )
 {
 	bool res = false;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		res = node->IsListeningDevice();
@@ -4364,7 +4772,7 @@ bool Driver::IsNodeFrequentListeningDevice
 )
 {
 	bool res = false;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		res = node->IsFrequentListeningDevice();
@@ -4383,7 +4791,7 @@ bool Driver::IsNodeBeamingDevice
 )
 {
 	bool res = false;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		res = node->IsBeamingDevice();
@@ -4402,7 +4810,7 @@ bool Driver::IsNodeRoutingDevice
 )
 {
 	bool res = false;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		res = node->IsRoutingDevice();
@@ -4421,7 +4829,7 @@ bool Driver::IsNodeSecurityDevice
 )
 {
 	bool security = false;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		security = node->IsSecurityDevice();
@@ -4440,7 +4848,7 @@ uint32 Driver::GetNodeMaxBaudRate
 )
 {
 	uint32 baud = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		baud = node->GetMaxBaudRate();
@@ -4459,7 +4867,7 @@ uint8 Driver::GetNodeVersion
 )
 {
 	uint8 version = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		version = node->GetVersion();
@@ -4478,7 +4886,7 @@ uint8 Driver::GetNodeSecurity
 )
 {
 	uint8 security = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		security = node->GetSecurity();
@@ -4497,7 +4905,7 @@ uint8 Driver::GetNodeBasic
 )
 {
 	uint8 basic = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		basic = node->GetBasic();
@@ -4516,7 +4924,7 @@ uint8 Driver::GetNodeGeneric
 )
 {
 	uint8 genericType = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		genericType = node->GetGeneric();
@@ -4535,7 +4943,7 @@ uint8 Driver::GetNodeSpecific
 )
 {
 	uint8 specific = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		specific = node->GetSpecific();
@@ -4554,7 +4962,7 @@ string Driver::GetNodeType
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetType();
@@ -4574,7 +4982,7 @@ uint32 Driver::GetNodeNeighbors
 )
 {
 	uint32 numNeighbors = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		numNeighbors = node->GetNeighbors( o_neighbors );
@@ -4583,6 +4991,44 @@ uint32 Driver::GetNodeNeighbors
 	return numNeighbors;
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeHopCount>
+// Gets the expected number of hops from the controller to a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeHopCount
+(
+		uint8 const _nodeId
+)
+{
+	return m_topology->GetHopCount( _nodeId );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodesReachableOnlyVia>
+// Gets the nodes that would be cut off from the controller without a node
+//-----------------------------------------------------------------------------
+uint32 Driver::GetNodesReachableOnlyVia
+(
+		uint8 const _nodeId,
+		uint8** o_nodes
+)
+{
+	vector<uint8> nodes;
+	uint32 numNodes = m_topology->GetNodesReachableOnlyVia( _nodeId, &nodes );
+	if( numNodes == 0 )
+	{
+		*o_nodes = NULL;
+		return 0;
+	}
+
+	*o_nodes = new uint8[numNodes];
+	for( uint32 i=0; i<numNodes; ++i )
+	{
+		(*o_nodes)[i] = nodes[i];
+	}
+	return numNodes;
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::GetNodeManufacturerName>
 // Get the manufacturer name for the node with the specified ID
@@ -4593,7 +5039,7 @@ string Driver::GetNodeManufacturerName
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetManufacturerName();
@@ -4612,7 +5058,7 @@ string Driver::GetNodeProductName
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetProductName();
@@ -4631,7 +5077,7 @@ string Driver::GetNodeName
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetNodeName();
@@ -4650,7 +5096,7 @@ string Driver::GetNodeLocation
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetLocation();
@@ -4669,7 +5115,7 @@ string Driver::GetNodeManufacturerId
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetManufacturerId();
@@ -4688,7 +5134,7 @@ string Driver::GetNodeProductType
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetProductType();
@@ -4707,7 +5153,7 @@ string Driver::GetNodeProductId
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->GetProductId();
@@ -4726,7 +5172,7 @@ void Driver::SetNodeManufacturerName
 		string const& _manufacturerName
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetManufacturerName( _manufacturerName );
@@ -4743,7 +5189,7 @@ void Driver::SetNodeProductName
 		string const& _productName
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetProductName( _productName );
@@ -4760,7 +5206,7 @@ void Driver::SetNodeName
 		string const& _nodeName
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetNodeName( _nodeName );
@@ -4777,7 +5223,7 @@ void Driver::SetNodeLocation
 		string const& _location
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetLocation( _location );
@@ -4794,7 +5240,7 @@ void Driver::SetNodeLevel
 		uint8 const _level
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetLevel( _level );
@@ -4810,7 +5256,7 @@ void Driver::SetNodeOn
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetNodeOn();
@@ -4826,7 +5272,7 @@ void Driver::SetNodeOff
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->SetNodeOff();
@@ -4839,19 +5285,37 @@ void Driver::SetNodeOff
 //-----------------------------------------------------------------------------
 Value* Driver::GetValue
 (
-		ValueID const& _id
+		ValueID const& _id,
+		uint32* _handle	// = NULL
 )
 {
 
 	// This method is only called by code that has already locked the node
 	if( Node* node = m_nodes[_id.GetNodeId()] )
 	{
-		return node->GetValue( _id );
+		return _handle ? node->GetValue( _id, _handle ) : node->GetValue( _id );
 	}
 
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::IsValueValid>
+// Check that a value still exists, without adding a reference to it
+//-----------------------------------------------------------------------------
+bool Driver::IsValueValid
+(
+		ValueID const& _id
+)
+{
+	if( Node* node = m_nodes[_id.GetNodeId()] )
+	{
+		return node->GetValueStore()->Contains( _id.GetValueStoreKey() );
+	}
+
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // Controller commands
 //-----------------------------------------------------------------------------
@@ -4948,7 +5412,7 @@ bool Driver::BeginControllerCommand
 	item.m_cci = cci;
 
 	m_sendMutex->Lock();
-	m_msgQueue[MsgQueue_Controller].push_back( item );
+	m_msgQueue[MsgQueue_Controller]->PushBack( item );
 	m_queueEvent[MsgQueue_Controller]->Set();
 	m_sendMutex->Unlock();
 
@@ -5479,6 +5943,49 @@ void Driver::TestNetwork
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::ScheduleNeighborUpdate>
+// Request a neighbor update for a node whose routes have degraded
+//-----------------------------------------------------------------------------
+void Driver::ScheduleNeighborUpdate
+(
+)
+{
+	// Leave the network alone until the awake nodes have been interviewed
+	if( !m_awakeNodesQueried || !IsPrimaryController() )
+	{
+		return;
+	}
+
+	uint8 nodeId = m_topology->TakeNeighborUpdate();
+	if( nodeId == 0 )
+	{
+		return;
+	}
+
+	{
+		// A node that sleeps would not take part in the neighbor discovery
+		NodeLockGuard NLG( m_nodeMutex, nodeId, false );
+		Node* node = GetNode( nodeId );
+		if( node == NULL || !( node->IsListeningDevice() || node->IsFrequentListeningDevice() ) )
+		{
+			return;
+		}
+	}
+
+	vector<uint8> dependents;
+	if( m_topology->GetNodesReachableOnlyVia( nodeId, &dependents ) > 0 )
+	{
+		Log::Write( LogLevel_Info, nodeId, "Requesting a neighbor update for degraded routes (%d other nodes are only reachable through this node)", (int32)dependents.size() );
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, nodeId, "Requesting a neighbor update for degraded routes" );
+	}
+	m_neighborUpdates++;
+	BeginControllerCommand( ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, nodeId, 0 );
+}
+
 //-----------------------------------------------------------------------------
 //	SwitchAll
 //-----------------------------------------------------------------------------
@@ -5529,6 +6036,313 @@ void Driver::SwitchAllOff
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::BeginMulticast>
+// Start holding back the messages queued for sending
+//-----------------------------------------------------------------------------
+void Driver::BeginMulticast
+(
+)
+{
+	m_multicastMutex->Lock();
+	if( m_bMulticast && IsAPICallSupported( FUNC_ID_ZW_SEND_DATA_MULTI ) )
+	{
+		m_sendMutex->Lock();
+		m_multicastMsgs = new list<Msg*>();
+		m_multicastOwner = &t_threadMarker;
+		m_sendMutex->Unlock();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::EndMulticast>
+// Queue the held messages, combining identical commands into multicast frames
+//-----------------------------------------------------------------------------
+void Driver::EndMulticast
+(
+)
+{
+	m_sendMutex->Lock();
+	list<Msg*>* held = m_multicastMsgs;
+	m_multicastMsgs = NULL;
+	m_multicastOwner = NULL;
+	m_sendMutex->Unlock();
+
+	if( held != NULL )
+	{
+		// Sort the messages into groups, kept in the order they are to be sent.
+		// A command joins an earlier group with the same payload, provided that
+		// the group comes after every other group holding a message for the same
+		// node.  Everything else starts a group of its own.
+		vector< list<Msg*> > groups;
+		vector<bool> multicast;
+		int32 lastGroup[256];
+		for( int32 i=0; i<256; ++i )
+		{
+			lastGroup[i] = -1;
+		}
+
+		for( list<Msg*>::iterator it = held->begin(); it != held->end(); ++it )
+		{
+			Msg* msg = *it;
+			uint8 nodeId = msg->GetTargetNodeId();
+			int32 group = -1;
+			bool candidate = IsMulticastCandidate( msg );
+			if( candidate )
+			{
+				uint8* buffer = msg->GetBuffer();
+				for( int32 j=lastGroup[nodeId]+1; j<(int32)groups.size(); ++j )
+				{
+					if( multicast[j] && groups[j].size() < c_maxMulticastNodes )
+					{
+						// Compare the data length, the data and the transmit options
+						uint8* other = groups[j].front()->GetBuffer();
+						if( !memcmp( &buffer[5], &other[5], buffer[5] + 2 ) )
+						{
+							group = j;
+							break;
+						}
+					}
+				}
+			}
+			if( group < 0 )
+			{
+				group = (int32)groups.size();
+				groups.push_back( list<Msg*>() );
+				multicast.push_back( candidate );
+			}
+			groups[group].push_back( msg );
+			lastGroup[nodeId] = group;
+		}
+		delete held;
+
+		for( uint32 j=0; j<groups.size(); ++j )
+		{
+			list<Msg*>& group = groups[j];
+			bool queueGroup = true;
+			if( group.size() > 1 )
+			{
+				Msg* first = group.front();
+				uint8* buffer = first->GetBuffer();
+				Msg* msg = new Msg( "Multicast " + first->GetLogText(), 0xff, REQUEST, FUNC_ID_ZW_SEND_DATA_MULTI, true );
+				msg->SetQueuedTime( first->GetQueuedTime() );
+				msg->Append( (uint8)group.size() );
+				for( list<Msg*>::iterator it = group.begin(); it != group.end(); ++it )
+				{
+					msg->Append( (*it)->GetTargetNodeId() );
+				}
+				for( uint32 i=0; i<(uint32)buffer[5] + 2; ++i )
+				{
+					// Data length, data and transmit options
+					msg->Append( buffer[5+i] );
+				}
+				Log::Write( LogLevel_Info, "Sending %s to %d nodes in one multicast frame", first->GetLogText().c_str(), (int32)group.size() );
+				SendMsg( msg, MsgQueue_Send );
+
+				m_multicastFrames++;
+				m_multicastMessages += (uint32)group.size();
+
+				if( !m_bMulticastVerify )
+				{
+					for( list<Msg*>::iterator it = group.begin(); it != group.end(); ++it )
+					{
+						delete *it;
+					}
+					queueGroup = false;
+				}
+			}
+
+			if( queueGroup )
+			{
+				m_sendMutex->Lock();
+				for( list<Msg*>::iterator it = group.begin(); it != group.end(); ++it )
+				{
+					MsgQueueItem item;
+					item.m_command = MsgQueueCmd_SendMsg;
+					item.m_msg = *it;
+					Log::Write( LogLevel_Detail, GetNodeNumber( *it ), "Queuing (%s) %s", c_sendQueueNames[MsgQueue_Send], (*it)->GetAsString().c_str() );
+					m_msgQueue[MsgQueue_Send]->PushBack( item );
+				}
+				m_queueEvent[MsgQueue_Send]->Set();
+				m_sendMutex->Unlock();
+			}
+		}
+	}
+
+	m_multicastMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsMulticastCandidate>
+// Whether a held message could be sent to its node as part of a multicast frame
+//-----------------------------------------------------------------------------
+bool Driver::IsMulticastCandidate
+(
+		Msg* _msg
+)
+{
+	// Only plain commands that wait for nothing but the callback.  A multicast
+	// frame cannot be encrypted, and draws no reply from the nodes.
+	if( _msg->isEncrypted() || _msg->GetExpectedReply() != FUNC_ID_ZW_SEND_DATA || _msg->GetBuffer()[3] != FUNC_ID_ZW_SEND_DATA )
+	{
+		return false;
+	}
+
+	uint8 nodeId = _msg->GetTargetNodeId();
+	if( nodeId == m_Controller_nodeId )
+	{
+		return false;
+	}
+
+	// A node that is not always listening would miss the frame
+	NodeLockGuard NLG( m_nodeMutex, nodeId, false );
+	Node* node = GetNode( nodeId );
+	return( node != NULL && node->IsListeningDevice() );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSendDataMultiResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSendDataMultiResponse
+(
+		uint8* _data
+)
+{
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Detail, "  ZW_SEND_DATA_MULTI delivered to Z-Wave stack" );
+	}
+	else
+	{
+		Log::Write( LogLevel_Error, "ERROR: ZW_SEND_DATA_MULTI could not be delivered to Z-Wave stack" );
+		m_nondelivery++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSendDataMultiRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSendDataMultiRequest
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Detail, "  ZW_SEND_DATA_MULTI Request with callback ID 0x%.2x received (expected 0x%.2x)", _data[2], m_expectedCallbackId );
+	if( _data[2] != m_expectedCallbackId )
+	{
+		m_callbacks++;
+		Log::Write( LogLevel_Warning, "WARNING: Unexpected Callback ID received" );
+	}
+	else if( _data[3] != 0 )
+	{
+		// The nodes do not acknowledge a multicast frame, so this only means the
+		// controller could not transmit it.  Any verifying commands still follow.
+		Log::Write( LogLevel_Warning, "WARNING: ZW_SEND_DATA_MULTI failed with transmit status %d", _data[3] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AdmitInterview>
+// Decide whether a node may go on with its interview
+//-----------------------------------------------------------------------------
+bool Driver::AdmitInterview
+(
+		Node* _node
+)
+{
+	if( m_maxInterviews <= 0 || ( !_node->IsListeningDevice() && !_node->IsFrequentListeningDevice() ) )
+	{
+		return true;
+	}
+
+	LockGuard LG(m_nodeMutex);
+	uint8 nodeId = _node->GetNodeId();
+	if( m_interviewing[nodeId] )
+	{
+		return true;
+	}
+
+	if( m_interviewCount < (uint32)m_maxInterviews )
+	{
+		m_interviewWaiting.remove( nodeId );
+		m_interviewing[nodeId] = true;
+		++m_interviewCount;
+		return true;
+	}
+
+	for( list<uint8>::iterator it = m_interviewWaiting.begin(); it != m_interviewWaiting.end(); ++it )
+	{
+		if( *it == nodeId )
+		{
+			return false;
+		}
+	}
+
+	// Mains powered nodes go ahead of frequently listening ones, which are slow to reach
+	list<uint8>::iterator pos = m_interviewWaiting.end();
+	if( _node->IsListeningDevice() )
+	{
+		for( pos = m_interviewWaiting.begin(); pos != m_interviewWaiting.end(); ++pos )
+		{
+			Node* node = GetNode( *pos );
+			if( node != NULL && !node->IsListeningDevice() )
+			{
+				break;
+			}
+		}
+	}
+	m_interviewWaiting.insert( pos, nodeId );
+	Log::Write( LogLevel_Info, nodeId, "Waiting to be interviewed (%d nodes in progress, %d waiting)", m_interviewCount, (int32)m_interviewWaiting.size() );
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::EndInterview>
+// Give up a node's place among the nodes being interviewed
+//-----------------------------------------------------------------------------
+void Driver::EndInterview
+(
+		uint8 const _nodeId
+)
+{
+	LockGuard LG(m_nodeMutex);
+	m_interviewWaiting.remove( _nodeId );
+	if( !m_interviewing[_nodeId] )
+	{
+		return;
+	}
+	m_interviewing[_nodeId] = false;
+	--m_interviewCount;
+
+	while( !m_exit && !m_interviewWaiting.empty() && m_interviewCount < (uint32)m_maxInterviews )
+	{
+		uint8 nodeId = m_interviewWaiting.front();
+		m_interviewWaiting.pop_front();
+		Node* node = GetNode( nodeId );
+		if( node == NULL || !node->IsNodeAlive() )
+		{
+			continue;
+		}
+		m_interviewing[nodeId] = true;
+		++m_interviewCount;
+
+		// Resume the node's queries from the query queue, rather than from
+		// within whatever ended the other interview
+		Log::Write( LogLevel_Detail, nodeId, "Queuing (%s) Query Stage Resume (%s)", c_sendQueueNames[MsgQueue_Query], node->GetQueryStageName( node->GetCurrentQueryStage() ).c_str() );
+		MsgQueueItem item;
+		item.m_command = MsgQueueCmd_QueryStageComplete;
+		item.m_nodeId = nodeId;
+		item.m_queryStage = node->GetCurrentQueryStage();
+		item.m_retry = true;
+		m_sendMutex->Lock();
+		m_msgQueue[MsgQueue_Query]->PushBack( item );
+		m_queueEvent[MsgQueue_Query]->Set();
+		m_sendMutex->Unlock();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::SetConfigParam>
 // Set the value of one of the configuration parameters of a device
@@ -5541,7 +6355,7 @@ bool Driver::SetConfigParam
 		uint8 _size
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		return node->SetConfigParam( _param, _value, _size );
@@ -5550,6 +6364,26 @@ bool Driver::SetConfigParam
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::SetConfigParams>
+// Set the values of several configuration parameters of a device
+//-----------------------------------------------------------------------------
+bool Driver::SetConfigParams
+(
+		uint8 const _nodeId,
+		map<uint8,int32> const& _params,
+		map<uint8,Node::ConfigParamStatus>* o_status
+)
+{
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
+	if( Node* node = GetNode( _nodeId ) )
+	{
+		return node->SetConfigParams( _params, o_status );
+	}
+
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::RequestConfigParam>
 // Request the value of one of the configuration parameters of a device
@@ -5560,7 +6394,7 @@ void Driver::RequestConfigParam
 		uint8 const _param
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->RequestConfigParam( _param );
@@ -5577,7 +6411,7 @@ uint8 Driver::GetNumGroups
 )
 {
 	uint8 numGroups = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		numGroups = node->GetNumGroups();
@@ -5598,7 +6432,7 @@ uint32 Driver::GetAssociations
 )
 {
 	uint32 numAssociations = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		numAssociations = node->GetAssociations( _groupIdx, o_associations );
@@ -5618,7 +6452,7 @@ uint8 Driver::GetMaxAssociations
 )
 {
 	uint8 maxAssociations = 0;
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		maxAssociations = node->GetMaxAssociations( _groupIdx );
@@ -5638,7 +6472,7 @@ string Driver::GetGroupLabel
 )
 {
 	string label = "";
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, false );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		label = node->GetGroupLabel( _groupIdx );
@@ -5658,7 +6492,7 @@ void Driver::AddAssociation
 		uint8 const _targetNodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->AddAssociation( _groupIdx, _targetNodeId );
@@ -5676,7 +6510,7 @@ void Driver::RemoveAssociation
 		uint8 const _targetNodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
+	NodeLockGuard NLG( m_nodeMutex, _nodeId, true );
 	if( Node* node = GetNode( _nodeId ) )
 	{
 		node->RemoveAssociation( _groupIdx, _targetNodeId );
@@ -5714,7 +6548,7 @@ void Driver::NotifyWatchers
 		switch (notification->GetType()) {
 			case Notification::Type_ValueChanged:
 			case Notification::Type_ValueRefreshed:
-				if (!GetValue(notification->GetValueID())) {
+				if (!IsValueValid(notification->GetValueID())) {
 					Log::Write(LogLevel_Info, notification->GetNodeId(), "Dropping Notification as ValueID does not exist");
 					nit = m_notifications.begin();
 					delete notification;
@@ -5727,9 +6561,12 @@ void Driver::NotifyWatchers
 
 		Log::Write(LogLevel_Detail, notification->GetNodeId(), "Notification: %s", notification->GetAsString().c_str());
 
+		// The change has been made by now, so it is safe to mark it for saving
+		m_configWriter->Notify( notification );
+
+		// The manager deletes the notification once the watchers have seen it
 		Manager::Get()->NotifyWatchers( notification );
 
-		delete notification;
 		nit = m_notifications.begin();
 	}
 	m_notificationsEvent->Reset();
@@ -5900,7 +6737,7 @@ void Driver::SendVirtualNodeInfo
 	char str[80];
 
 	snprintf( str, sizeof(str), "Send Virtual Node Info from %d to %d", _FromNodeId, _ToNodeId );
-	Msg* msg = new Msg( str, 0xff, REQUEST, FUNC_ID_ZW_SEND_SLAVE_NODE_INFO, true );
+	Msg* msg = new Msg( string( str ), 0xff, REQUEST, FUNC_ID_ZW_SEND_SLAVE_NODE_INFO, true );
 	msg->Append( _FromNodeId );		// from the virtual node
 	msg->Append( _ToNodeId );		// to the handheld controller
 	msg->Append( TRANSMIT_OPTION_ACK );
@@ -6409,6 +7246,13 @@ void Driver::GetDriverStatistics
 	_data->m_routedbusy = m_routedbusy;
 	_data->m_broadcastReadCnt = m_broadcastReadCnt;
 	_data->m_broadcastWriteCnt = m_broadcastWriteCnt;
+	_data->m_multiCmdFrames = m_multiCmdFrames;
+	_data->m_multiCmdMessages = m_multiCmdMessages;
+	_data->m_multicastFrames = m_multicastFrames;
+	_data->m_multicastMessages = m_multicastMessages;
+	_data->m_prefetchedNonces = m_prefetchedNonces;
+	_data->m_neighborUpdates = m_neighborUpdates;
+	Msg::GetPoolStatistics( &_data->m_msgAllocated, &_data->m_msgReused );
 }
 
 //-----------------------------------------------------------------------------
@@ -6426,7 +7270,47 @@ void Driver::GetNodeStatistics
 	if( node != NULL )
 	{
 		node->GetNodeStatistics( _data );
+
+		Topology::NodeHealth health;
+		m_topology->GetNodeHealth( _nodeId, &health );
+		_data->m_hopCount = health.m_hopCount;
+		_data->m_routeHealth = health.m_health;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetLatencyStatistics>
+// Summarise one of the latency histograms
+//-----------------------------------------------------------------------------
+bool Driver::GetLatencyStatistics
+(
+		LatencyStats::Stage const _stage,
+		LatencyStats::Group const _group,
+		uint8 const _key,
+		LatencyStats::Summary* _data
+)
+{
+	if( m_latencyStats == NULL )
+	{
+		return false;
+	}
+	return m_latencyStats->GetSummary( _stage, _group, _key, _data );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::WriteLatencyStatistics>
+// Write the latency histograms in the Prometheus text format
+//-----------------------------------------------------------------------------
+bool Driver::WriteLatencyStatistics
+(
+		string const& _filename
+)
+{
+	if( m_latencyStats == NULL )
+	{
+		return false;
 	}
+	return m_latencyStats->Write( _filename, m_homeId );
 }
 
 //-----------------------------------------------------------------------------
@@ -6457,6 +7341,11 @@ void Driver::LogDriverStatistics
 	Log::Write( LogLevel_Always, "Total messages successfully received: . . . . . . . . . . %ld", data.m_readCnt );
 	Log::Write( LogLevel_Always, "Total Messages successfully sent: . . . . . . . . . . . . %ld", data.m_writeCnt );
 	Log::Write( LogLevel_Always, "ACKs received from controller:  . . . . . . . . . . . . . %ld", data.m_ACKCnt );
+	Log::Write( LogLevel_Always, "Messages packed into multi-command frames:  . . . . . . . %ld (%ld frames)", data.m_multiCmdMessages, data.m_multiCmdFrames );
+	Log::Write( LogLevel_Always, "Commands sent by multicast:  . . . . . . . . . . . . . . %ld (%ld frames)", data.m_multicastMessages, data.m_multicastFrames );
+	Log::Write( LogLevel_Always, "Encrypted messages sent with a prefetched nonce: . . . . %ld", data.m_prefetchedNonces );
+	Log::Write( LogLevel_Always, "Neighbor updates requested for degraded routes:  . . . . %ld", data.m_neighborUpdates );
+	Log::Write( LogLevel_Always, "Messages allocated (all drivers):  . . . . . . . . . . . %ld (%ld reused)", data.m_msgAllocated + data.m_msgReused, data.m_msgReused );
 	// Consider tracking and adding:
 	//		Initialization messages
 	//		Ad-hoc command messages
@@ -6518,6 +7407,13 @@ uint8 *Driver::GetNetworkKey() {
 //-----------------------------------------------------------------------------
 bool Driver::SendEncryptedMessage() {
 
+	m_awaitingNonce = false;
+	if( IsEncryptedMsgQueued( m_currentMsg->GetTargetNodeId() ) )
+	{
+		// Have the node send its next nonce with its reply, so that the next
+		// message does not need a Nonce Get of its own
+		m_currentMsg->setRequestNonce();
+	}
 	uint8 *buffer = m_currentMsg->GetBuffer();
 	uint8 length = m_currentMsg->GetLength();
 	m_expectedCallbackId = m_currentMsg->GetCallbackId();
@@ -6557,10 +7453,31 @@ bool Driver::SendNonceRequest(string logmsg) {
 	Log::Write(LogLevel_Info, m_currentMsg->GetTargetNodeId(), "Sending (%s) message (Callback ID=0x%.2x, Expected Reply=0x%.2x) - Nonce_Get(%s) - %s:", c_sendQueueNames[m_currentMsgQueueSource], m_expectedCallbackId, m_expectedReply, logmsg.c_str(), PktToString(m_buffer, 10).c_str());
 
 	m_controller->Write(m_buffer, 11);
+	m_awaitingNonce = true;
 
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::IsEncryptedMsgQueued>
+// Whether the next message queued for a node is to be encrypted
+//-----------------------------------------------------------------------------
+bool Driver::IsEncryptedMsgQueued
+(
+		uint8 const _nodeId
+)
+{
+	LockGuard LG(m_sendMutex);
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		if( MsgQueueItem* item = m_msgQueue[i]->NodeFront( _nodeId ) )
+		{
+			return( MsgQueueCmd_SendMsg == item->m_command && item->m_msg->isEncrypted() );
+		}
+	}
+	return false;
+}
+
 bool Driver::initNetworkKeys(bool newnode) {
 
 	uint8_t EncryptPassword[16] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
@@ -6570,8 +7487,11 @@ bool Driver::initNetworkKeys(bool newnode) {
 			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
 	};
 	this->m_inclusionkeySet = newnode;
-	this->AuthKey = new aes_encrypt_ctx;
-	this->EncryptKey = new aes_encrypt_ctx;
+	if( this->AuthKey == NULL )
+	{
+		this->AuthKey = new aes_encrypt_ctx;
+		this->EncryptKey = new aes_encrypt_ctx;
+	}
 
 	Log::Write(LogLevel_Info, GetControllerNodeId(), "Setting Up %s Network Key for Secure Communications", newnode == true ? "Inclusion" : "Provided");
 
@@ -6665,7 +7585,8 @@ aes_encrypt_ctx *Driver::GetAuthKey
 			m_currentControllerCommand->m_controllerCommand == ControllerCommand_AddDevice &&
 			m_currentControllerCommand->m_controllerState == ControllerState_Completed ) {
 		/* we are adding a Node, so our AuthKey is different from normal comms */
-		initNetworkKeys(true);
+		if (!m_inclusionkeySet)
+			initNetworkKeys(true);
 	} else if (m_inclusionkeySet) {
 		initNetworkKeys(false);
 	}
@@ -6679,7 +7600,8 @@ aes_encrypt_ctx *Driver::GetEncKey
 			m_currentControllerCommand->m_controllerCommand == ControllerCommand_AddDevice &&
 			m_currentControllerCommand->m_controllerState == ControllerState_Completed ) {
 		/* we are adding a Node, so our EncryptKey is different from normal comms */
-		initNetworkKeys(true);
+		if (!m_inclusionkeySet)
+			initNetworkKeys(true);
 	} else if (m_inclusionkeySet) {
 		initNetworkKeys(false);
 	}
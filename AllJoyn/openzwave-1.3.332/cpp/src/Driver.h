@@ -35,6 +35,11 @@
 #include "Defs.h"
 #include "value_classes/ValueID.h"
 #include "Node.h"
+#include "NodeLocks.h"
+#include "PollScheduler.h"
+#include "Topology.h"
+#include "LatencyStats.h"
+#include "value_classes/ValueSnapshot.h"
 #include "platform/Event.h"
 #include "platform/Mutex.h"
 #include "platform/TimeStamp.h"
@@ -50,6 +55,8 @@ namespace OpenZWave
 	class Thread;
 	class ControllerReplication;
 	class Notification;
+	class ConfigWriter;
+	class SendQueue;
 
 	/** \brief The Driver class handles communication between OpenZWave
 	 *  and a device attached via a serial port (typically a controller).
@@ -73,6 +80,8 @@ namespace OpenZWave
 		friend class WakeUp;
 		friend class Security;
 		friend class Msg;
+		friend class ConfigWriter;
+		friend class SendQueue;
 
 	//-----------------------------------------------------------------------------
 	//	Controller Interfaces
@@ -82,7 +91,8 @@ namespace OpenZWave
 		{
 			ControllerInterface_Unknown = 0,
 			ControllerInterface_Serial,
-			ControllerInterface_Hid
+			ControllerInterface_Hid,
+			ControllerInterface_Simulator
 		};
 
 	//-----------------------------------------------------------------------------
@@ -146,6 +156,13 @@ namespace OpenZWave
 		 * Used when deleting a node.
 		 */
 		void RemoveQueues( uint8 const _nodeId );
+		/**
+		 * Remove the messages queued by an earlier Value::Set of a value that send
+		 * the same Set command as a newer message, with different parameters.
+		 * Called by SendMsg, so that a newer value replaces an older one that has
+		 * not been sent yet, rather than both being sent.
+		 */
+		void RemoveValueMsgs( Msg const* _msg );
 
 		Thread*					m_driverThread;			/**< Thread for reading from the Z-Wave controller, and for creating and managing the other threads for sending, polling etc. */
 		bool					m_exit;					/**< Flag that is set when the application is exiting. */
@@ -153,6 +170,12 @@ namespace OpenZWave
 		bool					m_awakeNodesQueried;	/**< Set to true once the driver has polled all awake nodes */
 		bool					m_allNodesQueried;		/**< Set to true once the driver has polled all nodes */
 		bool					m_notifytransactions;
+		bool					m_bMultiCmd;			/**< Pack queued messages for nodes that support COMMAND_CLASS_MULTI_CMD into a single frame */
+		bool					m_bNetworkCache;		/**< Load and save a binary copy of the network file alongside the XML */
+		bool					m_bMulticast;			/**< Send identical commands for several nodes as one FUNC_ID_ZW_SEND_DATA_MULTI frame */
+		bool					m_bMulticastVerify;		/**< Follow each multicast frame with the original commands, sent to each node in turn */
+		bool					m_bAdaptiveTimeout;		/**< Time out a node's reply from its measured round trip times, rather than after RetryTimeout */
+		int32					m_minReplyTimeout;		/**< Shortest adaptive reply timeout for each hop to a node, in milliseconds */
 		TimeStamp				m_startTime;			/**< Time this driver started (for log report purposes) */
 
 	//-----------------------------------------------------------------------------
@@ -161,7 +184,11 @@ namespace OpenZWave
 	private:
 		void RequestConfig();							// Get the network configuration from the Z-Wave network
 		bool ReadConfig();								// Read the configuration from a file
-		void WriteConfig();								// Save the configuration to a file
+		void WriteConfig( bool const _full = false );	// Save the configuration to a file now.  _full rebuilds the XML of every node.
+		void WriteXML( TiXmlElement* _driverElement );	// Write the attributes of the driver element
+
+		ConfigWriter*			m_configWriter;			// Saves the configuration, rebuilding only what has changed
+		static uint32 const		c_configVersion;		// Version of the configuration file format
 
 	//-----------------------------------------------------------------------------
 	//	Controller
@@ -202,15 +229,7 @@ namespace OpenZWave
 		ControllerInterface GetControllerInterfaceType()const{ return m_controllerInterfaceType; }
 		string GetLibraryVersion()const{ return m_libraryVersion; }
 		string GetLibraryTypeName()const{ return m_libraryTypeName; }
-		int32 GetSendQueueCount()const
-		{
-			int32 count = 0;
-			for( int32 i=0; i<MsgQueue_Count; ++i )
-			{
-				count += (int32) (m_msgQueue[i].size());
-			}
-			return count;
-		}
+		int32 GetSendQueueCount()const;
 
 		/**
 		 *  A version of GetNode that does not have the protective "lock" and "release" requirement.
@@ -223,13 +242,12 @@ namespace OpenZWave
 		 */
 		Node* GetNodeUnsafe( uint8 _nodeId );
 		/**
-		 *  Locks the node array and returns the specified node (if it exists).  If a node is returned,
-		 *  the lock must be released after the node has been processed via a call to ReleaseNodes().
-		 *  If the node specified by _nodeId does not exist, the lock is released and NULL is returned.
+		 *  Returns the specified node (if it exists).  The caller must hold m_nodeMutex, either
+		 *  locked for all nodes or with a lock on this node from NodeLocks::LockNode.
 		 *  \param _nodeId The nodeId (index into the node array) identifying the node to be returned
 		 *  \return
 		 *  A pointer to the specified node (if it exists) or NULL if not.
-		 *  \see LockNodes, ReleaseNodes
+		 *  \see NodeLocks
 		 */
 		Node* GetNode( uint8 _nodeId );
 		/**
@@ -261,7 +279,8 @@ namespace OpenZWave
 		uint8					m_controllerCaps;							// Set of flags indicating the controller's capabilities (See IsInclusionController above).
 		uint8					m_Controller_nodeId;									// Z-Wave Controller's own node ID.
 		Node*					m_nodes[256];								// Array containing all the node objects.
-		Mutex*					m_nodeMutex;								// Serializes access to node data
+		NodeLocks*				m_nodeMutex;								// Serializes access to node data, for all nodes or for one node at a time
+		ValueSnapshotTable*		m_valueSnapshots;							// Copies of the values of every node that can be read without m_nodeMutex
 
 		ControllerReplication*	m_controllerReplication;					// Controller replication is handled separately from the other command classes, due to older hand-held controllers using invalid node IDs.
 
@@ -352,19 +371,15 @@ namespace OpenZWave
 		bool DisablePoll( const ValueID &_valueId );
 		bool isPolled( const ValueID &_valueId );
 		void SetPollIntensity( const ValueID &_valueId, uint8 _intensity );
+		bool SetPollPeriod( const ValueID &_valueId, int32 _period, int32 _jitter );
+		void GetPollStatistics( PollScheduler::PollData* _data );
+		void PollValueRefreshed( const ValueID &_valueId );
 		static void PollThreadEntryPoint( Event* _exitEvent, void* _context );
 		void PollThreadProc( Event* _exitEvent );
 
 		Thread*					m_pollThread;								// Thread for polling devices on the Z-Wave network
-		struct PollEntry
-		{
-			ValueID	m_id;
-			uint8	m_pollCounter;
-		};
-OPENZWAVE_EXPORT_WARNINGS_OFF
-		list<PollEntry>			m_pollList;									// List of nodes that need to be polled
-OPENZWAVE_EXPORT_WARNINGS_ON
-		Mutex*					m_pollMutex;								// Serialize access to the polling list
+		PollScheduler*			m_pollScheduler;							// Decides which values are due to be polled
+		Mutex*					m_pollMutex;								// Serialize enabling and disabling polls with the poll thread
 		int32					m_pollInterval;								// Time interval during which all nodes must be polled
 		bool					m_bIntervalBetweenPolls;					// if true, the library intersperses m_pollInterval between polls; if false, the library attempts to complete all polls within m_pollInterval
 
@@ -403,6 +418,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		uint8 GetNodeSpecific( uint8 const _nodeId );
 		string GetNodeType( uint8 const _nodeId );
 		uint32 GetNodeNeighbors( uint8 const _nodeId, uint8** o_neighbors );
+		uint8 GetNodeHopCount( uint8 const _nodeId );
+		uint32 GetNodesReachableOnlyVia( uint8 const _nodeId, uint8** o_nodes );
 
 		string GetNodeManufacturerName( uint8 const _nodeId );
 		string GetNodeProductName( uint8 const _nodeId );
@@ -420,7 +437,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void SetNodeOn( uint8 const _nodeId );
 		void SetNodeOff( uint8 const _nodeId );
 
-		Value* GetValue( ValueID const& _id );
+		Value* GetValue( ValueID const& _id, uint32* _handle = NULL );			// _handle is a saved position in the node's ValueStore, updated if it was stale
+		bool IsValueValid( ValueID const& _id );						// True if the value exists.  Unlike GetValue, no reference is added.
 
 		bool IsAPICallSupported( uint8 const _apinum )const{ return (( m_apiMask[( _apinum - 1 ) >> 3] & ( 1 << (( _apinum - 1 ) & 0x07 ))) != 0 ); }
 		void SetAPICall( uint8 const _apinum, bool _toSet )
@@ -590,6 +608,7 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 *  RemoveNodeQuery, Node::AllQueriesCompleted
 		 */
 		bool WriteNextMsg( MsgQueue const _queue );							// Extracts the first message from the queue, and makes it the current one.
+		Msg* EncapsulateMultiCmd( MsgQueue const _queue, Msg* _msg );		// Packs _msg and the messages for the same node that follow it in the queue into one Multi Command frame.
 		bool WriteMsg( string const &str);									// Sends the current message to the Z-Wave network
 		void RemoveCurrentMsg();											// Deletes the current message and cleans up the callback etc states
 		bool MoveMessagesToWakeUpQueue(	uint8 const _targetNodeId, bool const _move );		// If a node does not respond, and is of a type that can sleep, this method is used to move all its pending messages to another queue ready for when it mext wakes up.
@@ -598,6 +617,21 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void SendQueryStageComplete( uint8 const _nodeId, Node::QueryStage const _stage );
 		void RetryQueryStageComplete( uint8 const _nodeId, Node::QueryStage const _stage );
 		void CheckCompletedNodeQueries();									// Send notifications if all awake and/or sleeping nodes have completed their queries
+		/**
+		 *  The time to wait for the node's reply to the current message.
+		 *  Once a node's round trip times have been measured, the timeout is the
+		 *  smoothed round trip time plus four times its mean deviation, as in TCP.
+		 *  It is at least m_minReplyTimeout for each hop to the node, and doubles
+		 *  with each further attempt to send the message.  Otherwise, and for
+		 *  messages that do not expect a reply from the node, the timeout is
+		 *  _retryTimeout, which is also the upper limit.  The timeout runs from
+		 *  when the message was sent, but only applies once the controller has
+		 *  reported the message delivered.
+		 */
+		int32 GetReplyTimeout( int32 const _retryTimeout );
+		void UpdateReplyRTT( Node* _node, int32 const _rtt );				// Add a measured response round trip time to the node's estimate
+		void ReplyTimedOut();												// Widen the estimate of a node that failed to reply within its adaptive timeout
+		void ScheduleNeighborUpdate();										// Request a neighbor update for a node whose routes have degraded
 
 		// Requests to be sent to nodes are assigned to one of five queues.
 		// From highest to lowest priority, these are
@@ -680,14 +714,14 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 			ControllerCommandItem*		m_cci;
 		};
 
-OPENZWAVE_EXPORT_WARNINGS_OFF
-		list<MsgQueueItem>			m_msgQueue[MsgQueue_Count];
-OPENZWAVE_EXPORT_WARNINGS_ON
+		SendQueue*				m_msgQueue[MsgQueue_Count];				// Each queue holds a FIFO per node, and takes turns between the nodes
 		Event*					m_queueEvent[MsgQueue_Count];				// Events for each queue, which are signalled when the queue is not empty
 		Mutex*					m_sendMutex;						// Serialize access to the queues
 		Msg*					m_currentMsg;
 		MsgQueue				m_currentMsgQueueSource;			// identifies which queue held m_currentMsg
 		TimeStamp				m_resendTimeStamp;
+		Topology*				m_topology;							// Neighbor lists and route health of the nodes
+		LatencyStats*			m_latencyStats;						// Latency histograms of the message transactions, or NULL if they are not kept
 
 	//-----------------------------------------------------------------------------
 	// Network functions
@@ -723,12 +757,75 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void SwitchAllOn();
 		void SwitchAllOff();
 
+	//-----------------------------------------------------------------------------
+	// Multicast
+	//-----------------------------------------------------------------------------
+	private:
+		// The public interface is provided via the bulk SetValue methods in the Manager class
+		/**
+		 *  Start holding back the messages the calling thread queues on MsgQueue_Send.
+		 *  Until EndMulticast is called, SendMsg keeps that thread's messages for
+		 *  listening nodes in a list instead of queuing them.  Messages from other
+		 *  threads are queued as usual.  Only one batch is collected at a time, so a
+		 *  second caller waits here until the first batch has ended.
+		 *  \see EndMulticast
+		 */
+		void BeginMulticast();
+		/**
+		 *  Queue the messages held since BeginMulticast.
+		 *  Commands with the same payload for two or more nodes are sent as one
+		 *  FUNC_ID_ZW_SEND_DATA_MULTI frame, which the nodes all act on at once.
+		 *  Unless the MulticastVerify option is false, the original commands are
+		 *  then sent to each node in turn, since a multicast frame is not
+		 *  acknowledged by the nodes that receive it.  Every other message is
+		 *  queued unchanged.  Each node receives its messages in the order they
+		 *  were queued.
+		 */
+		void EndMulticast();
+		bool IsMulticastCandidate( Msg* _msg );						// A command that needs no reply, for a listening node, that could be sent by multicast
+		void HandleSendDataMultiResponse( uint8* _data );
+		void HandleSendDataMultiRequest( uint8* _data );
+
+		Mutex*					m_multicastMutex;					// Held from BeginMulticast to EndMulticast
+		list<Msg*>*				m_multicastMsgs;					// Messages held since BeginMulticast, or NULL.  Protected by m_sendMutex.
+		void const*				m_multicastOwner;					// Identifies the thread collecting the batch.  Protected by m_sendMutex.
+
+		static uint32 const		c_maxMulticastNodes = 64;			// Nodes addressed by one multicast frame
+
+	//-----------------------------------------------------------------------------
+	// Interview scheduling
+	//-----------------------------------------------------------------------------
+	private:
+		/**
+		 *  Decide whether a node may go on with its interview.
+		 *  At most MaxInterviews listening or frequently listening nodes are
+		 *  interviewed at once, so that each node's stages follow each other
+		 *  promptly rather than every node's stages interleaving.  A node that is
+		 *  refused waits its turn, behind any mains powered nodes that are already
+		 *  waiting, and its queries are resumed when a place becomes free.  Nodes
+		 *  that sleep are not limited, since they can only be queried while awake.
+		 *  \return true if the node may send its queries now.
+		 *  \see EndInterview
+		 */
+		bool AdmitInterview( Node* _node );
+		/**
+		 *  Give up a node's place when its interview is complete, the node is
+		 *  presumed dead or it is removed, and resume the next waiting node.
+		 */
+		void EndInterview( uint8 const _nodeId );
+
+		int32					m_maxInterviews;					// Nodes interviewed at once, or 0 for no limit
+		uint32					m_interviewCount;					// Nodes holding a place.  Protected by m_nodeMutex, as are the members below.
+		bool					m_interviewing[256];				// Nodes holding a place, by node Id
+		list<uint8>				m_interviewWaiting;					// Nodes waiting for a place, mains powered nodes first
+
 	//-----------------------------------------------------------------------------
 	// Configuration Parameters	(wrappers for the Node methods)
 	//-----------------------------------------------------------------------------
 	private:
 		// The public interface is provided via the wrappers in the Manager class
 		bool SetConfigParam( uint8 const _nodeId, uint8 const _param, int32 _value, uint8 const _size );
+		bool SetConfigParams( uint8 const _nodeId, map<uint8,int32> const& _params, map<uint8,Node::ConfigParamStatus>* o_status );
 		void RequestConfigParam( uint8 const _nodeId, uint8 const _param );
 
 	//-----------------------------------------------------------------------------
@@ -782,6 +879,14 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 			uint32 m_routedbusy;			// Number of messages received with routed busy status
 			uint32 m_broadcastReadCnt;		// Number of broadcasts read
 			uint32 m_broadcastWriteCnt;		// Number of broadcasts sent
+			uint32 m_multiCmdFrames;		// Number of Multi Command Encapsulation frames sent
+			uint32 m_multiCmdMessages;		// Number of messages packed into those frames
+			uint32 m_multicastFrames;		// Number of multicast frames sent
+			uint32 m_multicastMessages;		// Number of commands sent by those frames
+			uint32 m_prefetchedNonces;		// Number of encrypted messages sent with a nonce the node sent ahead of time
+			uint32 m_neighborUpdates;		// Number of neighbor updates requested for nodes whose routes had degraded
+			uint32 m_msgAllocated;			// Number of messages allocated from the heap, by all drivers
+			uint32 m_msgReused;				// Number of messages that reused a pooled allocation, by all drivers
 		};
 
 		void LogDriverStatistics();
@@ -789,6 +894,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 	private:
 		void GetDriverStatistics( DriverData* _data );
 		void GetNodeStatistics( uint8 const _nodeId, Node::NodeData* _data );
+		bool GetLatencyStatistics( LatencyStats::Stage const _stage, LatencyStats::Group const _group, uint8 const _key, LatencyStats::Summary* _data );
+		bool WriteLatencyStatistics( string const& _filename );
 
 		uint32 m_SOFCnt;			// Number of SOF bytes received
 		uint32 m_ACKWaiting;			// Number of unsolcited messages while waiting for an ACK
@@ -811,6 +918,12 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		uint32 m_routedbusy;			// Number of messages received with routed busy status
 		uint32 m_broadcastReadCnt;		// Number of broadcasts read
 		uint32 m_broadcastWriteCnt;		// Number of broadcasts sent
+		uint32 m_multiCmdFrames;		// Number of Multi Command Encapsulation frames sent
+		uint32 m_multiCmdMessages;		// Number of messages packed into those frames
+		uint32 m_multicastFrames;		// Number of multicast frames sent
+		uint32 m_multicastMessages;		// Number of commands sent by those frames
+		uint32 m_prefetchedNonces;		// Number of encrypted messages sent with a nonce the node sent ahead of time
+		uint32 m_neighborUpdates;		// Number of neighbor updates requested for nodes whose routes had degraded
 		//time_t m_commandStart;	// Start time of last command
 		//time_t m_timeoutLost;		// Cumulative time lost to timeouts
 
@@ -829,10 +942,12 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		bool SendEncryptedMessage();
 		bool SendNonceRequest(string logmsg);
 		void SendNonceKey(uint8 nodeId, uint8 *nonce);
-		aes_encrypt_ctx *AuthKey;
-		aes_encrypt_ctx *EncryptKey;
+		bool IsEncryptedMsgQueued( uint8 const _nodeId );
 		uint8 m_nonceReportSent;
 		uint8 m_nonceReportSentAttempt;
+		bool m_awaitingNonce;						// A Nonce Get has been sent for the current message
+		aes_encrypt_ctx *AuthKey;
+		aes_encrypt_ctx *EncryptKey;
 		bool m_inclusionkeySet;
 
 	};
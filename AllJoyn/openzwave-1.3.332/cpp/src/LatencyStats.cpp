@@ -0,0 +1,642 @@
+//-----------------------------------------------------------------------------
+//
+//	LatencyStats.cpp
+//
+//	Histograms of the time messages spend at each stage of a transaction
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "LatencyStats.h"
+#include "platform/Atomic.h"
+#include "platform/Event.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Thread.h"
+#include "platform/Wait.h"
+
+using namespace OpenZWave;
+
+static char const* c_stageNames[] =
+{
+	"queue",
+	"ack",
+	"callback",
+	"report"
+};
+
+// Upper bounds of the exported buckets, in milliseconds.  Each is a bucket
+// boundary of LatencyHistogram, so the exported counts are exact.
+static uint32 const c_exportLimits[] =
+{
+	1, 2, 4, 8, 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024,
+	1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576, 32768, 65536
+};
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::LatencyHistogram>
+// Constructor
+//-----------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram
+(
+):
+	m_sum( 0 ),
+	m_max( 0 )
+{
+	for( uint32 i=0; i<c_numBuckets; ++i )
+	{
+		m_counts[i] = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetBucket>
+// Index of the bucket that holds a latency
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetBucket
+(
+	uint32 const _latency
+)
+{
+	if( _latency < c_linearBuckets )
+	{
+		return _latency;
+	}
+
+	// Position of the highest set bit, which is at least 5
+	uint32 bit = 5;
+	while( ( _latency >> ( bit + 1 ) ) != 0 )
+	{
+		++bit;
+	}
+	if( bit >= c_maxBits )
+	{
+		return( c_numBuckets - 1 );
+	}
+
+	// The four bits below the highest choose the sub-bucket
+	return( c_linearBuckets + ( bit - 5 ) * c_subBuckets + ( ( _latency >> ( bit - 4 ) ) & ( c_subBuckets - 1 ) ) );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetBucketLimit>
+// Lowest latency that falls above a bucket
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetBucketLimit
+(
+	uint32 const _bucket
+)
+{
+	if( _bucket < c_linearBuckets )
+	{
+		return( _bucket + 1 );
+	}
+
+	uint32 bit = 5 + ( _bucket - c_linearBuckets ) / c_subBuckets;
+	uint32 sub = ( _bucket - c_linearBuckets ) % c_subBuckets;
+	return( ( c_subBuckets + sub + 1 ) << ( bit - 4 ) );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::Record>
+// Add a latency to the histogram
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Record
+(
+	uint32 const _latency
+)
+{
+	// Only the recording thread writes, so plain increments are enough
+	m_counts[GetBucket( _latency )]++;
+	m_sum += _latency;
+	if( _latency > m_max )
+	{
+		m_max = _latency;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::Read>
+// Copy the histogram while it may still be recorded into
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Read
+(
+	LatencyHistogram* o_copy
+)const
+{
+	for( uint32 i=0; i<c_numBuckets; ++i )
+	{
+		o_copy->m_counts[i] = m_counts[i];
+	}
+	o_copy->m_sum = m_sum;
+	o_copy->m_max = m_max;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetCount>
+// Number of latencies recorded
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetCount
+(
+)const
+{
+	uint32 count = 0;
+	for( uint32 i=0; i<c_numBuckets; ++i )
+	{
+		count += m_counts[i];
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetCountBelow>
+// Number of latencies recorded below a limit, rounded up to a bucket boundary
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetCountBelow
+(
+	uint32 const _limit
+)const
+{
+	if( _limit == 0 )
+	{
+		return 0;
+	}
+
+	uint32 count = 0;
+	uint32 last = GetBucket( _limit - 1 );
+	for( uint32 i=0; i<=last; ++i )
+	{
+		count += m_counts[i];
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetPercentile>
+// Latency below which a share of the recorded latencies fall
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetPercentile
+(
+	uint32 const _permille
+)const
+{
+	uint32 count = GetCount();
+	if( count == 0 )
+	{
+		return 0;
+	}
+
+	// Rank of the latency that reaches the share, counting from one
+	uint32 rank = (uint32)( ( (uint64)count * _permille + 999 ) / 1000 );
+	if( rank == 0 )
+	{
+		rank = 1;
+	}
+
+	uint32 seen = 0;
+	for( uint32 i=0; i<c_numBuckets; ++i )
+	{
+		seen += m_counts[i];
+		if( seen >= rank )
+		{
+			uint32 latency = GetBucketLimit( i ) - 1;
+			return( latency < m_max ? latency : m_max );
+		}
+	}
+	return m_max;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::LatencyStats>
+// Constructor
+//-----------------------------------------------------------------------------
+LatencyStats::LatencyStats
+(
+	char const* const* _queueNames,
+	uint32 const _numQueues
+):
+	m_queueNames( _queueNames ),
+	m_numQueues( _numQueues < (uint32)c_maxQueues ? _numQueues : (uint32)c_maxQueues ),
+	m_nodeId( 0 ),
+	m_commandClassId( 0 ),
+	m_queue( 0 ),
+	m_sentTime( 0 ),
+	m_ackTime( 0 ),
+	m_callbackTime( 0 ),
+	m_thread( NULL ),
+	m_interval( 0 ),
+	m_homeId( 0 )
+{
+	for( uint32 stage=0; stage<Stage_Count; ++stage )
+	{
+		m_all[stage] = NULL;
+		for( uint32 i=0; i<256; ++i )
+		{
+			m_nodes[stage][i] = NULL;
+			m_commandClasses[stage][i] = NULL;
+		}
+		for( uint32 i=0; i<c_maxQueues; ++i )
+		{
+			m_queues[stage][i] = NULL;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::~LatencyStats>
+// Destructor
+//-----------------------------------------------------------------------------
+LatencyStats::~LatencyStats
+(
+)
+{
+	if( m_thread != NULL )
+	{
+		m_thread->Stop();
+		m_thread->Release();
+	}
+
+	for( uint32 stage=0; stage<Stage_Count; ++stage )
+	{
+		delete m_all[stage];
+		for( uint32 i=0; i<256; ++i )
+		{
+			delete m_nodes[stage][i];
+			delete m_commandClasses[stage][i];
+		}
+		for( uint32 i=0; i<c_maxQueues; ++i )
+		{
+			delete m_queues[stage][i];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Sent>
+// Start timing a transaction, or a retry of it
+//-----------------------------------------------------------------------------
+void LatencyStats::Sent
+(
+	uint8 const _nodeId,
+	uint8 const _commandClassId,
+	uint32 const _queue,
+	uint32 const _queuedTime
+)
+{
+	m_nodeId = _nodeId;
+	m_commandClassId = _commandClassId;
+	m_queue = _queue;
+	m_sentTime = Now();
+	m_ackTime = 0;
+	m_callbackTime = 0;
+
+	if( _queuedTime != 0 && m_sentTime >= _queuedTime )
+	{
+		Record( Stage_Queue, m_sentTime - _queuedTime );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Acked>
+// Time the controller's ACK from the write
+//-----------------------------------------------------------------------------
+void LatencyStats::Acked
+(
+)
+{
+	if( m_sentTime == 0 || m_ackTime != 0 )
+	{
+		return;
+	}
+
+	m_ackTime = Now();
+	Record( Stage_Ack, m_ackTime - m_sentTime );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::CalledBack>
+// Time the controller's callback from the ACK
+//-----------------------------------------------------------------------------
+void LatencyStats::CalledBack
+(
+)
+{
+	if( m_sentTime == 0 || m_callbackTime != 0 )
+	{
+		return;
+	}
+
+	m_callbackTime = Now();
+	Record( Stage_Callback, m_callbackTime - ( m_ackTime ? m_ackTime : m_sentTime ) );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Reported>
+// Time the node's reply from the last stage before it
+//-----------------------------------------------------------------------------
+void LatencyStats::Reported
+(
+)
+{
+	if( m_sentTime == 0 )
+	{
+		return;
+	}
+
+	uint32 from = m_callbackTime ? m_callbackTime : ( m_ackTime ? m_ackTime : m_sentTime );
+	Record( Stage_Report, Now() - from );
+	m_sentTime = 0;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Record>
+// Add a latency to every histogram the current transaction belongs to
+//-----------------------------------------------------------------------------
+void LatencyStats::Record
+(
+	Stage const _stage,
+	uint32 const _latency
+)
+{
+	Record( &m_all[_stage], _latency );
+	if( m_nodeId != 0 && m_nodeId != 0xff )
+	{
+		Record( &m_nodes[_stage][m_nodeId], _latency );
+	}
+	if( m_commandClassId != 0 )
+	{
+		Record( &m_commandClasses[_stage][m_commandClassId], _latency );
+	}
+	if( m_queue < m_numQueues )
+	{
+		Record( &m_queues[_stage][m_queue], _latency );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Record>
+// Add a latency to a histogram, creating it if need be
+//-----------------------------------------------------------------------------
+void LatencyStats::Record
+(
+	LatencyHistogram* volatile* _slot,
+	uint32 const _latency
+)
+{
+	LatencyHistogram* histogram = *_slot;
+	if( histogram == NULL )
+	{
+		histogram = new LatencyHistogram();
+		// Readers must not see the pointer before the histogram is initialised
+		AtomicFence();
+		*_slot = histogram;
+	}
+	histogram->Record( _latency );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Find>
+// Get a histogram, if anything has been recorded for it
+//-----------------------------------------------------------------------------
+LatencyHistogram const* LatencyStats::Find
+(
+	Stage const _stage,
+	Group const _group,
+	uint8 const _key
+)const
+{
+	if( _stage >= Stage_Count )
+	{
+		return NULL;
+	}
+
+	LatencyHistogram const* histogram = NULL;
+	switch( _group )
+	{
+		case Group_All:
+		{
+			histogram = m_all[_stage];
+			break;
+		}
+		case Group_Node:
+		{
+			histogram = m_nodes[_stage][_key];
+			break;
+		}
+		case Group_CommandClass:
+		{
+			histogram = m_commandClasses[_stage][_key];
+			break;
+		}
+		case Group_Queue:
+		{
+			if( _key < m_numQueues )
+			{
+				histogram = m_queues[_stage][_key];
+			}
+			break;
+		}
+	}
+	AtomicFence();
+	return histogram;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::GetSummary>
+// Summarise a histogram
+//-----------------------------------------------------------------------------
+bool LatencyStats::GetSummary
+(
+	Stage const _stage,
+	Group const _group,
+	uint8 const _key,
+	Summary* o_summary
+)const
+{
+	LatencyHistogram const* histogram = Find( _stage, _group, _key );
+	if( histogram == NULL )
+	{
+		return false;
+	}
+
+	LatencyHistogram copy;
+	histogram->Read( &copy );
+	o_summary->m_count = copy.GetCount();
+	o_summary->m_sum = copy.GetSum();
+	o_summary->m_max = copy.GetMax();
+	o_summary->m_p50 = copy.GetPercentile( 500 );
+	o_summary->m_p90 = copy.GetPercentile( 900 );
+	o_summary->m_p99 = copy.GetPercentile( 990 );
+	o_summary->m_p999 = copy.GetPercentile( 999 );
+	return( o_summary->m_count != 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::WriteHistogram>
+// Write the series of one histogram in the Prometheus text format
+//-----------------------------------------------------------------------------
+void LatencyStats::WriteHistogram
+(
+	FILE* _fp,
+	LatencyHistogram const& _histogram,
+	char const* _labels
+)const
+{
+	LatencyHistogram copy;
+	_histogram.Read( &copy );
+
+	// The buckets are cumulative, and latencies are whole milliseconds
+	// truncated down, so the count below a limit is the count up to it.
+	char const* name = "ozw_latency_seconds";
+	for( uint32 i=0; i<sizeof(c_exportLimits)/sizeof(c_exportLimits[0]); ++i )
+	{
+		fprintf( _fp, "%s_bucket{%s,le=\"%.3f\"} %u\n", name, _labels, c_exportLimits[i] / 1000.0, copy.GetCountBelow( c_exportLimits[i] ) );
+	}
+	uint32 count = copy.GetCount();
+	fprintf( _fp, "%s_bucket{%s,le=\"+Inf\"} %u\n", name, _labels, count );
+	fprintf( _fp, "%s_sum{%s} %.3f\n", name, _labels, (double)copy.GetSum() / 1000.0 );
+	fprintf( _fp, "%s_count{%s} %u\n", name, _labels, count );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::Write>
+// Write every histogram in the Prometheus text format
+//-----------------------------------------------------------------------------
+bool LatencyStats::Write
+(
+	string const& _filename,
+	uint32 const _homeId
+)const
+{
+	string tempFilename = _filename + ".tmp";
+	bool res = false;
+	if( FILE* fp = fopen( tempFilename.c_str(), "w" ) )
+	{
+		fprintf( fp, "# HELP ozw_latency_seconds Time Z-Wave messages spent at each stage of their transactions.\n" );
+		fprintf( fp, "# TYPE ozw_latency_seconds histogram\n" );
+
+		char labels[128];
+		for( uint32 stage=0; stage<Stage_Count; ++stage )
+		{
+			LatencyHistogram const* histogram = Find( (Stage)stage, Group_All, 0 );
+			if( histogram != NULL )
+			{
+				snprintf( labels, sizeof(labels), "home=\"0x%08x\",stage=\"%s\"", _homeId, c_stageNames[stage] );
+				WriteHistogram( fp, *histogram, labels );
+			}
+			for( uint32 i=0; i<256; ++i )
+			{
+				if( ( histogram = Find( (Stage)stage, Group_Node, (uint8)i ) ) != NULL )
+				{
+					snprintf( labels, sizeof(labels), "home=\"0x%08x\",stage=\"%s\",node=\"%u\"", _homeId, c_stageNames[stage], i );
+					WriteHistogram( fp, *histogram, labels );
+				}
+			}
+			for( uint32 i=0; i<256; ++i )
+			{
+				if( ( histogram = Find( (Stage)stage, Group_CommandClass, (uint8)i ) ) != NULL )
+				{
+					snprintf( labels, sizeof(labels), "home=\"0x%08x\",stage=\"%s\",command_class=\"0x%02x\"", _homeId, c_stageNames[stage], i );
+					WriteHistogram( fp, *histogram, labels );
+				}
+			}
+			for( uint32 i=0; i<m_numQueues; ++i )
+			{
+				if( ( histogram = Find( (Stage)stage, Group_Queue, (uint8)i ) ) != NULL )
+				{
+					snprintf( labels, sizeof(labels), "home=\"0x%08x\",stage=\"%s\",queue=\"%s\"", _homeId, c_stageNames[stage], m_queueNames[i] );
+					WriteHistogram( fp, *histogram, labels );
+				}
+			}
+		}
+		res = ( ferror( fp ) == 0 );
+		res = ( fclose( fp ) == 0 ) && res;
+	}
+
+	if( res )
+	{
+		res = FileOps::RenameFile( tempFilename, _filename );
+	}
+
+	if( !res )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Unable to write latency statistics to %s", _filename.c_str() );
+		remove( tempFilename.c_str() );
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::StartExport>
+// Start the thread that writes the statistics at a regular interval
+//-----------------------------------------------------------------------------
+void LatencyStats::StartExport
+(
+	string const& _filename,
+	int32 const _interval,
+	uint32 const _homeId
+)
+{
+	if( m_thread != NULL || _interval <= 0 )
+	{
+		return;
+	}
+
+	m_filename = _filename;
+	m_interval = _interval;
+	m_homeId = _homeId;
+	m_thread = new Thread( "latency" );
+	m_thread->Start( LatencyStats::ExportThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::ExportThreadEntryPoint>
+// Entry point of the thread that writes the statistics
+//-----------------------------------------------------------------------------
+void LatencyStats::ExportThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	LatencyStats* stats = (LatencyStats*)_context;
+	if( stats )
+	{
+		stats->ExportThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyStats::ExportThreadProc>
+// Write the statistics each interval until told to exit
+//-----------------------------------------------------------------------------
+void LatencyStats::ExportThreadProc
+(
+	Event* _exitEvent
+)
+{
+	while( Wait::Single( _exitEvent, m_interval * 1000 ) != 0 )
+	{
+		Write( m_filename, m_homeId );
+	}
+}
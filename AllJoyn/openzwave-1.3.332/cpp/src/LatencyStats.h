@@ -0,0 +1,275 @@
+//-----------------------------------------------------------------------------
+//
+//	LatencyStats.h
+//
+//	Histograms of the time messages spend at each stage of a transaction
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _LatencyStats_H
+#define _LatencyStats_H
+
+#include <stdio.h>
+#include <string>
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Thread;
+
+	/** \brief A histogram of latencies in milliseconds, with a bounded relative error.
+	 *
+	 *  Latencies under 32ms each have a bucket of their own.  Above that, each
+	 *  power of two is split into 16 buckets, so a latency is never placed more
+	 *  than 1/16th away from its true value, up to the largest latency of about
+	 *  17 minutes.
+	 *
+	 *  Only one thread may record into a histogram.  Any thread may read it at
+	 *  the same time without a lock.  A reader sees each count as it was at some
+	 *  moment, though a latency recorded during the read may be missing from
+	 *  some of the totals.
+	 */
+	class LatencyHistogram
+	{
+	public:
+		enum
+		{
+			c_linearBuckets = 32,
+			c_subBuckets = 16,
+			c_maxBits = 20,
+			c_numBuckets = c_linearBuckets + ( c_maxBits - 5 ) * c_subBuckets
+		};
+
+		LatencyHistogram();
+
+		/**
+		 * Add a latency to the histogram.
+		 */
+		void Record( uint32 const _latency );
+
+		/**
+		 * Copy the histogram.
+		 */
+		void Read( LatencyHistogram* o_copy )const;
+
+		/**
+		 * Number of latencies recorded.
+		 */
+		uint32 GetCount()const;
+
+		/**
+		 * Number of latencies recorded that were less than a limit.
+		 * The limit is rounded up to the nearest bucket boundary.
+		 */
+		uint32 GetCountBelow( uint32 const _limit )const;
+
+		/**
+		 * Sum of the latencies recorded, in milliseconds.
+		 */
+		uint64 GetSum()const{ return m_sum; }
+
+		/**
+		 * Largest latency recorded.
+		 */
+		uint32 GetMax()const{ return m_max; }
+
+		/**
+		 * Latency below which a share of the recorded latencies fall.
+		 * \param _permille the share, in thousandths.
+		 * \return the highest latency in the bucket that holds the percentile, or zero if nothing was recorded.
+		 */
+		uint32 GetPercentile( uint32 const _permille )const;
+
+		static uint32 GetBucket( uint32 const _latency );
+		static uint32 GetBucketLimit( uint32 const _bucket );		// Lowest latency above the bucket
+
+	private:
+		uint32 volatile		m_counts[c_numBuckets];
+		uint64 volatile		m_sum;
+		uint32 volatile		m_max;
+	};
+
+	/** \brief Latency histograms for the stages of a driver's message transactions.
+	 *
+	 *  A transaction is timed in four stages:
+	 *  - Queue: from the message being queued to it first being written to the controller;
+	 *  - Ack: from each write to the controller's ACK;
+	 *  - Callback: from the ACK to the controller's callback, reporting the radio transmission;
+	 *  - Report: from the callback, or the ACK if there is none, to the reply that completes the transaction.
+	 *  Slowness in the queue stage comes from the driver, in the ack stage from the
+	 *  controller, and in the callback and report stages from the radio and the node.
+	 *
+	 *  Each stage has a histogram for all messages, and histograms broken down by
+	 *  node, by the command class of the message and by the queue it was sent from.
+	 *  Histograms are only created when something is recorded for them.  They are
+	 *  recorded by the driver thread alone, and can be read by any thread without
+	 *  a lock.  A histogram, once created, lasts as long as the statistics.
+	 *
+	 *  The histograms can be written in the Prometheus text format, so the node
+	 *  exporter can collect them from a file.  A thread of its own can write the
+	 *  file at a regular interval.
+	 */
+	class LatencyStats
+	{
+	public:
+		enum Stage
+		{
+			Stage_Queue = 0,
+			Stage_Ack,
+			Stage_Callback,
+			Stage_Report,
+			Stage_Count
+		};
+
+		enum Group
+		{
+			Group_All = 0,						/**< Every message.  The key is ignored. */
+			Group_Node,							/**< Messages for the node whose id is the key */
+			Group_CommandClass,					/**< Messages from the command class whose id is the key */
+			Group_Queue							/**< Messages sent from the driver queue whose number is the key */
+		};
+
+		/**
+		 * Summary of one histogram.  Latencies are in milliseconds.
+		 */
+		struct Summary
+		{
+			uint32	m_count;
+			uint64	m_sum;
+			uint32	m_max;
+			uint32	m_p50;
+			uint32	m_p90;
+			uint32	m_p99;
+			uint32	m_p999;
+		};
+
+		/**
+		 * Constructor.
+		 * \param _queueNames names of the driver's queues, used to label them in the exported file.
+		 * \param _numQueues number of queues.
+		 */
+		LatencyStats( char const* const* _queueNames, uint32 const _numQueues );
+		~LatencyStats();
+
+		/**
+		 * Milliseconds since the statistics were created.  Never zero, so that zero can mean "not set".
+		 */
+		uint32 Now(){ uint32 now = (uint32)( -m_start.TimeRemaining() ); return( now ? now : 1 ); }
+
+		/**
+		 * Record that a message has been written to the controller.
+		 * \param _nodeId the node the message is for, or 0xff for a controller function.
+		 * \param _commandClassId the command class of the message, or zero.
+		 * \param _queue the queue the message was taken from.
+		 * \param _queuedTime the time the message was queued, or zero to skip the queue stage, as for a retry.
+		 */
+		void Sent( uint8 const _nodeId, uint8 const _commandClassId, uint32 const _queue, uint32 const _queuedTime );
+
+		/**
+		 * Record that the controller acknowledged the message.
+		 */
+		void Acked();
+
+		/**
+		 * Record that the controller's callback for the message arrived.
+		 */
+		void CalledBack();
+
+		/**
+		 * Record that the node's reply to the message arrived, which ends the transaction.
+		 */
+		void Reported();
+
+		/**
+		 * Record that the transaction is over.  Stages that arrive later are not timed.
+		 */
+		void Finished(){ m_sentTime = 0; }
+
+		/**
+		 * Summarise a histogram.
+		 * \return false if nothing has been recorded for it.
+		 */
+		bool GetSummary( Stage const _stage, Group const _group, uint8 const _key, Summary* o_summary )const;
+
+		/**
+		 * Write every histogram in the Prometheus text format.
+		 * \param _filename the file.  It is written under a temporary name, which then replaces it.
+		 * \param _homeId the home id, used to label the histograms.
+		 * \return true if the file was written.
+		 */
+		bool Write( string const& _filename, uint32 const _homeId )const;
+
+		/**
+		 * Start a thread that writes the file at a regular interval.
+		 * \param _filename the file.
+		 * \param _interval seconds between writes.
+		 * \param _homeId the home id.
+		 */
+		void StartExport( string const& _filename, int32 const _interval, uint32 const _homeId );
+
+	private:
+		LatencyStats( LatencyStats const& );					// prevent copy
+		LatencyStats& operator = ( LatencyStats const& );		// prevent assignment
+
+		enum
+		{
+			c_maxQueues = 16
+		};
+
+		void Record( Stage const _stage, uint32 const _latency );
+		void Record( LatencyHistogram* volatile* _slot, uint32 const _latency );
+		LatencyHistogram const* Find( Stage const _stage, Group const _group, uint8 const _key )const;
+		void WriteHistogram( FILE* _fp, LatencyHistogram const& _histogram, char const* _labels )const;
+
+		static void ExportThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ExportThreadProc( Event* _exitEvent );
+
+		TimeStamp					m_start;
+		char const* const*			m_queueNames;
+		uint32						m_numQueues;
+
+		// Histograms, created on first use
+		LatencyHistogram* volatile	m_all[Stage_Count];
+		LatencyHistogram* volatile	m_nodes[Stage_Count][256];
+		LatencyHistogram* volatile	m_commandClasses[Stage_Count][256];
+		LatencyHistogram* volatile	m_queues[Stage_Count][c_maxQueues];
+
+		// The transaction being timed.  Only used by the driver thread.
+		uint8						m_nodeId;
+		uint8						m_commandClassId;
+		uint32						m_queue;
+		uint32						m_sentTime;				// Zero if no transaction is being timed
+		uint32						m_ackTime;
+		uint32						m_callbackTime;
+
+		// Periodic export
+		Thread*						m_thread;
+		string						m_filename;
+		int32						m_interval;
+		uint32						m_homeId;
+	};
+
+} // namespace OpenZWave
+
+#endif //_LatencyStats_H
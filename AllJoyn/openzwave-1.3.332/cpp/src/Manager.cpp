@@ -32,8 +32,11 @@
 #include "Defs.h"
 #include "Manager.h"
 #include "Driver.h"
+#include "ConfigWriter.h"
+#include "Msg.h"
 #include "Node.h"
 #include "Notification.h"
+#include "NotificationDispatcher.h"
 #include "Options.h"
 #include "Scene.h"
 #include "Utils.h"
@@ -41,9 +44,12 @@
 #include "platform/Mutex.h"
 #include "platform/Event.h"
 #include "platform/Log.h"
+#include "platform/FileOps.h"
+#include "platform/SimulatorController.h"
 
 #include "command_classes/CommandClasses.h"
 #include "command_classes/CommandClass.h"
+#include "command_classes/ManufacturerSpecific.h"
 #include "command_classes/WakeUp.h"
 
 #include "value_classes/ValueID.h"
@@ -140,7 +146,9 @@ ozwversion Manager::getVersion() {
 Manager::Manager
 (
 ):
-m_notificationMutex( new Mutex() )
+m_driverMutex( new Mutex() ),
+m_notificationMutex( new Mutex() ),
+m_notificationDispatcher( NULL )
 {
 	// Ensure the singleton instance is set
 	s_instance = this;
@@ -179,10 +187,30 @@ m_notificationMutex( new Mutex() )
 	int nDumpTrigger = (int) LogLevel_Warning;
 	Options::Get()->GetOptionAsInt( "DumpTriggerLevel", &nDumpTrigger );
 
+	bool bAsyncLogging = false;
+	Options::Get()->GetOptionAsBool( "AsyncLogging", &bAsyncLogging );
+
 	string logFilename = userPath + logFileNameBase;
 	Log::Create( logFilename, bAppend, bConsoleOutput, (LogLevel) nSaveLogLevel, (LogLevel) nQueueLogLevel, (LogLevel) nDumpTrigger );
 	Log::SetLoggingState( logging );
+	Log::SetAsync( bAsyncLogging );
+
+	// The drivers map their network caches through FileOps
+	FileOps::Create();
+
+	Notification::CreatePool();
+	Msg::CreatePool();
 
+	bool notifyThread = false;
+	Options::Get()->GetOptionAsBool( "NotifyThread", &notifyThread );
+	if( notifyThread )
+	{
+		int32 coalesceTime = 0;
+		Options::Get()->GetOptionAsInt( "NotifyCoalesceTime", &coalesceTime );
+		m_notificationDispatcher = new NotificationDispatcher( this, coalesceTime );
+	}
+
+	ManufacturerSpecific::CreateLock();
 	CommandClasses::RegisterCommandClasses();
 	Scene::ReadScenes();
 	Log::Write(LogLevel_Always, "OpenZwave Version %s Starting Up", getVersionAsString().c_str());
@@ -207,12 +235,18 @@ Manager::~Manager
 	// Clear the ready map
 	while( !m_readyDrivers.empty() )
 	{
-		map<uint32,Driver*>::iterator it = m_readyDrivers.begin();
-		delete it->second;
-		m_readyDrivers.erase( it );
+		DeleteReadyDriver( m_readyDrivers.begin()->first );
 	}
 
+	// Deliver anything the drivers sent as they were removed
+	delete m_notificationDispatcher;
+	m_notificationDispatcher = NULL;
+	Notification::DestroyPool();
+	Msg::DestroyPool();
+	ManufacturerSpecific::DestroyLock();
+
 	m_notificationMutex->Release();
+	m_driverMutex->Release();
 
 	// Clear the watchers list
 	while( !m_watchers.empty() )
@@ -230,6 +264,7 @@ Manager::~Manager
 		Node::s_genericDeviceClasses.erase( git );
 	}
 
+	FileOps::Destroy();
 	Log::Destroy();
 }
 
@@ -248,8 +283,8 @@ void Manager::WriteConfig
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		driver->WriteConfig();
-		Log::Write( LogLevel_Info, "mgr,     Manager::WriteConfig completed for driver with home ID of 0x%.8x", _homeId );
+		driver->m_configWriter->RequestWrite();
+		Log::Write( LogLevel_Info, "mgr,     Manager::WriteConfig requested for driver with home ID of 0x%.8x", _homeId );
 	}
 	else
 	{
@@ -324,6 +359,7 @@ bool Manager::RemoveDriver
 	}
 
 	// Search the ready map
+	m_driverMutex->Lock();
 	for( map<uint32,Driver*>::iterator rit = m_readyDrivers.begin(); rit != m_readyDrivers.end(); ++rit )
 	{
 		if( _controllerPath == rit->second->GetControllerPath() )
@@ -342,12 +378,14 @@ bool Manager::RemoveDriver
 			 * will crash and burn if they can't get a valid Driver back...
 			 */
 			Log::Write( LogLevel_Info, "mgr,     Driver for controller %s pending removal", _controllerPath.c_str() );
-			delete rit->second;
-			m_readyDrivers.erase( rit );
+			uint32 homeId = rit->first;
+			m_driverMutex->Unlock();
+			DeleteReadyDriver( homeId );
 			Log::Write( LogLevel_Info, "mgr,     Driver for controller %s removed", _controllerPath.c_str() );
 			return true;
 		}
 	}
+	m_driverMutex->Unlock();
 
 	Log::Write( LogLevel_Info, "mgr,     Failed to remove driver for controller %s", _controllerPath.c_str() );
 	return false;
@@ -405,7 +443,9 @@ void Manager::SetDriverReady
 		}
 
 		// Add the driver to the ready map
+		m_driverMutex->Lock();
 		m_readyDrivers[_driver->GetHomeId()] = _driver;
+		m_driverMutex->Unlock();
 
 		// Notify the watchers
 		Notification* notification = new Notification(success ? Notification::Type_DriverReady : Notification::Type_DriverFailed );
@@ -414,6 +454,37 @@ void Manager::SetDriverReady
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::DeleteReadyDriver>
+// Delete a driver from the ready map
+//-----------------------------------------------------------------------------
+void Manager::DeleteReadyDriver
+(
+		uint32 const _homeId
+)
+{
+	// The driver stays in the map while it is deleted, as its destructor
+	// looks itself up.  It is marked as being removed first, so that the
+	// notification thread no longer locks its nodes.
+	m_driverMutex->Lock();
+	map<uint32,Driver*>::iterator it = m_readyDrivers.find( _homeId );
+	if( it == m_readyDrivers.end() )
+	{
+		m_driverMutex->Unlock();
+		return;
+	}
+	Driver* driver = it->second;
+	m_removingDrivers.insert( _homeId );
+	m_driverMutex->Unlock();
+
+	delete driver;
+
+	m_driverMutex->Lock();
+	m_readyDrivers.erase( _homeId );
+	m_removingDrivers.erase( _homeId );
+	m_driverMutex->Unlock();
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetControllerNodeId>
 //
@@ -738,7 +809,7 @@ uint8 Manager::GetPollIntensity
 	uint8 intensity = 0;
 	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _valueId.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _valueId ) )
 		{
 			intensity = value->GetPollIntensity();
@@ -751,6 +822,26 @@ uint8 Manager::GetPollIntensity
 	return intensity;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::SetPollPeriod>
+// Give a polled value its own period
+//-----------------------------------------------------------------------------
+bool Manager::SetPollPeriod
+(
+		ValueID const &_valueId,
+		int32 const _period,
+		int32 const _jitter
+)
+{
+	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
+	{
+		return( driver->SetPollPeriod( _valueId, _period, _jitter ) );
+	}
+
+	Log::Write( LogLevel_Info, "mgr,     SetPollPeriod failed - Driver with Home ID 0x%.8x is not available", _valueId.GetHomeId() );
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 //	Retrieving Node information
 //-----------------------------------------------------------------------------
@@ -1075,6 +1166,44 @@ uint32 Manager::GetNodeNeighbors
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeHopCount>
+// Get the expected number of hops from the controller to a node
+//-----------------------------------------------------------------------------
+uint8 Manager::GetNodeHopCount
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetNodeHopCount( _nodeId );
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNodesReachableOnlyVia>
+// Get the nodes that can only be reached through a node
+//-----------------------------------------------------------------------------
+uint32 Manager::GetNodesReachableOnlyVia
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8** o_nodes
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetNodesReachableOnlyVia( _nodeId, o_nodes );
+	}
+
+	*o_nodes = NULL;
+	return 0;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetNodeManufacturerName>
 // Get the manufacturer name of a node
@@ -1319,7 +1448,7 @@ bool Manager::IsNodeInfoReceived
 		Node *node;
 
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _nodeId, false );
 
 		if( (node = driver->GetNode( _nodeId ) ) != NULL)
 		{
@@ -1350,7 +1479,7 @@ bool Manager::GetNodeClassInformation
 		Node *node;
 
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _nodeId, false );
 
 		if( ( node = driver->GetNode( _nodeId ) ) != NULL )
 		{
@@ -1393,7 +1522,7 @@ bool Manager::IsNodeAwake
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _nodeId, false );
 
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
@@ -1419,7 +1548,7 @@ bool Manager::IsNodeFailed
 	bool result = false;
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _nodeId, false );
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
 			result = !node->IsNodeAlive();
@@ -1441,7 +1570,7 @@ string Manager::GetNodeQueryStage
 	string result = "Unknown";
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _nodeId, false );
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
 			result = node->GetQueryStageName( node->GetCurrentQueryStage() );
@@ -1483,7 +1612,7 @@ string Manager::GetValueLabel
 	string label;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			label = value->GetLabel();
@@ -1508,10 +1637,11 @@ void Manager::SetValueLabel
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetLabel( _value );
+			driver->m_configWriter->ValueChanged( _id );
 			value->Release();
 		} else {
 			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueLabel");
@@ -1531,7 +1661,7 @@ string Manager::GetValueUnits
 	string units;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			units = value->GetUnits();
@@ -1556,10 +1686,11 @@ void Manager::SetValueUnits
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetUnits( _value );
+			driver->m_configWriter->ValueChanged( _id );
 			value->Release();
 		} else {
 			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueUnits");
@@ -1579,7 +1710,7 @@ string Manager::GetValueHelp
 	string help;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			help = value->GetHelp();
@@ -1604,10 +1735,11 @@ void Manager::SetValueHelp
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetHelp( _value );
+			driver->m_configWriter->ValueChanged( _id );
 			value->Release();
 		} else {
 			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueHelp");
@@ -1627,7 +1759,7 @@ int32 Manager::GetValueMin
 	int32 limit = 0;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			limit = value->GetMin();
@@ -1652,7 +1784,7 @@ int32 Manager::GetValueMax
 	int32 limit = 0;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			limit = value->GetMax();
@@ -1677,7 +1809,7 @@ bool Manager::IsValueReadOnly
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsReadOnly();
@@ -1702,7 +1834,7 @@ bool Manager::IsValueWriteOnly
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsWriteOnly();
@@ -1727,7 +1859,7 @@ bool Manager::IsValueSet
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsSet();
@@ -1752,7 +1884,7 @@ bool Manager::IsValuePolled
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsPolled();
@@ -1772,7 +1904,8 @@ bool Manager::IsValuePolled
 bool Manager::GetValueAsBool
 (
 		ValueID const& _id,
-		bool* o_value
+		bool* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1783,14 +1916,23 @@ bool Manager::GetValueAsBool
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					*o_value = value->GetValue();
-					value->Release();
+					*o_value = ( snapshot != 0 );
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsBool");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->GetValue();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsBool");
+					}
 				}
 			}
 		}
@@ -1798,14 +1940,23 @@ bool Manager::GetValueAsBool
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					*o_value = value->IsPressed();
-					value->Release();
+					*o_value = ( snapshot != 0 );
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsBool");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->IsPressed();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsBool");
+					}
 				}
 			}
 		} else {
@@ -1823,7 +1974,8 @@ bool Manager::GetValueAsBool
 bool Manager::GetValueAsByte
 (
 		ValueID const& _id,
-		uint8* o_value
+		uint8* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1834,14 +1986,23 @@ bool Manager::GetValueAsByte
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					*o_value = value->GetValue();
-					value->Release();
+					*o_value = (uint8)snapshot;
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsByte");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->GetValue();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsByte");
+					}
 				}
 			}
 		} else {
@@ -1859,7 +2020,8 @@ bool Manager::GetValueAsByte
 bool Manager::GetValueAsFloat
 (
 		ValueID const& _id,
-		float* o_value
+		float* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1870,15 +2032,24 @@ bool Manager::GetValueAsFloat
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				uint8 precision;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot, &precision ) )
 				{
-					string str = value->GetValue();
-					*o_value = (float)atof( str.c_str() );
-					value->Release();
+					*o_value = ValueDecimal::ToFloat( ValueDecimal::Decimal( snapshot, precision ) );
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsFloat");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->GetAsFloat();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsFloat");
+					}
 				}
 			}
 		} else {
@@ -1896,7 +2067,8 @@ bool Manager::GetValueAsFloat
 bool Manager::GetValueAsInt
 (
 		ValueID const& _id,
-		int32* o_value
+		int32* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1907,14 +2079,23 @@ bool Manager::GetValueAsInt
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					*o_value = value->GetValue();
-					value->Release();
+					*o_value = snapshot;
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsInt");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->GetValue();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsInt");
+					}
 				}
 			}
 		} else {
@@ -1933,7 +2114,8 @@ bool Manager::GetValueAsRaw
 (
 		ValueID const& _id,
 		uint8** o_value,
-		uint8* o_length
+		uint8* o_length,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1944,8 +2126,8 @@ bool Manager::GetValueAsRaw
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id, io_handle ) ) )
 				{
 					*o_length = value->GetLength();
 					*o_value = new uint8[*o_length];
@@ -1971,7 +2153,8 @@ bool Manager::GetValueAsRaw
 bool Manager::GetValueAsShort
 (
 		ValueID const& _id,
-		int16* o_value
+		int16* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -1982,14 +2165,23 @@ bool Manager::GetValueAsShort
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					*o_value = value->GetValue();
-					value->Release();
+					*o_value = (int16)snapshot;
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsShort");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						*o_value = value->GetValue();
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsShort");
+					}
 				}
 			}
 		} else {
@@ -2007,7 +2199,8 @@ bool Manager::GetValueAsShort
 bool Manager::GetValueAsString
 (
 		ValueID const& _id,
-		string* o_value
+		string* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -2017,145 +2210,152 @@ bool Manager::GetValueAsString
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-
-			switch( _id.GetType() )
+			if( driver->m_valueSnapshots->GetString( _id, o_value ) )
 			{
-				case ValueID::ValueType_Bool:
+				res = true;
+			}
+			else
+			{
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+
+				switch( _id.GetType() )
 				{
-					if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Bool:
 					{
-						*o_value = value->GetValue() ? "True" : "False";
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->GetValue() ? "True" : "False";
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Byte:
-				{
-					if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Byte:
 					{
-						snprintf( str, sizeof(str), "%u", value->GetValue() );
-						*o_value = str;
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							snprintf( str, sizeof(str), "%u", value->GetValue() );
+							*o_value = str;
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Decimal:
-				{
-					if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Decimal:
 					{
-						*o_value = value->GetValue();
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->GetValue();
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Int:
-				{
-					if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Int:
 					{
-						snprintf( str, sizeof(str), "%d", value->GetValue() );
-						*o_value = str;
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							snprintf( str, sizeof(str), "%d", value->GetValue() );
+							*o_value = str;
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_List:
-				{
-					if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_List:
 					{
-						ValueList::Item const& item = value->GetItem();
-						*o_value = item.m_label;
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							ValueList::Item const& item = value->GetItem();
+							*o_value = item.m_label;
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Raw:
-				{
-					if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Raw:
 					{
-						*o_value = value->GetAsString();
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->GetAsString();
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Short:
-				{
-					if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Short:
 					{
-						snprintf( str, sizeof(str), "%d", value->GetValue() );
-						*o_value = str;
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							snprintf( str, sizeof(str), "%d", value->GetValue() );
+							*o_value = str;
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_String:
-				{
-					if( ValueString* value = static_cast<ValueString*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_String:
 					{
-						*o_value = value->GetValue();
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueString* value = static_cast<ValueString*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->GetValue();
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Button:
-				{
-					if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Button:
 					{
-						*o_value = value->IsPressed() ? "True" : "False";
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->IsPressed() ? "True" : "False";
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
-				case ValueID::ValueType_Schedule:
-				{
-					if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+					case ValueID::ValueType_Schedule:
 					{
-						*o_value = value->GetAsString();
-						value->Release();
-						res = true;
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id, io_handle ) ) )
+						{
+							*o_value = value->GetAsString();
+							value->Release();
+							res = true;
+						} else {
+							OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueAsString");
+						}
+						break;
 					}
-					break;
-				}
 
-#if 0
-				/* comment this out so if we miss a ValueID, GCC warns us loudly! */
-				default:
-				{
-					// To keep GCC happy
-					break;
+	#if 0
+					/* comment this out so if we miss a ValueID, GCC warns us loudly! */
+					default:
+					{
+						// To keep GCC happy
+						break;
+					}
+	#endif
 				}
-#endif
-			}
 
+			}
 		}
 	}
 
@@ -2169,7 +2369,8 @@ bool Manager::GetValueAsString
 bool Manager::GetValueListSelection
 (
 		ValueID const& _id,
-		string* o_value
+		string* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -2180,18 +2381,27 @@ bool Manager::GetValueListSelection
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				string snapshot;
+				if( driver->m_valueSnapshots->GetString( _id, &snapshot ) && !snapshot.empty() )
+				{
+					*o_value = snapshot;
+					res = true;
+				}
+				else
 				{
-					ValueList::Item const& item = value->GetItem();
-					if( item.m_label.length() > 0 )
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id, io_handle ) ) )
 					{
-						*o_value = item.m_label;
-						res = true;
+						ValueList::Item const& item = value->GetItem();
+						if( item.m_label.length() > 0 )
+						{
+							*o_value = item.m_label;
+							res = true;
+						}
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListSelection");
 					}
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListSelection");
 				}
 			}
 		} else {
@@ -2209,7 +2419,8 @@ bool Manager::GetValueListSelection
 bool Manager::GetValueListSelection
 (
 		ValueID const& _id,
-		int32* o_value
+		int32* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -2220,15 +2431,24 @@ bool Manager::GetValueListSelection
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				int32 snapshot;
+				if( driver->m_valueSnapshots->GetInt( _id, &snapshot ) )
 				{
-					ValueList::Item const& item = value->GetItem();
-					*o_value = item.m_value;
-					value->Release();
+					*o_value = snapshot;
 					res = true;
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListSelection");
+				}
+				else
+				{
+					NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+					if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id, io_handle ) ) )
+					{
+						ValueList::Item const& item = value->GetItem();
+						*o_value = item.m_value;
+						value->Release();
+						res = true;
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListSelection");
+					}
 				}
 			}
 		} else {
@@ -2246,7 +2466,8 @@ bool Manager::GetValueListSelection
 bool Manager::GetValueListItems
 (
 		ValueID const& _id,
-		vector<string>* o_value
+		vector<string>* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -2257,8 +2478,8 @@ bool Manager::GetValueListItems
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id, io_handle ) ) )
 				{
 					o_value->clear();
 					res = value->GetItemLabels( o_value );
@@ -2282,7 +2503,8 @@ bool Manager::GetValueListItems
 bool Manager::GetValueFloatPrecision
 (
 		ValueID const& _id,
-		uint8* o_value
+		uint8* o_value,
+		uint32* io_handle	// = NULL
 )
 {
 	bool res = false;
@@ -2293,8 +2515,8 @@ bool Manager::GetValueFloatPrecision
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id, io_handle ) ) )
 				{
 					*o_value = value->GetPrecision();
 					value->Release();
@@ -2311,6 +2533,71 @@ bool Manager::GetValueFloatPrecision
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetValueSnapshot>
+// Gets the last published state of a value without locking its node
+//-----------------------------------------------------------------------------
+bool Manager::GetValueSnapshot
+(
+		ValueID const& _id,
+		ValueSnapshot* o_snapshot
+)
+{
+	bool res = false;
+
+	if( o_snapshot )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			res = driver->m_valueSnapshots->Get( _id, o_snapshot );
+			int32 published;
+			if( !res && driver->m_valueSnapshots->GetInt( _id, &published ) )
+			{
+				// Published, but the string was too long to copy
+				res = GetValueAsString( _id, &o_snapshot->m_string );
+			}
+			if( !res )
+			{
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueSnapshot");
+			}
+		}
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValues>
+// Gets the last published state of all of a node's values
+//-----------------------------------------------------------------------------
+bool Manager::GetValues
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		vector<ValueSnapshot>* o_values
+)
+{
+	bool res = false;
+
+	if( o_values )
+	{
+		if( Driver* driver = GetDriver( _homeId ) )
+		{
+			vector<uint32> incomplete;
+			driver->m_valueSnapshots->GetNode( _homeId, _nodeId, o_values, &incomplete );
+			for( vector<uint32>::iterator it = incomplete.begin(); it != incomplete.end(); ++it )
+			{
+				// Strings too long for the snapshot are read the slow way
+				ValueSnapshot& snapshot = (*o_values)[*it];
+				GetValueAsString( snapshot.m_id, &snapshot.m_string );
+			}
+			res = true;
+		}
+	}
+
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::SetValue>
 // Sets the value from a bool
@@ -2329,7 +2616,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
 				{
 					res = value->Set( _value );
@@ -2364,7 +2651,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
 				{
 					res = value->Set( _value );
@@ -2399,7 +2686,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
 				{
 					char str[256];
@@ -2454,7 +2741,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
 				{
 					res = value->Set( _value );
@@ -2490,7 +2777,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
 				{
 					res = value->Set( _value, _length );
@@ -2525,7 +2812,7 @@ bool Manager::SetValue
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
 				{
 					res = value->Set( _value );
@@ -2560,7 +2847,7 @@ bool Manager::SetValueListSelection
 		{
 			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
 				{
 					res = value->SetByLabel( _selectedItem );
@@ -2594,7 +2881,7 @@ bool Manager::SetValue
 	{
 		if( _id.GetNodeId() != driver->GetControllerNodeId() )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 
 			switch( _id.GetType() )
 			{
@@ -2714,6 +3001,80 @@ bool Manager::SetValue
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::SetValue>
+// Sets several values to the same string, sending the commands as a batch
+//-----------------------------------------------------------------------------
+bool Manager::SetValue
+(
+		vector<ValueID> const& _ids,
+		string const& _value
+)
+{
+	vector<string> values( _ids.size(), _value );
+	return SetValue( _ids, values );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValue>
+// Sets several values from strings, sending the commands as a batch
+//-----------------------------------------------------------------------------
+bool Manager::SetValue
+(
+		vector<ValueID> const& _ids,
+		vector<string> const& _values
+)
+{
+	if( _ids.size() != _values.size() )
+	{
+		return false;
+	}
+
+	// Hold back the commands of every driver involved.  The batches are begun in
+	// a fixed order so that two bulk calls cannot each wait for the other.
+	vector<Driver*> drivers;
+	for( vector<ValueID>::const_iterator it = _ids.begin(); it != _ids.end(); ++it )
+	{
+		if( Driver* driver = GetDriver( it->GetHomeId() ) )
+		{
+			drivers.push_back( driver );
+		}
+	}
+	sort( drivers.begin(), drivers.end() );
+	drivers.erase( unique( drivers.begin(), drivers.end() ), drivers.end() );
+
+	for( vector<Driver*>::iterator dit = drivers.begin(); dit != drivers.end(); ++dit )
+	{
+		(*dit)->BeginMulticast();
+	}
+
+	bool res = true;
+	try
+	{
+		for( size_t i=0; i<_ids.size(); ++i )
+		{
+			if( !SetValue( _ids[i], _values[i] ) )
+			{
+				res = false;
+			}
+		}
+	}
+	catch( ... )
+	{
+		for( vector<Driver*>::iterator dit = drivers.begin(); dit != drivers.end(); ++dit )
+		{
+			(*dit)->EndMulticast();
+		}
+		throw;
+	}
+
+	for( vector<Driver*>::iterator dit = drivers.begin(); dit != drivers.end(); ++dit )
+	{
+		(*dit)->EndMulticast();
+	}
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::RefreshValue>
 // Instruct the driver to refresh this value by sending a message to the device
@@ -2730,7 +3091,7 @@ bool Manager::RefreshValue
 		Node *node;
 
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 
 		if( (node = driver->GetNode( _id.GetNodeId() ) ) != NULL)
 		{
@@ -2762,10 +3123,11 @@ void Manager::SetChangeVerified
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetChangeVerified( _verify );
+			driver->m_configWriter->ValueChanged( _id );
 			value->Release();
 		} else {
 			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetChangeVerified");
@@ -2785,7 +3147,7 @@ bool Manager::GetChangeVerified
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->GetChangeVerified();
@@ -2813,7 +3175,7 @@ bool Manager::PressButton
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
 			{
 				res = value->PressButton();
@@ -2844,7 +3206,7 @@ bool Manager::ReleaseButton
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
 			{
 				res = value->ReleaseButton();
@@ -2880,7 +3242,7 @@ uint8 Manager::GetNumSwitchPoints
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
 			{
 				numSwitchPoints = value->GetNumSwitchPoints();
@@ -2914,7 +3276,7 @@ bool Manager::SetSwitchPoint
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
 			{
 				res = value->SetSwitchPoint( _hours, _minutes, _setback );
@@ -2947,7 +3309,7 @@ bool Manager::RemoveSwitchPoint
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
 			{
 				uint8 idx;
@@ -2982,7 +3344,7 @@ void Manager::ClearSwitchPoints
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), true );
 			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
 			{
 				value->ClearSwitchPoints();
@@ -3015,7 +3377,7 @@ bool Manager::GetSwitchPoint
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
 			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
 			{
 				res = value->GetSwitchPoint( _idx, o_hours, o_minutes, o_setback );
@@ -3090,6 +3452,26 @@ bool Manager::SetConfigParam
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::SetConfigParams>
+// Set the values of several configuration parameters of a device
+//-----------------------------------------------------------------------------
+bool Manager::SetConfigParams
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		map<uint8,int32> const& _params,
+		map<uint8,Node::ConfigParamStatus>* o_status	// = NULL
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SetConfigParams( _nodeId, _params, o_status );
+	}
+
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::RequestConfigParam>
 // Request the value of one of the configuration parameters of a device
@@ -3258,12 +3640,63 @@ bool Manager::AddWatcher
 		pfnOnNotification_t _watcher,
 		void* _context
 )
+{
+	return InsertWatcher( Watcher( _watcher, NULL, _context ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveWatcher>
+// Remove a watcher from the list
+//-----------------------------------------------------------------------------
+bool Manager::RemoveWatcher
+(
+		pfnOnNotification_t _watcher,
+		void* _context
+)
+{
+	return EraseWatcher( Watcher( _watcher, NULL, _context ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::AddBatchWatcher>
+// Add a batch watcher to the list
+//-----------------------------------------------------------------------------
+bool Manager::AddBatchWatcher
+(
+		pfnOnNotificationBatch_t _watcher,
+		void* _context
+)
+{
+	return InsertWatcher( Watcher( NULL, _watcher, _context ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveBatchWatcher>
+// Remove a batch watcher from the list
+//-----------------------------------------------------------------------------
+bool Manager::RemoveBatchWatcher
+(
+		pfnOnNotificationBatch_t _watcher,
+		void* _context
+)
+{
+	return EraseWatcher( Watcher( NULL, _watcher, _context ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::InsertWatcher>
+// Add a watcher of either kind to the list
+//-----------------------------------------------------------------------------
+bool Manager::InsertWatcher
+(
+		Watcher const& _watcher
+)
 {
 	// Ensure this watcher is not already on the list
 	m_notificationMutex->Lock();
 	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
 	{
-		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
+		if( ((*it)->m_callback == _watcher.m_callback ) && ((*it)->m_batchCallback == _watcher.m_batchCallback ) && ( (*it)->m_context == _watcher.m_context ) )
 		{
 			// Already in the list
 			m_notificationMutex->Unlock();
@@ -3271,26 +3704,25 @@ bool Manager::AddWatcher
 		}
 	}
 
-	m_watchers.push_back( new Watcher( _watcher, _context ) );
+	m_watchers.push_back( new Watcher( _watcher ) );
 	m_notificationMutex->Unlock();
 	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RemoveWatcher>
-// Remove a watcher from the list
+// <Manager::EraseWatcher>
+// Remove a watcher of either kind from the list
 //-----------------------------------------------------------------------------
-bool Manager::RemoveWatcher
+bool Manager::EraseWatcher
 (
-		pfnOnNotification_t _watcher,
-		void* _context
+		Watcher const& _watcher
 )
 {
 	m_notificationMutex->Lock();
 	list<Watcher*>::iterator it = m_watchers.begin();
 	while( it != m_watchers.end() )
 	{
-		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
+		if( ((*it)->m_callback == _watcher.m_callback ) && ((*it)->m_batchCallback == _watcher.m_batchCallback ) && ( (*it)->m_context == _watcher.m_context ) )
 		{
 			delete (*it);
 			m_watchers.erase( it );
@@ -3306,22 +3738,91 @@ bool Manager::RemoveWatcher
 
 //-----------------------------------------------------------------------------
 // <Manager::NotifyWatchers>
-// Notify any watching objects of a value change
+// Pass a notification to the watchers, now or from the notification thread
 //-----------------------------------------------------------------------------
 void Manager::NotifyWatchers
 (
 		Notification* _notification
 )
+{
+	if( m_notificationDispatcher != NULL )
+	{
+		m_notificationDispatcher->Queue( _notification );
+		return;
+	}
+
+	DeliverNotifications( &_notification, 1 );
+	delete _notification;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::DeliverNotifications>
+// Notify any watching objects of a batch of notifications
+//-----------------------------------------------------------------------------
+void Manager::DeliverNotifications
+(
+		Notification const* const* _notifications,
+		uint32 const _count
+)
 {
 	m_notificationMutex->Lock();
 	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
 	{
 		Watcher* pWatcher = *it;
-		pWatcher->m_callback( _notification, pWatcher->m_context );
+		if( pWatcher->m_batchCallback != NULL )
+		{
+			pWatcher->m_batchCallback( _notifications, _count, pWatcher->m_context );
+			continue;
+		}
+		for( uint32 i=0; i<_count; ++i )
+		{
+			pWatcher->m_callback( _notifications[i], pWatcher->m_context );
+		}
 	}
 	m_notificationMutex->Unlock();
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::FlushNotifications>
+// Wait until every notification sent so far has been delivered
+//-----------------------------------------------------------------------------
+void Manager::FlushNotifications
+(
+)
+{
+	if( m_notificationDispatcher != NULL )
+	{
+		m_notificationDispatcher->Flush();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::IsValueValid>
+// Check that a value still exists, for notifications delivered after a delay
+//-----------------------------------------------------------------------------
+bool Manager::IsValueValid
+(
+		ValueID const& _id
+)
+{
+	// The driver cannot start being deleted while the mutex is held
+	LockGuard LG( m_driverMutex );
+	if( m_removingDrivers.find( _id.GetHomeId() ) != m_removingDrivers.end() )
+	{
+		return false;
+	}
+	map<uint32,Driver*>::iterator it = m_readyDrivers.find( _id.GetHomeId() );
+	if( it == m_readyDrivers.end() )
+	{
+		// The driver has been removed
+		return false;
+	}
+
+	Driver* driver = it->second;
+	NodeLockGuard NLG( driver->m_nodeMutex, _id.GetNodeId(), false );
+	return driver->IsValueValid( _id );
+}
+
 //-----------------------------------------------------------------------------
 //	Controller commands
 //-----------------------------------------------------------------------------
@@ -4531,3 +5032,98 @@ void Manager::GetNodeStatistics
 	}
 
 }
+
+//-----------------------------------------------------------------------------
+// <Manager::GetLatencyStatistics>
+// Summarise the latencies of one stage of the message transactions.
+//-----------------------------------------------------------------------------
+bool Manager::GetLatencyStatistics
+(
+		uint32 const _homeId,
+		LatencyStats::Stage const _stage,
+		LatencyStats::Group const _group,
+		uint8 const _key,
+		LatencyStats::Summary* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetLatencyStatistics( _stage, _group, _key, _data );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::WriteLatencyStatistics>
+// Write the latency histograms in the Prometheus text format.
+//-----------------------------------------------------------------------------
+bool Manager::WriteLatencyStatistics
+(
+		uint32 const _homeId,
+		string const& _filename
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->WriteLatencyStatistics( _filename );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetPollStatistics>
+// Retrieve the poll scheduler counters.
+//-----------------------------------------------------------------------------
+void Manager::GetPollStatistics
+(
+		uint32 const _homeId,
+		PollScheduler::PollData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetPollStatistics( _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetSimulatorStatistics>
+// Retrieve the benchmark counters of a simulated controller.
+//-----------------------------------------------------------------------------
+bool Manager::GetSimulatorStatistics
+(
+		uint32 const _homeId,
+		SimulatorData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		if( Driver::ControllerInterface_Simulator == driver->GetControllerInterfaceType() )
+		{
+			static_cast<SimulatorController*>( driver->m_controller )->GetStatistics( _data );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ResetSimulatorStatistics>
+// Restart the benchmark measurement period of a simulated controller.
+//-----------------------------------------------------------------------------
+void Manager::ResetSimulatorStatistics
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		if( Driver::ControllerInterface_Simulator == driver->GetControllerInterfaceType() )
+		{
+			static_cast<SimulatorController*>( driver->m_controller )->ResetStatistics();
+		}
+	}
+}
@@ -32,12 +32,14 @@
 #include <cstring>
 #include <vector>
 #include <map>
+#include <set>
 #include <list>
 #include <deque>
 
 #include "Defs.h"
 #include "Driver.h"
 #include "value_classes/ValueID.h"
+#include "value_classes/ValueSnapshot.h"
 
 namespace OpenZWave
 {
@@ -50,6 +52,8 @@ namespace OpenZWave
 	class SerialPort;
 	class Thread;
 	class Notification;
+	class NotificationDispatcher;
+	struct SimulatorData;
 	class ValueBool;
 	class ValueByte;
 	class ValueDecimal;
@@ -115,9 +119,11 @@ namespace OpenZWave
 		friend class ValueStore;
 		friend class ValueButton;
 		friend class Msg;
+		friend class NotificationDispatcher;
 
 	public:
 		typedef void (*pfnOnNotification_t)( Notification const* _pNotification, void* _context );
+		typedef void (*pfnOnNotificationBatch_t)( Notification const* const* _notifications, uint32 const _count, void* _context );
 
 	//-----------------------------------------------------------------------------
 	// Construction
@@ -197,6 +203,11 @@ namespace OpenZWave
 		 * consists of the 8 digit hexadecimal version of the controller's Home ID, prefixed with the string 'zwcfg_'.
 		 * This convention allows OpenZWave to find the correct configuration file for a controller, even if it is
 		 * attached to a different serial port, USB device path, etc.
+		 * The file is saved in the background, once no further call has been made for the number of
+		 * milliseconds set by the SaveConfigurationDelay option, so that calls made close together
+		 * result in a single save.  Calls made more often than that delay put the save off for at most
+		 * five times the delay.  Only the nodes and values that have changed since the last save
+		 * are serialized again.  A pending save is always completed before the driver is removed.
 		 * \param _homeId The Home ID of the Z-Wave controller to save.
 		 */
 		void WriteConfig( uint32 const _homeId );
@@ -350,11 +361,14 @@ namespace OpenZWave
 	private:
 		Driver* GetDriver( uint32 const _homeId );	/**< Get a pointer to a Driver object from the HomeID.  Only to be used by OpenZWave. */
 		void SetDriverReady( Driver* _driver, bool success );		/**< Indicate that the Driver is ready to be used, and send the notification callback. */
+		void DeleteReadyDriver( uint32 const _homeId );				/**< Delete a ready Driver, keeping the notification thread away from it while it is destroyed. */
 
 OPENZWAVE_EXPORT_WARNINGS_OFF
 		list<Driver*>		m_pendingDrivers;		/**< Drivers that are in the process of reading saved data and querying their Z-Wave network for basic information. */
 		map<uint32,Driver*>	m_readyDrivers;			/**< Drivers that are ready to be used by the application. */
+		set<uint32>			m_removingDrivers;		/**< Home IDs of the ready Drivers that are being deleted. */
 OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*				m_driverMutex;			/**< Protects changes to m_readyDrivers and m_removingDrivers from the notification thread.  Taken before any node lock. */
 
 	//-----------------------------------------------------------------------------
 	//	Polling Z-Wave devices
@@ -421,6 +435,18 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		uint8 GetPollIntensity( ValueID const &_valueId );
 
+		/**
+		 * \brief Give a polled value its own polling period, instead of one derived from the
+		 * poll interval and its intensity.
+		 * \param _valueId The ID of a value that is being polled.
+		 * \param _period Milliseconds between polls, or zero to go back to the poll interval and intensity.
+		 * \param _jitter Up to this many milliseconds are added at random to each period, so that
+		 * values with the same period drift apart.
+		 * \return True if the period was set, false if the value is not being polled.
+		 * \see EnablePoll, SetPollIntensity, GetPollStatistics
+		 */
+		bool SetPollPeriod( ValueID const &_valueId, int32 const _period, int32 const _jitter = 0 );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -571,6 +597,27 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		uint32 GetNodeNeighbors( uint32 const _homeId, uint8 const _nodeId, uint8** _nodeNeighbors );
 
+		/**
+		 * \brief Get the number of hops a message is expected to take from the controller to a node.
+		 * The hop count is worked out from the neighbor lists of all of the nodes, taking the shortest route.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to query.
+		 * \return the number of hops, or zero if no route to the node is known.
+		 * \see GetNodeNeighbors, GetNodesReachableOnlyVia
+		 */
+		uint8 GetNodeHopCount( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * \brief Get the nodes that can only be reached through a node, according to the neighbor lists.
+		 * These are the nodes that would be cut off from the controller if the node failed.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to query.
+		 * \param o_nodes Pointer that receives a new array of node IDs, or NULL if there are none.  The caller must delete[] the array.
+		 * \return the number of nodes in the array.
+		 * \see GetNodeHopCount
+		 */
+		uint32 GetNodesReachableOnlyVia( uint32 const _homeId, uint8 const _nodeId, uint8** o_nodes );
+
 		/**
 		 * \brief Get the manufacturer name of a device
 		 * The manufacturer name would normally be handled by the Manufacturer Specific commmand class,
@@ -940,139 +987,182 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool IsValuePolled( ValueID const& _id );
 
+		/**
+		 * \brief Initial value of a handle passed to the GetValueAs methods.
+		 * Callers that read the same values repeatedly, such as a dashboard, can keep a handle for
+		 * each value.  The handle lets the value be found without a search while the node's values
+		 * are unchanged, and is corrected automatically after a value has been added or removed.
+		 */
+		static uint32 const c_noValueHandle = 0xffffffff;
+
 		/**
 		 * \brief Gets a value as a bool.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a bool that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Bool. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsBool( ValueID const& _id, bool* o_value );
+		bool GetValueAsBool( ValueID const& _id, bool* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as an 8-bit unsigned integer.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a uint8 that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Byte. The type can be tested with a call to ValueID::GetType
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsByte( ValueID const& _id, uint8* o_value );
+		bool GetValueAsByte( ValueID const& _id, uint8* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as a float.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a float that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Decimal. The type can be tested with a call to ValueID::GetType
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsFloat( ValueID const& _id, float* o_value );
+		bool GetValueAsFloat( ValueID const& _id, float* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as a 32-bit signed integer.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to an int32 that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Int. The type can be tested with a call to ValueID::GetType
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsInt( ValueID const& _id, int32* o_value );
+		bool GetValueAsInt( ValueID const& _id, int32* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as a 16-bit signed integer.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to an int16 that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Short. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsString, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsShort( ValueID const& _id, int16* o_value );
+		bool GetValueAsShort( ValueID const& _id, int16* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as a string.
 		 * Creates a string representation of a value, regardless of type.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a string that will be filled with the value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsString( ValueID const& _id, string* o_value );
+		bool GetValueAsString( ValueID const& _id, string* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a value as a collection of bytes.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a uint8* that will be filled with the value. This return value will need to be freed as it was dynamically allocated.
 		 * \param o_length Pointer to a uint8 that will be fill with the data length.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained. Returns false if the value is not a ValueID::ValueType_Raw. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueListSelection, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueAsRaw( ValueID const& _id, uint8** o_value, uint8* o_length );
+		bool GetValueAsRaw( ValueID const& _id, uint8** o_value, uint8* o_length, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets the selected item from a list (as a string).
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a string that will be filled with the selected item.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return True if the value was obtained.  Returns false if the value is not a ValueID::ValueType_List. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueListSelection( ValueID const& _id, string* o_value );
+		bool GetValueListSelection( ValueID const& _id, string* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets the selected item from a list (as an integer).
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to an integer that will be filled with the selected item.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return True if the value was obtained.  Returns false if the value is not a ValueID::ValueType_List. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListItems, GetValueAsRaw
 		 */
-		bool GetValueListSelection( ValueID const& _id, int32* o_value );
+		bool GetValueListSelection( ValueID const& _id, int32* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets the list of items from a list value.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a vector of strings that will be filled with list items. The vector will be cleared before the items are added.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the list items were obtained.  Returns false if the value is not a ValueID::ValueType_List. The type can be tested with a call to ValueID::GetType.
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsFloat, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueAsRaw
 		 */
-		bool GetValueListItems( ValueID const& _id, vector<string>* o_value );
+		bool GetValueListItems( ValueID const& _id, vector<string>* o_value, uint32* io_handle = NULL );
 
 		/**
 		 * \brief Gets a float value's precision.
 		 * \param _id The unique identifier of the value.
 		 * \param o_value Pointer to a uint8 that will be filled with the precision value.
+		 * \param io_handle If not NULL, a handle kept by the caller for this value, which saves searching the node for it.  Initialise it to c_noValueHandle; it is updated when the value has moved.
 		 * \return true if the value was obtained.  Returns false if the value is not a ValueID::ValueType_Decimal. The type can be tested with a call to ValueID::GetType
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
 		 * \see ValueID::GetType, GetValueAsBool, GetValueAsByte, GetValueAsInt, GetValueAsShort, GetValueAsString, GetValueListSelection, GetValueListItems
 		 */
-		bool GetValueFloatPrecision( ValueID const& _id, uint8* o_value );
+		bool GetValueFloatPrecision( ValueID const& _id, uint8* o_value, uint32* io_handle = NULL );
+
+		/**
+		 * \brief Gets a snapshot of a value.
+		 * Reads the last published state of the value, without waiting for the driver to release the node.
+		 * \param _id The unique identifier of the value.
+		 * \param o_snapshot Pointer to a ValueSnapshot that will be filled with the value's state.
+		 * \return true if the value was obtained.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \see GetValues, GetValueAsString
+		 */
+		bool GetValueSnapshot( ValueID const& _id, ValueSnapshot* o_snapshot );
+
+		/**
+		 * \brief Gets snapshots of all the values of a node.
+		 * Reads the whole node in one call, without waiting for the driver to release the node.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to query.
+		 * \param o_values Pointer to a vector that will be filled with the snapshots, in ValueID order.
+		 * \return true if the node's values were obtained.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \see GetValueSnapshot
+		 */
+		bool GetValues( uint32 const _homeId, uint8 const _nodeId, vector<ValueSnapshot>* o_values );
 
 		/**
 		 * \brief Sets the state of a bool.
@@ -1174,6 +1264,32 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool SetValue( ValueID const& _id, string const& _value );
 
+		/**
+		 * \brief Sets several values to the same string, as one batch.
+		 * Each value is set as by SetValue( ValueID const&, string const& ), but the commands are
+		 * sent together: an identical command for several listening nodes is sent once, as a
+		 * multicast frame, so that the nodes all act on it at the same moment.  Unless the
+		 * MulticastVerify option is false, each node is then also sent the command directly.
+		 * \param _ids The unique identifiers of the values.
+		 * \param _value The new value of every one of them.
+		 * \return true if every value was set.
+		 * \throws OZWException as for SetValue( ValueID const&, string const& ).  Commands for the values
+		 * already set are still sent.
+		 * \see Scene::Activate
+		 */
+		bool SetValue( vector<ValueID> const& _ids, string const& _value );
+
+		/**
+		 * \brief Sets several values from strings, as one batch.
+		 * As SetValue( vector<ValueID> const&, string const& ), with a value for each ValueID.
+		 * \param _ids The unique identifiers of the values.
+		 * \param _values The new values, in the same order as _ids.
+		 * \return true if every value was set.  Returns false if the two vectors differ in length.
+		 * \throws OZWException as for SetValue( ValueID const&, string const& ).  Commands for the values
+		 * already set are still sent.
+		 */
+		bool SetValue( vector<ValueID> const& _ids, vector<string> const& _values );
+
 		/**
 		 * \brief Sets the selected item in a list.
 		 * Due to the possibility of a device being asleep, the command is assumed to suceed, and the value
@@ -1397,6 +1513,27 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool SetConfigParam( uint32 const _homeId, uint8 const _nodeId, uint8 const _param, int32 _value, uint8 const _size = 2 );
 
+		/**
+		 * \brief Set the values of several configurable parameters in a device, such as a whole profile.
+		 * The profile is applied as a whole or not at all.  It is only sent if every parameter is known
+		 * to the node, is writable, and is given a value within its range.  Parameters the device already
+		 * holds are not sent again.  Devices that support Configuration version 2 are sent runs of
+		 * consecutive parameters in Bulk Set commands.  For other devices, the parameters are queued
+		 * together, so they are packed into Multi Command frames where the device supports them.
+		 * The parameters that were sent are then requested back from the device, and each is confirmed
+		 * by a ValueChanged or ValueRefreshed notification.
+		 * This method returns immediately, without waiting for confirmation from the device.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to configure.
+		 * \param _params The values of the parameters, by parameter index.
+		 * \param o_status If not NULL, receives the status of each parameter.  This reflects only the
+		 * checks made before sending, not whether the device accepted the values.
+		 * \return true if the profile was accepted.  False if any parameter was refused, in which case
+		 * none were sent.
+		 * \see SetConfigParam, Node::ConfigParamStatus
+		 */
+		bool SetConfigParams( uint32 const _homeId, uint8 const _nodeId, map<uint8,int32> const& _params, map<uint8,Node::ConfigParamStatus>* o_status = NULL );
+
 		/**
 		 * \brief Request the value of a configurable parameter from a device.
 		 * Some devices have various parameters that can be configured to control the device behaviour.
@@ -1531,31 +1668,63 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 * \see AddWatcher, Notification
 		 */
 		bool RemoveWatcher( pfnOnNotification_t _watcher, void* _context );
+
+		/**
+		 * \brief Add a watcher that receives notifications in batches.
+		 * A batch watcher is called once with every notification in a batch, in the order they were sent.
+		 * When the NotifyThread option is set, watchers are called from a thread of their own, and a batch
+		 * holds all of the notifications that were sent while the previous batch was being delivered.
+		 * Otherwise each batch holds a single notification.  The notifications are only valid during the call.
+		 * \param _watcher pointer to a function that will be called with each batch of notifications.
+		 * \param _context pointer to user defined data that will be passed to the watcher function with each batch.
+		 * \return true if the watcher was successfully added.
+		 * \see RemoveBatchWatcher, AddWatcher, Notification
+		 */
+		bool AddBatchWatcher( pfnOnNotificationBatch_t _watcher, void* _context );
+
+		/**
+		 * \brief Remove a batch notification watcher.
+		 * \param _watcher pointer to a function that must match that passed to a previous call to AddBatchWatcher
+		 * \param _context pointer to user defined data that must match the one passed in that same previous call to AddBatchWatcher.
+		 * \return true if the watcher was successfully removed.
+		 * \see AddBatchWatcher
+		 */
+		bool RemoveBatchWatcher( pfnOnNotificationBatch_t _watcher, void* _context );
 	/*@}*/
 
 	private:
-		void NotifyWatchers( Notification* _notification );					// Passes the notifications to all the registered watcher callbacks in turn.
+		void NotifyWatchers( Notification* _notification );					// Passes a notification to the watchers, now or from the notification thread.  Takes ownership of it.
+		void DeliverNotifications( Notification const* const* _notifications, uint32 const _count );	// Calls all the registered watcher callbacks in turn.
+		void FlushNotifications();											// Waits until every notification passed to NotifyWatchers has been delivered.
+		bool IsValueValid( ValueID const& _id );							// True if the value still exists.  Unlike GetDriver, an unknown home id is not an error.
 
 		struct Watcher
 		{
-			pfnOnNotification_t	m_callback;
-			void*				m_context;
+			pfnOnNotification_t			m_callback;
+			pfnOnNotificationBatch_t	m_batchCallback;
+			void*						m_context;
 
 			Watcher
 			(
 				pfnOnNotification_t _callback,
+				pfnOnNotificationBatch_t _batchCallback,
 				void* _context
 			):
 				m_callback( _callback ),
+				m_batchCallback( _batchCallback ),
 				m_context( _context )
 			{
 			}
 		};
 
+		bool InsertWatcher( Watcher const& _watcher );
+		bool EraseWatcher( Watcher const& _watcher );
+
 OPENZWAVE_EXPORT_WARNINGS_OFF
 		list<Watcher*>		m_watchers;										// List of all the registered watchers.
 OPENZWAVE_EXPORT_WARNINGS_ON
 		Mutex*				m_notificationMutex;
+		NotificationDispatcher*	m_notificationDispatcher;					// Calls the watchers from a thread of its own, or NULL to call them from the thread sending the notification
 
 	//-----------------------------------------------------------------------------
 	// Controller commands
@@ -2288,6 +2457,51 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		void GetNodeStatistics( uint32 const _homeId, uint8 const _nodeId, Node::NodeData* _data );
 
+		/**
+		 * \brief Summarise the latencies of one stage of a driver's message transactions
+		 * \param _homeId The Home ID of the driver to obtain the latencies
+		 * \param _stage The stage: waiting in the queue, the controller's ACK, its callback or the node's reply
+		 * \param _group Whether to summarise every message, or only those for one node, command class or queue
+		 * \param _key The node id, command class id or queue number.  Ignored for LatencyStats::Group_All.
+		 * \param _data Pointer to structure Summary to return the count, sum, maximum and percentiles, in milliseconds
+		 * \return True if any latencies have been recorded for the stage and group
+		 * \see WriteLatencyStatistics
+		 */
+		bool GetLatencyStatistics( uint32 const _homeId, LatencyStats::Stage const _stage, LatencyStats::Group const _group, uint8 const _key, LatencyStats::Summary* _data );
+
+		/**
+		 * \brief Write every latency histogram of a driver to a file in the Prometheus text format
+		 * The file can be collected by the node exporter's textfile collector.  Set the
+		 * LatencyExportPath option to have the driver write it at a regular interval instead.
+		 * \param _homeId The Home ID of the driver
+		 * \param _filename The file to write
+		 * \return True if the file was written
+		 * \see GetLatencyStatistics
+		 */
+		bool WriteLatencyStatistics( uint32 const _homeId, string const& _filename );
+
+		/**
+		 * \brief Retrieve the poll scheduler statistics from a driver
+		 * \param _homeId The Home ID of the driver to obtain counters
+		 * \param _data Pointer to structure PollData to return values
+		 */
+		void GetPollStatistics( uint32 const _homeId, PollScheduler::PollData* _data );
+
+		/**
+		 * \brief Retrieve benchmark statistics from a simulated controller
+		 * \param _homeId The Home ID of the driver to obtain counters
+		 * \param _data Pointer to structure SimulatorData to return values
+		 * \return True if the driver is using the simulated controller interface
+		 * \see AddDriver, Driver::ControllerInterface_Simulator
+		 */
+		bool GetSimulatorStatistics( uint32 const _homeId, SimulatorData* _data );
+
+		/**
+		 * \brief Restart the benchmark measurement period of a simulated controller
+		 * \param _homeId The Home ID of the driver using the simulator
+		 */
+		void ResetSimulatorStatistics( uint32 const _homeId );
+
 	};
 	/*@}*/
 } // namespace OpenZWave
@@ -32,6 +32,7 @@
 #include "Utils.h"
 #include "ZWSecurity.h"
 #include "platform/Log.h"
+#include "platform/Mutex.h"
 #include "command_classes/MultiInstance.h"
 #include "command_classes/Security.h"
 #include "aes/aescpp.h"
@@ -43,6 +44,14 @@ uint8 Msg::s_nextCallbackId = 10;
 
 #define DEBUG 1
 
+// Freed messages kept for reuse
+static uint32 const c_poolSize = 32;
+static Mutex* s_poolMutex = NULL;
+static void* s_pool[c_poolSize];
+static uint32 s_pooled = 0;
+static uint32 s_allocated = 0;
+static uint32 s_reused = 0;
+
 //-----------------------------------------------------------------------------
 // <Msg::Msg>
 // Constructor
@@ -58,23 +67,67 @@ Msg::Msg
 	uint8 const _expectedReply,			// = 0
 	uint8 const _expectedCommandClassId	// = 0
 ):
+	m_logName( NULL ),
 	m_logText( _logText ),
 	m_bFinal( false ),
 	m_bCallbackRequired( _bCallbackRequired ),
-	m_callbackId( 0 ),
-	m_expectedReply( 0 ),
-	m_expectedCommandClassId( _expectedCommandClassId ),
-	m_length( 4 ),
-	m_targetNodeId( _targetNodeId ),
-	m_sendAttempts( 0 ),
-	m_maxSendAttempts( MAX_TRIES ),
-	m_instance( 1 ),
-	m_endPoint( 0 ),
-	m_flags( 0 ),
-	m_encrypted ( false ),
-	m_noncerecvd ( false ),
-	m_homeId ( 0 )
+	m_expectedCommandClassId( _expectedCommandClassId )
+{
+	Init( _targetNodeId, _msgType, _function, _bReplyRequired, _expectedReply );
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::Msg>
+// Constructor for a message with a string literal as its log text
+//-----------------------------------------------------------------------------
+Msg::Msg
+(
+	char const* _logText,
+	uint8 _targetNodeId,
+	uint8 const _msgType,
+	uint8 const _function,
+	bool const _bCallbackRequired,
+	bool const _bReplyRequired,			// = true
+	uint8 const _expectedReply,			// = 0
+	uint8 const _expectedCommandClassId	// = 0
+):
+	m_logName( _logText ),
+	m_bFinal( false ),
+	m_bCallbackRequired( _bCallbackRequired ),
+	m_expectedCommandClassId( _expectedCommandClassId )
 {
+	Init( _targetNodeId, _msgType, _function, _bReplyRequired, _expectedReply );
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::Init>
+// Set up the members that both constructors share
+//-----------------------------------------------------------------------------
+void Msg::Init
+(
+	uint8 _targetNodeId,
+	uint8 const _msgType,
+	uint8 const _function,
+	bool const _bReplyRequired,
+	uint8 const _expectedReply
+)
+{
+	m_callbackId = 0;
+	m_expectedReply = 0;
+	m_length = 4;
+	m_targetNodeId = _targetNodeId;
+	m_sendAttempts = 0;
+	m_maxSendAttempts = MAX_TRIES;
+	m_instance = 1;
+	m_endPoint = 0;
+	m_flags = 0;
+	m_encrypted = false;
+	m_noncerecvd = false;
+	m_requestnonce = false;
+	m_homeId = 0;
+	m_valueKey = 0;
+	m_queuedTime = 0;
+
 	if( _bReplyRequired )
 	{
 		// Wait for this message before considering the transaction complete
@@ -87,6 +140,122 @@ Msg::Msg
 	m_buffer[3] = _function;
 }
 
+//-----------------------------------------------------------------------------
+// <Msg::operator new>
+// Take a message from the pool, or allocate one if it is empty
+//-----------------------------------------------------------------------------
+void* Msg::operator new
+(
+	size_t _size
+)
+{
+	assert( _size == sizeof(Msg) );
+	void* p = NULL;
+	if( s_poolMutex != NULL )
+	{
+		s_poolMutex->Lock();
+		if( s_pooled > 0 )
+		{
+			p = s_pool[--s_pooled];
+			++s_reused;
+		}
+		else
+		{
+			++s_allocated;
+		}
+		s_poolMutex->Unlock();
+	}
+	if( p == NULL )
+	{
+		p = ::operator new( _size );
+	}
+	return p;
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::operator delete>
+// Return a message to the pool, or free it if the pool is full
+//-----------------------------------------------------------------------------
+void Msg::operator delete
+(
+	void* _p
+)
+{
+	if( _p == NULL )
+	{
+		return;
+	}
+	if( s_poolMutex != NULL )
+	{
+		s_poolMutex->Lock();
+		if( s_pooled < c_poolSize )
+		{
+			s_pool[s_pooled++] = _p;
+			_p = NULL;
+		}
+		s_poolMutex->Unlock();
+	}
+	if( _p != NULL )
+	{
+		::operator delete( _p );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::CreatePool>
+// Start keeping freed messages for reuse
+//-----------------------------------------------------------------------------
+void Msg::CreatePool
+(
+)
+{
+	if( s_poolMutex == NULL )
+	{
+		s_poolMutex = new Mutex();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::DestroyPool>
+// Free the pooled messages.  Called once no other thread can be using them.
+//-----------------------------------------------------------------------------
+void Msg::DestroyPool
+(
+)
+{
+	if( s_poolMutex != NULL )
+	{
+		while( s_pooled > 0 )
+		{
+			::operator delete( s_pool[--s_pooled] );
+		}
+		s_poolMutex->Release();
+		s_poolMutex = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::GetPoolStatistics>
+// Counts of message allocations
+//-----------------------------------------------------------------------------
+void Msg::GetPoolStatistics
+(
+	uint32* o_allocated,
+	uint32* o_reused
+)
+{
+	if( s_poolMutex != NULL )
+	{
+		s_poolMutex->Lock();
+	}
+	*o_allocated = s_allocated;
+	*o_reused = s_reused;
+	if( s_poolMutex != NULL )
+	{
+		s_poolMutex->Unlock();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Msg::SetInstance>
 // Used to enable wrapping with MultiInstance/MultiChannel during finalize.
@@ -186,6 +355,59 @@ void Msg::Finalize()
 }
 
 
+//-----------------------------------------------------------------------------
+// <Msg::GetHash>
+// FNV-1a hash of the bytes compared by operator ==
+//-----------------------------------------------------------------------------
+uint32 Msg::GetHash
+(
+)const
+{
+	uint32 hash = 2166136261u;
+	if( m_bFinal )
+	{
+		uint8 length = m_length - (m_bCallbackRequired ? 2: 1 );
+		for( uint8 i=0; i<length; ++i )
+		{
+			hash ^= m_buffer[i];
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::IsSameSet>
+// Compare the command class and command, and any encapsulation header
+//-----------------------------------------------------------------------------
+bool Msg::IsSameSet
+(
+	Msg const& _other
+)const
+{
+	if( !m_bFinal || !_other.m_bFinal || m_buffer[3] != FUNC_ID_ZW_SEND_DATA || _other.m_buffer[3] != FUNC_ID_ZW_SEND_DATA )
+	{
+		return false;
+	}
+	if( FUNC_ID_APPLICATION_COMMAND_HANDLER == m_expectedReply || FUNC_ID_APPLICATION_COMMAND_HANDLER == _other.m_expectedReply )
+	{
+		// A request for a report
+		return false;
+	}
+
+	// Node, then the data from the command class to the command, skipping the data length
+	uint32 end = 8;
+	if( MultiInstance::StaticGetCommandClassId() == m_buffer[6] )
+	{
+		end += ( MultiInstance::MultiChannelCmd_Encap == m_buffer[7] ) ? 4 : 3;
+	}
+	if( m_length < end || _other.m_length < end || m_buffer[4] != _other.m_buffer[4] )
+	{
+		return false;
+	}
+	return( !memcmp( &m_buffer[6], &_other.m_buffer[6], end - 6 ) );
+}
+
 //-----------------------------------------------------------------------------
 // <Msg::UpdateCallbackId>
 // If this message has a callback ID, increment it and recalculate the checksum
@@ -220,7 +442,7 @@ void Msg::UpdateCallbackId()
 //-----------------------------------------------------------------------------
 string Msg::GetAsString()
 {
-	string str = m_logText;
+	string str = GetLogText();
 
 	char byteStr[16];
 	if( m_targetNodeId != 0xff )
@@ -275,8 +497,9 @@ void Msg::MultiEncap
 		m_buffer[9] = m_endPoint;
 		m_length += 4;
 
-		snprintf( str, sizeof(str), "MultiChannel Encapsulated (instance=%d): %s", m_instance, m_logText.c_str() );
+		snprintf( str, sizeof(str), "MultiChannel Encapsulated (instance=%d): %s", m_instance, GetLogText().c_str() );
 		m_logText = str;
+		m_logName = NULL;
 	}
 	else
 	{
@@ -292,8 +515,9 @@ void Msg::MultiEncap
 		m_buffer[8] = m_instance;
 		m_length += 3;
 
-		snprintf( str, sizeof(str), "MultiInstance Encapsulated (instance=%d): %s", m_instance, m_logText.c_str() );
+		snprintf( str, sizeof(str), "MultiInstance Encapsulated (instance=%d): %s", m_instance, GetLogText().c_str() );
 		m_logText = str;
+		m_logName = NULL;
 	}
 }
 
@@ -313,7 +537,7 @@ uint8* Msg::GetBuffer() {
 	if (m_encrypted == false)
 		return m_buffer;
 	else
-		if (EncyrptBuffer(m_buffer, m_length, GetDriver(), GetDriver()->GetControllerNodeId(), m_targetNodeId, m_nonce, e_buffer)) {
+		if (EncyrptBuffer(m_buffer, m_length, GetDriver(), GetDriver()->GetControllerNodeId(), m_targetNodeId, m_nonce, e_buffer, m_requestnonce)) {
 			return e_buffer;
 		} else {
 			Log::Write(LogLevel_Warning, m_targetNodeId, "Failed to Encyrpt Packet");
@@ -51,8 +51,27 @@ namespace OpenZWave
 		};
 
 		Msg( string const& _logtext, uint8 _targetNodeId, uint8 const _msgType, uint8 const _function, bool const _bCallbackRequired, bool const _bReplyRequired = true, uint8 const _expectedReply = 0, uint8 const _expectedCommandClassId = 0 );
+
+		/**
+		 * Constructor for a message whose log text is a string literal.  Only the pointer is
+		 * kept, and the text is copied if it is ever needed, so it must outlive the message.
+		 */
+		Msg( char const* _logtext, uint8 _targetNodeId, uint8 const _msgType, uint8 const _function, bool const _bCallbackRequired, bool const _bReplyRequired = true, uint8 const _expectedReply = 0, uint8 const _expectedCommandClassId = 0 );
 		~Msg(){}
 
+		/**
+		 * Messages are allocated from a pool while the Manager exists.
+		 */
+		static void* operator new( size_t _size );
+		static void operator delete( void* _p );
+
+		/**
+		 * \brief Counts of message allocations, for all of the drivers.
+		 * \param o_allocated receives the number of messages allocated from the heap.
+		 * \param o_reused receives the number of messages that reused one from the pool.
+		 */
+		static void GetPoolStatistics( uint32* o_allocated, uint32* o_reused );
+
 		void SetInstance( CommandClass* _cc, uint8 const _instance );	// Used to enable wrapping with MultiInstance/MultiChannel during finalize.
 
 		void Append( uint8 const _data );
@@ -105,7 +124,7 @@ namespace OpenZWave
 		 * \brief get the LogText Associated with this message
 		 * \return the LogText used during the constructor
 		 */
-		string GetLogText()const{ return m_logText; }
+		string GetLogText()const{ return( m_logName != NULL ? string( m_logName ) : m_logText ); }
 
 		uint32 GetLength()const{ return m_encrypted == true ? m_length + 20 + 6 : m_length; }
 		uint8* GetBuffer();
@@ -137,6 +156,34 @@ namespace OpenZWave
 
 			return false;
 		}
+
+		/**
+		 * \brief Hash of the part of the message that operator == compares.
+		 */
+		uint32 GetHash()const;
+
+		/**
+		 * \brief Identify the value whose Value::Set queued this message.
+		 * A later Set of the same command for the same value replaces the message if it has not been sent yet.
+		 * \return the value store key of the value, or zero if the message was not queued by Value::Set.
+		 */
+		uint32 GetValueKey()const{ return m_valueKey; }
+		void SetValueKey( uint32 const _valueKey ){ m_valueKey = _valueKey; }
+
+		/**
+		 * \brief Determine whether another message sends the same Set command to the same node and endpoint.
+		 * The parameters of the commands are not compared.  A message that expects a report,
+		 * such as a Get, is never the same Set.
+		 */
+		bool IsSameSet( Msg const& _other )const;
+
+		/**
+		 * \brief Time the message was queued, for the latency statistics.
+		 * \return milliseconds from LatencyStats::Now, or zero if the time was not taken.
+		 */
+		uint32 GetQueuedTime()const{ return m_queuedTime; }
+		void SetQueuedTime( uint32 const _queuedTime ){ m_queuedTime = _queuedTime; }
+
 		uint8 GetSendingCommandClass() {
 			if (m_buffer[3] == 0x13) {
 				return m_buffer[6];
@@ -162,6 +209,11 @@ namespace OpenZWave
 		void clearNonce() {
 			memset((m_nonce), '\0', 8);
 			m_noncerecvd = false;
+			m_requestnonce = false;
+		}
+		/** Ask the node to send its next nonce along with its reply to this message */
+		void setRequestNonce() {
+			m_requestnonce = true;
 		}
 		void SetHomeId(uint32 homeId) { m_homeId = homeId; };
 
@@ -170,10 +222,15 @@ namespace OpenZWave
 		*/
 		Driver* GetDriver()const;
 	private:
+		friend class Manager;
 
-
+		void Init( uint8 _targetNodeId, uint8 const _msgType, uint8 const _function, bool const _bReplyRequired, uint8 const _expectedReply );
 		void MultiEncap();					// Encapsulate the data inside a MultiInstance/Multicommand message
 
+		static void CreatePool();
+		static void DestroyPool();
+
+		char const*		m_logName;			// Static log text, or NULL if the text is in m_logText
 		string			m_logText;
 		bool			m_bFinal;
 		bool			m_bCallbackRequired;
@@ -196,7 +253,10 @@ namespace OpenZWave
 		bool			m_encrypted;
 		bool			m_noncerecvd;
 		uint8			m_nonce[8];
+		bool			m_requestnonce;		// Sent as MessageEncapNonceGet
 		uint32			m_homeId;
+		uint32			m_valueKey;			// Value store key of the value being set, or zero
+		uint32			m_queuedTime;		// Time the message was queued, or zero
 		static uint8		s_nextCallbackId;		// counter to get a unique callback id
 	};
 
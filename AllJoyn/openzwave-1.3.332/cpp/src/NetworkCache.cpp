@@ -0,0 +1,385 @@
+//-----------------------------------------------------------------------------
+//
+//	NetworkCache.cpp
+//
+//	Binary copy of the zwcfg network file for fast loading
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "tinyxml.h"
+#include "NetworkCache.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+static char const c_magic[4] = { 'O', 'Z', 'W', 'C' };
+static uint32 const c_maxDepth = 32;			// Deeper than any network file, to reject damaged trees
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::Write>
+// Write the cache for an XML network file that has just been saved
+//-----------------------------------------------------------------------------
+bool NetworkCache::Write
+(
+	string const& _cacheFile,
+	string const& _xmlFile,
+	TiXmlElement const* _root,
+	vector<TiXmlElement const*> const& _children,
+	uint32 const _homeId,
+	uint32 const _configVersion
+)
+{
+	Header header;
+	if( !HashFile( _xmlFile, &header.m_xmlLength, &header.m_xmlHash ) )
+	{
+		return false;
+	}
+
+	Tables tables;
+	tables.m_stringBytes = 0;
+	AddElement( &tables, _root, &_children );
+
+	// Lay out everything after the header: string offsets, elements, attributes and then the strings themselves
+	uint32 const offsetsSize = (uint32)( tables.m_strings.size() * sizeof(uint32) );
+	uint32 const elementsSize = (uint32)( tables.m_elements.size() * sizeof(ElementRecord) );
+	uint32 const attributesSize = (uint32)( tables.m_attributes.size() * sizeof(AttributeRecord) );
+	vector<uint8> body( offsetsSize + elementsSize + attributesSize + tables.m_stringBytes );
+
+	uint32* offsets = (uint32*)&body[0];
+	char* stringData = (char*)&body[offsetsSize + elementsSize + attributesSize];
+	uint32 offset = 0;
+	for( uint32 i=0; i<tables.m_strings.size(); ++i )
+	{
+		string const& str = *tables.m_strings[i];
+		offsets[i] = offset;
+		memcpy( &stringData[offset], str.c_str(), str.length()+1 );
+		offset += (uint32)str.length()+1;
+	}
+	memcpy( &body[offsetsSize], &tables.m_elements[0], elementsSize );
+	if( attributesSize )
+	{
+		memcpy( &body[offsetsSize + elementsSize], &tables.m_attributes[0], attributesSize );
+	}
+
+	memcpy( header.m_magic, c_magic, sizeof(c_magic) );
+	header.m_byteOrder = c_byteOrder;
+	header.m_formatVersion = c_formatVersion;
+	header.m_configVersion = _configVersion;
+	header.m_homeId = _homeId;
+	header.m_stringCount = (uint32)tables.m_strings.size();
+	header.m_stringBytes = tables.m_stringBytes;
+	header.m_elementCount = (uint32)tables.m_elements.size();
+	header.m_attributeCount = (uint32)tables.m_attributes.size();
+	header.m_checksum = Hash( &body[0], (uint32)body.size() );
+
+	// A partly written file fails the checksum, so it is written in place
+	FILE* fp = fopen( _cacheFile.c_str(), "wb" );
+	if( fp == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Unable to write network cache %s", _cacheFile.c_str() );
+		return false;
+	}
+	bool res = ( fwrite( &header, sizeof(header), 1, fp ) == 1 ) && ( fwrite( &body[0], body.size(), 1, fp ) == 1 );
+	res = ( fclose( fp ) == 0 ) && res;
+	if( !res )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Unable to write network cache %s", _cacheFile.c_str() );
+		remove( _cacheFile.c_str() );
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::Read>
+// Rebuild the element tree of an XML network file from its cache
+//-----------------------------------------------------------------------------
+bool NetworkCache::Read
+(
+	string const& _cacheFile,
+	string const& _xmlFile,
+	uint32 const _homeId,
+	uint32 const _configVersion,
+	TiXmlDocument* o_doc
+)
+{
+	uint32 size = 0;
+	uint8 const* data = (uint8 const*)FileOps::MapFile( _cacheFile, &size );
+	if( data == NULL )
+	{
+		return false;
+	}
+
+	bool res = false;
+	uint32 xmlLength;
+	uint32 xmlHash;
+	Header const* header = (Header const*)data;
+	if( ( size < sizeof(Header) )
+	 || memcmp( header->m_magic, c_magic, sizeof(c_magic) )
+	 || ( header->m_byteOrder != c_byteOrder )
+	 || ( header->m_formatVersion != c_formatVersion )
+	 || ( header->m_configVersion != _configVersion )
+	 || ( header->m_homeId != _homeId ) )
+	{
+		Log::Write( LogLevel_Info, "Network cache %s is from another version or network", _cacheFile.c_str() );
+	}
+	else if( !HashFile( _xmlFile, &xmlLength, &xmlHash )
+	 || ( header->m_xmlLength != xmlLength )
+	 || ( header->m_xmlHash != xmlHash ) )
+	{
+		Log::Write( LogLevel_Info, "Network cache %s does not match %s", _cacheFile.c_str(), _xmlFile.c_str() );
+	}
+	else
+	{
+		uint64 const expected = (uint64)sizeof(Header)
+							  + (uint64)header->m_stringCount * sizeof(uint32)
+							  + (uint64)header->m_elementCount * sizeof(ElementRecord)
+							  + (uint64)header->m_attributeCount * sizeof(AttributeRecord)
+							  + (uint64)header->m_stringBytes;
+
+		if( ( expected == (uint64)size ) && ( Hash( data + sizeof(Header), size - (uint32)sizeof(Header) ) == header->m_checksum ) )
+		{
+			View view;
+			view.m_stringCount = header->m_stringCount;
+			view.m_elementCount = header->m_elementCount;
+			view.m_attributeCount = header->m_attributeCount;
+			view.m_stringOffsets = (uint32 const*)( data + sizeof(Header) );
+			view.m_elements = (ElementRecord const*)( view.m_stringOffsets + view.m_stringCount );
+			view.m_attributes = (AttributeRecord const*)( view.m_elements + view.m_elementCount );
+			view.m_stringData = (char const*)( view.m_attributes + view.m_attributeCount );
+
+			// Every string must start inside the string data, which must end with a terminator
+			bool valid = ( header->m_stringBytes != 0 ) && ( view.m_stringData[header->m_stringBytes-1] == 0 );
+			for( uint32 i=0; valid && i<view.m_stringCount; ++i )
+			{
+				valid = ( view.m_stringOffsets[i] < header->m_stringBytes );
+			}
+
+			if( valid )
+			{
+				uint32 elementPos = 0;
+				uint32 attributePos = 0;
+				if( TiXmlElement* root = BuildElement( view, &elementPos, &attributePos, 0 ) )
+				{
+					if( elementPos == view.m_elementCount )
+					{
+						o_doc->LinkEndChild( root );
+						res = true;
+					}
+					else
+					{
+						delete root;
+					}
+				}
+			}
+		}
+
+		if( !res )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Network cache %s is damaged", _cacheFile.c_str() );
+		}
+	}
+
+	FileOps::UnmapFile( data, size );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::Hash>
+// FNV-1a hash of a block of memory
+//-----------------------------------------------------------------------------
+uint32 NetworkCache::Hash
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint32 _hash			// = c_hashSeed
+)
+{
+	for( uint32 i=0; i<_length; ++i )
+	{
+		_hash ^= _data[i];
+		_hash *= 16777619u;
+	}
+	return _hash;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::HashFile>
+// Get the length and hash of a file
+//-----------------------------------------------------------------------------
+bool NetworkCache::HashFile
+(
+	string const& _fileName,
+	uint32* o_length,
+	uint32* o_hash
+)
+{
+	uint32 size = 0;
+	uint8 const* data = (uint8 const*)FileOps::MapFile( _fileName, &size );
+	if( data == NULL )
+	{
+		return false;
+	}
+
+	*o_length = size;
+	*o_hash = Hash( data, size );
+	FileOps::UnmapFile( data, size );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::AddString>
+// Get the index of a string in the string table, adding it if necessary
+//-----------------------------------------------------------------------------
+uint32 NetworkCache::AddString
+(
+	Tables* _tables,
+	char const* _str
+)
+{
+	pair<map<string,uint32>::iterator,bool> res = _tables->m_stringIndex.insert( pair<string,uint32>( _str, (uint32)_tables->m_strings.size() ) );
+	if( res.second )
+	{
+		// Point at the copy held by the map, which never moves
+		_tables->m_strings.push_back( &res.first->first );
+		_tables->m_stringBytes += (uint32)res.first->first.length() + 1;
+	}
+	return res.first->second;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::AddElement>
+// Add an element, its attributes and its children to the tables
+//-----------------------------------------------------------------------------
+void NetworkCache::AddElement
+(
+	Tables* _tables,
+	TiXmlElement const* _element,
+	vector<TiXmlElement const*> const* _children	// = NULL
+)
+{
+	uint32 pos = (uint32)_tables->m_elements.size();
+	_tables->m_elements.push_back( ElementRecord() );
+
+	ElementRecord record;
+	record.m_name = AddString( _tables, _element->Value() );
+	record.m_text = c_noString;
+	record.m_attributeCount = 0;
+	record.m_childCount = 0;
+
+	// The element's attributes must be contiguous, so add them before any children
+	for( TiXmlAttribute const* attribute = _element->FirstAttribute(); attribute; attribute = attribute->Next() )
+	{
+		AttributeRecord attributeRecord;
+		attributeRecord.m_name = AddString( _tables, attribute->Name() );
+		attributeRecord.m_value = AddString( _tables, attribute->Value() );
+		_tables->m_attributes.push_back( attributeRecord );
+		++record.m_attributeCount;
+	}
+
+	if( _children != NULL )
+	{
+		for( uint32 i=0; i<_children->size(); ++i )
+		{
+			AddElement( _tables, (*_children)[i] );
+			++record.m_childCount;
+		}
+	}
+	else
+	{
+		for( TiXmlNode const* child = _element->FirstChild(); child; child = child->NextSibling() )
+		{
+			if( TiXmlElement const* childElement = child->ToElement() )
+			{
+				AddElement( _tables, childElement );
+				++record.m_childCount;
+			}
+			else if( TiXmlText const* text = child->ToText() )
+			{
+				if( record.m_text == c_noString )
+				{
+					record.m_text = AddString( _tables, text->Value() );
+				}
+			}
+		}
+	}
+
+	_tables->m_elements[pos] = record;
+}
+
+//-----------------------------------------------------------------------------
+// <NetworkCache::BuildElement>
+// Create an element, its attributes and its children from the tables
+//-----------------------------------------------------------------------------
+TiXmlElement* NetworkCache::BuildElement
+(
+	View const& _view,
+	uint32* _elementPos,
+	uint32* _attributePos,
+	uint32 const _depth
+)
+{
+	if( ( _depth >= c_maxDepth ) || ( *_elementPos >= _view.m_elementCount ) )
+	{
+		return NULL;
+	}
+
+	ElementRecord const& record = _view.m_elements[(*_elementPos)++];
+	if( ( record.m_name >= _view.m_stringCount )
+	 || ( ( record.m_text != c_noString ) && ( record.m_text >= _view.m_stringCount ) )
+	 || ( record.m_attributeCount > ( _view.m_attributeCount - *_attributePos ) ) )
+	{
+		return NULL;
+	}
+
+	TiXmlElement* element = new TiXmlElement( &_view.m_stringData[_view.m_stringOffsets[record.m_name]] );
+	for( uint32 i=0; i<record.m_attributeCount; ++i )
+	{
+		AttributeRecord const& attribute = _view.m_attributes[(*_attributePos)++];
+		if( ( attribute.m_name >= _view.m_stringCount ) || ( attribute.m_value >= _view.m_stringCount ) )
+		{
+			delete element;
+			return NULL;
+		}
+		element->SetAttribute( &_view.m_stringData[_view.m_stringOffsets[attribute.m_name]], &_view.m_stringData[_view.m_stringOffsets[attribute.m_value]] );
+	}
+
+	if( record.m_text != c_noString )
+	{
+		element->LinkEndChild( new TiXmlText( &_view.m_stringData[_view.m_stringOffsets[record.m_text]] ) );
+	}
+
+	for( uint32 i=0; i<record.m_childCount; ++i )
+	{
+		TiXmlElement* child = BuildElement( _view, _elementPos, _attributePos, _depth+1 );
+		if( child == NULL )
+		{
+			delete element;
+			return NULL;
+		}
+		element->LinkEndChild( child );
+	}
+
+	return element;
+}
@@ -0,0 +1,147 @@
+//-----------------------------------------------------------------------------
+//
+//	NetworkCache.h
+//
+//	Binary copy of the zwcfg network file for fast loading
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NetworkCache_H
+#define _NetworkCache_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include "Defs.h"
+
+class TiXmlDocument;
+class TiXmlElement;
+
+namespace OpenZWave
+{
+	/** \brief Binary copy of a driver's zwcfg network file.
+	 *
+	 * Parsing the XML text is most of the cost of Driver::ReadConfig.  Whenever the
+	 * network file is saved, the same element tree is also written as a table of
+	 * elements and attributes that refer to a table of unique strings.  At startup
+	 * the table is memory-mapped and the element tree is rebuilt from it directly,
+	 * without reading the XML text.
+	 *
+	 * The cache records the length and a hash of the XML file it was made from.  If
+	 * the XML file has been changed or replaced since, or the cache is damaged or
+	 * from another version, the cache is ignored and the XML is parsed as before.
+	 */
+	class NetworkCache
+	{
+	public:
+		/**
+		 * Write the cache for an XML network file that has just been saved.
+		 * \param _cacheFile Name of the cache file.
+		 * \param _xmlFile Name of the XML file that was saved.
+		 * \param _root The root element of the saved file.
+		 * \param _children The elements saved as the children of _root.
+		 * \param _homeId Home ID of the network.
+		 * \param _configVersion Version of the network file format.
+		 * \return true if the cache was written.
+		 */
+		static bool Write( string const& _cacheFile, string const& _xmlFile, TiXmlElement const* _root, vector<TiXmlElement const*> const& _children, uint32 const _homeId, uint32 const _configVersion );
+
+		/**
+		 * Rebuild the element tree of an XML network file from its cache.
+		 * \param _cacheFile Name of the cache file.
+		 * \param _xmlFile Name of the XML file the cache should match.
+		 * \param _homeId Home ID of the network.
+		 * \param _configVersion Version of the network file format.
+		 * \param o_doc Receives the element tree.
+		 * \return false if the cache is missing, damaged or out of date.  o_doc is left empty.
+		 */
+		static bool Read( string const& _cacheFile, string const& _xmlFile, uint32 const _homeId, uint32 const _configVersion, TiXmlDocument* o_doc );
+
+	private:
+		struct Header
+		{
+			char	m_magic[4];
+			uint32	m_byteOrder;				// Written as c_byteOrder, to reject caches from a machine of different endianness
+			uint32	m_formatVersion;			// Layout of this file
+			uint32	m_configVersion;			// Layout of the XML network file
+			uint32	m_homeId;
+			uint32	m_xmlLength;				// Length of the XML file the cache was made from
+			uint32	m_xmlHash;					// Hash of the XML file the cache was made from
+			uint32	m_stringCount;
+			uint32	m_stringBytes;
+			uint32	m_elementCount;
+			uint32	m_attributeCount;
+			uint32	m_checksum;					// Hash of everything after the header
+		};
+
+		// Elements are stored in document order, each followed by its children
+		struct ElementRecord
+		{
+			uint32	m_name;						// Index into the string table
+			uint32	m_text;						// Index of the element's text, or c_noString
+			uint32	m_attributeCount;			// Attributes taken in order from the attribute table
+			uint32	m_childCount;
+		};
+
+		struct AttributeRecord
+		{
+			uint32	m_name;
+			uint32	m_value;
+		};
+
+		// Tables collected while writing
+		struct Tables
+		{
+			map<string,uint32>		m_stringIndex;
+			vector<string const*>	m_strings;
+			uint32					m_stringBytes;
+			vector<ElementRecord>	m_elements;
+			vector<AttributeRecord>	m_attributes;
+		};
+
+		// Tables found in a mapped cache
+		struct View
+		{
+			uint32 const*			m_stringOffsets;
+			char const*				m_stringData;
+			uint32					m_stringCount;
+			ElementRecord const*	m_elements;
+			uint32					m_elementCount;
+			AttributeRecord const*	m_attributes;
+			uint32					m_attributeCount;
+		};
+
+		static uint32 Hash( uint8 const* _data, uint32 const _length, uint32 _hash = c_hashSeed );
+		static bool HashFile( string const& _fileName, uint32* o_length, uint32* o_hash );
+		static uint32 AddString( Tables* _tables, char const* _str );
+		static void AddElement( Tables* _tables, TiXmlElement const* _element, vector<TiXmlElement const*> const* _children = NULL );
+		static TiXmlElement* BuildElement( View const& _view, uint32* _elementPos, uint32* _attributePos, uint32 const _depth );
+
+		static uint32 const c_byteOrder = 0x01020304;
+		static uint32 const c_formatVersion = 1;
+		static uint32 const c_noString = 0xffffffff;
+		static uint32 const c_hashSeed = 2166136261u;
+	};
+
+} // namespace OpenZWave
+
+#endif //_NetworkCache_H
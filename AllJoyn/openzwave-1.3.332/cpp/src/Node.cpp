@@ -56,6 +56,7 @@
 #include "command_classes/SwitchAll.h"
 
 #include "Scene.h"
+#include "ConfigWriter.h"
 
 #include "value_classes/ValueID.h"
 #include "value_classes/Value.h"
@@ -122,6 +123,9 @@ m_manufacturerSpecificClassReceived( false ),
 m_nodeInfoSupported( true ),
 m_refreshonNodeInfoFrame ( true ),
 m_nodeAlive( true ),	// assome live node
+m_interviewWaiting( false ),
+m_timedStage( QueryStage_None ),
+m_interviewTime( 0 ),
 m_listening( true ),	// assume we start out listening
 m_frequentListening( false ),
 m_beaming( false ),
@@ -146,6 +150,7 @@ m_productType( "" ),
 m_productId( "" ),
 m_secured ( false ),
 m_values( new ValueStore() ),
+m_setValueKey( 0 ),
 m_sentCnt( 0 ),
 m_sentFailed( 0 ),
 m_retries( 0 ),
@@ -156,14 +161,19 @@ m_lastRequestRTT( 0 ),
 m_lastResponseRTT( 0 ),
 m_averageRequestRTT( 0 ),
 m_averageResponseRTT( 0 ),
+m_smoothedResponseRTT( 0 ),
+m_responseRTTDeviation( 0 ),
 m_quality( 0 ),
 m_lastReceivedMessage(),
 m_errors( 0 ),
-m_lastnonce ( 0 )
+m_lastnonce ( 0 ),
+m_peerNonceValid( false )
 {
 	memset( m_neighbors, 0, sizeof(m_neighbors) );
 	memset( m_routeNodes, 0, sizeof(m_routeNodes) );
 	memset( m_nonces, 0, sizeof(m_nonces) );
+	memset( m_peerNonce, 0, sizeof(m_peerNonce) );
+	memset( m_peerNonceUsed, 0, sizeof(m_peerNonceUsed) );
 	AddCommandClass( 0 );
 }
 
@@ -242,6 +252,24 @@ void Node::AdvanceQueries
 	bool addQSC = false;			// We only want to add a query stage complete if we did some work.
 	while( !m_queryPending && m_nodeAlive )
 	{
+		TimeQueryStage();
+		if( m_queryStage > QueryStage_ProtocolInfo && m_queryStage != QueryStage_Complete )
+		{
+			// Beyond the protocol info, which comes from the controller, queries
+			// go to the node, so it must wait for a place among the nodes being interviewed
+			if( !GetDriver()->AdmitInterview( this ) )
+			{
+				m_interviewWaiting = true;
+				break;
+			}
+			if( m_interviewWaiting )
+			{
+				Log::Write( LogLevel_Info, m_nodeId, "Waited %d ms to be interviewed", -m_stageTS.TimeRemaining() );
+				m_interviewWaiting = false;
+				m_stageTS.SetTime();
+			}
+		}
+
 		switch( m_queryStage )
 		{
 			case QueryStage_None:
@@ -633,6 +661,8 @@ void Node::AdvanceQueries
 			case QueryStage_Complete:
 			{
 				ClearAddingNode();
+				GetDriver()->EndInterview( m_nodeId );
+
 				// Notify the watchers that the queries are complete for this node
 				Log::Write( LogLevel_Detail, m_nodeId, "QueryStage_Complete" );
 				Notification* notification = new Notification( Notification::Type_NodeQueriesComplete );
@@ -650,6 +680,9 @@ void Node::AdvanceQueries
 		}
 	}
 
+	// The query stage is saved, but changes to it are not notified
+	GetDriver()->m_configWriter->NodeChanged( m_nodeId );
+
 	if( addQSC && m_nodeAlive )
 	{
 		// Add a marker to the query queue so this advance method
@@ -658,6 +691,37 @@ void Node::AdvanceQueries
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Node::TimeQueryStage>
+// Log the time taken by a stage once the node has moved on from it
+//-----------------------------------------------------------------------------
+void Node::TimeQueryStage
+(
+)
+{
+	if( m_queryStage == m_timedStage )
+	{
+		return;
+	}
+
+	if( QueryStage_None == m_timedStage || QueryStage_Complete == m_timedStage || m_queryStage < m_timedStage )
+	{
+		// The interview is starting, or restarting from an earlier stage
+		m_interviewTS.SetTime();
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, m_nodeId, "Query stage %s took %d ms", c_queryStageNames[m_timedStage], -m_stageTS.TimeRemaining() );
+	}
+	if( QueryStage_Complete == m_queryStage )
+	{
+		m_interviewTime = -m_interviewTS.TimeRemaining();
+		Log::Write( LogLevel_Info, m_nodeId, "Interview complete in %d ms", m_interviewTime );
+	}
+	m_timedStage = m_queryStage;
+	m_stageTS.SetTime();
+}
+
 //-----------------------------------------------------------------------------
 // <Node::QueryStageComplete>
 // We are done with a stage in the query process
@@ -683,6 +747,8 @@ void Node::QueryStageComplete
 			m_queryStage = (QueryStage)( (uint32)m_queryStage + 1 );
 		}
 		m_queryRetries = 0;
+		TimeQueryStage();
+		GetDriver()->m_configWriter->NodeChanged( m_nodeId );
 	}
 }
 
@@ -738,6 +804,7 @@ void Node::SetQueryStage
 		{
 			m_queryConfiguration = true;
 		}
+		GetDriver()->m_configWriter->NodeChanged( m_nodeId );
 	}
 	if( _advance )
 	{
@@ -1643,6 +1710,7 @@ void Node::SetNodeAlive
 	{
 		Log::Write( LogLevel_Error, m_nodeId, "ERROR: node presumed dead" );
 		m_nodeAlive = false;
+		GetDriver()->EndInterview( m_nodeId );
 		if( m_queryStage != Node::QueryStage_Complete )
 		{
 			// Check whether all nodes are now complete
@@ -1920,6 +1988,144 @@ bool Node::SetConfigParam
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::SetConfigParams>
+// Set a profile of configuration parameters in a device
+//-----------------------------------------------------------------------------
+bool Node::SetConfigParams
+(
+		map<uint8,int32> const& _params,
+		map<uint8,ConfigParamStatus>* o_status
+)
+{
+	Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) );
+	if( cc == NULL )
+	{
+		return false;
+	}
+
+	// Check the whole profile before anything is sent
+	bool valid = true;
+	map<uint8,Configuration::Param> send;
+	map<uint8,ConfigParamStatus> status;
+	for( map<uint8,int32>::const_iterator it = _params.begin(); it != _params.end(); ++it )
+	{
+		uint8 param = it->first;
+		int32 paramValue = it->second;
+
+		Value* value = cc->GetValue( 1, param );
+		if( value == NULL )
+		{
+			status[param] = ConfigParam_Unknown;
+			valid = false;
+			continue;
+		}
+
+		uint8 size = Configuration::GetParamSize( value );
+		int32 current = 0;
+		bool inRange = true;
+		switch( value->GetID().GetType() )
+		{
+			case ValueID::ValueType_Bool:
+			{
+				current = static_cast<ValueBool*>( value )->GetValue() ? 1 : 0;
+				inRange = ( paramValue == 0 || paramValue == 1 );
+				break;
+			}
+			case ValueID::ValueType_Byte:
+			{
+				current = (int32)static_cast<ValueByte*>( value )->GetValue();
+				break;
+			}
+			case ValueID::ValueType_Short:
+			{
+				current = (int32)static_cast<ValueShort*>( value )->GetValue();
+				break;
+			}
+			case ValueID::ValueType_Int:
+			{
+				current = static_cast<ValueInt*>( value )->GetValue();
+				break;
+			}
+			case ValueID::ValueType_List:
+			{
+				ValueList* valueList = static_cast<ValueList*>( value );
+				current = valueList->GetItem().m_value;
+				inRange = ( valueList->GetItemIdxByValue( paramValue ) >= 0 );
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		if( value->GetID().GetType() != ValueID::ValueType_List && value->GetMin() < value->GetMax() )
+		{
+			inRange = inRange && ( paramValue >= value->GetMin() ) && ( paramValue <= value->GetMax() );
+		}
+
+		if( size == 0 )
+		{
+			status[param] = ConfigParam_Unknown;
+			valid = false;
+		}
+		else if( value->IsReadOnly() )
+		{
+			status[param] = ConfigParam_ReadOnly;
+			valid = false;
+		}
+		else if( !inRange )
+		{
+			status[param] = ConfigParam_OutOfRange;
+			valid = false;
+		}
+		else if( value->IsSet() && current == paramValue )
+		{
+			status[param] = ConfigParam_Unchanged;
+		}
+		else
+		{
+			Configuration::Param& entry = send[param];
+			entry.m_value = paramValue;
+			entry.m_size = size;
+			status[param] = ConfigParam_Sent;
+		}
+		value->Release();
+	}
+
+	if( valid && !send.empty() )
+	{
+		Log::Write( LogLevel_Info, m_nodeId, "Setting %d of %d configuration parameters", (int32)send.size(), (int32)_params.size() );
+		cc->SetParams( send );
+
+		// Read the parameters back, so the values reflect what the device accepted
+		map<uint8,uint8> sent;
+		for( map<uint8,Configuration::Param>::iterator it = send.begin(); it != send.end(); ++it )
+		{
+			sent[it->first] = it->second.m_size;
+		}
+		cc->RequestParams( sent, 0, Driver::MsgQueue_Send );
+	}
+	else if( !valid )
+	{
+		Log::Write( LogLevel_Warning, m_nodeId, "Configuration profile refused - nothing was sent" );
+		for( map<uint8,ConfigParamStatus>::iterator it = status.begin(); it != status.end(); ++it )
+		{
+			if( it->second == ConfigParam_Sent )
+			{
+				it->second = ConfigParam_Withheld;
+			}
+		}
+	}
+
+	if( o_status )
+	{
+		*o_status = status;
+	}
+	return valid;
+}
+
 //-----------------------------------------------------------------------------
 // <Node::RequestConfigParam>
 // Request the value of a configuration parameter from the device
@@ -1947,7 +2153,8 @@ bool Node::RequestAllConfigParams
 	bool res = false;
 	if( Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) ) )
 	{
-		// Go through all the values in the value store, and request all those which are in the Configuration command class
+		// Go through all the values in the value store, and collect all those which are in the Configuration command class
+		map<uint8,uint8> params;
 		for( ValueStore::Iterator it = m_values->Begin(); it != m_values->End(); ++it )
 		{
 			Value* value = it->second;
@@ -1957,9 +2164,10 @@ bool Node::RequestAllConfigParams
 				 * lot of ConfigParams requests, and should help speed up any user generated messages being sent out (as the MsgQueue_Send has a higher
 				 * priority than MsgQueue_Query
 				 */
-				res |= cc->RequestValue( _requestFlags, value->GetID().GetIndex(), 1, Driver::MsgQueue_Query );
+				params[value->GetID().GetIndex()] = Configuration::GetParamSize( value );
 			}
 		}
+		res = cc->RequestParams( params, _requestFlags, Driver::MsgQueue_Query );
 	}
 
 	return res;
@@ -2448,6 +2656,7 @@ void Node::ReadValueFromXML
 		if( Value* value = store->GetValue( id.GetValueStoreKey() ) )
 		{
 			value->ReadXML( m_homeId, m_nodeId, _commandClassId, _valueElement );
+			value->Publish();
 			value->Release();
 		}
 		else
@@ -2470,6 +2679,20 @@ Value* Node::GetValue
 	return GetValueStore()->GetValue( _id.GetValueStoreKey() );
 }
 
+//-----------------------------------------------------------------------------
+// <Node::GetValue>
+// Get the value object with the specified ID, trying a saved handle first
+//-----------------------------------------------------------------------------
+Value* Node::GetValue
+(
+		ValueID const& _id,
+		uint32* _handle
+)
+{
+	// This increments the value's reference count
+	return GetValueStore()->GetValue( _id.GetValueStoreKey(), _handle );
+}
+
 //-----------------------------------------------------------------------------
 // <Node::GetValue>
 // Get the value object with the specified settings
@@ -3004,6 +3227,7 @@ void Node::GetNodeStatistics
 	_data->m_receivedTS = m_receivedTS.GetAsString();
 	_data->m_averageRequestRTT = m_averageRequestRTT;
 	_data->m_averageResponseRTT = m_averageResponseRTT;
+	_data->m_interviewTime = m_interviewTime;
 	_data->m_quality = m_quality;
 	memcpy( _data->m_lastReceivedMessage, m_lastReceivedMessage, sizeof(m_lastReceivedMessage) );
 	for( map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin(); it != m_commandClassMap.end(); ++it )
@@ -3169,4 +3393,47 @@ uint8 *Node::GetNonceKey(uint32 nonceid) {
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::SetPeerNonce>
+// Keep a nonce received from this node for the next encrypted message
+//-----------------------------------------------------------------------------
+void Node::SetPeerNonce
+(
+	uint8 const* _nonce
+)
+{
+	if( !memcmp( _nonce, m_peerNonceUsed, 8 ) )
+	{
+		// A repeat of a nonce that has been used already
+		return;
+	}
+	memcpy( m_peerNonce, _nonce, 8 );
+	m_peerNonceValid = true;
+	m_peerNonceTS.SetTime( c_peerNonceLifetime );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::TakePeerNonce>
+// Take the kept nonce, if it is still fresh enough to use
+//-----------------------------------------------------------------------------
+bool Node::TakePeerNonce
+(
+	uint8* o_nonce
+)
+{
+	if( !m_peerNonceValid )
+	{
+		return false;
+	}
+	m_peerNonceValid = false;
+	if( m_peerNonceTS.TimeRemaining() <= 0 )
+	{
+		Log::Write( LogLevel_Info, m_nodeId, "Prefetched nonce has expired" );
+		return false;
+	}
+	memcpy( o_nonce, m_peerNonce, 8 );
+	memcpy( m_peerNonceUsed, m_peerNonce, 8 );
+	return true;
+}
+
 
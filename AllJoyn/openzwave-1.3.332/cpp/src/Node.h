@@ -64,6 +64,7 @@ namespace OpenZWave
 	{
 			friend class Manager;
 			friend class Driver;
+			friend class ConfigWriter;
 			friend class Group;
 			friend class Value;
 			friend class ValueButton;
@@ -253,6 +254,7 @@ namespace OpenZWave
 
 		private:
 			void SetStaticRequests();
+			void TimeQueryStage();						// Log the time taken by a stage once the node has moved on from it
 
 			QueryStage	m_queryStage;
 			bool		m_queryPending;
@@ -265,6 +267,11 @@ namespace OpenZWave
 			bool		m_nodeInfoSupported;
 			bool		m_refreshonNodeInfoFrame;
 			bool		m_nodeAlive;
+			bool		m_interviewWaiting;				// Waiting for a place among the nodes being interviewed
+			QueryStage	m_timedStage;					// Stage being timed by m_stageTS
+			TimeStamp	m_stageTS;						// Start of the current query stage
+			TimeStamp	m_interviewTS;					// Start of the interview
+			uint32		m_interviewTime;				// Duration of the last completed interview, in ms
 
 			//-----------------------------------------------------------------------------
 			// Capabilities
@@ -289,6 +296,20 @@ namespace OpenZWave
 				NodeBroadcast = 0xff
 			};
 
+			/** Status of each parameter given to Manager::SetConfigParams.  It is the result of the
+			 *  checks made before anything is sent: whether the device accepts a value that was sent
+			 *  is only known from the ValueChanged or ValueRefreshed notification that follows.
+			 */
+			enum ConfigParamStatus
+			{
+				ConfigParam_Sent = 0,						/**< The parameter was queued for sending to the device */
+				ConfigParam_Unchanged,						/**< The device already holds the value, so it was not sent */
+				ConfigParam_Withheld,						/**< The parameter is valid, but was not sent because others in the profile were refused */
+				ConfigParam_Unknown,						/**< The node has no value for the parameter, so its size is not known */
+				ConfigParam_ReadOnly,						/**< The parameter cannot be set */
+				ConfigParam_OutOfRange						/**< The value is outside the range of the parameter */
+			};
+
 			bool IsListeningDevice()const{ return m_listening; }
 			bool IsFrequentListeningDevice()const{ return m_frequentListening; }
 			bool IsBeamingDevice()const{ return m_beaming; }
@@ -429,6 +450,7 @@ namespace OpenZWave
 			ValueID CreateValueID( ValueID::ValueGenre const _genre, uint8 const _commandClassId, uint8 const _instance, uint8 const _valueIndex, ValueID::ValueType const _type );
 
 			Value* GetValue( ValueID const& _id );
+			Value* GetValue( ValueID const& _id, uint32* _handle );		// Look the value up using a handle saved by the caller
 			Value* GetValue( uint8 const _commandClassId, uint8 const _instance, uint8 const _valueIndex );
 			bool RemoveValue( uint8 const _commandClassId, uint8 const _instance, uint8 const _valueIndex );
 
@@ -454,12 +476,14 @@ namespace OpenZWave
 			ValueStore* GetValueStore()const{ return m_values; }
 
 			ValueStore*	m_values;			// Values reported via command classes
+			uint32		m_setValueKey;		// While Value::Set is queuing messages, the value store key of the value.  Protected by the driver's node mutex.
 
 			//-----------------------------------------------------------------------------
 			// Configuration Parameters (handled by the Configuration command class)
 			//-----------------------------------------------------------------------------
 		private:
 			bool SetConfigParam( uint8 const _param, int32 _value, uint8 const _size );
+			bool SetConfigParams( map<uint8,int32> const& _params, map<uint8,ConfigParamStatus>* o_status );
 			void RequestConfigParam( uint8 const _param );
 			bool RequestAllConfigParams( uint32 const _requestFlags );
 
@@ -557,7 +581,10 @@ namespace OpenZWave
 					uint32 m_averageRequestRTT;				// ms
 					uint32 m_lastResponseRTT;
 					uint32 m_averageResponseRTT;
+					uint32 m_interviewTime;				// ms
 					uint8 m_quality;					// Node quality measure
+					uint8 m_hopCount;					// Expected hops from the controller, or zero if no route is known
+					uint8 m_routeHealth;				// From 0 (every recent transmission failed) to 100
 					uint8 m_lastReceivedMessage[254];
 					list<CommandClassData> m_ccData;
 			};
@@ -577,6 +604,8 @@ namespace OpenZWave
 			TimeStamp m_receivedTS;				// Last message received time
 			uint32 m_averageRequestRTT;			// Average Request round trip time.
 			uint32 m_averageResponseRTT;			// Average Reponse round trip time.
+			int32 m_smoothedResponseRTT;			// Smoothed response round trip time for the reply timeout, in eighths of a millisecond
+			int32 m_responseRTTDeviation;			// Mean deviation of the response round trip time, in quarters of a millisecond
 			uint8 m_quality;				// Node quality measure
 			uint8 m_lastReceivedMessage[254];		// Place to hold last received message
 			uint8 m_errors;					// Count errors for dead node detection
@@ -589,9 +618,30 @@ namespace OpenZWave
 			uint8 *GenerateNonceKey();
 			uint8 *GetNonceKey(uint32 nonceid);
 
+			/**
+			 * Keep a nonce the node sent without it being needed straight away,
+			 * such as one requested with MessageEncapNonceGet.  A nonce that was
+			 * already used is ignored.
+			 */
+			void SetPeerNonce( uint8 const* _nonce );
+
+			/**
+			 * Take the kept nonce, if it has not expired, so that the next encrypted
+			 * message can be sent without first asking the node for a nonce.
+			 * \param o_nonce 8-byte buffer that receives the nonce.
+			 * \return true if a nonce was taken.  It cannot be taken again.
+			 */
+			bool TakePeerNonce( uint8* o_nonce );
+
 			private:
 			uint8 m_lastnonce;
 			uint8 m_nonces[8][8];
+			uint8 m_peerNonce[8];			// Nonce received from the node and not yet used
+			bool m_peerNonceValid;
+			uint8 m_peerNonceUsed[8];		// Last nonce of the node's that was used
+			TimeStamp m_peerNonceTS;		// Expiry of m_peerNonce
+
+			static int32 const c_peerNonceLifetime = 2500;	// The node keeps a nonce for at least 3 seconds.  Allow for the time to send.
 	};
 
 
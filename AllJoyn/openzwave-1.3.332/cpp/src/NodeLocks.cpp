@@ -0,0 +1,343 @@
+//-----------------------------------------------------------------------------
+//
+//	NodeLocks.cpp
+//
+//	Locks protecting a driver's nodes
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <assert.h>
+#include "NodeLocks.h"
+#include "platform/RWLock.h"
+#include "platform/Log.h"
+
+#ifdef WIN32
+#define OZW_THREAD_LOCAL __declspec(thread)
+#else
+#define OZW_THREAD_LOCAL __thread
+#endif
+
+using namespace OpenZWave;
+
+// The locks held by a thread.  A lock that is requested again, or that is
+// covered by one already held, adds to the count of the hold that covers it.
+struct NodeLockHold
+{
+	NodeLocks const*	m_locks;
+	uint16				m_nodeId;				// c_allNodes for a lock on all of the nodes
+	uint16				m_count;
+	bool				m_write;
+};
+
+static uint16 const c_allNodes = 256;
+static uint32 const c_maxHolds = 32;
+
+static OZW_THREAD_LOCAL NodeLockHold t_holds[c_maxHolds];
+static OZW_THREAD_LOCAL uint32 t_numHolds = 0;
+
+//-----------------------------------------------------------------------------
+// <FindHold>
+// The calling thread's hold on a lock, or NULL
+//-----------------------------------------------------------------------------
+static NodeLockHold* FindHold
+(
+	NodeLocks const* _locks,
+	uint16 const _nodeId
+)
+{
+	for( uint32 i=0; i<t_numHolds; ++i )
+	{
+		if( t_holds[i].m_locks == _locks && t_holds[i].m_nodeId == _nodeId )
+		{
+			return &t_holds[i];
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <AddHold>
+// Record a lock taken by the calling thread
+//-----------------------------------------------------------------------------
+static void AddHold
+(
+	NodeLocks const* _locks,
+	uint16 const _nodeId,
+	bool const _write
+)
+{
+	if( t_numHolds == c_maxHolds )
+	{
+		// Each lock has a single hold, so this is a lock that is never released
+		Log::Write( LogLevel_Error, "ERROR: Too many node locks held by one thread" );
+		assert(0);
+		return;
+	}
+	NodeLockHold& hold = t_holds[t_numHolds++];
+	hold.m_locks = _locks;
+	hold.m_nodeId = _nodeId;
+	hold.m_count = 1;
+	hold.m_write = _write;
+}
+
+//-----------------------------------------------------------------------------
+// <RemoveHold>
+// Forget a lock released by the calling thread
+//-----------------------------------------------------------------------------
+static void RemoveHold
+(
+	NodeLockHold* _hold
+)
+{
+	*_hold = t_holds[--t_numHolds];
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::NodeLocks>
+// Constructor
+//-----------------------------------------------------------------------------
+NodeLocks::NodeLocks
+(
+):
+	m_table( new RWLock() ),
+	m_checked( false )
+{
+	for( int32 i=0; i<256; ++i )
+	{
+		m_nodes[i] = new RWLock();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::~NodeLocks>
+// Destructor
+//-----------------------------------------------------------------------------
+NodeLocks::~NodeLocks
+(
+)
+{
+	for( int32 i=0; i<256; ++i )
+	{
+		delete m_nodes[i];
+	}
+	delete m_table;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::Lock>
+// Lock all of the nodes
+//-----------------------------------------------------------------------------
+bool NodeLocks::Lock
+(
+	bool const _bWait // = true;
+)
+{
+	if( NodeLockHold* hold = FindHold( this, c_allNodes ) )
+	{
+		++hold->m_count;
+		return true;
+	}
+
+	for( uint32 i=0; i<t_numHolds; ++i )
+	{
+		if( t_holds[i].m_locks == this )
+		{
+			// The thread holds the table for its node lock, so waiting for the
+			// other holders to let go of the table would never end
+			Log::Write( LogLevel_Error, (uint8)t_holds[i].m_nodeId, "ERROR: Locking all nodes while holding the lock of node %d", t_holds[i].m_nodeId );
+			assert(0);
+			return false;
+		}
+	}
+
+	if( !m_table->LockWrite( _bWait ) )
+	{
+		return false;
+	}
+	AddHold( this, c_allNodes, true );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::Unlock>
+// Release a lock on all of the nodes
+//-----------------------------------------------------------------------------
+void NodeLocks::Unlock
+(
+)
+{
+	NodeLockHold* hold = FindHold( this, c_allNodes );
+	if( hold == NULL )
+	{
+		// No locks - we have a mismatched lock/release pair
+		Log::Write( LogLevel_Error, "ERROR: Unlocking nodes that are not locked" );
+		assert(0);
+		return;
+	}
+
+	if( --hold->m_count == 0 )
+	{
+		RemoveHold( hold );
+		m_table->UnlockWrite();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::IsSignalled>
+// Whether the calling thread does not hold all of the nodes
+//-----------------------------------------------------------------------------
+bool NodeLocks::IsSignalled
+(
+)
+{
+	return( FindHold( this, c_allNodes ) == NULL );
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::LockNode>
+// Lock one node for reading or writing
+//-----------------------------------------------------------------------------
+bool NodeLocks::LockNode
+(
+	uint8 const _nodeId,
+	bool const _write
+)
+{
+	if( NodeLockHold* hold = FindHold( this, _nodeId ) )
+	{
+		if( _write && !hold->m_write )
+		{
+			// Waiting for the other readers to leave could deadlock with one of
+			// them doing the same, so the request is refused
+			Log::Write( LogLevel_Error, _nodeId, "ERROR: Locking node %d for writing while holding it for reading", _nodeId );
+			assert(0);
+			return false;
+		}
+		++hold->m_count;
+		return true;
+	}
+
+	if( NodeLockHold* hold = FindHold( this, c_allNodes ) )
+	{
+		++hold->m_count;
+		return true;
+	}
+
+	bool tableHeld = false;
+	for( uint32 i=0; i<t_numHolds; ++i )
+	{
+		if( t_holds[i].m_locks == this )
+		{
+			tableHeld = true;
+			if( m_checked && t_holds[i].m_nodeId > _nodeId )
+			{
+				Log::Write( LogLevel_Error, _nodeId, "ERROR: Locking node %d while holding the lock of node %d", _nodeId, t_holds[i].m_nodeId );
+			}
+		}
+	}
+
+	if( !tableHeld )
+	{
+		m_table->LockRead();
+	}
+	if( _write )
+	{
+		m_nodes[_nodeId]->LockWrite();
+	}
+	else
+	{
+		m_nodes[_nodeId]->LockRead();
+	}
+	AddHold( this, _nodeId, _write );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::UnlockNode>
+// Release a lock on one node
+//-----------------------------------------------------------------------------
+void NodeLocks::UnlockNode
+(
+	uint8 const _nodeId
+)
+{
+	NodeLockHold* hold = FindHold( this, _nodeId );
+	if( hold == NULL )
+	{
+		// The request was covered by a lock on all of the nodes
+		if( FindHold( this, c_allNodes ) != NULL )
+		{
+			Unlock();
+			return;
+		}
+		Log::Write( LogLevel_Error, _nodeId, "ERROR: Unlocking node %d, which is not locked", _nodeId );
+		assert(0);
+		return;
+	}
+
+	if( --hold->m_count != 0 )
+	{
+		return;
+	}
+
+	bool write = hold->m_write;
+	RemoveHold( hold );
+	if( write )
+	{
+		m_nodes[_nodeId]->UnlockWrite();
+	}
+	else
+	{
+		m_nodes[_nodeId]->UnlockRead();
+	}
+
+	for( uint32 i=0; i<t_numHolds; ++i )
+	{
+		if( t_holds[i].m_locks == this )
+		{
+			// Another node lock still needs the table
+			return;
+		}
+	}
+	m_table->UnlockRead();
+}
+
+//-----------------------------------------------------------------------------
+// <NodeLocks::IsLocked>
+// Whether the calling thread holds a lock covering a node
+//-----------------------------------------------------------------------------
+bool NodeLocks::IsLocked
+(
+	uint8 const _nodeId,
+	bool const _write // = false
+)
+{
+	if( FindHold( this, c_allNodes ) != NULL )
+	{
+		return true;
+	}
+	if( NodeLockHold* hold = FindHold( this, _nodeId ) )
+	{
+		return( hold->m_write || !_write );
+	}
+	return false;
+}
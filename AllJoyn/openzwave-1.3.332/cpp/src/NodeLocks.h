@@ -0,0 +1,164 @@
+//-----------------------------------------------------------------------------
+//
+//	NodeLocks.h
+//
+//	Locks protecting a driver's nodes
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NodeLocks_H
+#define _NodeLocks_H
+
+#include "Defs.h"
+#include "platform/Mutex.h"
+
+namespace OpenZWave
+{
+	class RWLock;
+
+	/** \brief Locks protecting a driver's nodes.
+	 *
+	 *  Locking the object as a Mutex gives the calling thread exclusive access
+	 *  to the driver's table of nodes and to every node in it.  This is for
+	 *  code that adds or removes nodes, or that works across many nodes.
+	 *
+	 *  Each node also has a reader/writer lock of its own.  LockNode takes the
+	 *  node's lock, along with a shared hold on the table, so that threads
+	 *  working on different nodes, or only reading the same node, do not wait
+	 *  for each other.
+	 *
+	 *  All of the locks are recursive, and a lock the thread already holds
+	 *  covers later requests: holding all of the nodes covers any node, and a
+	 *  node's write lock covers reading it.  Locks must be taken in this order:
+	 *  - the driver's poll mutex;
+	 *  - all of the nodes, which cannot be locked while holding a node lock;
+	 *  - node locks, in increasing order of node id;
+	 *  - the send queue, wake-up and notification mutexes.
+	 *  A node's read lock cannot be upgraded to a write lock.
+	 *
+	 *  Requests that would deadlock the calling thread are always refused with
+	 *  an error in the log and an assertion, and the caller is told that it does
+	 *  not hold the lock.  In checked mode, set by the CheckNodeLocks option,
+	 *  requests that could deadlock against another thread are logged as well.
+	 */
+	class NodeLocks: public Mutex
+	{
+	public:
+		/**
+		 * Constructor.
+		 */
+		NodeLocks();
+
+		/**
+		 * Lock all of the nodes.
+		 * \param _bWait if false, return immediately if another thread holds any of the locks.
+		 * \return True if the lock was obtained.  False if another thread held a lock, or if
+		 * the calling thread holds a node lock, which would deadlock.
+		 */
+		virtual bool Lock( bool const _bWait = true );
+
+		/**
+		 * Release a lock on all of the nodes.
+		 */
+		virtual void Unlock();
+
+		/**
+		 * Whether the calling thread does not hold all of the nodes.
+		 */
+		virtual bool IsSignalled();
+
+		/**
+		 * Lock one node.  There must be a matching call to UnlockNode.
+		 * \param _nodeId the node.  A node that does not exist can be locked too.
+		 * \param _write true to change the node, false to only read it.
+		 * \return true if the lock was obtained.  False if the calling thread holds the
+		 * node for reading and asked to write it, in which case nothing is locked.
+		 */
+		bool LockNode( uint8 const _nodeId, bool const _write );
+
+		/**
+		 * Release a lock taken by LockNode.  Not called for a refused request.
+		 */
+		void UnlockNode( uint8 const _nodeId );
+
+		/**
+		 * Whether the calling thread holds a lock that covers a node.
+		 * \param _nodeId the node.
+		 * \param _write true if the lock must allow the node to be changed.
+		 */
+		bool IsLocked( uint8 const _nodeId, bool const _write = false );
+
+		/**
+		 * Turn checking of the lock ordering protocol on or off.
+		 */
+		void SetChecked( bool const _checked ){ m_checked = _checked; }
+		bool IsChecked()const{ return m_checked; }
+
+	protected:
+		virtual ~NodeLocks();
+
+	private:
+		NodeLocks( NodeLocks const& );					// prevent copy
+		NodeLocks& operator = ( NodeLocks const& );		// prevent assignment
+
+		RWLock*			m_table;					// Shared by node locks, held exclusively when locking all of the nodes
+		RWLock*			m_nodes[256];
+		bool			m_checked;
+	};
+
+	/** \brief Holds a node lock for the lifetime of the guard.
+	 */
+	struct NodeLockGuard
+	{
+		NodeLockGuard( NodeLocks* _locks, uint8 const _nodeId, bool const _write ):
+			m_locks( _locks ),
+			m_nodeId( _nodeId )
+		{
+			m_locked = m_locks->LockNode( m_nodeId, _write );
+		}
+
+		~NodeLockGuard()
+		{
+			if( m_locked )
+			{
+				m_locks->UnlockNode( m_nodeId );
+			}
+		}
+
+		/**
+		 * Whether the lock was obtained.  Code that changes the node must not
+		 * go on if it was refused.
+		 */
+		bool IsLocked()const{ return m_locked; }
+
+	private:
+		NodeLockGuard( NodeLockGuard const& );
+		NodeLockGuard& operator = ( NodeLockGuard const& );
+
+		NodeLocks*	m_locks;
+		uint8		m_nodeId;
+		bool		m_locked;
+	};
+
+} // namespace OpenZWave
+
+#endif //_NodeLocks_H
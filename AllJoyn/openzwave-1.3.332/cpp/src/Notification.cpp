@@ -28,9 +28,105 @@
 #include "Defs.h"
 #include "Notification.h"
 #include "Driver.h"
+#include "platform/Mutex.h"
 
 using namespace OpenZWave;
 
+// Freed notifications kept for reuse
+static uint32 const c_poolSize = 256;
+static Mutex* s_poolMutex = NULL;
+static void* s_pool[c_poolSize];
+static uint32 s_pooled = 0;
+
+//-----------------------------------------------------------------------------
+// <Notification::operator new>
+// Take a notification from the pool, or allocate one if it is empty
+//-----------------------------------------------------------------------------
+void* Notification::operator new
+(
+	size_t _size
+)
+{
+	assert( _size == sizeof(Notification) );
+	if( s_poolMutex != NULL )
+	{
+		void* p = NULL;
+		s_poolMutex->Lock();
+		if( s_pooled > 0 )
+		{
+			p = s_pool[--s_pooled];
+		}
+		s_poolMutex->Unlock();
+		if( p != NULL )
+		{
+			return p;
+		}
+	}
+	return ::operator new( _size );
+}
+
+//-----------------------------------------------------------------------------
+// <Notification::operator delete>
+// Return a notification to the pool, or free it if the pool is full
+//-----------------------------------------------------------------------------
+void Notification::operator delete
+(
+	void* _p
+)
+{
+	if( _p == NULL )
+	{
+		return;
+	}
+	if( s_poolMutex != NULL )
+	{
+		s_poolMutex->Lock();
+		if( s_pooled < c_poolSize )
+		{
+			s_pool[s_pooled++] = _p;
+			_p = NULL;
+		}
+		s_poolMutex->Unlock();
+	}
+	if( _p != NULL )
+	{
+		::operator delete( _p );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Notification::CreatePool>
+// Start keeping freed notifications for reuse
+//-----------------------------------------------------------------------------
+void Notification::CreatePool
+(
+)
+{
+	if( s_poolMutex == NULL )
+	{
+		s_poolMutex = new Mutex();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Notification::DestroyPool>
+// Free the pooled notifications.  Called once no other thread can be using them.
+//-----------------------------------------------------------------------------
+void Notification::DestroyPool
+(
+)
+{
+	if( s_poolMutex != NULL )
+	{
+		while( s_pooled > 0 )
+		{
+			::operator delete( s_pool[--s_pooled] );
+		}
+		s_poolMutex->Release();
+		s_poolMutex = NULL;
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // <Notification::GetAsString>
@@ -43,6 +43,7 @@ namespace OpenZWave
 	{
 		friend class Manager;
 		friend class Driver;
+		friend class NotificationDispatcher;
 		friend class Node;
 		friend class Group;
 		friend class Value;
@@ -185,6 +186,12 @@ namespace OpenZWave
 		Notification( NotificationType _type ): m_type( _type ), m_byte(0), m_event(0) {}
 		~Notification(){}
 
+		// Notifications are allocated from a pool while the Manager exists
+		static void* operator new( size_t _size );
+		static void operator delete( void* _p );
+		static void CreatePool();
+		static void DestroyPool();
+
 		void SetHomeAndNodeIds( uint32 const _homeId, uint8 const _nodeId ){ m_valueId = ValueID( _homeId, _nodeId ); }
 		void SetHomeNodeIdAndInstance ( uint32 const _homeId, uint8 const _nodeId, uint32 const _instance ){ m_valueId = ValueID( _homeId, _nodeId, _instance ); }
 		void SetValueId( ValueID const& _valueId ){ m_valueId = _valueId; }
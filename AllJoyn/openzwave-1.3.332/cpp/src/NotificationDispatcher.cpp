@@ -0,0 +1,271 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationDispatcher.cpp
+//
+//	Delivers notifications to the watchers from a thread of their own
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+#include "NotificationDispatcher.h"
+#include "Manager.h"
+#include "Notification.h"
+#include "platform/Event.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+#include "platform/Wait.h"
+#include "platform/WaitSet.h"
+
+#ifdef WIN32
+#define OZW_THREAD_LOCAL __declspec(thread)
+#else
+#define OZW_THREAD_LOCAL __thread
+#endif
+
+using namespace OpenZWave;
+
+// Set on the dispatch thread, so that a watcher calling Flush does not wait for itself
+static OZW_THREAD_LOCAL bool t_dispatching = false;
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::NotificationDispatcher>
+// Constructor
+//-----------------------------------------------------------------------------
+NotificationDispatcher::NotificationDispatcher
+(
+	Manager* _manager,
+	int32 const _coalesceTime
+):
+	m_manager( _manager ),
+	m_coalesceTime( _coalesceTime ),
+	m_mutex( new Mutex() ),
+	m_dispatching( false ),
+	m_delivered( 0 ),
+	m_batches( 0 ),
+	m_merged( 0 ),
+	m_thread( new Thread( "notify" ) ),
+	m_queueEvent( new Event() ),
+	m_idleEvent( new Event() )
+{
+	m_idleEvent->Set();
+	m_thread->Start( NotificationDispatcher::DispatchThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::~NotificationDispatcher>
+// Destructor
+//-----------------------------------------------------------------------------
+NotificationDispatcher::~NotificationDispatcher
+(
+)
+{
+	m_thread->Stop();
+	m_thread->Release();
+
+	// Anything still queued is delivered from this thread
+	Dispatch();
+
+	Log::Write( LogLevel_Info, "mgr,     Notifications: %d delivered in %d batches, %d merged", m_delivered, m_batches, m_merged );
+
+	m_idleEvent->Release();
+	m_queueEvent->Release();
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Queue>
+// Queue a notification for delivery
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::Queue
+(
+	Notification* _notification
+)
+{
+	m_mutex->Lock();
+	if( ( m_coalesceTime > 0 ) && ( Notification::Type_ValueChanged == _notification->GetType() ) )
+	{
+		// The newest change replaces any that is still waiting
+		uint32 pos = (uint32)m_queue.size();
+		pair<map<ValueID,uint32>::iterator,bool> res = m_changed.insert( pair<ValueID,uint32>( _notification->GetValueID(), pos ) );
+		if( !res.second )
+		{
+			delete m_queue[res.first->second];
+			m_queue[res.first->second] = NULL;
+			res.first->second = pos;
+			++m_merged;
+		}
+	}
+	else if( Notification::Type_ValueRemoved == _notification->GetType() )
+	{
+		// The watchers could not read the value when its waiting notifications are delivered
+		ValueID const& valueId = _notification->GetValueID();
+		for( deque<Notification*>::iterator it = m_queue.begin(); it != m_queue.end(); ++it )
+		{
+			Notification* queued = *it;
+			if( ( queued != NULL ) && ( queued->GetValueID() == valueId ) &&
+				( ( Notification::Type_ValueChanged == queued->GetType() ) || ( Notification::Type_ValueRefreshed == queued->GetType() ) ) )
+			{
+				delete queued;
+				*it = NULL;
+			}
+		}
+		m_changed.erase( valueId );
+	}
+	m_queue.push_back( _notification );
+	m_idleEvent->Reset();
+	m_queueEvent->Set();
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Flush>
+// Wait until the queued notifications have been delivered
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::Flush
+(
+)
+{
+	if( t_dispatching )
+	{
+		return;
+	}
+	Wait::Single( m_idleEvent );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Dispatch>
+// Deliver all of the queued notifications as one batch
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::Dispatch
+(
+)
+{
+	vector<Notification*> batch;
+	m_mutex->Lock();
+	batch.reserve( m_queue.size() );
+	for( deque<Notification*>::iterator it = m_queue.begin(); it != m_queue.end(); ++it )
+	{
+		if( *it != NULL )
+		{
+			batch.push_back( *it );
+		}
+	}
+	m_queue.clear();
+	m_changed.clear();
+	m_queueEvent->Reset();
+	m_dispatching = true;
+	m_mutex->Unlock();
+
+	// Values may have been removed since their notifications were queued
+	vector<Notification*>::iterator last = batch.begin();
+	for( vector<Notification*>::iterator it = batch.begin(); it != batch.end(); ++it )
+	{
+		Notification* notification = *it;
+		if( ( ( Notification::Type_ValueChanged == notification->GetType() ) || ( Notification::Type_ValueRefreshed == notification->GetType() ) ) &&
+			!m_manager->IsValueValid( notification->GetValueID() ) )
+		{
+			Log::Write( LogLevel_Info, notification->GetNodeId(), "Dropping Notification as ValueID does not exist" );
+			delete notification;
+			continue;
+		}
+		*last++ = notification;
+	}
+	batch.erase( last, batch.end() );
+
+	if( !batch.empty() )
+	{
+		m_manager->DeliverNotifications( &batch[0], (uint32)batch.size() );
+		for( vector<Notification*>::iterator it = batch.begin(); it != batch.end(); ++it )
+		{
+			delete *it;
+		}
+	}
+
+	m_mutex->Lock();
+	if( !batch.empty() )
+	{
+		m_delivered += (uint32)batch.size();
+		++m_batches;
+	}
+	m_dispatching = false;
+	if( m_queue.empty() )
+	{
+		m_idleEvent->Set();
+	}
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::DispatchThreadEntryPoint>
+// Entry point of the dispatch thread
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::DispatchThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	NotificationDispatcher* dispatcher = (NotificationDispatcher*)_context;
+	if( dispatcher )
+	{
+		dispatcher->DispatchThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::DispatchThreadProc>
+// Deliver batches of notifications as they are queued
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::DispatchThreadProc
+(
+	Event* _exitEvent
+)
+{
+	t_dispatching = true;
+
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;		// Thread must exit.
+	waitObjects[1] = m_queueEvent;		// Notifications have been queued.
+	WaitSet waitSet( waitObjects, 2 );
+
+	while( true )
+	{
+		if( waitSet.Any() == 0 )
+		{
+			// Exit has been called
+			return;
+		}
+
+		if( m_coalesceTime > 0 )
+		{
+			// Let further notifications gather, so repeated changes are delivered once
+			if( Wait::Single( _exitEvent, m_coalesceTime ) == 0 )
+			{
+				// Anything still queued is delivered by the destructor
+				return;
+			}
+		}
+
+		Dispatch();
+	}
+}
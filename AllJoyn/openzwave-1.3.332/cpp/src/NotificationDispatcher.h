@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationDispatcher.h
+//
+//	Delivers notifications to the watchers from a thread of their own
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NotificationDispatcher_H
+#define _NotificationDispatcher_H
+
+#include <deque>
+#include <map>
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Manager;
+	class Mutex;
+	class Notification;
+	class Thread;
+
+	/** \brief Delivers notifications to the watchers from a thread of its own.
+	 *
+	 *  Notifications are queued by the thread that sends them, which is
+	 *  usually a driver thread, so a slow watcher no longer holds up the
+	 *  serial port.  The dispatch thread takes everything that has been
+	 *  queued as one batch, and delivers the batch in order.
+	 *
+	 *  With a coalescing time, the thread waits that long once a notification
+	 *  arrives before taking the batch.  A ValueChanged notification for a
+	 *  value that already has one waiting in the queue replaces it, and is
+	 *  delivered in the newer one's place.
+	 *
+	 *  A value can be removed while its notifications wait.  A ValueRemoved
+	 *  notification drops the ValueChanged and ValueRefreshed notifications
+	 *  still waiting for the value, and just before a batch is delivered, those
+	 *  for values that no longer exist are dropped.
+	 */
+	class NotificationDispatcher
+	{
+	public:
+		/**
+		 * Constructor.
+		 * \param _manager the manager whose watchers are called.
+		 * \param _coalesceTime milliseconds to gather notifications before they are delivered.
+		 */
+		NotificationDispatcher( Manager* _manager, int32 const _coalesceTime );
+
+		/**
+		 * Destructor.  Notifications that are still queued are delivered first.
+		 */
+		~NotificationDispatcher();
+
+		/**
+		 * Queue a notification for delivery.  The dispatcher takes ownership of it.
+		 */
+		void Queue( Notification* _notification );
+
+		/**
+		 * Wait until every notification queued so far has been delivered.  Returns at
+		 * once if called by a watcher, which is itself being run by the dispatch thread.
+		 */
+		void Flush();
+
+	private:
+		NotificationDispatcher( NotificationDispatcher const& );					// prevent copy
+		NotificationDispatcher& operator = ( NotificationDispatcher const& );		// prevent assignment
+
+		static void DispatchThreadEntryPoint( Event* _exitEvent, void* _context );
+		void DispatchThreadProc( Event* _exitEvent );
+		void Dispatch();							// Deliver everything that is queued as one batch
+
+		Manager*					m_manager;
+		int32						m_coalesceTime;
+
+		Mutex*						m_mutex;				// Protects the members below.  Never held while the watchers are called.
+		deque<Notification*>		m_queue;				// Holds NULL in place of a notification that has been dropped
+		map<ValueID,uint32>			m_changed;				// Position in m_queue of each value's ValueChanged notification
+		bool						m_dispatching;			// A batch is being delivered
+		uint32						m_delivered;
+		uint32						m_batches;
+		uint32						m_merged;
+
+		Thread*						m_thread;
+		Event*						m_queueEvent;			// Set while m_queue is not empty
+		Event*						m_idleEvent;			// Set while nothing is queued or being delivered
+	};
+
+} // namespace OpenZWave
+
+#endif //_NotificationDispatcher_H
@@ -106,6 +106,7 @@ Options* Options::Create
 		s_instance->AddOptionInt(		"SaveLogLevel",				LogLevel_Detail );			// Save (to file) log messages equal to or above LogLevel_Detail
 		s_instance->AddOptionInt(		"QueueLogLevel",			LogLevel_Debug );			// Save (in RAM) log messages equal to or above LogLevel_Debug
 		s_instance->AddOptionInt(		"DumpTriggerLevel",			LogLevel_None );			// Default is to never dump RAM-stored log messages
+		s_instance->AddOptionBool(		"AsyncLogging",				false );					// Write log messages from a background thread rather than the calling thread
 
 		s_instance->AddOptionBool(		"Associate",				true );						// Enable automatic association of the controller with group one of every device.
 		s_instance->AddOptionString(	"Exclude",					string(""),		true );		// Remove support for the listed command classes.
@@ -123,12 +124,37 @@ Options* Options::Create
 		s_instance->AddOptionString(	"NetworkKey", 				string(""), 			false);
 		s_instance->AddOptionBool(		"RefreshAllUserCodes",		false ); 					// if true, during startup, we refresh all the UserCodes the device reports it supports. If False, we stop after we get the first "Available" slot (Some devices have 250+ usercode slots! - That makes our Session Stage Very Long )
 		s_instance->AddOptionInt( 		"RetryTimeout", 			RETRY_TIMEOUT);				// How long do we wait to timeout messages sent
+		s_instance->AddOptionBool(		"AdaptiveTimeout",			true);						// Time out a node's reply from its measured round trip times, rather than after RetryTimeout
+		s_instance->AddOptionInt(		"MinReplyTimeout",			20);						// Shortest adaptive reply timeout, in milliseconds for each hop to the node
+		s_instance->AddOptionInt(		"MaxInterviews",			8);							// Listening nodes interviewed at once, mains powered nodes first (0 = no limit)
 		s_instance->AddOptionBool( 		"EnableSIS", 				true);						// Automatically become a SUC if there is no SUC on the network.
 		s_instance->AddOptionBool( 		"AssumeAwake", 				true);						// Assume Devices that Support the Wakeup CC are awake when we first query them....
 		s_instance->AddOptionBool(		"NotifyOnDriverUnload",		false);						// Should we send the Node/Value Notifications on Driver Unloading - Read comments in Driver::~Driver() method about possible race conditions
 		s_instance->AddOptionString(	"SecurityStrategy", 		"SUPPORTED", 	false);		// Should we encrypt CC's that are available via both clear text and Security CC?
 		s_instance->AddOptionString(	"CustomSecuredCC", 			"0x62,0x4c,0x63", 	false);	// What List of Custom CC should we always encrypt if SecurityStrategy is CUSTOM
 		s_instance->AddOptionBool(		"EnforceSecureReception",	true);						// if we recieve a clear text message for a CC that is Secured, should we drop the message
+		s_instance->AddOptionBool(		"MultiCmdEncapsulation",	true);						// Pack queued wake-up, query and poll messages for a node that supports COMMAND_CLASS_MULTI_CMD into a single frame
+		s_instance->AddOptionBool(		"NetworkCache",				true);						// Keep a binary copy of the zwcfg network file that loads without parsing XML
+		s_instance->AddOptionBool(		"Multicast",				true);						// Send an identical command for several nodes in a scene or bulk SetValue as one multicast frame
+		s_instance->AddOptionBool(		"MulticastVerify",			true);						// Follow each multicast frame with the same command sent to each node in turn
+		s_instance->AddOptionInt(		"SaveConfigurationDelay",	1000);						// Milliseconds Manager::WriteConfig waits for further calls before saving in the background (0 saves at once)
+		s_instance->AddOptionBool(		"CheckNodeLocks",			false);						// Log node locks taken out of order, which could deadlock two threads
+		s_instance->AddOptionBool(		"NotifyThread",				false);						// Call the watchers from a thread of their own, so a slow watcher does not hold up the driver
+		s_instance->AddOptionInt(		"NotifyCoalesceTime",		0);							// Milliseconds the notification thread gathers notifications, merging repeated ValueChanged for a value (0 = none)
+		s_instance->AddOptionInt(		"NeighborUpdateInterval",	0);							// Minutes before a node whose routes have degraded may be sent another automatic neighbor update (0 = no automatic updates)
+		s_instance->AddOptionBool(		"LatencyStatistics",		true);						// Keep latency histograms of each stage of a transaction, by node, command class and queue
+		s_instance->AddOptionString(	"LatencyExportPath",		string(""),		false );	// Directory to write the latency histograms to, in the Prometheus text format ("" = none)
+		s_instance->AddOptionInt(		"LatencyExportInterval",	60);						// Seconds between writes of the latency histograms
+
+		s_instance->AddOptionInt(		"SimulatorNodes",			10);						// Number of virtual nodes behind a simulated controller (ControllerInterface_Simulator)
+		s_instance->AddOptionInt(		"SimulatorAckLatency",		2);							// Milliseconds before the simulated controller ACKs a frame
+		s_instance->AddOptionInt(		"SimulatorResponseLatency",	5);							// Milliseconds between the ACK and the response
+		s_instance->AddOptionInt(		"SimulatorCallbackLatency",	20);						// Milliseconds between the response and the transmit callback
+		s_instance->AddOptionInt(		"SimulatorReportLatency",	15);						// Milliseconds between the callback and a node's report
+		s_instance->AddOptionInt(		"SimulatorReportInterval",	0);							// Milliseconds between unsolicited reports from the virtual nodes (0 = never)
+		s_instance->AddOptionInt(		"SimulatorCANRate",			0);							// Frames per thousand answered with a CAN
+		s_instance->AddOptionInt(		"SimulatorNAKRate",			0);							// Frames per thousand answered with a NAK
+		s_instance->AddOptionBool(		"SimulatorReplayLoop",		false);						// Restart the replay script (the controller path) when it ends
 	}
 
 	return s_instance;
@@ -0,0 +1,516 @@
+//-----------------------------------------------------------------------------
+//
+//	PollScheduler.cpp
+//
+//	Schedules the polling of values, each with its own period
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <string.h>
+#include "PollScheduler.h"
+#include "Utils.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+// Values of the same node and command class that fall due within this
+// fraction of their period are polled along with a value that is due now.
+static uint32 const c_coalesceFraction = 4;
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::PollScheduler>
+// Constructor
+//-----------------------------------------------------------------------------
+PollScheduler::PollScheduler
+(
+):
+	m_mutex( new Mutex() ),
+	m_event( new Event() ),
+	m_interval( 0 ),
+	m_bIntervalBetweenPolls( false ),
+	m_lastPoll( 0 ),
+	m_seed( 0x12345678 ),
+	m_lateTotal( 0 )
+{
+	memset( &m_stats, 0, sizeof(m_stats) );
+	m_lastPoll = Now();
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::~PollScheduler>
+// Destructor
+//-----------------------------------------------------------------------------
+PollScheduler::~PollScheduler
+(
+)
+{
+	m_event->Release();
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Add>
+// Start polling a value
+//-----------------------------------------------------------------------------
+bool PollScheduler::Add
+(
+	ValueID const& _valueId,
+	uint8 const _intensity
+)
+{
+	m_mutex->Lock();
+	if( m_entries.find( _valueId ) != m_entries.end() )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	PollEntry& entry = m_entries[_valueId];
+	entry.m_intensity = _intensity;
+	entry.m_period = 0;
+	entry.m_jitter = 0;
+	entry.m_due = 0;
+	entry.m_generation = 0;
+	entry.m_lastReport = 0;
+	entry.m_reported = false;
+	entry.m_pending = false;
+
+	// Spread the first polls of the values over their periods, in the way
+	// that the old round-robin poll list spread them over the interval.
+	uint32 offset = 0;
+	int32 period = GetPeriod( entry );
+	if( period > 0 )
+	{
+		uint64 id = _valueId.GetId();
+		offset = (uint32)( ( id ^ ( id >> 29 ) ) * 2654435761u ) % (uint32)period;
+	}
+	Schedule( _valueId, entry, Now() + offset );
+	m_mutex->Unlock();
+
+	m_event->Set();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Remove>
+// Stop polling a value
+//-----------------------------------------------------------------------------
+bool PollScheduler::Remove
+(
+	ValueID const& _valueId
+)
+{
+	LockGuard LG( m_mutex );
+	map<ValueID,PollEntry>::iterator it = m_entries.find( _valueId );
+	if( it == m_entries.end() )
+	{
+		return false;
+	}
+
+	// The heap item is discarded when it reaches the front
+	m_entries.erase( it );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Contains>
+// Determine whether a value is being polled
+//-----------------------------------------------------------------------------
+bool PollScheduler::Contains
+(
+	ValueID const& _valueId
+)
+{
+	LockGuard LG( m_mutex );
+	return( m_entries.find( _valueId ) != m_entries.end() );
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Size>
+// Get the number of values being polled
+//-----------------------------------------------------------------------------
+uint32 PollScheduler::Size
+(
+)
+{
+	LockGuard LG( m_mutex );
+	return (uint32)m_entries.size();
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::SetIntensity>
+// Change the poll intensity of a value
+//-----------------------------------------------------------------------------
+void PollScheduler::SetIntensity
+(
+	ValueID const& _valueId,
+	uint8 const _intensity
+)
+{
+	LockGuard LG( m_mutex );
+	map<ValueID,PollEntry>::iterator it = m_entries.find( _valueId );
+	if( it != m_entries.end() )
+	{
+		// Takes effect when the value is next rescheduled
+		it->second.m_intensity = _intensity;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::SetPeriod>
+// Give a value its own poll period and jitter
+//-----------------------------------------------------------------------------
+bool PollScheduler::SetPeriod
+(
+	ValueID const& _valueId,
+	int32 const _period,
+	int32 const _jitter
+)
+{
+	m_mutex->Lock();
+	map<ValueID,PollEntry>::iterator it = m_entries.find( _valueId );
+	if( it == m_entries.end() )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	PollEntry& entry = it->second;
+	entry.m_period = ( _period > 0 ) ? _period : 0;
+	entry.m_jitter = ( _jitter > 0 ) ? _jitter : 0;
+
+	// Bring the next poll forward if the new period is shorter than the remaining wait
+	uint32 now = Now();
+	uint32 due = now + (uint32)GetPeriod( entry ) + Jitter( entry );
+	if( (int32)( due - entry.m_due ) < 0 )
+	{
+		Schedule( _valueId, entry, due );
+	}
+	m_mutex->Unlock();
+
+	m_event->Set();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::SetInterval>
+// Set the interval from which the default poll periods are derived
+//-----------------------------------------------------------------------------
+void PollScheduler::SetInterval
+(
+	int32 const _interval,
+	bool const _bIntervalBetweenPolls
+)
+{
+	LockGuard LG( m_mutex );
+	if( ( _interval == m_interval ) && ( _bIntervalBetweenPolls == m_bIntervalBetweenPolls ) )
+	{
+		return;
+	}
+
+	m_interval = _interval;
+	m_bIntervalBetweenPolls = _bIntervalBetweenPolls;
+	if( ( m_interval > 0 ) && ( m_interval < 100 ) )
+	{
+		Log::Write( LogLevel_Info, "The pollInterval setting is only %d, which appears to be a legacy setting.  Multiplying by 1000 to convert to ms.", m_interval );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Refreshed>
+// Record that a node has reported a polled value
+//-----------------------------------------------------------------------------
+void PollScheduler::Refreshed
+(
+	ValueID const& _valueId
+)
+{
+	LockGuard LG( m_mutex );
+	map<ValueID,PollEntry>::iterator it = m_entries.find( _valueId );
+	if( it == m_entries.end() )
+	{
+		return;
+	}
+
+	PollEntry& entry = it->second;
+	if( entry.m_pending )
+	{
+		// This is the reply to our poll
+		entry.m_pending = false;
+		return;
+	}
+
+	entry.m_lastReport = Now();
+	entry.m_reported = true;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Unanswered>
+// Record that no reply will arrive for the outstanding polls of a node
+//-----------------------------------------------------------------------------
+void PollScheduler::Unanswered
+(
+	uint32 const _homeId,
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	for( map<ValueID,PollEntry>::iterator it = m_entries.lower_bound( ValueID( _homeId, _nodeId ) ); it != m_entries.end(); ++it )
+	{
+		if( ( it->first.GetHomeId() != _homeId ) || ( it->first.GetNodeId() != _nodeId ) )
+		{
+			break;
+		}
+		it->second.m_pending = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Unanswered>
+// Record that no reply will arrive for the outstanding poll of a value
+//-----------------------------------------------------------------------------
+void PollScheduler::Unanswered
+(
+	ValueID const& _valueId
+)
+{
+	LockGuard LG( m_mutex );
+	map<ValueID,PollEntry>::iterator it = m_entries.find( _valueId );
+	if( it != m_entries.end() )
+	{
+		it->second.m_pending = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::GetDuePolls>
+// Get the next group of values to poll, or the time until one is due
+//-----------------------------------------------------------------------------
+int32 PollScheduler::GetDuePolls
+(
+	list<ValueID>& _valueIds
+)
+{
+	LockGuard LG( m_mutex );
+	while( !m_heap.empty() )
+	{
+		HeapItem item = m_heap.front();
+		map<ValueID,PollEntry>::iterator it = m_entries.find( item.m_valueId );
+		if( ( it == m_entries.end() ) || ( it->second.m_generation != item.m_generation ) )
+		{
+			// The value has been removed or rescheduled
+			pop_heap( m_heap.begin(), m_heap.end(), HeapCompare() );
+			m_heap.pop_back();
+			continue;
+		}
+
+		uint32 now = Now();
+		int32 wait = (int32)( item.m_due - now );
+		if( wait > 0 )
+		{
+			return wait;
+		}
+
+		PollEntry& entry = it->second;
+		int32 period = GetPeriod( entry );
+		if( m_bIntervalBetweenPolls )
+		{
+			// Leave the interval between consecutive polls
+			int32 gap = (int32)( now - m_lastPoll );
+			int32 interval = ( m_interval < 100 ) ? m_interval * 1000 : m_interval;
+			if( gap < interval )
+			{
+				return( interval - gap );
+			}
+		}
+
+		if( entry.m_reported && ( (int32)( now - entry.m_lastReport ) < period ) )
+		{
+			// The node has told us the value recently, so there is no need to ask for it
+			entry.m_reported = false;
+			Schedule( item.m_valueId, entry, entry.m_lastReport + (uint32)period + Jitter( entry ) );
+			++m_stats.m_skipped;
+			continue;
+		}
+
+		// Poll this value, along with any others of the same node and command class
+		// that are nearly due.  Values that will be reported by the same Get are then
+		// requested together.
+		uint32 late = (uint32)( -wait );
+		m_stats.m_lateLast = late;
+		m_lateTotal += late;
+		if( late > m_stats.m_lateMax )
+		{
+			m_stats.m_lateMax = late;
+		}
+
+		ValueID valueId = item.m_valueId;
+		uint8 nodeId = valueId.GetNodeId();
+		uint8 commandClassId = valueId.GetCommandClassId();
+		for( map<ValueID,PollEntry>::iterator nit = m_entries.lower_bound( ValueID( valueId.GetHomeId(), nodeId ) ); nit != m_entries.end(); ++nit )
+		{
+			if( ( nit->first.GetHomeId() != valueId.GetHomeId() ) || ( nit->first.GetNodeId() != nodeId ) )
+			{
+				break;
+			}
+			if( nit->first.GetCommandClassId() != commandClassId )
+			{
+				continue;
+			}
+
+			PollEntry& other = nit->second;
+			int32 otherPeriod = GetPeriod( other );
+			if( nit->first != valueId )
+			{
+				if( (int32)( other.m_due - now ) > ( otherPeriod / (int32)c_coalesceFraction ) )
+				{
+					continue;
+				}
+				++m_stats.m_coalesced;
+			}
+
+			_valueIds.push_back( nit->first );
+			other.m_pending = true;
+			other.m_reported = false;
+
+			// Keep to the schedule, unless we have fallen more than a period behind
+			uint32 due = other.m_due + (uint32)otherPeriod;
+			if( (int32)( due - now ) < 0 )
+			{
+				due = now + (uint32)otherPeriod;
+			}
+			Schedule( nit->first, other, due + Jitter( other ) );
+			++m_stats.m_polls;
+		}
+
+		m_lastPoll = now;
+		return 0;
+	}
+
+	// Nothing is being polled
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::GetStatistics>
+// Retrieve the scheduler statistics
+//-----------------------------------------------------------------------------
+void PollScheduler::GetStatistics
+(
+	PollData* _data
+)
+{
+	LockGuard LG( m_mutex );
+	*_data = m_stats;
+	_data->m_entries = (uint32)m_entries.size();
+	_data->m_lateAvg = m_stats.m_polls ? (uint32)( m_lateTotal / m_stats.m_polls ) : 0;
+
+	_data->m_backlog = 0;
+	uint32 now = Now();
+	for( map<ValueID,PollEntry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+	{
+		if( (int32)( it->second.m_due - now ) <= 0 )
+		{
+			++_data->m_backlog;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::GetPeriod>
+// Get the time between polls of a value.  Must be called with m_mutex held.
+//-----------------------------------------------------------------------------
+int32 PollScheduler::GetPeriod
+(
+	PollEntry const& _entry
+)
+{
+	if( _entry.m_period > 0 )
+	{
+		return _entry.m_period;
+	}
+
+	int32 interval = ( m_interval < 100 ) ? m_interval * 1000 : m_interval;
+	int32 period = interval * ( _entry.m_intensity ? _entry.m_intensity : 1 );
+	if( m_bIntervalBetweenPolls )
+	{
+		// Each value waits for every other value to be polled first
+		period *= (int32)( m_entries.empty() ? 1 : m_entries.size() );
+	}
+	return period;
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Schedule>
+// Set the time at which a value is next due.  Must be called with m_mutex held.
+//-----------------------------------------------------------------------------
+void PollScheduler::Schedule
+(
+	ValueID const& _valueId,
+	PollEntry& _entry,
+	uint32 const _due
+)
+{
+	_entry.m_due = _due;
+	++_entry.m_generation;
+
+	m_heap.push_back( HeapItem( _due, _entry.m_generation, _valueId ) );
+	push_heap( m_heap.begin(), m_heap.end(), HeapCompare() );
+
+	// Discard the stale items if they start to dominate the heap
+	if( m_heap.size() > 64 && m_heap.size() > 4 * m_entries.size() )
+	{
+		vector<HeapItem> heap;
+		heap.reserve( m_entries.size() * 2 );
+		for( vector<HeapItem>::iterator it = m_heap.begin(); it != m_heap.end(); ++it )
+		{
+			map<ValueID,PollEntry>::iterator eit = m_entries.find( it->m_valueId );
+			if( ( eit != m_entries.end() ) && ( eit->second.m_generation == it->m_generation ) )
+			{
+				heap.push_back( *it );
+			}
+		}
+		make_heap( heap.begin(), heap.end(), HeapCompare() );
+		m_heap.swap( heap );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <PollScheduler::Jitter>
+// Get a random delay to add to a period.  Must be called with m_mutex held.
+//-----------------------------------------------------------------------------
+uint32 PollScheduler::Jitter
+(
+	PollEntry const& _entry
+)
+{
+	if( _entry.m_jitter <= 0 )
+	{
+		return 0;
+	}
+
+	m_seed = m_seed * 1103515245 + 12345;
+	return( ( m_seed >> 8 ) % (uint32)( _entry.m_jitter + 1 ) );
+}
@@ -0,0 +1,220 @@
+//-----------------------------------------------------------------------------
+//
+//	PollScheduler.h
+//
+//	Schedules the polling of values, each with its own period
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _PollScheduler_H
+#define _PollScheduler_H
+
+#include <map>
+#include <list>
+#include <vector>
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Mutex;
+
+	/** \brief Decides when each polled value is next due to be polled.
+	 *
+	 *  Every value has its own period.  By default this is derived from the
+	 *  driver's poll interval and the value's poll intensity, but it can be
+	 *  set explicitly, together with a random jitter that is added to each
+	 *  period.  Due times are kept in a min-heap, so the poll thread can sleep
+	 *  until the next poll is due rather than walking the whole poll list.
+	 *
+	 *  When a poll falls due, any other values of the same node and command
+	 *  class that are nearly due are polled along with it.  A poll is skipped
+	 *  if the node reported the value by itself within the value's period.
+	 */
+	class PollScheduler
+	{
+	public:
+		/**
+		 * Poll scheduler statistics.
+		 * Lateness is the time between a poll falling due and it being issued.
+		 */
+		struct PollData
+		{
+			uint32 m_entries;			// Number of values being polled
+			uint32 m_backlog;			// Number of values whose poll is overdue
+			uint32 m_polls;				// Number of values polled
+			uint32 m_coalesced;			// Number of values polled early, along with another value of the same command class
+			uint32 m_skipped;			// Number of polls skipped because the node had reported the value recently
+			uint32 m_lateLast;			// Lateness of the most recent poll in milliseconds
+			uint32 m_lateAvg;			// Average lateness in milliseconds
+			uint32 m_lateMax;			// Largest lateness in milliseconds
+		};
+
+		PollScheduler();
+		~PollScheduler();
+
+		/**
+		 * Start polling a value.
+		 * The first poll is spread over the value's period, so that values
+		 * added together are not all polled together.
+		 * \param _valueId the value to poll.
+		 * \param _intensity the number of poll intervals between polls of the value.
+		 * \return false if the value was already being polled.
+		 */
+		bool Add( ValueID const& _valueId, uint8 const _intensity );
+
+		/**
+		 * Stop polling a value.
+		 * \return false if the value was not being polled.
+		 */
+		bool Remove( ValueID const& _valueId );
+
+		/**
+		 * Determine whether a value is being polled.
+		 */
+		bool Contains( ValueID const& _valueId );
+
+		/**
+		 * Get the number of values being polled.
+		 */
+		uint32 Size();
+
+		/**
+		 * Change the poll intensity of a value.
+		 * This only affects values that do not have an explicit period.
+		 */
+		void SetIntensity( ValueID const& _valueId, uint8 const _intensity );
+
+		/**
+		 * Give a value its own poll period.
+		 * \param _valueId the value.
+		 * \param _period milliseconds between polls, or zero to go back to using the poll interval and intensity.
+		 * \param _jitter up to this many milliseconds are added at random to each period.
+		 * \return false if the value is not being polled.
+		 */
+		bool SetPeriod( ValueID const& _valueId, int32 const _period, int32 const _jitter );
+
+		/**
+		 * Set the driver's poll interval, from which the default periods are derived.
+		 * \param _interval the poll interval in milliseconds.  Values under 100 are taken to be in seconds.
+		 * \param _bIntervalBetweenPolls if true, the interval is the gap between consecutive polls.
+		 * If false, every value is polled once per interval (multiplied by its intensity).
+		 */
+		void SetInterval( int32 const _interval, bool const _bIntervalBetweenPolls );
+
+		/**
+		 * Record that a node has reported a polled value.
+		 * Reports that arrive while a poll of the value is outstanding are taken to be the
+		 * reply to that poll.  Other reports postpone the next poll of the value.
+		 */
+		void Refreshed( ValueID const& _valueId );
+
+		/**
+		 * Record that the polls of a node's values will not be answered, because
+		 * the poll was dropped or could not be sent.  Reports that arrive later are
+		 * then not mistaken for replies to those polls.
+		 */
+		void Unanswered( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * Record that the poll of a single value will not be answered, because no
+		 * request for it could be queued.
+		 */
+		void Unanswered( ValueID const& _valueId );
+
+		/**
+		 * Get the values that should be polled now.
+		 * \param _valueIds receives the values to poll.  They all belong to the same node
+		 * and command class.
+		 * \return zero if values were returned, otherwise the number of milliseconds until
+		 * the next poll is due, or -1 if nothing is being polled.
+		 */
+		int32 GetDuePolls( list<ValueID>& _valueIds );
+
+		/**
+		 * Get an event that is set whenever a value is added or its period changes,
+		 * so that a thread waiting for the next poll can recalculate its timeout.
+		 */
+		Event* GetEvent(){ return m_event; }
+
+		/**
+		 * Retrieve the scheduler statistics.
+		 */
+		void GetStatistics( PollData* _data );
+
+	private:
+		PollScheduler( PollScheduler const& );					// prevent copy
+		PollScheduler& operator = ( PollScheduler const& );		// prevent assignment
+
+		struct PollEntry
+		{
+			uint8	m_intensity;
+			int32	m_period;				// Explicit period, or zero to derive it from the interval and intensity
+			int32	m_jitter;
+			uint32	m_due;					// Time at which the value is next due, relative to m_start
+			uint32	m_generation;			// Incremented whenever m_due changes, to invalidate stale heap items
+			uint32	m_lastReport;			// Time of the last report that was not a reply to a poll
+			bool	m_reported;				// m_lastReport is valid
+			bool	m_pending;				// A poll has been issued and no reply has been seen yet
+		};
+
+		struct HeapItem
+		{
+			HeapItem( uint32 const _due, uint32 const _generation, ValueID const& _valueId ): m_due( _due ), m_generation( _generation ), m_valueId( _valueId ){}
+
+			uint32	m_due;
+			uint32	m_generation;
+			ValueID	m_valueId;
+		};
+
+		struct HeapCompare
+		{
+			// Orders the heap so that the earliest due time is at the front
+			bool operator()( HeapItem const& _a, HeapItem const& _b )const{ return( (int32)( _a.m_due - _b.m_due ) > 0 ); }
+		};
+
+		uint32 Now(){ return (uint32)( -m_start.TimeRemaining() ); }
+		int32 GetPeriod( PollEntry const& _entry );
+		void Schedule( ValueID const& _valueId, PollEntry& _entry, uint32 const _due );
+		uint32 Jitter( PollEntry const& _entry );
+
+		Mutex*						m_mutex;			// Protects everything below.  Never held while calling out of the scheduler.
+		Event*						m_event;
+		TimeStamp					m_start;
+
+		map<ValueID,PollEntry>		m_entries;
+		vector<HeapItem>			m_heap;				// Min-heap of due times.  Items whose generation is stale are discarded when they reach the front.
+
+		int32						m_interval;
+		bool						m_bIntervalBetweenPolls;
+		uint32						m_lastPoll;
+		uint32						m_seed;
+
+		PollData					m_stats;
+		uint64						m_lateTotal;
+	};
+
+} // namespace OpenZWave
+
+#endif //_PollScheduler_H
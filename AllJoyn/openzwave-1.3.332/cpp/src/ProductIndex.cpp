@@ -0,0 +1,510 @@
+//-----------------------------------------------------------------------------
+//
+//	ProductIndex.cpp
+//
+//	Compiled, memory-mapped index of the manufacturer and product database
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "ProductIndex.h"
+#include "XmlTagReader.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+static char const c_magic[4] = { 'O', 'Z', 'W', 'P' };
+static uint32 const c_noString = 0xffffffff;
+
+//-----------------------------------------------------------------------------
+// <ProductKey>
+// Sort key of a product
+//-----------------------------------------------------------------------------
+static uint64 ProductKey
+(
+	uint16 const _manufacturerId,
+	uint16 const _productType,
+	uint16 const _productId
+)
+{
+	return( (((uint64)_manufacturerId)<<32) | (((uint64)_productType)<<16) | (uint64)_productId );
+}
+
+//-----------------------------------------------------------------------------
+// <AddString>
+// Get the offset of a string in the string data, adding it if necessary
+//-----------------------------------------------------------------------------
+static uint32 AddString
+(
+	map<string,uint32>* _index,
+	string* _data,
+	string const& _str
+)
+{
+	map<string,uint32>::iterator it = _index->find( _str );
+	if( it != _index->end() )
+	{
+		return it->second;
+	}
+	uint32 offset = (uint32)_data->size();
+	_data->append( _str.c_str(), _str.size()+1 );
+	(*_index)[_str] = offset;
+	return offset;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::ProductIndex>
+// Constructor
+//-----------------------------------------------------------------------------
+ProductIndex::ProductIndex
+(
+):
+	m_mapped( NULL ),
+	m_mappedSize( 0 ),
+	m_header( NULL ),
+	m_manufacturers( NULL ),
+	m_products( NULL ),
+	m_strings( NULL )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::~ProductIndex>
+// Destructor
+//-----------------------------------------------------------------------------
+ProductIndex::~ProductIndex
+(
+)
+{
+	if( m_mapped != NULL )
+	{
+		FileOps::UnmapFile( m_mapped, m_mappedSize );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Open>
+// Map a compiled index
+//-----------------------------------------------------------------------------
+ProductIndex* ProductIndex::Open
+(
+	string const& _indexFile,
+	string const& _xmlFile
+)
+{
+	uint32 size = 0;
+	uint8 const* data = (uint8 const*)FileOps::MapFile( _indexFile, &size );
+	if( data == NULL )
+	{
+		return NULL;
+	}
+
+	uint32 xmlLength;
+	uint32 xmlHash;
+	Header const* header = (Header const*)data;
+	if( ( size >= sizeof(Header) ) && HashFile( _xmlFile, &xmlLength, &xmlHash )
+	 && ( ( header->m_xmlLength != xmlLength ) || ( header->m_xmlHash != xmlHash ) ) )
+	{
+		Log::Write( LogLevel_Info, "Product index %s does not match %s", _indexFile.c_str(), _xmlFile.c_str() );
+		FileOps::UnmapFile( data, size );
+		return NULL;
+	}
+
+	ProductIndex* index = new ProductIndex();
+	index->m_mapped = data;
+	index->m_mappedSize = size;
+	if( !index->Attach( data, size ) )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Product index %s is damaged or from another version", _indexFile.c_str() );
+		delete index;
+		return NULL;
+	}
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Create>
+// Compile an XML product database, and save the index
+//-----------------------------------------------------------------------------
+ProductIndex* ProductIndex::Create
+(
+	string const& _xmlFile,
+	string const& _indexFile
+)
+{
+	ProductIndex* index = new ProductIndex();
+	if( !Compile( _xmlFile, &index->m_image ) || !index->Attach( &index->m_image[0], (uint32)index->m_image.size() ) )
+	{
+		delete index;
+		return NULL;
+	}
+
+	if( !_indexFile.empty() )
+	{
+		// A partly written file fails the checksum, so it is written in place
+		FILE* fp = fopen( _indexFile.c_str(), "wb" );
+		bool res = ( fp != NULL ) && ( fwrite( &index->m_image[0], index->m_image.size(), 1, fp ) == 1 );
+		if( fp != NULL )
+		{
+			res = ( fclose( fp ) == 0 ) && res;
+		}
+		if( !res )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Unable to write product index %s", _indexFile.c_str() );
+			remove( _indexFile.c_str() );
+		}
+	}
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetManufacturerName>
+// Binary search for a manufacturer
+//-----------------------------------------------------------------------------
+char const* ProductIndex::GetManufacturerName
+(
+	uint16 const _manufacturerId
+)const
+{
+	uint32 low = 0;
+	uint32 high = m_header->m_manufacturerCount;
+	while( low < high )
+	{
+		uint32 mid = ( low + high ) / 2;
+		if( m_manufacturers[mid].m_id < _manufacturerId )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	if( ( low < m_header->m_manufacturerCount ) && ( m_manufacturers[low].m_id == _manufacturerId ) )
+	{
+		return &m_strings[m_manufacturers[low].m_name];
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetProduct>
+// Binary search for a product
+//-----------------------------------------------------------------------------
+bool ProductIndex::GetProduct
+(
+	uint16 const _manufacturerId,
+	uint16 const _productType,
+	uint16 const _productId,
+	char const** o_name,
+	char const** o_config
+)const
+{
+	uint64 const key = ProductKey( _manufacturerId, _productType, _productId );
+	uint32 low = 0;
+	uint32 high = m_header->m_productCount;
+	while( low < high )
+	{
+		uint32 mid = ( low + high ) / 2;
+		ProductRecord const& product = m_products[mid];
+		if( ProductKey( product.m_manufacturerId, product.m_productType, product.m_productId ) < key )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	if( low == m_header->m_productCount )
+	{
+		return false;
+	}
+
+	ProductRecord const& product = m_products[low];
+	if( ProductKey( product.m_manufacturerId, product.m_productType, product.m_productId ) != key )
+	{
+		return false;
+	}
+	*o_name = &m_strings[product.m_name];
+	*o_config = ( product.m_config == c_noString ) ? "" : &m_strings[product.m_config];
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Attach>
+// Check an index image and point the tables into it
+//-----------------------------------------------------------------------------
+bool ProductIndex::Attach
+(
+	uint8 const* _data,
+	uint32 const _size
+)
+{
+	Header const* header = (Header const*)_data;
+	if( ( _size < sizeof(Header) )
+	 || memcmp( header->m_magic, c_magic, sizeof(c_magic) )
+	 || ( header->m_byteOrder != c_byteOrder )
+	 || ( header->m_formatVersion != c_formatVersion ) )
+	{
+		return false;
+	}
+
+	uint64 const expected = (uint64)sizeof(Header)
+						  + (uint64)header->m_manufacturerCount * sizeof(ManufacturerRecord)
+						  + (uint64)header->m_productCount * sizeof(ProductRecord)
+						  + (uint64)header->m_stringBytes;
+	if( ( expected != (uint64)_size ) || ( Hash( _data + sizeof(Header), _size - (uint32)sizeof(Header) ) != header->m_checksum ) )
+	{
+		return false;
+	}
+
+	ManufacturerRecord const* manufacturers = (ManufacturerRecord const*)( _data + sizeof(Header) );
+	ProductRecord const* products = (ProductRecord const*)( manufacturers + header->m_manufacturerCount );
+	char const* strings = (char const*)( products + header->m_productCount );
+
+	// Every string must start inside the string data, which must end with a terminator
+	uint32 const stringBytes = header->m_stringBytes;
+	if( ( stringBytes == 0 ) || ( strings[stringBytes-1] != 0 ) )
+	{
+		return false;
+	}
+	for( uint32 i=0; i<header->m_manufacturerCount; ++i )
+	{
+		if( manufacturers[i].m_name >= stringBytes )
+		{
+			return false;
+		}
+	}
+	for( uint32 i=0; i<header->m_productCount; ++i )
+	{
+		if( ( products[i].m_name >= stringBytes ) || ( ( products[i].m_config != c_noString ) && ( products[i].m_config >= stringBytes ) ) )
+		{
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_manufacturers = manufacturers;
+	m_products = products;
+	m_strings = strings;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Compile>
+// Build an index image from an XML product database
+//-----------------------------------------------------------------------------
+bool ProductIndex::Compile
+(
+	string const& _xmlFile,
+	vector<uint8>* o_image
+)
+{
+	Header header;
+	if( !HashFile( _xmlFile, &header.m_xmlLength, &header.m_xmlHash ) )
+	{
+		Log::Write( LogLevel_Info, "Unable to load %s", _xmlFile.c_str() );
+		return false;
+	}
+
+	// The file is large, and only the attributes are needed, so it is read
+	// a tag at a time rather than into a document
+	XmlTagReader reader;
+	if( !reader.Open( _xmlFile ) )
+	{
+		Log::Write( LogLevel_Info, "Unable to load %s", _xmlFile.c_str() );
+		return false;
+	}
+
+	map<string,uint32> stringIndex;
+	string strings;
+	map<uint16,uint32> manufacturers;						// Name of each manufacturer
+	map<uint64,ProductRecord> products;
+
+	char const* str;
+	char* pStopChar;
+	bool inManufacturer = false;
+	uint16 manufacturerId = 0;
+
+	while( reader.NextElement() )
+	{
+		if( reader.GetDepth() == 1 )
+		{
+			inManufacturer = ( reader.GetName() == "Manufacturer" );
+			if( !inManufacturer )
+			{
+				continue;
+			}
+
+			// Read in the manufacturer attributes
+			str = reader.Attribute( "id" );
+			if( !str )
+			{
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer id attribute", reader.Row() );
+				return false;
+			}
+			manufacturerId = (uint16)strtol( str, &pStopChar, 16 );
+
+			str = reader.Attribute( "name" );
+			if( !str )
+			{
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer name attribute", reader.Row() );
+				return false;
+			}
+
+			// Add this manufacturer to the index
+			manufacturers[manufacturerId] = AddString( &stringIndex, &strings, str );
+		}
+		else if( inManufacturer && ( reader.GetDepth() == 2 ) && ( reader.GetName() == "Product" ) )
+		{
+			str = reader.Attribute( "type" );
+			if( !str )
+			{
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product type attribute", reader.Row() );
+				return false;
+			}
+			uint16 productType = (uint16)strtol( str, &pStopChar, 16 );
+
+			str = reader.Attribute( "id" );
+			if( !str )
+			{
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product id attribute", reader.Row() );
+				return false;
+			}
+			uint16 productId = (uint16)strtol( str, &pStopChar, 16 );
+
+			str = reader.Attribute( "name" );
+			if( !str )
+			{
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product name attribute", reader.Row() );
+				return false;
+			}
+			string productName = str;
+
+			uint64 key = ProductKey( manufacturerId, productType, productId );
+			map<uint64,ProductRecord>::iterator pit = products.find( key );
+			if( pit != products.end() )
+			{
+				Log::Write( LogLevel_Info, "Product name collision: %s type %x id %x manufacturerid %x, collides with %s, type %x id %x manufacturerid %x", productName.c_str(), productType, productId, manufacturerId, &strings[pit->second.m_name], productType, productId, manufacturerId );
+				continue;
+			}
+
+			// Add the product to the index, with its optional config path
+			ProductRecord& product = products[key];
+			product.m_manufacturerId = manufacturerId;
+			product.m_productType = productType;
+			product.m_productId = productId;
+			product.m_reserved = 0;
+			product.m_name = AddString( &stringIndex, &strings, productName );
+			str = reader.Attribute( "config" );
+			product.m_config = str ? AddString( &stringIndex, &strings, str ) : c_noString;
+		}
+	}
+
+	if( reader.IsError() )
+	{
+		Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml near line %d - malformed XML", reader.Row() );
+		return false;
+	}
+	if( strings.empty() )
+	{
+		strings.push_back( 0 );
+	}
+
+	// Lay out the header, the manufacturers, the products and then the strings
+	uint32 const manufacturersSize = (uint32)( manufacturers.size() * sizeof(ManufacturerRecord) );
+	uint32 const productsSize = (uint32)( products.size() * sizeof(ProductRecord) );
+	o_image->assign( sizeof(Header) + manufacturersSize + productsSize + strings.size(), 0 );
+	uint8* body = &(*o_image)[sizeof(Header)];
+
+	ManufacturerRecord* manufacturerRecords = (ManufacturerRecord*)body;
+	for( map<uint16,uint32>::iterator mit = manufacturers.begin(); mit != manufacturers.end(); ++mit, ++manufacturerRecords )
+	{
+		manufacturerRecords->m_id = mit->first;
+		manufacturerRecords->m_reserved = 0;
+		manufacturerRecords->m_name = mit->second;
+	}
+	ProductRecord* productRecords = (ProductRecord*)manufacturerRecords;
+	for( map<uint64,ProductRecord>::iterator pit = products.begin(); pit != products.end(); ++pit, ++productRecords )
+	{
+		*productRecords = pit->second;
+	}
+	memcpy( productRecords, strings.data(), strings.size() );
+
+	memcpy( header.m_magic, c_magic, sizeof(c_magic) );
+	header.m_byteOrder = c_byteOrder;
+	header.m_formatVersion = c_formatVersion;
+	header.m_manufacturerCount = (uint32)manufacturers.size();
+	header.m_productCount = (uint32)products.size();
+	header.m_stringBytes = (uint32)strings.size();
+	header.m_checksum = Hash( body, (uint32)( o_image->size() - sizeof(Header) ) );
+	memcpy( &(*o_image)[0], &header, sizeof(Header) );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Hash>
+// FNV-1a hash of a block of memory
+//-----------------------------------------------------------------------------
+uint32 ProductIndex::Hash
+(
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	uint32 hash = 2166136261u;
+	for( uint32 i=0; i<_length; ++i )
+	{
+		hash ^= _data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::HashFile>
+// Get the length and hash of a file
+//-----------------------------------------------------------------------------
+bool ProductIndex::HashFile
+(
+	string const& _fileName,
+	uint32* o_length,
+	uint32* o_hash
+)
+{
+	uint32 size = 0;
+	uint8 const* data = (uint8 const*)FileOps::MapFile( _fileName, &size );
+	if( data == NULL )
+	{
+		return false;
+	}
+
+	*o_length = size;
+	*o_hash = Hash( data, size );
+	FileOps::UnmapFile( data, size );
+	return true;
+}
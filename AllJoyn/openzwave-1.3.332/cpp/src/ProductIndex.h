@@ -0,0 +1,146 @@
+//-----------------------------------------------------------------------------
+//
+//	ProductIndex.h
+//
+//	Compiled, memory-mapped index of the manufacturer and product database
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ProductIndex_H
+#define _ProductIndex_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief Compiled index of the manufacturer and product database.
+	 *
+	 * manufacturer_specific.xml is compiled into a binary file that holds
+	 * the manufacturers and the products, each sorted by id, and a table of
+	 * the names and config paths they refer to.  The file is memory-mapped
+	 * and searched in place, so the database costs neither a parse nor heap
+	 * strings at startup.
+	 *
+	 * The index records the length and a hash of the XML file it was compiled
+	 * from.  If that XML file is present and differs, the index is not used,
+	 * so an edited or user-supplied XML file always takes effect.  An index
+	 * can also be shipped without the XML file, for devices that do not need
+	 * to override it.
+	 */
+	class ProductIndex
+	{
+	public:
+		/**
+		 * Map a compiled index.
+		 * \param _indexFile Name of the index file.
+		 * \param _xmlFile Name of the XML file the index should match.  If that file
+		 * does not exist, the index is used as it is.
+		 * \return the index, or NULL if it is missing, damaged or out of date.
+		 */
+		static ProductIndex* Open( string const& _indexFile, string const& _xmlFile );
+
+		/**
+		 * Compile an XML product database.  This is also the build step that
+		 * produces an index to ship with the config files.
+		 * \param _xmlFile Name of the XML file.
+		 * \param _indexFile Name of the index file to write, or empty to not write one.
+		 * \return the index, held in memory, or NULL if the XML file could not be read.
+		 */
+		static ProductIndex* Create( string const& _xmlFile, string const& _indexFile );
+
+		~ProductIndex();
+
+		/**
+		 * The name of a manufacturer, or NULL if it is not in the database.
+		 */
+		char const* GetManufacturerName( uint16 const _manufacturerId )const;
+
+		/**
+		 * Look up a product.
+		 * \param o_name receives the product name.
+		 * \param o_config receives the path of the product's config file, which is empty if it has none.
+		 * \return false if the product is not in the database.
+		 */
+		bool GetProduct( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, char const** o_name, char const** o_config )const;
+
+		uint32 GetManufacturerCount()const{ return m_header->m_manufacturerCount; }
+		uint32 GetProductCount()const{ return m_header->m_productCount; }
+
+	private:
+		struct Header
+		{
+			char	m_magic[4];
+			uint32	m_byteOrder;				// Written as c_byteOrder, to reject an index from a machine of different endianness
+			uint32	m_formatVersion;
+			uint32	m_xmlLength;				// Length of the XML file the index was compiled from
+			uint32	m_xmlHash;					// Hash of the XML file the index was compiled from
+			uint32	m_manufacturerCount;
+			uint32	m_productCount;
+			uint32	m_stringBytes;
+			uint32	m_checksum;					// Hash of everything after the header
+		};
+
+		// Sorted by id
+		struct ManufacturerRecord
+		{
+			uint16	m_id;
+			uint16	m_reserved;
+			uint32	m_name;						// Offset into the string data
+		};
+
+		// Sorted by manufacturer id, product type and product id
+		struct ProductRecord
+		{
+			uint16	m_manufacturerId;
+			uint16	m_productType;
+			uint16	m_productId;
+			uint16	m_reserved;
+			uint32	m_name;
+			uint32	m_config;
+		};
+
+		ProductIndex();
+		ProductIndex( ProductIndex const& );					// prevent copy
+		ProductIndex& operator = ( ProductIndex const& );		// prevent assignment
+
+		bool Attach( uint8 const* _data, uint32 const _size );	// Check an index image and point the tables into it
+		static bool Compile( string const& _xmlFile, vector<uint8>* o_image );
+		static uint32 Hash( uint8 const* _data, uint32 const _length );
+		static bool HashFile( string const& _fileName, uint32* o_length, uint32* o_hash );
+
+		uint8 const*				m_mapped;				// Mapped index file, or NULL if the index is in m_image
+		uint32						m_mappedSize;
+		vector<uint8>				m_image;
+		Header const*				m_header;
+		ManufacturerRecord const*	m_manufacturers;
+		ProductRecord const*		m_products;
+		char const*					m_strings;
+
+		static uint32 const c_byteOrder = 0x01020304;
+		static uint32 const c_formatVersion = 1;
+	};
+
+} // namespace OpenZWave
+
+#endif //_ProductIndex_H
@@ -463,19 +463,19 @@ bool Scene::SetValue
 
 //-----------------------------------------------------------------------------
 // <Scene::Activate>
-// Execute scene activation by running each ValueId/value
+// Execute scene activation by setting every ValueId/value as one batch, so
+// that nodes given the same value are sent a single multicast command
 //-----------------------------------------------------------------------------
 bool Scene::Activate
 (
 )
 {
-	bool res = true;
+	vector<ValueID> ids;
+	vector<string> values;
 	for( vector<SceneStorage*>::iterator it = m_values.begin(); it != m_values.end(); ++it )
 	{
-		if ( !Manager::Get()->SetValue( (*it)->m_id, (*it)->m_value ) )
-		{
-			res = false;
-		}
+		ids.push_back( (*it)->m_id );
+		values.push_back( (*it)->m_value );
 	}
-	return res;
+	return Manager::Get()->SetValue( ids, values );
 }
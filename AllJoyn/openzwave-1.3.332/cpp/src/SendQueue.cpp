@@ -0,0 +1,582 @@
+//-----------------------------------------------------------------------------
+//
+//	SendQueue.cpp
+//
+//	One priority level of the driver's message queues
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "SendQueue.h"
+#include "Msg.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <SendQueue::SendQueue>
+// Constructor
+//-----------------------------------------------------------------------------
+SendQueue::SendQueue
+(
+	bool const _fair,
+	Merge const _merge
+):
+	m_fair( _fair ),
+	m_merge( _merge ),
+	m_size( 0 ),
+	m_queues( _fair ? 256 : 1 ),
+	m_deficit( _fair ? 256 : 1, 0 ),
+	m_indexed( 0 )
+{
+	if( Merge_None != m_merge )
+	{
+		Slot empty;
+		empty.m_used = false;
+		empty.m_hash = 0;
+		empty.m_key = 0;
+		m_index.resize( 16, empty );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::~SendQueue>
+// Destructor.  The owner deletes the messages of any items still queued.
+//-----------------------------------------------------------------------------
+SendQueue::~SendQueue
+(
+)
+{
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Front>
+// The item that is to be sent next
+//-----------------------------------------------------------------------------
+Driver::MsgQueueItem& SendQueue::Front
+(
+)
+{
+	return m_queues[m_active.front()].front().m_item;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::PopFront>
+// Remove the item that is to be sent next, and charge its node for it
+//-----------------------------------------------------------------------------
+void SendQueue::PopFront
+(
+)
+{
+	uint8 key = m_active.front();
+	if( m_fair )
+	{
+		m_deficit[key] -= 1;
+	}
+	Erase( key, m_queues[key].begin() );
+	if( m_fair )
+	{
+		if( !m_queues[key].empty() && m_deficit[key] <= 0 )
+		{
+			// Its turn is over
+			m_active.splice( m_active.end(), m_active, m_active.begin() );
+		}
+		Advance();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::PushBack>
+// Add an item to the back of its node's queue, replacing an identical item
+//-----------------------------------------------------------------------------
+bool SendQueue::PushBack
+(
+	Driver::MsgQueueItem const& _item
+)
+{
+	uint8 key = GetKey( GetNodeId( _item ) );
+	list<Entry>& queue = m_queues[key];
+
+	uint32 hash = 0;
+	bool indexed = GetHash( _item, &hash );
+	if( indexed && ( Merge_All == m_merge || Driver::MsgQueueCmd_SendMsg == _item.m_command ) )
+	{
+		uint32 slot = FindSlot( _item, hash );
+		if( slot != c_noSlot )
+		{
+			list<Entry>::iterator it = m_index[slot].m_it;
+			Log::Write( LogLevel_Detail, GetNodeId( _item ), "Replacing an identical queued message" );
+			if( it == --queue.end() )
+			{
+				// Nothing has been queued for the node since, so the new
+				// item can simply take the place of the old one.
+				DeleteItem( it->m_item );
+				it->m_item = _item;
+				return false;
+			}
+
+			// Otherwise the new item goes to the back, after the items that
+			// were queued since, as they would have been sent before it.
+			DeleteItem( it->m_item );
+			Erase( key, it );
+			PushBack( _item );
+			return false;
+		}
+	}
+
+	Entry entry;
+	entry.m_item = _item;
+	entry.m_hash = hash;
+	entry.m_indexed = false;
+	if( m_spare.empty() )
+	{
+		queue.push_back( entry );
+	}
+	else
+	{
+		queue.splice( queue.end(), m_spare, m_spare.begin() );
+		queue.back() = entry;
+	}
+	++m_size;
+
+	if( indexed )
+	{
+		Index( key, --queue.end() );
+	}
+
+	if( queue.size() == 1 )
+	{
+		// The node joins the round-robin order
+		m_active.push_back( key );
+		if( m_fair )
+		{
+			Advance();
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::NodeFront>
+// The next item queued for a node
+//-----------------------------------------------------------------------------
+Driver::MsgQueueItem* SendQueue::NodeFront
+(
+	uint8 const _nodeId
+)
+{
+	list<Entry>& queue = m_queues[GetKey( _nodeId )];
+	if( queue.empty() || GetNodeId( queue.front().m_item ) != _nodeId )
+	{
+		return NULL;
+	}
+	return &queue.front().m_item;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::PopNodeFront>
+// Remove the next item queued for a node, without charging the node for it
+//-----------------------------------------------------------------------------
+void SendQueue::PopNodeFront
+(
+	uint8 const _nodeId
+)
+{
+	uint8 key = GetKey( _nodeId );
+	Erase( key, m_queues[key].begin() );
+	if( m_fair )
+	{
+		Advance();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Find>
+// Find a queued item identical to _item
+//-----------------------------------------------------------------------------
+Driver::MsgQueueItem* SendQueue::Find
+(
+	Driver::MsgQueueItem const& _item
+)
+{
+	uint32 hash;
+	if( GetHash( _item, &hash ) )
+	{
+		uint32 slot = FindSlot( _item, hash );
+		if( slot != c_noSlot )
+		{
+			return &m_index[slot].m_it->m_item;
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Extract>
+// Remove all the items for a node
+//-----------------------------------------------------------------------------
+void SendQueue::Extract
+(
+	uint8 const _nodeId,
+	list<Driver::MsgQueueItem>* o_items,
+	Driver::ControllerCommandItem const* _keep
+)
+{
+	uint8 key = GetKey( _nodeId );
+	list<Entry>& queue = m_queues[key];
+	list<Entry>::iterator it = queue.begin();
+	while( it != queue.end() )
+	{
+		Driver::MsgQueueItem const& item = it->m_item;
+		if( GetNodeId( item ) == _nodeId && ( _keep == NULL || item.m_cci != _keep ) )
+		{
+			o_items->push_back( item );
+			list<Entry>::iterator next = it;
+			++next;
+			Erase( key, it );
+			it = next;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	if( m_fair )
+	{
+		Advance();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::RemoveValueMsgs>
+// Remove and delete the messages superseded by a newer Set of the same value
+//-----------------------------------------------------------------------------
+uint32 SendQueue::RemoveValueMsgs
+(
+	Msg const* _msg
+)
+{
+	uint32 count = 0;
+	uint8 nodeId = _msg->GetTargetNodeId();
+	uint8 key = GetKey( nodeId );
+	list<Entry>& queue = m_queues[key];
+	list<Entry>::iterator it = queue.begin();
+	while( it != queue.end() )
+	{
+		Driver::MsgQueueItem const& item = it->m_item;
+		if( Driver::MsgQueueCmd_SendMsg == item.m_command && item.m_msg->GetValueKey() == _msg->GetValueKey() && item.m_msg->IsSameSet( *_msg ) && !( *item.m_msg == *_msg ) )
+		{
+			Log::Write( LogLevel_Detail, nodeId, "Removing superseded message %s", item.m_msg->GetAsString().c_str() );
+			DeleteItem( item );
+			list<Entry>::iterator next = it;
+			++next;
+			Erase( key, it );
+			it = next;
+			++count;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	if( m_fair )
+	{
+		Advance();
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Charge>
+// Charge a node for extra transmissions
+//-----------------------------------------------------------------------------
+void SendQueue::Charge
+(
+	uint8 const _nodeId,
+	int32 const _cost
+)
+{
+	if( m_fair )
+	{
+		m_deficit[_nodeId] -= _cost;
+		if( !m_active.empty() && m_active.front() == _nodeId && m_deficit[_nodeId] <= 0 )
+		{
+			m_active.splice( m_active.end(), m_active, m_active.begin() );
+			Advance();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::GetNodeId>
+// The node an item is for
+//-----------------------------------------------------------------------------
+uint8 SendQueue::GetNodeId
+(
+	Driver::MsgQueueItem const& _item
+)
+{
+	switch( _item.m_command )
+	{
+		case Driver::MsgQueueCmd_SendMsg:
+		{
+			return _item.m_msg->GetTargetNodeId();
+		}
+		case Driver::MsgQueueCmd_QueryStageComplete:
+		{
+			return _item.m_nodeId;
+		}
+		case Driver::MsgQueueCmd_Controller:
+		{
+			return _item.m_cci->m_controllerCommandNode;
+		}
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::GetHash>
+// Hash an item for the index.  Returns false if the item is not to be indexed.
+//-----------------------------------------------------------------------------
+bool SendQueue::GetHash
+(
+	Driver::MsgQueueItem const& _item,
+	uint32* o_hash
+)const
+{
+	if( Merge_None == m_merge )
+	{
+		return false;
+	}
+
+	switch( _item.m_command )
+	{
+		case Driver::MsgQueueCmd_SendMsg:
+		{
+			if( _item.m_msg->IsNoOperation() )
+			{
+				return false;
+			}
+			*o_hash = _item.m_msg->GetHash();
+			return true;
+		}
+		case Driver::MsgQueueCmd_QueryStageComplete:
+		{
+			*o_hash = ( ( (uint32)_item.m_nodeId << 8 ) | (uint32)_item.m_queryStage ) * 2654435761U;
+			return true;
+		}
+		case Driver::MsgQueueCmd_Controller:
+		{
+			*o_hash = ( 0x10000 | (uint32)_item.m_cci->m_controllerCommand ) * 2654435761U;
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::FindSlot>
+// Find the index slot of a queued item identical to _item
+//-----------------------------------------------------------------------------
+uint32 SendQueue::FindSlot
+(
+	Driver::MsgQueueItem const& _item,
+	uint32 const _hash
+)const
+{
+	uint32 mask = (uint32)m_index.size() - 1;
+	for( uint32 i = _hash & mask; m_index[i].m_used; i = ( i + 1 ) & mask )
+	{
+		if( m_index[i].m_hash == _hash && m_index[i].m_it->m_item == _item )
+		{
+			return i;
+		}
+	}
+	return c_noSlot;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Index>
+// Add an entry to the index
+//-----------------------------------------------------------------------------
+void SendQueue::Index
+(
+	uint8 const _key,
+	list<Entry>::iterator _it
+)
+{
+	if( ( m_indexed + 1 ) * 2 > m_index.size() )
+	{
+		Grow();
+	}
+
+	uint32 mask = (uint32)m_index.size() - 1;
+	uint32 i = _it->m_hash & mask;
+	while( m_index[i].m_used )
+	{
+		i = ( i + 1 ) & mask;
+	}
+	m_index[i].m_used = true;
+	m_index[i].m_hash = _it->m_hash;
+	m_index[i].m_key = _key;
+	m_index[i].m_it = _it;
+	_it->m_indexed = true;
+	++m_indexed;
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Unindex>
+// Remove an entry from the index
+//-----------------------------------------------------------------------------
+void SendQueue::Unindex
+(
+	list<Entry>::iterator _it
+)
+{
+	if( !_it->m_indexed )
+	{
+		return;
+	}
+
+	uint32 mask = (uint32)m_index.size() - 1;
+	uint32 i = _it->m_hash & mask;
+	while( !m_index[i].m_used || &*m_index[i].m_it != &*_it )
+	{
+		i = ( i + 1 ) & mask;
+	}
+	m_index[i].m_used = false;
+	_it->m_indexed = false;
+	--m_indexed;
+
+	// Move back any entries after it in the same run that no longer
+	// have an unbroken run of slots from their home slot.
+	uint32 j = ( i + 1 ) & mask;
+	while( m_index[j].m_used )
+	{
+		uint32 home = m_index[j].m_hash & mask;
+		if( ( ( j - home ) & mask ) >= ( ( j - i ) & mask ) )
+		{
+			m_index[i] = m_index[j];
+			m_index[j].m_used = false;
+			i = j;
+		}
+		j = ( j + 1 ) & mask;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Grow>
+// Double the size of the index
+//-----------------------------------------------------------------------------
+void SendQueue::Grow
+(
+)
+{
+	vector<Slot> old;
+	old.swap( m_index );
+
+	Slot empty;
+	empty.m_used = false;
+	empty.m_hash = 0;
+	empty.m_key = 0;
+	m_index.resize( old.size() * 2, empty );
+	m_indexed = 0;
+
+	for( vector<Slot>::iterator it = old.begin(); it != old.end(); ++it )
+	{
+		if( it->m_used )
+		{
+			it->m_it->m_indexed = false;
+			Index( it->m_key, it->m_it );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Erase>
+// Remove an entry.  A node whose queue is emptied leaves the round-robin order.
+//-----------------------------------------------------------------------------
+void SendQueue::Erase
+(
+	uint8 const _key,
+	list<Entry>::iterator _it
+)
+{
+	Unindex( _it );
+	m_spare.splice( m_spare.begin(), m_queues[_key], _it );
+	--m_size;
+
+	if( m_queues[_key].empty() )
+	{
+		m_active.remove( _key );
+
+		// A node keeps any debt, but does not save up unused credit
+		if( m_deficit[_key] > 0 )
+		{
+			m_deficit[_key] = 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::Advance>
+// Give nodes their turns until the node at the front has credit to send
+//-----------------------------------------------------------------------------
+void SendQueue::Advance
+(
+)
+{
+	while( !m_active.empty() )
+	{
+		uint8 key = m_active.front();
+		if( m_deficit[key] > 0 )
+		{
+			break;
+		}
+		m_deficit[key] += c_quantum;
+		if( m_deficit[key] > 0 )
+		{
+			break;
+		}
+
+		// Still repaying its debt, so it waits for the next round
+		m_active.splice( m_active.end(), m_active, m_active.begin() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendQueue::DeleteItem>
+// Delete the message or controller command of an item that is discarded
+//-----------------------------------------------------------------------------
+void SendQueue::DeleteItem
+(
+	Driver::MsgQueueItem const& _item
+)
+{
+	if( Driver::MsgQueueCmd_SendMsg == _item.m_command )
+	{
+		delete _item.m_msg;
+	}
+	else if( Driver::MsgQueueCmd_Controller == _item.m_command )
+	{
+		delete _item.m_cci;
+	}
+}
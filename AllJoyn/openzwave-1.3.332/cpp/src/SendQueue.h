@@ -0,0 +1,183 @@
+//-----------------------------------------------------------------------------
+//
+//	SendQueue.h
+//
+//	One priority level of the driver's message queues
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _SendQueue_H
+#define _SendQueue_H
+
+#include <list>
+#include <vector>
+#include "Defs.h"
+#include "Driver.h"
+
+namespace OpenZWave
+{
+	/** \brief One priority level of the driver's message queues.
+	 *
+	 *  Items are kept in a FIFO for each node, so a node always receives its
+	 *  messages in the order they were queued.  A fair queue takes items from
+	 *  the nodes in deficit round-robin order.  Each turn gives a node credit
+	 *  for one transmission.  A message that needs retries is charged for every
+	 *  attempt, so a node that is slow to respond, or not responding at all,
+	 *  waits for its debt to be repaid while the other nodes get their turns.
+	 *  A queue that is not fair is a single FIFO.
+	 *
+	 *  A merging queue finds an identical item that is already queued through
+	 *  a hash index, and replaces it with the new item, rather than sending
+	 *  both.  NoOperation messages are never merged, since they are sent in
+	 *  numbers on purpose.  Query stage markers and controller commands are
+	 *  only merged if the queue is asked to merge all items.
+	 *
+	 *  The queue does not lock itself.  It is protected by the owner's mutex.
+	 */
+	class SendQueue
+	{
+	public:
+		enum Merge
+		{
+			Merge_None = 0,						/**< Items are never merged */
+			Merge_Messages,						/**< A message replaces an identical message */
+			Merge_All							/**< Any item replaces an identical item */
+		};
+
+		/**
+		 * Constructor.
+		 * \param _fair if true, nodes take turns.  Otherwise items are taken in the order they were added.
+		 * \param _merge which items replace an identical item that is already queued.
+		 */
+		SendQueue( bool const _fair, Merge const _merge );
+		~SendQueue();
+
+		bool IsEmpty()const{ return( 0 == m_size ); }
+		uint32 Size()const{ return m_size; }
+
+		/**
+		 * The item that is to be sent next.  The queue must not be empty.
+		 */
+		Driver::MsgQueueItem& Front();
+
+		/**
+		 * Remove the item returned by Front, charging its node for one transmission.
+		 * The item's message is not deleted.
+		 */
+		void PopFront();
+
+		/**
+		 * Add an item at the back of its node's queue.  In a merging queue, an
+		 * identical item that is already queued is removed, and its message deleted.
+		 * \return false if the item replaced one that was already queued.
+		 */
+		bool PushBack( Driver::MsgQueueItem const& _item );
+
+		/**
+		 * The next item queued for a node, or NULL if there is none.
+		 */
+		Driver::MsgQueueItem* NodeFront( uint8 const _nodeId );
+
+		/**
+		 * Remove the item returned by NodeFront.  The node is not charged for it.
+		 */
+		void PopNodeFront( uint8 const _nodeId );
+
+		/**
+		 * Find a queued item that is identical to _item.  Only a queue that merges items can find them.
+		 * \return the item, or NULL if there is none.
+		 */
+		Driver::MsgQueueItem* Find( Driver::MsgQueueItem const& _item );
+
+		/**
+		 * Remove all of the items for a node, in the order they were queued.
+		 * \param _nodeId the node.
+		 * \param o_items receives the items.
+		 * \param _keep a controller command that is to be left in the queue, or NULL.
+		 */
+		void Extract( uint8 const _nodeId, list<Driver::MsgQueueItem>* o_items, Driver::ControllerCommandItem const* _keep = NULL );
+
+		/**
+		 * Remove and delete the messages that a newer message from Value::Set supersedes:
+		 * those queued by a Set of the same value, sending the same Set command with
+		 * different parameters.  An identical message is left to be merged by PushBack.
+		 * \param _msg the newer message, tagged with the value store key of its value.
+		 * \return the number of messages removed.
+		 */
+		uint32 RemoveValueMsgs( Msg const* _msg );
+
+		/**
+		 * Charge a node for transmissions beyond the one charged by PopFront, such as retries.
+		 */
+		void Charge( uint8 const _nodeId, int32 const _cost );
+
+		/**
+		 * The node an item is for.
+		 */
+		static uint8 GetNodeId( Driver::MsgQueueItem const& _item );
+
+	private:
+		SendQueue( SendQueue const& );					// prevent copy
+		SendQueue& operator = ( SendQueue const& );		// prevent assignment
+
+		struct Entry
+		{
+			Driver::MsgQueueItem	m_item;
+			uint32					m_hash;
+			bool					m_indexed;
+		};
+
+		struct Slot
+		{
+			bool					m_used;
+			uint32					m_hash;
+			uint8					m_key;
+			list<Entry>::iterator	m_it;
+		};
+
+		uint8 GetKey( uint8 const _nodeId )const{ return( m_fair ? _nodeId : 0 ); }
+		bool GetHash( Driver::MsgQueueItem const& _item, uint32* o_hash )const;		// false if the item is not to be indexed
+		uint32 FindSlot( Driver::MsgQueueItem const& _item, uint32 const _hash )const;	// Slot of an identical item, or c_noSlot
+		void Index( uint8 const _key, list<Entry>::iterator _it );
+		void Unindex( list<Entry>::iterator _it );
+		void Grow();
+		void Erase( uint8 const _key, list<Entry>::iterator _it );					// Remove an entry, and its node from the round-robin order if it has no more
+		void Advance();																// Give nodes their turns until the front node has credit
+		static void DeleteItem( Driver::MsgQueueItem const& _item );
+
+		bool					m_fair;
+		Merge					m_merge;
+		uint32					m_size;
+		vector< list<Entry> >	m_queues;						// FIFO of each node, or a single FIFO if the queue is not fair
+		list<Entry>				m_spare;						// Nodes of removed entries, spliced back in to queue new items without allocating
+		vector<int32>			m_deficit;						// Transmissions each node may make before the next node's turn
+		list<uint8>				m_active;						// Nodes with queued items, in round-robin order
+		vector<Slot>			m_index;						// Open-addressed hash index of the items
+		uint32					m_indexed;						// Number of occupied slots
+
+		static int32 const		c_quantum = 1;					// Credit given to a node at each turn
+		static uint32 const		c_noSlot = 0xffffffff;
+	};
+
+} // namespace OpenZWave
+
+#endif //_SendQueue_H
@@ -0,0 +1,525 @@
+//-----------------------------------------------------------------------------
+//
+//	Topology.cpp
+//
+//	Model of the routes through a Z-Wave network, and of their health
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "Topology.h"
+#include "Utils.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <Topology::Topology>
+// Constructor
+//-----------------------------------------------------------------------------
+Topology::Topology
+(
+):
+	m_mutex( new Mutex() ),
+	m_controller( 0 ),
+	m_hopsValid( false ),
+	m_interval( 0 ),
+	m_lastCheck( 0 )
+{
+	memset( m_present, 0, sizeof(m_present) );
+	memset( m_neighbors, 0, sizeof(m_neighbors) );
+	memset( m_links, 0, sizeof(m_links) );
+	memset( m_hops, 0, sizeof(m_hops) );
+	memset( m_records, 0, sizeof(m_records) );
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::~Topology>
+// Destructor
+//-----------------------------------------------------------------------------
+Topology::~Topology
+(
+)
+{
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::SetController>
+// Set the node from which hop counts are measured
+//-----------------------------------------------------------------------------
+void Topology::SetController
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	m_controller = _nodeId;
+	m_present[_nodeId] = true;
+	m_hopsValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::AddNode>
+// Add a node to the network
+//-----------------------------------------------------------------------------
+void Topology::AddNode
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	if( !m_present[_nodeId] )
+	{
+		m_present[_nodeId] = true;
+		m_hopsValid = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::RemoveNode>
+// Remove a node, its links and its transmission record
+//-----------------------------------------------------------------------------
+void Topology::RemoveNode
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	m_present[_nodeId] = false;
+	memset( m_neighbors[_nodeId], 0, sizeof(m_neighbors[_nodeId]) );
+	Link( _nodeId );
+	memset( &m_records[_nodeId], 0, sizeof(Record) );
+	m_hopsValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Clear>
+// Remove every node
+//-----------------------------------------------------------------------------
+void Topology::Clear
+(
+)
+{
+	LockGuard LG( m_mutex );
+	memset( m_present, 0, sizeof(m_present) );
+	memset( m_neighbors, 0, sizeof(m_neighbors) );
+	memset( m_links, 0, sizeof(m_links) );
+	memset( m_records, 0, sizeof(m_records) );
+	m_hopsValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::SetNeighbors>
+// Replace a node's neighbor list
+//-----------------------------------------------------------------------------
+bool Topology::SetNeighbors
+(
+	uint8 const _nodeId,
+	uint8 const* _neighbors
+)
+{
+	// The routing info has bit 0 of the first byte for node 1
+	uint8 neighbors[32];
+	memset( neighbors, 0, sizeof(neighbors) );
+	for( uint32 i=1; i<=232; ++i )
+	{
+		if( _neighbors[( i - 1 ) >> 3] & ( 0x01 << ( ( i - 1 ) & 0x07 ) ) )
+		{
+			neighbors[i>>3] |= 0x01 << ( i & 0x07 );
+		}
+	}
+
+	LockGuard LG( m_mutex );
+	m_present[_nodeId] = true;
+	ResetRecord( _nodeId );
+	if( 0 == memcmp( neighbors, m_neighbors[_nodeId], sizeof(neighbors) ) )
+	{
+		return false;
+	}
+
+	memcpy( m_neighbors[_nodeId], neighbors, sizeof(neighbors) );
+	Link( _nodeId );
+	m_hopsValid = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::GetHopCount>
+// Expected hops from the controller to a node
+//-----------------------------------------------------------------------------
+uint8 Topology::GetHopCount
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	if( !m_hopsValid )
+	{
+		Search( 0, m_hops );
+		m_hopsValid = true;
+	}
+	return m_hops[_nodeId];
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::GetNodesReachableOnlyVia>
+// Nodes that would be cut off from the controller without a node
+//-----------------------------------------------------------------------------
+uint32 Topology::GetNodesReachableOnlyVia
+(
+	uint8 const _nodeId,
+	vector<uint8>* o_nodes
+)
+{
+	o_nodes->clear();
+
+	LockGuard LG( m_mutex );
+	if( !m_hopsValid )
+	{
+		Search( 0, m_hops );
+		m_hopsValid = true;
+	}
+
+	uint8 hops[256];
+	if( _nodeId == m_controller )
+	{
+		// Everything is reached through the controller
+		memset( hops, 0, sizeof(hops) );
+	}
+	else
+	{
+		Search( _nodeId, hops );
+	}
+
+	for( uint32 i=1; i<256; ++i )
+	{
+		if( i != _nodeId && m_hops[i] != 0 && hops[i] == 0 )
+		{
+			o_nodes->push_back( (uint8)i );
+		}
+	}
+	return (uint32)o_nodes->size();
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Delivered>
+// Record a transmission the controller delivered
+//-----------------------------------------------------------------------------
+void Topology::Delivered
+(
+	uint8 const _nodeId,
+	int32 const _latency
+)
+{
+	int32 latency = ( _latency > 0 ) ? _latency : 1;
+
+	LockGuard LG( m_mutex );
+	Record& record = m_records[_nodeId];
+	if( record.m_latency )
+	{
+		// Gain of 1/8, with the average kept scaled by 8
+		record.m_latency += latency - ( record.m_latency >> 3 );
+	}
+	else
+	{
+		record.m_latency = latency << 3;
+	}
+
+	// The best delivery time is only taken once the average has settled
+	if( ++record.m_samples >= c_minSamples && ( 0 == record.m_bestLatency || record.m_latency < record.m_bestLatency ) )
+	{
+		record.m_bestLatency = record.m_latency;
+	}
+
+	++record.m_transmissions;
+	Decay( record );
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Failed>
+// Record a transmission the controller could not deliver
+//-----------------------------------------------------------------------------
+void Topology::Failed
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	Record& record = m_records[_nodeId];
+	++record.m_transmissions;
+	++record.m_failures;
+	Decay( record );
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::SetUpdateInterval>
+// Set how often a degraded node may be offered for a neighbor update
+//-----------------------------------------------------------------------------
+void Topology::SetUpdateInterval
+(
+	int32 const _interval
+)
+{
+	LockGuard LG( m_mutex );
+	m_interval = ( _interval > 0 ) ? (uint32)_interval * 60 * 1000 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::TakeNeighborUpdate>
+// Take the most degraded node that is due for a neighbor update
+//-----------------------------------------------------------------------------
+uint8 Topology::TakeNeighborUpdate
+(
+)
+{
+	LockGuard LG( m_mutex );
+	if( 0 == m_interval )
+	{
+		return 0;
+	}
+
+	uint32 now = Now();
+	if( now - m_lastCheck < c_checkInterval )
+	{
+		return 0;
+	}
+	m_lastCheck = now;
+
+	uint8 worst = 0;
+	uint8 worstHealth = 0;
+	for( uint32 i=1; i<256; ++i )
+	{
+		Record const& record = m_records[i];
+		if( !m_present[i] || i == m_controller || !IsDegraded( record ) )
+		{
+			continue;
+		}
+		if( record.m_offered && ( now - record.m_lastUpdate ) < m_interval )
+		{
+			continue;
+		}
+
+		uint8 health = GetHealth( record );
+		if( 0 == worst || health < worstHealth )
+		{
+			worst = (uint8)i;
+			worstHealth = health;
+		}
+	}
+
+	if( worst != 0 )
+	{
+		Record& record = m_records[worst];
+		Log::Write( LogLevel_Info, worst, "Routes degraded: %d of %d recent transmissions failed, delivery time %dms (best %dms)",
+			record.m_failures, record.m_transmissions, record.m_latency >> 3, record.m_bestLatency >> 3 );
+		record.m_lastUpdate = now;
+		record.m_offered = true;
+	}
+	return worst;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::GetNodeHealth>
+// Retrieve the route health of a node
+//-----------------------------------------------------------------------------
+void Topology::GetNodeHealth
+(
+	uint8 const _nodeId,
+	NodeHealth* _data
+)
+{
+	uint8 hops = GetHopCount( _nodeId );
+
+	LockGuard LG( m_mutex );
+	Record const& record = m_records[_nodeId];
+	_data->m_hopCount = hops;
+	_data->m_health = GetHealth( record );
+	_data->m_transmissions = record.m_transmissions;
+	_data->m_failures = record.m_failures;
+	_data->m_latency = record.m_latency >> 3;
+	_data->m_bestLatency = record.m_bestLatency >> 3;
+	_data->m_degraded = IsDegraded( record );
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Link>
+// Work out a node's links from its own neighbor list and those of the others
+//-----------------------------------------------------------------------------
+void Topology::Link
+(
+	uint8 const _nodeId
+)
+{
+	uint8 const mask = 0x01 << ( _nodeId & 0x07 );
+	for( uint32 i=1; i<256; ++i )
+	{
+		uint8 const bit = 0x01 << ( i & 0x07 );
+		if( i != _nodeId && ( TestBit( m_neighbors[_nodeId], (uint8)i ) || TestBit( m_neighbors[i], _nodeId ) ) )
+		{
+			m_links[_nodeId][i>>3] |= bit;
+			m_links[i][_nodeId>>3] |= mask;
+		}
+		else
+		{
+			m_links[_nodeId][i>>3] &= ~bit;
+			m_links[i][_nodeId>>3] &= ~mask;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Search>
+// Breadth first search from the controller, avoiding one node
+//-----------------------------------------------------------------------------
+void Topology::Search
+(
+	uint8 const _exclude,
+	uint8* o_hops
+)const
+{
+	memset( o_hops, 0, 256 );
+	if( 0 == m_controller || !m_present[m_controller] )
+	{
+		return;
+	}
+
+	bool visited[256];
+	memset( visited, 0, sizeof(visited) );
+	visited[m_controller] = true;
+	if( _exclude != 0 )
+	{
+		visited[_exclude] = true;
+	}
+
+	uint8 queue[256];
+	uint32 head = 0;
+	uint32 tail = 0;
+	queue[tail++] = m_controller;
+	while( head < tail )
+	{
+		uint8 from = queue[head++];
+		uint8 hops = ( from == m_controller ) ? 1 : o_hops[from] + 1;
+		if( hops > c_maxHops )
+		{
+			continue;
+		}
+
+		for( uint32 i=0; i<32; ++i )
+		{
+			uint8 links = m_links[from][i];
+			for( uint32 j=0; links != 0; ++j, links >>= 1 )
+			{
+				uint8 to = (uint8)( ( i << 3 ) + j );
+				if( ( links & 0x01 ) && m_present[to] && !visited[to] )
+				{
+					visited[to] = true;
+					o_hops[to] = hops;
+					queue[tail++] = to;
+				}
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::Decay>
+// Halve a node's counts once the window is full, so recent transmissions count most
+//-----------------------------------------------------------------------------
+void Topology::Decay
+(
+	Record& _record
+)
+{
+	if( _record.m_transmissions >= c_window )
+	{
+		_record.m_transmissions >>= 1;
+		_record.m_failures >>= 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::IsDegraded>
+// Whether the routes to a node need updating
+//-----------------------------------------------------------------------------
+bool Topology::IsDegraded
+(
+	Record const& _record
+)const
+{
+	if( _record.m_transmissions < c_minSamples )
+	{
+		return false;
+	}
+	if( _record.m_failures * 100 >= _record.m_transmissions * c_failurePercent )
+	{
+		return true;
+	}
+	if( _record.m_bestLatency != 0
+		&& _record.m_latency >= _record.m_bestLatency * c_latencyFactor
+		&& _record.m_latency - _record.m_bestLatency >= ( c_minLatencyIncrease << 3 ) )
+	{
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::GetHealth>
+// Score a node's routes from 0 to 100
+//-----------------------------------------------------------------------------
+uint8 Topology::GetHealth
+(
+	Record const& _record
+)const
+{
+	if( 0 == _record.m_transmissions )
+	{
+		return 100;
+	}
+
+	uint32 health = ( ( _record.m_transmissions - _record.m_failures ) * 100 ) / _record.m_transmissions;
+	if( _record.m_bestLatency != 0 && _record.m_latency > _record.m_bestLatency )
+	{
+		// Slower delivery lowers the score in proportion
+		health = ( health * (uint32)_record.m_bestLatency ) / (uint32)_record.m_latency;
+	}
+	return (uint8)health;
+}
+
+//-----------------------------------------------------------------------------
+// <Topology::ResetRecord>
+// Start a node's transmission record again, keeping track of its last update
+//-----------------------------------------------------------------------------
+void Topology::ResetRecord
+(
+	uint8 const _nodeId
+)
+{
+	Record& record = m_records[_nodeId];
+	uint32 lastUpdate = record.m_lastUpdate;
+	bool offered = record.m_offered;
+	memset( &record, 0, sizeof(Record) );
+	record.m_lastUpdate = lastUpdate;
+	record.m_offered = offered;
+}
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+//
+//	Topology.h
+//
+//	Model of the routes through a Z-Wave network, and of their health
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _Topology_H
+#define _Topology_H
+
+#include <vector>
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief Model of the routes through a Z-Wave network, and of their health.
+	 *
+	 *  The model keeps its own copy of each node's neighbor list, as reported
+	 *  by the controller's routing info, so it can be queried without locking
+	 *  the nodes.  A link is assumed to work both ways if either node lists the
+	 *  other as a neighbor.  Changing one node's list only updates that node's
+	 *  links, and the hop counts are worked out again by the next query.
+	 *
+	 *  Each node also has a record of its recent transmissions: how many failed,
+	 *  and how long the controller took to deliver the ones that succeeded.  A
+	 *  node's routes are degraded if too many transmissions fail, or if delivery
+	 *  has become much slower than the best seen since its neighbors were last
+	 *  updated.  Degraded nodes are offered for a neighbor update, no more often
+	 *  than the update interval allows.
+	 *
+	 *  The model locks itself, and never calls out while it holds its lock.
+	 */
+	class Topology
+	{
+	public:
+		/**
+		 * The route health of a node.
+		 */
+		struct NodeHealth
+		{
+			uint8	m_hopCount;				// Expected hops from the controller, or zero if no route is known
+			uint8	m_health;				// From 0 (every transmission fails) to 100
+			uint32	m_transmissions;		// Recent transmissions.  Older ones count for less.
+			uint32	m_failures;				// Recent transmissions that failed
+			int32	m_latency;				// Smoothed delivery time, in milliseconds
+			int32	m_bestLatency;			// Best smoothed delivery time since the neighbors were updated, or zero
+			bool	m_degraded;				// The routes to the node need updating
+		};
+
+		Topology();
+		~Topology();
+
+		/**
+		 * Set the node from which hop counts are measured.
+		 */
+		void SetController( uint8 const _nodeId );
+
+		/**
+		 * Add a node to the network.  It can be reached through nodes that list it as a neighbor.
+		 */
+		void AddNode( uint8 const _nodeId );
+
+		/**
+		 * Remove a node, along with its links and its transmission record.
+		 */
+		void RemoveNode( uint8 const _nodeId );
+
+		/**
+		 * Remove every node.
+		 */
+		void Clear();
+
+		/**
+		 * Replace a node's neighbor list.  The node's transmission record starts
+		 * again, since the controller may now route to it differently.
+		 * \param _nodeId the node.
+		 * \param _neighbors bitmap of 29 bytes, with bit 0 of the first byte for node 1.
+		 * \return true if the list changed.
+		 */
+		bool SetNeighbors( uint8 const _nodeId, uint8 const* _neighbors );
+
+		/**
+		 * Get the expected number of hops from the controller to a node.
+		 * \return the hop count, or zero if the node cannot be reached within c_maxHops.
+		 */
+		uint8 GetHopCount( uint8 const _nodeId );
+
+		/**
+		 * Get the nodes that would be cut off from the controller without a node.
+		 * \param _nodeId the node the others depend on.
+		 * \param o_nodes receives the ids of the dependent nodes, in increasing order.
+		 * \return the number of dependent nodes.
+		 */
+		uint32 GetNodesReachableOnlyVia( uint8 const _nodeId, vector<uint8>* o_nodes );
+
+		/**
+		 * Record a transmission to a node that the controller delivered.
+		 * \param _latency milliseconds from sending the message to the controller's callback.
+		 */
+		void Delivered( uint8 const _nodeId, int32 const _latency );
+
+		/**
+		 * Record a transmission to a node that the controller could not deliver.
+		 */
+		void Failed( uint8 const _nodeId );
+
+		/**
+		 * Set how often a degraded node may be offered for a neighbor update.
+		 * \param _interval minutes between updates of the same node, or zero for never.
+		 */
+		void SetUpdateInterval( int32 const _interval );
+
+		/**
+		 * Take the most degraded node that is due for a neighbor update.
+		 * The node is not offered again until the update interval has passed.
+		 * \return the node, or zero if none is due.
+		 */
+		uint8 TakeNeighborUpdate();
+
+		/**
+		 * Retrieve the route health of a node.
+		 */
+		void GetNodeHealth( uint8 const _nodeId, NodeHealth* _data );
+
+		static uint8 const	c_maxHops = 5;					// Hops through the largest number of repeaters a route can use
+
+	private:
+		Topology( Topology const& );					// prevent copy
+		Topology& operator = ( Topology const& );		// prevent assignment
+
+		struct Record
+		{
+			uint32	m_transmissions;
+			uint32	m_failures;
+			int32	m_latency;						// Smoothed delivery time, in eighths of a millisecond
+			int32	m_bestLatency;					// In eighths of a millisecond, or zero
+			uint32	m_samples;						// Deliveries since the neighbors were updated
+			uint32	m_lastUpdate;					// Time the node was last offered for a neighbor update
+			bool	m_offered;						// m_lastUpdate is valid
+		};
+
+		uint32 Now(){ return (uint32)( -m_start.TimeRemaining() ); }
+		void Link( uint8 const _nodeId );										// Work out a node's links from the neighbor lists
+		void Search( uint8 const _exclude, uint8* o_hops )const;				// Breadth first search from the controller, avoiding _exclude
+		void Decay( Record& _record );
+		bool IsDegraded( Record const& _record )const;
+		uint8 GetHealth( Record const& _record )const;
+		void ResetRecord( uint8 const _nodeId );
+
+		static bool TestBit( uint8 const* _bitmap, uint8 const _nodeId ){ return( 0 != ( _bitmap[_nodeId>>3] & ( 0x01 << ( _nodeId & 0x07 ) ) ) ); }
+
+		Mutex*			m_mutex;						// Protects everything below
+		TimeStamp		m_start;
+		uint8			m_controller;
+		bool			m_present[256];
+		uint8			m_neighbors[256][32];			// Neighbors reported by each node, with bit n for node n
+		uint8			m_links[256][32];				// Links of each node, in either direction
+		uint8			m_hops[256];					// Hop counts from the controller, by node id
+		bool			m_hopsValid;					// False once a link changes
+		Record			m_records[256];
+		uint32			m_interval;						// Milliseconds between neighbor updates of a node, or zero
+		uint32			m_lastCheck;					// Time degraded nodes were last looked for
+
+		static uint32 const	c_minSamples = 8;			// Transmissions needed before a node can be judged
+		static uint32 const	c_window = 32;				// Transmissions after which the counts are halved
+		static uint32 const	c_failurePercent = 25;		// Share of failed transmissions that degrades a node
+		static int32 const	c_latencyFactor = 2;		// Slowdown from the best delivery time that degrades a node...
+		static int32 const	c_minLatencyIncrease = 50;	// ...as long as it is at least this many milliseconds
+		static uint32 const	c_checkInterval = 1000;		// Milliseconds between looks for degraded nodes
+	};
+
+} // namespace OpenZWave
+
+#endif //_Topology_H
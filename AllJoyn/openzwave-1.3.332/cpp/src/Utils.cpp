@@ -116,7 +116,7 @@ void OpenZWave::split
 }
 
 void OpenZWave::PrintHex(std::string prefix, uint8_t const *data, uint32 const length) {
-	Log::Write(LogLevel_Info, "%s: %s", prefix.c_str(), PktToString(data, length).c_str());
+	Log::WriteFrame(LogLevel_Info, 0, (prefix + ": ").c_str(), data, length);
 }
 
 string OpenZWave::PktToString(uint8 const *data, uint32 const length) {
@@ -80,7 +80,7 @@ namespace OpenZWave
 			LockGuard(Mutex* mutex) : _ref(mutex)
 			{
 				//std::cout << "Locking" << std::endl;
-				_ref->Lock();
+				_locked = _ref->Lock();
 			};
 
 			~LockGuard()
@@ -91,20 +91,27 @@ namespace OpenZWave
 				else
 					std::cout << "Unlocking" << std::endl;
 #endif
-				if (!_ref->IsSignalled())
+				if (_locked && !_ref->IsSignalled())
 					_ref->Unlock();
 			}
 			void Unlock()
 			{
 //				std::cout << "Unlocking" << std::endl;
-				_ref->Unlock();
+				if (_locked)
+				{
+					_locked = false;
+					_ref->Unlock();
+				}
 			}
+			// False if the lock was refused, as when a NodeLocks request would deadlock
+			bool IsLocked()const { return _locked; }
 		private:
 			LockGuard(const LockGuard&);
 			LockGuard& operator = ( LockGuard const& );
 
 
 			Mutex* _ref;
+			bool _locked;
 	};
 
 
@@ -0,0 +1,463 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlTagReader.cpp
+//
+//	Streaming reader of the start tags in an XML file
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "XmlTagReader.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <IsSpace>
+// Whether a character is XML white space
+//-----------------------------------------------------------------------------
+static bool IsSpace
+(
+	int32 const _c
+)
+{
+	return( ( ' ' == _c ) || ( '\t' == _c ) || ( '\r' == _c ) || ( '\n' == _c ) );
+}
+
+//-----------------------------------------------------------------------------
+// <AppendUtf8>
+// Append a character to a string in UTF-8
+//-----------------------------------------------------------------------------
+static void AppendUtf8
+(
+	uint32 const _code,
+	string* o_str
+)
+{
+	if( _code < 0x80 )
+	{
+		*o_str += (char)_code;
+	}
+	else if( _code < 0x800 )
+	{
+		*o_str += (char)( 0xc0 | ( _code >> 6 ) );
+		*o_str += (char)( 0x80 | ( _code & 0x3f ) );
+	}
+	else if( _code < 0x10000 )
+	{
+		*o_str += (char)( 0xe0 | ( _code >> 12 ) );
+		*o_str += (char)( 0x80 | ( ( _code >> 6 ) & 0x3f ) );
+		*o_str += (char)( 0x80 | ( _code & 0x3f ) );
+	}
+	else
+	{
+		*o_str += (char)( 0xf0 | ( _code >> 18 ) );
+		*o_str += (char)( 0x80 | ( ( _code >> 12 ) & 0x3f ) );
+		*o_str += (char)( 0x80 | ( ( _code >> 6 ) & 0x3f ) );
+		*o_str += (char)( 0x80 | ( _code & 0x3f ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <DecodeEntity>
+// Append the character an entity or character reference stands for
+//-----------------------------------------------------------------------------
+static void DecodeEntity
+(
+	string const& _entity,
+	string* o_str
+)
+{
+	if( _entity == "amp" )			*o_str += '&';
+	else if( _entity == "lt" )		*o_str += '<';
+	else if( _entity == "gt" )		*o_str += '>';
+	else if( _entity == "quot" )	*o_str += '"';
+	else if( _entity == "apos" )	*o_str += '\'';
+	else if( ( _entity.size() > 1 ) && ( '#' == _entity[0] ) )
+	{
+		char const* digits = _entity.c_str() + 1;
+		int base = 10;
+		if( ( 'x' == *digits ) || ( 'X' == *digits ) )
+		{
+			++digits;
+			base = 16;
+		}
+		char* end;
+		uint32 code = (uint32)strtoul( digits, &end, base );
+		if( ( *end == 0 ) && ( code != 0 ) && ( code < 0x110000 ) )
+		{
+			AppendUtf8( code, o_str );
+			return;
+		}
+		*o_str += '&' + _entity + ';';
+	}
+	else
+	{
+		// Not an entity we know, so it is kept as it was
+		*o_str += '&' + _entity + ';';
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::XmlTagReader>
+// Constructor
+//-----------------------------------------------------------------------------
+XmlTagReader::XmlTagReader
+(
+):
+	m_file( NULL ),
+	m_pos( 0 ),
+	m_length( 0 ),
+	m_row( 1 ),
+	m_depth( 0 ),
+	m_elementDepth( 0 ),
+	m_elementRow( 0 ),
+	m_error( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::~XmlTagReader>
+// Destructor
+//-----------------------------------------------------------------------------
+XmlTagReader::~XmlTagReader
+(
+)
+{
+	if( m_file != NULL )
+	{
+		fclose( m_file );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::Open>
+// Open a file
+//-----------------------------------------------------------------------------
+bool XmlTagReader::Open
+(
+	string const& _filename
+)
+{
+	m_file = fopen( _filename.c_str(), "rb" );
+	return( m_file != NULL );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::NextElement>
+// Move to the next start tag
+//-----------------------------------------------------------------------------
+bool XmlTagReader::NextElement
+(
+)
+{
+	m_name.clear();
+	m_attributes.clear();
+
+	while( !m_error )
+	{
+		int32 c = Get();
+		if( EOF == c )
+		{
+			return false;
+		}
+		if( '<' != c )
+		{
+			// Text
+			continue;
+		}
+
+		c = Peek();
+		if( '/' == c )
+		{
+			// End tag
+			if( !SkipPast( ">" ) )
+			{
+				m_error = true;
+				break;
+			}
+			if( m_depth > 0 )
+			{
+				--m_depth;
+			}
+			continue;
+		}
+
+		if( '?' == c )
+		{
+			// Declaration or processing instruction
+			m_error = !SkipPast( "?>" );
+			continue;
+		}
+
+		if( '!' == c )
+		{
+			Get();
+			if( '-' == Peek() )
+			{
+				Get();
+				if( '-' != Get() )
+				{
+					m_error = true;
+					break;
+				}
+				m_error = !SkipPast( "-->" );
+			}
+			else if( '[' == Peek() )
+			{
+				m_error = !SkipPast( "]]>" );
+			}
+			else
+			{
+				m_error = !SkipPast( ">" );
+			}
+			continue;
+		}
+
+		// Start tag
+		m_elementRow = m_row;
+		m_elementDepth = m_depth;
+		bool empty = false;
+		if( !ReadName( &m_name ) || !ReadAttributes( &empty ) )
+		{
+			m_error = true;
+			break;
+		}
+		if( !empty )
+		{
+			++m_depth;
+		}
+		return true;
+	}
+
+	m_name.clear();
+	m_attributes.clear();
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::Attribute>
+// The value of an attribute of the current element
+//-----------------------------------------------------------------------------
+char const* XmlTagReader::Attribute
+(
+	char const* _name
+)const
+{
+	for( uint32 i=0; i+1<m_attributes.size(); i+=2 )
+	{
+		if( m_attributes[i] == _name )
+		{
+			return m_attributes[i+1].c_str();
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::Get>
+// Read the next character of the file
+//-----------------------------------------------------------------------------
+int32 XmlTagReader::Get
+(
+)
+{
+	if( EOF == Peek() )
+	{
+		return EOF;
+	}
+	int32 c = (uint8)m_buffer[m_pos++];
+	if( '\n' == c )
+	{
+		++m_row;
+	}
+	return c;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::Peek>
+// The next character of the file, which is left to be read
+//-----------------------------------------------------------------------------
+int32 XmlTagReader::Peek
+(
+)
+{
+	if( m_pos == m_length )
+	{
+		if( m_file == NULL )
+		{
+			return EOF;
+		}
+		m_length = (uint32)fread( m_buffer, 1, sizeof(m_buffer), m_file );
+		m_pos = 0;
+		if( 0 == m_length )
+		{
+			return EOF;
+		}
+	}
+	return (uint8)m_buffer[m_pos];
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::SkipPast>
+// Skip up to and including a terminating string
+//-----------------------------------------------------------------------------
+bool XmlTagReader::SkipPast
+(
+	char const* _terminator
+)
+{
+	uint32 length = (uint32)strlen( _terminator );
+	string tail;
+	while( true )
+	{
+		int32 c = Get();
+		if( EOF == c )
+		{
+			return false;
+		}
+		tail += (char)c;
+		if( tail.size() > length )
+		{
+			tail.erase( 0, 1 );
+		}
+		if( tail == _terminator )
+		{
+			return true;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::ReadName>
+// Read an element name
+//-----------------------------------------------------------------------------
+bool XmlTagReader::ReadName
+(
+	string* o_name
+)
+{
+	o_name->clear();
+	int32 c = Peek();
+	while( ( EOF != c ) && !IsSpace( c ) && ( '>' != c ) && ( '/' != c ) )
+	{
+		*o_name += (char)Get();
+		c = Peek();
+	}
+	return !o_name->empty();
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::ReadAttributes>
+// Read the attributes up to the end of a start tag
+//-----------------------------------------------------------------------------
+bool XmlTagReader::ReadAttributes
+(
+	bool* o_empty
+)
+{
+	while( true )
+	{
+		SkipSpace();
+		int32 c = Get();
+		if( EOF == c )
+		{
+			return false;
+		}
+		if( '>' == c )
+		{
+			*o_empty = false;
+			return true;
+		}
+		if( '/' == c )
+		{
+			*o_empty = true;
+			return( '>' == Get() );
+		}
+
+		string name( 1, (char)c );
+		c = Peek();
+		while( ( EOF != c ) && !IsSpace( c ) && ( '=' != c ) && ( '>' != c ) && ( '/' != c ) )
+		{
+			name += (char)Get();
+			c = Peek();
+		}
+
+		SkipSpace();
+		if( '=' != Get() )
+		{
+			return false;
+		}
+		SkipSpace();
+		int32 quote = Get();
+		if( ( '"' != quote ) && ( '\'' != quote ) )
+		{
+			return false;
+		}
+
+		string value;
+		while( ( c = Get() ) != quote )
+		{
+			if( EOF == c )
+			{
+				return false;
+			}
+			if( '&' != c )
+			{
+				value += (char)c;
+				continue;
+			}
+
+			string entity;
+			while( ( ( c = Get() ) != ';' ) && ( entity.size() < 10 ) )
+			{
+				if( ( EOF == c ) || ( quote == c ) )
+				{
+					return false;
+				}
+				entity += (char)c;
+			}
+			if( ';' != c )
+			{
+				return false;
+			}
+			DecodeEntity( entity, &value );
+		}
+
+		m_attributes.push_back( name );
+		m_attributes.push_back( value );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlTagReader::SkipSpace>
+// Skip white space
+//-----------------------------------------------------------------------------
+void XmlTagReader::SkipSpace
+(
+)
+{
+	while( IsSpace( Peek() ) )
+	{
+		Get();
+	}
+}
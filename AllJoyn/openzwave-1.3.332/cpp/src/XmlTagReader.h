@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlTagReader.h
+//
+//	Streaming reader of the start tags in an XML file
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _XmlTagReader_H
+#define _XmlTagReader_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief Streaming reader of the start tags in an XML file.
+	 *
+	 *  Reads the file in small blocks and returns each element's name and
+	 *  attributes in document order, without building a document tree.  Text,
+	 *  comments, CDATA sections, declarations and processing instructions are
+	 *  skipped.  The five predefined entities and character references in
+	 *  attribute values are decoded.  This is for large configuration files
+	 *  where only the attributes are needed, such as manufacturer_specific.xml.
+	 */
+	class XmlTagReader
+	{
+	public:
+		XmlTagReader();
+		~XmlTagReader();
+
+		/**
+		 * Open a file.
+		 * \return false if the file could not be opened.
+		 */
+		bool Open( string const& _filename );
+
+		/**
+		 * Move to the next start tag.
+		 * \return false at the end of the file, or if the XML is malformed.
+		 * \see IsError
+		 */
+		bool NextElement();
+
+		/**
+		 * Whether NextElement stopped at malformed XML rather than the end of the file.
+		 */
+		bool IsError()const{ return m_error; }
+
+		/**
+		 * The name of the current element.
+		 */
+		string const& GetName()const{ return m_name; }
+
+		/**
+		 * The value of an attribute of the current element, or NULL if it has none.
+		 */
+		char const* Attribute( char const* _name )const;
+
+		/**
+		 * How deeply the current element is nested.  The root element is at depth zero.
+		 */
+		uint32 GetDepth()const{ return m_elementDepth; }
+
+		/**
+		 * The line of the file on which the current element starts.
+		 */
+		int32 Row()const{ return m_elementRow; }
+
+	private:
+		XmlTagReader( XmlTagReader const& );					// prevent copy
+		XmlTagReader& operator = ( XmlTagReader const& );		// prevent assignment
+
+		int32 Get();											// Next character, or EOF
+		int32 Peek();
+		bool SkipPast( char const* _terminator );				// Skip up to and including the terminator
+		bool ReadName( string* o_name );
+		bool ReadAttributes( bool* o_empty );					// Read up to the end of a start tag
+		void SkipSpace();
+
+		FILE*					m_file;
+		char					m_buffer[4096];
+		uint32					m_pos;
+		uint32					m_length;
+		int32					m_row;
+
+		string					m_name;
+		vector<string>			m_attributes;					// Names and values, alternately
+		uint32					m_depth;						// Depth of the next element
+		uint32					m_elementDepth;
+		int32					m_elementRow;
+		bool					m_error;
+	};
+
+} // namespace OpenZWave
+
+#endif //_XmlTagReader_H
@@ -41,6 +41,95 @@
 namespace OpenZWave {
 	//using namespace OpenZWave;
 
+	//-----------------------------------------------------------------------------
+	// <CbcMac>
+	// CBC-MAC of a stream of bytes, zero padded to a whole number of blocks.
+	// The key schedule is used directly, without going through the mode
+	// functions, which would need their state resetting before every block.
+	//-----------------------------------------------------------------------------
+	class CbcMac
+	{
+	public:
+		CbcMac
+		(
+				aes_encrypt_ctx const* _key,
+				uint8 const* _iv
+		):
+		m_key( _key ),
+		m_block( 0 ),
+		m_ok( true )
+		{
+			m_ok = ( aes_encrypt( _iv, m_state, m_key ) != EXIT_FAILURE );
+		}
+
+		void Add
+		(
+				uint8 const _byte
+		)
+		{
+			m_state[m_block++] ^= _byte;
+			if( 16 == m_block )
+			{
+				m_block = 0;
+				m_ok &= ( aes_encrypt( m_state, m_state, m_key ) != EXIT_FAILURE );
+			}
+		}
+
+		bool Final
+		(
+				uint8* _mac			// 8-byte buffer that will be filled with the MAC
+		)
+		{
+			// The padding is zero, so only the encryption remains to be done
+			if( m_block > 0 )
+			{
+				m_block = 0;
+				m_ok &= ( aes_encrypt( m_state, m_state, m_key ) != EXIT_FAILURE );
+			}
+			memcpy( _mac, m_state, 8 );
+			return m_ok;
+		}
+
+	private:
+		aes_encrypt_ctx const*	m_key;
+		uint8					m_state[16];
+		uint32					m_block;
+		bool					m_ok;
+	};
+
+	//-----------------------------------------------------------------------------
+	// <CryptAndAuthenticate>
+	// OFB encryption or decryption, adding the ciphertext to a MAC as it goes
+	//-----------------------------------------------------------------------------
+	static bool CryptAndAuthenticate
+	(
+			aes_encrypt_ctx const* _key,
+			uint8 const* _iv,
+			uint8 const* _in,
+			uint8* _out,					// May be the same as _in
+			uint32 const _length,
+			bool const _encrypt,
+			CbcMac* _mac
+	)
+	{
+		uint8 stream[16];
+		memcpy( stream, _iv, 16 );
+		for( uint32 i = 0; i < _length; ++i )
+		{
+			if( 0 == ( i & 0x0f ) )
+			{
+				if( aes_encrypt( stream, stream, _key ) == EXIT_FAILURE )
+				{
+					return false;
+				}
+			}
+			uint8 in = _in[i];
+			_out[i] = in ^ stream[i & 0x0f];
+			_mac->Add( _encrypt ? _out[i] : in );
+		}
+		return true;
+	}
+
 	//-----------------------------------------------------------------------------
 	// <GenerateAuthentication>
 	// Generate authentication data from a security-encrypted message
@@ -56,77 +145,26 @@ namespace OpenZWave {
 			uint8* _authentication			// 8-byte buffer that will be filled with the authentication data
 	)
 	{
-		// Build a buffer containing a 4-byte header and the encrypted
-		// message data, padded with zeros to a 16-byte boundary.
-		uint8 buffer[256];
-		uint8 tmpauth[16];
-		memset(buffer, 0, 256);
-		memset(tmpauth, 0, 16);
-		buffer[0] = _data[0];							// Security command class command
-		buffer[1] = _sendingNode;
-		buffer[2] = _receivingNode;
-		buffer[3] = _length - 19; // Subtract 19 to account for the 9 security command class bytes that come before and after the encrypted data
-		memcpy( &buffer[4], &_data[9], _length-19 );	// Encrypted message
-
-		uint8 bufsize = _length - 19 + 4; /* the size of buffer */
-#ifdef DEBUG
-		PrintHex("Raw Auth (minus IV)", buffer, bufsize);
-		Log::Write(LogLevel_Debug, _receivingNode, "Raw Auth (Minus IV) Size: %d (%d)", bufsize, bufsize+16);
-#endif
-
-		aes_mode_reset(driver->GetAuthKey());
-		/* encrypt the IV with ecb */
-		if (aes_ecb_encrypt(iv, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-			Log::Write(LogLevel_Warning, _receivingNode, "Failed Initial ECB Encrypt of Auth Packet");
-			return false;
-		}
-
-		/* our temporary holding var */
-		uint8 encpck[16];
-
-		int block = 0;
-		/* reset our encpck temp var */
-		memset(encpck, 0, 16);
-		/* now xor the buffer with our encrypted IV */
-		for (int i = 0; i < bufsize; i++) {
-			encpck[block] = buffer[i];
-			block++;
-			/* if we hit a blocksize, then encrypt */
-			if (block == 16) {
-				for (int j = 0; j < 16; j++) {
-					/* here we do our xor */
-					tmpauth[j] = encpck[j] ^ tmpauth[j];
-					/* and reset encpck for good measure */
-					encpck[j] = 0;
-				}
-				/* reset our block counter back to 0 */
-				block = 0;
-				aes_mode_reset(driver->GetAuthKey());
-				if (aes_ecb_encrypt(tmpauth, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-					Log::Write(LogLevel_Warning, _receivingNode, "Failed Subsequent (%d) ECB Encrypt of Auth Packet", i);
-					return false;
-				}
-			}
+		// The MAC covers a 4-byte header and the encrypted message data.
+		// Subtract 19 to account for the 9 security command class bytes that come before and after the encrypted data
+		uint32 size = _length - 19;
+		CbcMac mac( driver->GetAuthKey(), iv );
+		mac.Add( _data[0] );							// Security command class command
+		mac.Add( _sendingNode );
+		mac.Add( _receivingNode );
+		mac.Add( (uint8)size );
+		for( uint32 i = 0; i < size; ++i )
+		{
+			mac.Add( _data[9+i] );						// Encrypted message
 		}
-		/* any left over data that isn't a full block size*/
-		if (block > 0) {
-			for (int i= 0; i < 16; i++) {
-				/* encpck from block to 16 is already gauranteed to be 0
-				 * so its safe to xor it with out tmpmac */
-				tmpauth[i] = encpck[i] ^ tmpauth[i];
-			}
-			aes_mode_reset(driver->GetAuthKey());
-			if (aes_ecb_encrypt(tmpauth, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-				Log::Write(LogLevel_Warning, _receivingNode, "Failed Final ECB Encrypt of Auth Packet");
-				return false;
-			}
+		if( !mac.Final( _authentication ) )
+		{
+			Log::Write(LogLevel_Warning, _receivingNode, "Failed ECB Encrypt of Auth Packet");
+			return false;
 		}
-		/* we only care about the first 8 bytes of tmpauth as the mac */
 #ifdef DEBUG
-		PrintHex("Computed Auth", tmpauth, 8);
+		PrintHex("Computed Auth", _authentication, 8);
 #endif
-		/* so only copy 8 bytes to the _authentication var */
-		memcpy(_authentication, tmpauth, 8);
 		return true;
 	}
 
@@ -137,20 +175,10 @@ namespace OpenZWave {
 			uint8 const _sendingNode,
 			uint8 const _receivingNode,
 			uint8 const m_nonce[8],
-			uint8* e_buffer
+			uint8* e_buffer,
+			bool const _requestNonce
 	)
 	{
-
-#if 0
-		m_nonce[0] = 0x09;
-		m_nonce[1] = 0x0d;
-		m_nonce[2] = 0x93;
-		m_nonce[3] = 0xd3;
-		m_nonce[4] = 0x61;
-		m_nonce[5] = 0x61;
-		m_nonce[6] = 0x1d;
-		m_nonce[7] = 0xd6;
-#endif
 		uint8 len = 0;
 		e_buffer[len++] = SOF;
 		e_buffer[len++] = m_length + 18; // length of full packet
@@ -159,7 +187,10 @@ namespace OpenZWave {
 		e_buffer[len++] = _receivingNode;
 		e_buffer[len++] = m_length + 11; 					// Length of the payload
 		e_buffer[len++] = Security::StaticGetCommandClassId();
-		e_buffer[len++] = SecurityCmd_MessageEncap;
+		/* MessageEncapNonceGet asks the node to send a new nonce straight
+		 * after this message, ready for the next one
+		 */
+		e_buffer[len++] = _requestNonce ? SecurityCmd_MessageEncapNonceGet : SecurityCmd_MessageEncap;
 
 		/* create our IV */
 		uint8 initializationVector[16];
@@ -176,7 +207,6 @@ namespace OpenZWave {
 			initializationVector[8+i] = m_nonce[i];
 		}
 
-
 		uint8 plaintextmsg[32];
 		/* add the Sequence Flag
 		 * - Since we dont currently handle multipacket encryption
@@ -186,46 +216,37 @@ namespace OpenZWave {
 		/* now add the actual message to be encrypted */
 		for (int i = 0; i < m_length-6-3; i++)
 			plaintextmsg[i+1] = m_buffer[6+i];
-
-		/* now encrypt */
-		uint8 encryptedpayload[30];
-		aes_mode_reset(driver->GetEncKey());
+		uint8 plaintextsize = m_length-5-3;
 #ifdef DEBUG
-		PrintHex("Plain Text Packet:", plaintextmsg, m_length-5-3);
+		PrintHex("Plain Text Packet:", plaintextmsg, plaintextsize);
 #endif
-		if (aes_ofb_encrypt(plaintextmsg, encryptedpayload, m_length-5-3, initializationVector, driver->GetEncKey()) == EXIT_FAILURE) {
+
+		/* encrypt straight into the packet, computing the MAC of the
+		 * header and the encrypted output at the same time
+		 */
+		CbcMac mac( driver->GetAuthKey(), initializationVector );
+		mac.Add( e_buffer[7] );
+		mac.Add( _sendingNode );
+		mac.Add( _receivingNode );
+		mac.Add( plaintextsize );
+		if (!CryptAndAuthenticate(driver->GetEncKey(), initializationVector, plaintextmsg, &e_buffer[len], plaintextsize, true, &mac)) {
 			Log::Write(LogLevel_Warning, _receivingNode, "Failed to Encrypt Packet");
 			return false;
 		}
 #ifdef DEBUG
-		PrintHex("Encrypted Packet", encryptedpayload, m_length-5-3);
+		PrintHex("Encrypted Packet", &e_buffer[len], plaintextsize);
 #endif
-		/* now add the Encrypted output to the packet */
-		for (int i = 0; i < m_length-5-3; i++) {
-			e_buffer[len++] = encryptedpayload[i];
-		}
+		len += plaintextsize;
 
 		// Append the nonce identifier :)
 		e_buffer[len++] = m_nonce[0];
 
-
-		/* regenerate the IV */
-		for (int i = 0; i < 8; i++) {
-			//initializationVector[i] = (rand()%0xFF)+1;
-			initializationVector[i] = 0xAA;
-		}
-		/* the remaining 8 bytes are the NONCE we got from the device */
-		for (int i = 0; i < 8; i++) {
-			initializationVector[8+i] = m_nonce[i];
-		}
-
-		/* now calculate the MAC and append it */
-		uint8 mac[8];
-		GenerateAuthentication(&e_buffer[7], e_buffer[5], driver, _sendingNode, _receivingNode, initializationVector, mac);
-		for(int i=0; i<8; ++i )
-		{
-			e_buffer[len++] = mac[i];
+		/* now append the MAC */
+		if (!mac.Final(&e_buffer[len])) {
+			Log::Write(LogLevel_Warning, _receivingNode, "Failed ECB Encrypt of Auth Packet");
+			return false;
 		}
+		len += 8;
 
 		e_buffer[len++] = driver->GetTransmitOptions();
 		/* this is the same as the Actual Message */
@@ -303,47 +324,27 @@ namespace OpenZWave {
 		}
 
 
-		uint8 encyptedpacket[32];
-
-		for (uint32 i = 0; i < 32; i++) {
-			if (i >= encryptedpacketsize) {
-				/* pad the remaining fields */
-				encyptedpacket[i] = 0;
-			} else {
-				encyptedpacket[i] = e_buffer[10+i];
-			}
-		}
-
-
 #ifdef DEBUG
 		Log::Write(LogLevel_Debug, _sendingNode, "Encrypted Packet Sizes: %d (Total) %d (Payload)", e_length, encryptedpacketsize);
 		PrintHex("IV", iv, 16);
-		PrintHex("Encrypted", encyptedpacket, 16);
+		PrintHex("Encrypted", &e_buffer[10], encryptedpacketsize);
 		/* Mac Starts after Encrypted Packet. */
 		PrintHex("Auth", &e_buffer[11+encryptedpacketsize], 8);
 #endif
-		aes_mode_reset(driver->GetEncKey());
-#if 0
-		uint8_t iv[16] = {  0x81, 0x42, 0xd1, 0x51, 0xf1, 0x59, 0x3d, 0x70, 0xd5, 0xe3, 0x6c, 0xcb, 0x02, 0xd0, 0x3f, 0x5c,  /* */  };
-		uint8_t pck[] = {  0x25, 0x68, 0x06, 0xc5, 0xb3, 0xee, 0x2c, 0x17, 0x26, 0x7e, 0xf0, 0x84, 0xd4, 0xc3, 0xba, 0xed, 0xe5, 0xb9, 0x55};
-		if (aes_ofb_decrypt(pck, decryptpacket, 19, iv, this->EncryptKey) == EXIT_FAILURE) {
-			Log::Write(LogLevel_Warning, GetNodeId(), "Failed to Decrypt Packet");
-			return false;
-		}
-		PrintHex("Pck", decryptpacket, 19);
-#else
-		if (aes_ofb_decrypt(encyptedpacket, m_buffer, encryptedpacketsize, iv, driver->GetEncKey()) == EXIT_FAILURE) {
+		/* decrypt, computing the MAC of the header and the encrypted data at the same time */
+		CbcMac auth( driver->GetAuthKey(), iv );
+		auth.Add( e_buffer[1] );
+		auth.Add( _sendingNode );
+		auth.Add( _receivingNode );
+		auth.Add( (uint8)encryptedpacketsize );
+		if (!CryptAndAuthenticate(driver->GetEncKey(), iv, &e_buffer[10], m_buffer, encryptedpacketsize, false, &auth)) {
 			Log::Write(LogLevel_Warning, _sendingNode, "Failed to Decrypt Packet");
 			return false;
 		}
 		Log::Write(LogLevel_Detail, _sendingNode, "Decrypted Packet: %s", PktToString(m_buffer, encryptedpacketsize).c_str());
-#endif
-		uint8 mac[32];
-		/* we have to regenerate the IV as the ofb decryption routine will alter it. */
-		createIVFromPacket_inbound(&e_buffer[2], m_nonce, iv);
 
-		GenerateAuthentication(&e_buffer[1], e_length-1, driver, _sendingNode, _receivingNode, iv, mac);
-		if (memcmp(&e_buffer[11+encryptedpacketsize], mac, 8) != 0) {
+		uint8 mac[8];
+		if (!auth.Final(mac) || memcmp(&e_buffer[11+encryptedpacketsize], mac, 8) != 0) {
 			Log::Write(LogLevel_Warning, _sendingNode, "MAC Authentication of Packet Failed. Dropping");
 			return false;
 		}
@@ -36,8 +36,10 @@
 #include "Node.h"
 #include "Driver.h"
 #include "Manager.h"
+#include "ConfigWriter.h"
 #include "platform/Log.h"
 #include "value_classes/ValueStore.h"
+#include "value_classes/ValueDecimal.h"
 
 using namespace OpenZWave;
 
@@ -194,6 +196,7 @@ void CommandClass::SetInstance
 	if( !m_instances.IsSet( _endPoint ) )
 	{
 		m_instances.Set( _endPoint );
+		ConfigChanged();
 		if( IsCreateVars() )
 		{
 			CreateVars( _endPoint );
@@ -201,6 +204,40 @@ void CommandClass::SetInstance
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <CommandClass::SetEndPoint>
+// Map an instance to the endpoint reported by the MultiChannel command class
+//-----------------------------------------------------------------------------
+void CommandClass::SetEndPoint
+(
+		uint8 const _instance,
+		uint8 const _endpoint
+)
+{
+	map<uint8,uint8>::iterator it = m_endPointMap.find( _instance );
+	if( it == m_endPointMap.end() || it->second != _endpoint )
+	{
+		m_endPointMap[_instance] = _endpoint;
+		ConfigChanged();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::SetVersion>
+// Set the version of the command class implemented by the device
+//-----------------------------------------------------------------------------
+void CommandClass::SetVersion
+(
+		uint8 const _version
+)
+{
+	if( m_version != _version )
+	{
+		m_version = _version;
+		ConfigChanged();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <CommandClass::ReadXML>
 // Read the saved command class data
@@ -228,6 +265,16 @@ void CommandClass::ReadXML
 	{
 		m_staticRequests = (uint8)intVal;
 	}
+	else if( Node* node = GetNodeUnsafe() )
+	{
+		// Outstanding requests are always saved, so if the node got past its static
+		// stage in an earlier run, there are none left.  Otherwise the requests set
+		// by the constructor would be made again.
+		if( node->GetCurrentQueryStage() > Node::QueryStage_Static )
+		{
+			m_staticRequests = 0;
+		}
+	}
 
 	if( TIXML_SUCCESS == _ccElement->QueryIntAttribute( "override_precision", &intVal ) )
 	{
@@ -540,9 +587,33 @@ string CommandClass::ExtractValue
 		uint8* _precision,
 		uint8 _valueOffset // = 1
 )const
+{
+	uint8 precision;
+	int32 value = ExtractDecimal( _data, _scale, &precision, _valueOffset );
+
+	if( _precision )
+	{
+		*_precision = precision;
+	}
+
+	char str[ValueDecimal::MaxFormatted];
+	ValueDecimal::Format( ValueDecimal::Decimal( value, precision ), str, sizeof(str) );
+	return string( str );
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::ExtractDecimal>
+// Read a value from a variable length sequence of bytes as a scaled integer
+//-----------------------------------------------------------------------------
+int32 CommandClass::ExtractDecimal
+(
+		uint8 const* _data,
+		uint8* _scale,
+		uint8* _precision,
+		uint8 _valueOffset // = 1
+)const
 {
 	uint8 const size = _data[0] & c_sizeMask;
-	uint8 const precision = (_data[0] & c_precisionMask) >> c_precisionShift;
 
 	if( _scale )
 	{
@@ -551,7 +622,7 @@ string CommandClass::ExtractValue
 
 	if( _precision )
 	{
-		*_precision = precision;
+		*_precision = (_data[0] & c_precisionMask) >> c_precisionShift;
 	}
 
 	uint32 value = 0;
@@ -563,11 +634,8 @@ string CommandClass::ExtractValue
 	}
 
 	// Deal with sign extension.  All values are signed
-	string res;
 	if( _data[_valueOffset] & 0x80 )
 	{
-		res = "-";
-
 		// MSB is signed
 		if( size == 1 )
 		{
@@ -579,54 +647,7 @@ string CommandClass::ExtractValue
 		}
 	}
 
-	// Convert the integer to a decimal string.  We avoid
-	// using floats to prevent accuracy issues.
-	char numBuf[12] = {0};
-
-	if( precision == 0 )
-	{
-		// The precision is zero, so we can just print the number directly into the string.
-		snprintf( numBuf, 12, "%d", (signed int)value );
-		res = numBuf;
-	}
-	else
-	{
-		// We'll need to insert a decimal point and include any necessary leading zeros.
-
-		// Fill the buffer with the value padded with leading zeros.
-		snprintf( numBuf, 12, "%011d", (signed int)value );
-
-		// Calculate the position of the decimal point in the buffer
-		int32 decimal = 10-precision;
-
-		// Shift the characters to make space for the decimal point.
-		// We don't worry about overwriting any minus sign since that is
-		// already written into the res string. While we're shifting, we
-		// also look for the real starting position of the number so we
-		// can copy it into the res string later.
-		int32 start = -1;
-		for( int32 i=0; i<decimal; ++i )
-		{
-			numBuf[i] = numBuf[i+1];
-			if( ( start<0 ) && ( numBuf[i] != '0' ) )
-			{
-				start = i;
-			}
-		}
-		if( start<0 )
-		{
-			start = decimal-1;
-		}
-
-		// Insert the decimal point
-		struct lconv const* locale = localeconv();
-		numBuf[decimal] = *(locale->decimal_point);
-
-		// Copy the buffer into res
-		res += &numBuf[start];
-	}
-
-	return res;
+	return (int32)value;
 }
 
 //-----------------------------------------------------------------------------
@@ -778,7 +799,41 @@ void CommandClass::ClearStaticRequest
 		uint8 _request
 )
 {
-	m_staticRequests &= ~_request;
+	if( m_staticRequests & _request )
+	{
+		m_staticRequests &= ~_request;
+		ConfigChanged();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::SetStaticRequest>
+// Set a request flag
+//-----------------------------------------------------------------------------
+void CommandClass::SetStaticRequest
+(
+		uint8 _request
+)
+{
+	if( ( m_staticRequests & _request ) != _request )
+	{
+		m_staticRequests |= _request;
+		ConfigChanged();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::ConfigChanged>
+// Mark the node for saving.  Changes that are notified are marked by the driver.
+//-----------------------------------------------------------------------------
+void CommandClass::ConfigChanged
+(
+)
+{
+	if( Driver* driver = GetDriver() )
+	{
+		driver->m_configWriter->NodeChanged( m_nodeId );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -68,7 +68,7 @@ namespace OpenZWave
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 ) = 0;
 		virtual bool SetValue( Value const& _value ){ return false; }
 		virtual void SetValueBasic( uint8 const _instance, uint8 const _level ){}		// Class specific handling of BASIC value mapping
-		virtual void SetVersion( uint8 const _version ){ m_version = _version; }
+		virtual void SetVersion( uint8 const _version );
 
 		bool RequestStateForAllInstances( uint32 const _requestFlags, Driver::MsgQueue const _queue );
 		bool CheckForRefreshValues(Value const* _value );
@@ -104,22 +104,32 @@ namespace OpenZWave
 
 		void SetInstances( uint8 const _instances );
 		void SetInstance( uint8 const _endPoint );
-		void SetAfterMark(){ m_afterMark = true; }
-		void SetEndPoint( uint8 const _instance, uint8 const _endpoint){ m_endPointMap[_instance] = _endpoint; }
+		void SetAfterMark(){ if( !m_afterMark ){ m_afterMark = true; ConfigChanged(); } }
+		void SetEndPoint( uint8 const _instance, uint8 const _endpoint);
 		bool IsAfterMark()const{ return m_afterMark; }
 		bool IsCreateVars()const{ return m_createVars; }
 		bool IsGetSupported()const{ return m_getSupported; }
 		bool IsSecured()const{ return m_isSecured; }
-		void SetSecured(){ m_isSecured = true; }
+		void SetSecured(){ if( !m_isSecured ){ m_isSecured = true; ConfigChanged(); } }
 		bool IsSecureSupported()const { return m_SecureSupport; }
 		void ClearSecureSupport() { m_SecureSupport = false; }
 		void SetSecureSupport() { m_SecureSupport = true; }
-		void SetInNIF() { m_inNIF = true; }
+		void SetInNIF() { if( !m_inNIF ){ m_inNIF = true; ConfigChanged(); } }
 		bool IsInNIF() { return m_inNIF; }
 
 		// Helper methods
 		string ExtractValue( uint8 const* _data, uint8* _scale, uint8* _precision, uint8 _valueOffset = 1 )const;
 
+		/**
+		 *  Read a value from a message without formatting it as a string.
+		 *  \param _data Points at the size, scale and precision byte that precedes the value.
+		 *  \param _scale Receives the scale of the value.
+		 *  \param _precision Receives the number of decimal digits in the value.
+		 *  \return The value scaled by 10 to the power of the precision.
+		 *  \see ExtractValue, ValueDecimal::OnValueRefreshed
+		 */
+		int32 ExtractDecimal( uint8 const* _data, uint8* _scale, uint8* _precision, uint8 _valueOffset = 1 )const;
+
 		/**
 		 *  Append a floating-point value to a message.
 		 *  \param _msg The message to which the value should be appended.
@@ -176,9 +186,12 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		};
 
 		bool HasStaticRequest( uint8 _request )const{ return( (m_staticRequests & _request) != 0 ); }
-		void SetStaticRequest( uint8 _request ){ m_staticRequests |= _request; }
+		void SetStaticRequest( uint8 _request );
 		void ClearStaticRequest( uint8 _request );
 
+	protected:
+		void ConfigChanged();			// Mark the node for saving after a change to saved state that is not notified
+
 	private:
 		uint8   m_staticRequests;
 
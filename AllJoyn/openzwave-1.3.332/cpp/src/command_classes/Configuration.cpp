@@ -45,7 +45,10 @@ enum ConfigurationCmd
 {
 	ConfigurationCmd_Set	= 0x04,
 	ConfigurationCmd_Get	= 0x05,
-	ConfigurationCmd_Report	= 0x06
+	ConfigurationCmd_Report	= 0x06,
+	ConfigurationCmd_BulkSet	= 0x07,
+	ConfigurationCmd_BulkGet	= 0x08,
+	ConfigurationCmd_BulkReport	= 0x09
 };
 
 //-----------------------------------------------------------------------------
@@ -71,85 +74,135 @@ bool Configuration::HandleMsg
 			paramValue |= (int32)_data[i+3];
 		}
 
-		if ( Value* value = GetValue( 1, parameter ) )
+		ReportParam( parameter, size, paramValue, _instance );
+		Log::Write( LogLevel_Info, GetNodeId(), "Received Configuration report: Parameter=%d, Value=%d", parameter, paramValue );
+		return true;
+	}
+
+	if( ConfigurationCmd_BulkReport == (ConfigurationCmd)_data[0] )
+	{
+		// A run of consecutive parameters, all of the same size
+		uint16 offset = (((uint16)_data[1])<<8) | (uint16)_data[2];
+		uint8 count = _data[3];
+		uint8 size = _data[5] & 0x07;
+		Log::Write( LogLevel_Info, GetNodeId(), "Received Configuration bulk report: Parameters=%d-%d, Size=%d, Reports to follow=%d", offset, offset+count-1, size, _data[4] );
+		if( size == 0 )
 		{
-			switch ( value->GetID().GetType() )
+			return true;
+		}
+
+		uint32 pos = 6;
+		for( uint8 i=0; i<count && ( pos+size <= _length-1 ); ++i, pos += size )
+		{
+			int32 paramValue = 0;
+			for( uint8 j=0; j<size; ++j )
 			{
-				case ValueID::ValueType_Bool:
-				{
-					ValueBool* valueBool = static_cast<ValueBool*>( value );
-					valueBool->OnValueRefreshed( paramValue != 0 );
-					break;
-				}
-				case ValueID::ValueType_Byte:
-				{
-					ValueByte* valueByte = static_cast<ValueByte*>( value );
-					valueByte->OnValueRefreshed( (uint8)paramValue );
-					break;
-				}
-				case ValueID::ValueType_Short:
+				paramValue <<= 8;
+				paramValue |= (int32)_data[pos+j];
+			}
+
+			uint16 parameter = offset + i;
+			if( parameter > 0xff )
+			{
+				break;
+			}
+			ReportParam( (uint8)parameter, size, paramValue, _instance );
+		}
+		return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Configuration::ReportParam>
+// Update, or create, the value of a parameter reported by the device
+//-----------------------------------------------------------------------------
+void Configuration::ReportParam
+(
+	uint8 const _parameter,
+	uint8 const _size,
+	int32 const _paramValue,
+	uint32 const _instance
+)
+{
+	uint8 parameter = _parameter;
+	uint8 size = _size;
+	int32 paramValue = _paramValue;
+
+	if ( Value* value = GetValue( 1, parameter ) )
+	{
+		switch ( value->GetID().GetType() )
+		{
+			case ValueID::ValueType_Bool:
+			{
+				ValueBool* valueBool = static_cast<ValueBool*>( value );
+				valueBool->OnValueRefreshed( paramValue != 0 );
+				break;
+			}
+			case ValueID::ValueType_Byte:
+			{
+				ValueByte* valueByte = static_cast<ValueByte*>( value );
+				valueByte->OnValueRefreshed( (uint8)paramValue );
+				break;
+			}
+			case ValueID::ValueType_Short:
+			{
+				ValueShort* valueShort = static_cast<ValueShort*>( value );
+				valueShort->OnValueRefreshed( (int16)paramValue );
+				break;
+			}
+			case ValueID::ValueType_Int:
+			{
+				ValueInt* valueInt = static_cast<ValueInt*>( value );
+				valueInt->OnValueRefreshed( paramValue );
+				break;
+			}
+			case ValueID::ValueType_List:
+			{
+				ValueList* valueList = static_cast<ValueList*>( value );
+				valueList->OnValueRefreshed( paramValue );
+				break;
+			}
+			default:
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "Invalid type (%d) for configuration parameter %d", value->GetID().GetType(), parameter );
+			}
+		}
+		value->Release();
+	}
+	else
+	{
+		char label[16];
+		snprintf( label, 16, "Parameter #%d", parameter );
+
+		// Create a new value
+		if( Node* node = GetNodeUnsafe() )
+		{
+			switch( size )
+			{
+				case 1:
 				{
-					ValueShort* valueShort = static_cast<ValueShort*>( value );
-					valueShort->OnValueRefreshed( (int16)paramValue );
+				  	node->CreateValueByte( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (uint8)paramValue, 0 );
 					break;
 				}
-				case ValueID::ValueType_Int:
+				case 2:
 				{
-					ValueInt* valueInt = static_cast<ValueInt*>( value );
-					valueInt->OnValueRefreshed( paramValue );
+				  	node->CreateValueShort( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (int16)paramValue, 0 );
 					break;
 				}
-				case ValueID::ValueType_List:
+				case 4:
 				{
-					ValueList* valueList = static_cast<ValueList*>( value );
-					valueList->OnValueRefreshed( paramValue );
+				  	node->CreateValueInt( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (int32)paramValue, 0 );
 					break;
 				}
 				default:
 				{
-					Log::Write( LogLevel_Info, GetNodeId(), "Invalid type (%d) for configuration parameter %d", value->GetID().GetType(), parameter );
-				}
-			}
-			value->Release();
-		}
-		else
-		{
-			char label[16];
-			snprintf( label, 16, "Parameter #%d", parameter );
-
-			// Create a new value
-			if( Node* node = GetNodeUnsafe() )
-			{
-				switch( size )
-				{
-					case 1:
-					{
-					  	node->CreateValueByte( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (uint8)paramValue, 0 );
-						break;
-					}
-					case 2:
-					{
-					  	node->CreateValueShort( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (int16)paramValue, 0 );
-						break;
-					}
-					case 4:
-					{
-					  	node->CreateValueInt( ValueID::ValueGenre_Config, GetCommandClassId(), _instance, parameter, label, "", false, false, (int32)paramValue, 0 );
-						break;
-					}
-					default:
-					{
-						Log::Write( LogLevel_Info, GetNodeId(), "Invalid size of %d bytes for configuration parameter %d", size, parameter );
-					}
+					Log::Write( LogLevel_Info, GetNodeId(), "Invalid size of %d bytes for configuration parameter %d", size, parameter );
 				}
 			}
 		}
-
-		Log::Write( LogLevel_Info, GetNodeId(), "Received Configuration report: Parameter=%d, Value=%d", parameter, paramValue );
-		return true;
 	}
-
-	return false;
 }
 
 //-----------------------------------------------------------------------------
@@ -275,3 +328,207 @@ void Configuration::Set
 	msg->Append( GetDriver()->GetTransmitOptions() );
 	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
 }
+
+//-----------------------------------------------------------------------------
+// <Configuration::SetParams>
+// Set several parameters, in runs of consecutive parameters where possible
+//-----------------------------------------------------------------------------
+void Configuration::SetParams
+(
+	map<uint8,Param> const& _params
+)
+{
+	map<uint8,Param>::const_iterator it = _params.begin();
+	while( it != _params.end() )
+	{
+		uint16 offset = it->first;
+		uint8 size = it->second.m_size;
+		vector<int32> values;
+		values.push_back( it->second.m_value );
+
+		map<uint8,Param>::const_iterator next = it;
+		++next;
+		if( GetVersion() >= 2 )
+		{
+			// Extend the run while the parameters are consecutive and the same size
+			while( next != _params.end()
+				&& next->first == offset + values.size()
+				&& next->second.m_size == size
+				&& ( values.size() + 1 ) * size <= c_maxBulkBytes )
+			{
+				values.push_back( next->second.m_value );
+				++next;
+			}
+		}
+
+		if( values.size() > 1 )
+		{
+			BulkSet( offset, values, size );
+		}
+		else
+		{
+			Set( (uint8)offset, values[0], size );
+		}
+		it = next;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Configuration::RequestParams>
+// Request several parameters, in runs of consecutive parameters where possible
+//-----------------------------------------------------------------------------
+bool Configuration::RequestParams
+(
+	map<uint8,uint8> const& _params,
+	uint32 const _requestFlags,
+	Driver::MsgQueue const _queue
+)
+{
+	bool requests = false;
+	if( GetVersion() < 2 || !IsGetSupported() )
+	{
+		for( map<uint8,uint8>::const_iterator it = _params.begin(); it != _params.end(); ++it )
+		{
+			requests |= RequestValue( _requestFlags, it->first, 1, _queue );
+		}
+		return requests;
+	}
+
+	map<uint8,uint8>::const_iterator it = _params.begin();
+	while( it != _params.end() )
+	{
+		uint16 offset = it->first;
+		uint8 size = it->second;
+		uint16 count = 1;
+
+		// A Bulk Report holds a single size, so the run ends where the size changes
+		map<uint8,uint8>::const_iterator next = it;
+		++next;
+		if( size != 0 )
+		{
+			while( next != _params.end()
+				&& next->first == offset + count
+				&& next->second == size
+				&& (uint32)( count + 1 ) * size <= c_maxBulkBytes )
+			{
+				++count;
+				++next;
+			}
+		}
+
+		if( count > 1 )
+		{
+			BulkGet( offset, count, _queue );
+			requests = true;
+		}
+		else
+		{
+			requests |= RequestValue( _requestFlags, it->first, 1, _queue );
+		}
+		it = next;
+	}
+	return requests;
+}
+
+//-----------------------------------------------------------------------------
+// <Configuration::GetParamSize>
+// The size of the parameter held by a value
+//-----------------------------------------------------------------------------
+uint8 Configuration::GetParamSize
+(
+	Value const* _value
+)
+{
+	switch( _value->GetID().GetType() )
+	{
+		case ValueID::ValueType_Bool:
+		case ValueID::ValueType_Byte:
+		{
+			return 1;
+		}
+		case ValueID::ValueType_Short:
+		{
+			return 2;
+		}
+		case ValueID::ValueType_Int:
+		{
+			return 4;
+		}
+		case ValueID::ValueType_List:
+		{
+			return static_cast<ValueList const*>( _value )->GetSize();
+		}
+		default:
+		{
+			return 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Configuration::BulkSet>
+// Set a run of consecutive parameters of the same size
+//-----------------------------------------------------------------------------
+void Configuration::BulkSet
+(
+	uint16 const _offset,
+	vector<int32> const& _values,
+	uint8 const _size
+)
+{
+	uint8 count = (uint8)_values.size();
+	Log::Write( LogLevel_Info, GetNodeId(), "Configuration::BulkSet - Parameters=%d-%d, Size=%d", _offset, _offset+count-1, _size );
+
+	Msg* msg = new Msg( "ConfigurationCmd_BulkSet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->Append( GetNodeId() );
+	msg->Append( 6 + count*_size );
+	msg->Append( GetCommandClassId() );
+	msg->Append( ConfigurationCmd_BulkSet );
+	msg->Append( (uint8)( ( _offset>>8 ) & 0xff ) );
+	msg->Append( (uint8)( _offset & 0xff ) );
+	msg->Append( count );
+	msg->Append( _size );
+	for( vector<int32>::const_iterator it = _values.begin(); it != _values.end(); ++it )
+	{
+		for( int32 shift = ( _size - 1 ) * 8; shift >= 0; shift -= 8 )
+		{
+			msg->Append( (uint8)( ( *it>>shift ) & 0xff ) );
+		}
+	}
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
+
+//-----------------------------------------------------------------------------
+// <Configuration::BulkGet>
+// Request a run of consecutive parameters
+//-----------------------------------------------------------------------------
+void Configuration::BulkGet
+(
+	uint16 const _offset,
+	uint16 const _count,
+	Driver::MsgQueue const _queue
+)
+{
+	// The count is a single byte, so a longer run is split
+	uint32 offset = _offset;
+	uint32 remaining = _count;
+	while( remaining > 0 )
+	{
+		uint8 count = ( remaining > 0xff ) ? 0xff : (uint8)remaining;
+
+		Msg* msg = new Msg( "ConfigurationCmd_BulkGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+		msg->Append( GetNodeId() );
+		msg->Append( 5 );
+		msg->Append( GetCommandClassId() );
+		msg->Append( ConfigurationCmd_BulkGet );
+		msg->Append( (uint8)( ( offset>>8 ) & 0xff ) );
+		msg->Append( (uint8)( offset & 0xff ) );
+		msg->Append( count );
+		msg->Append( GetDriver()->GetTransmitOptions() );
+		GetDriver()->SendMsg( msg, _queue );
+
+		offset += count;
+		remaining -= count;
+	}
+}
@@ -29,6 +29,8 @@
 #define _Configuration_H
 
 #include <list>
+#include <map>
+#include <vector>
 #include "command_classes/CommandClass.h"
 
 namespace OpenZWave
@@ -36,6 +38,10 @@ namespace OpenZWave
 	class Value;
 
 	/** \brief Implements COMMAND_CLASS_CONFIGURATION (x70), a Z-Wave device command class.
+	 *
+	 * Devices that support version 2 are sent runs of consecutive parameters
+	 * in Bulk Set and Bulk Get commands.  Other devices are sent a command for
+	 * each parameter.
 	 */
 	class Configuration: public CommandClass
 	{
@@ -48,17 +54,49 @@ namespace OpenZWave
 		static uint8 const StaticGetCommandClassId(){ return 0x70; }
 		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_CONFIGURATION"; }
 
+		struct Param
+		{
+			int32	m_value;
+			uint8	m_size;
+		};
+
 		virtual bool RequestValue( uint32 const _requestFlags, uint8 const _parameter, uint8 const _index, Driver::MsgQueue const _queue );
 		void Set( uint8 const _parameter, int32 const _value, uint8 const _size );
 
+		/**
+		 * Set several parameters, in as few messages as the device allows.
+		 */
+		void SetParams( map<uint8,Param> const& _params );
+
+		/**
+		 * Request several parameters, in as few messages as the device allows.
+		 * \param _params The size in bytes of each parameter, by parameter index.  A size of zero
+		 * means it is not known, and the parameter is requested on its own.
+		 * \return true if any requests were sent.
+		 */
+		bool RequestParams( map<uint8,uint8> const& _params, uint32 const _requestFlags, Driver::MsgQueue const _queue );
+
+		/**
+		 * The size in bytes of the parameter held by a value, or zero if it cannot be told from the value.
+		 */
+		static uint8 GetParamSize( Value const* _value );
+
 		// From CommandClass
 		virtual uint8 const GetCommandClassId()const{ return StaticGetCommandClassId(); }
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
 
+		virtual uint8 GetMaxVersion(){ return 2; }
+
 	private:
 		Configuration( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){}
+
+		void ReportParam( uint8 const _parameter, uint8 const _size, int32 const _paramValue, uint32 const _instance );
+		void BulkSet( uint16 const _offset, vector<int32> const& _values, uint8 const _size );
+		void BulkGet( uint16 const _offset, uint16 const _count, Driver::MsgQueue const _queue );
+
+		static uint32 const c_maxBulkBytes = 32;			// Most parameter bytes sent in one Bulk Set, or asked for in one Bulk Get
 	};
 
 } // namespace OpenZWave
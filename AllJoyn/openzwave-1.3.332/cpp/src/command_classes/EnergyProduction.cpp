@@ -134,7 +134,7 @@ bool EnergyProduction::HandleMsg
 	{
 		uint8 scale;
 		uint8 precision = 0;
-		string value = ExtractValue( &_data[2], &scale, &precision );
+		int32 value = ExtractDecimal( &_data[2], &scale, &precision );
 		uint8 paramType = _data[1];
 		if (paramType > 4) /* size of  c_energyParameterNames minus Invalid Entry*/
 		{
@@ -142,14 +142,12 @@ bool EnergyProduction::HandleMsg
 			return false;
 		}
 
-		Log::Write( LogLevel_Info, GetNodeId(), "Received an Energy production report: %s = %s", c_energyParameterNames[_data[1]], value.c_str() );
+		char valueStr[ValueDecimal::MaxFormatted];
+		ValueDecimal::Format( ValueDecimal::Decimal( value, precision ), valueStr, sizeof(valueStr) );
+		Log::Write( LogLevel_Info, GetNodeId(), "Received an Energy production report: %s = %s", c_energyParameterNames[_data[1]], valueStr );
 		if( ValueDecimal* decimalValue = static_cast<ValueDecimal*>( GetValue( _instance, _data[1] ) ) )
 		{
-			decimalValue->OnValueRefreshed( value );
-			if( decimalValue->GetPrecision() != precision )
-			{
-				decimalValue->SetPrecision( precision );
-			}
+			decimalValue->OnValueRefreshed( value, precision );
 			decimalValue->Release();
 		}
 		return true;
@@ -36,7 +36,10 @@
 #include "Manager.h"
 #include "Driver.h"
 #include "Notification.h"
+#include "ProductIndex.h"
+#include "Utils.h"
 #include "platform/Log.h"
+#include "platform/Mutex.h"
 
 #include "value_classes/ValueStore.h"
 #include "value_classes/ValueString.h"
@@ -49,9 +52,41 @@ enum ManufacturerSpecificCmd
 	ManufacturerSpecificCmd_Report	= 0x05
 };
 
-map<uint16,string> ManufacturerSpecific::s_manufacturerMap;
-map<int64,ManufacturerSpecific::Product*> ManufacturerSpecific::s_productMap;
+Mutex* ManufacturerSpecific::s_mutex = NULL;
+ProductIndex* ManufacturerSpecific::s_productIndex = NULL;
 bool ManufacturerSpecific::s_bXmlLoaded = false;
+map<string,ManufacturerSpecific::ConfigFile> ManufacturerSpecific::s_configCache;
+int32 volatile ManufacturerSpecific::s_instances = 0;
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::CreateLock>
+// Create the mutex shared by the drivers' instances
+//-----------------------------------------------------------------------------
+void ManufacturerSpecific::CreateLock
+(
+)
+{
+	if( s_mutex == NULL )
+	{
+		s_mutex = new Mutex();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::DestroyLock>
+// Free the mutex.  Called once every instance has been deleted.
+//-----------------------------------------------------------------------------
+void ManufacturerSpecific::DestroyLock
+(
+)
+{
+	if( s_mutex != NULL )
+	{
+		UnloadProductXML();
+		s_mutex->Release();
+		s_mutex = NULL;
+	}
+}
 
 //-----------------------------------------------------------------------------
 // <ManufacturerSpecific::RequestState>
@@ -115,6 +150,7 @@ string ManufacturerSpecific::SetProductDetails
 {
 	char str[64];
 
+	LockGuard LG( s_mutex );
 	if (!s_bXmlLoaded) LoadProductXML();
 
 	snprintf( str, sizeof(str), "Unknown: id=%.4x", manufacturerId );
@@ -126,18 +162,18 @@ string ManufacturerSpecific::SetProductDetails
 	string configPath = "";
 
 	// Try to get the real manufacturer and product names
-	map<uint16,string>::iterator mit = s_manufacturerMap.find( manufacturerId );
-	if( mit != s_manufacturerMap.end() )
+	char const* name;
+	if( s_productIndex && ( name = s_productIndex->GetManufacturerName( manufacturerId ) ) )
 	{
 		// Replace the id with the real name
-		manufacturerName = mit->second;
+		manufacturerName = name;
 
 		// Get the product
-		map<int64,Product*>::iterator pit = s_productMap.find( Product::GetKey( manufacturerId, productType, productId ) );
-		if( pit != s_productMap.end() )
+		char const* config;
+		if( s_productIndex->GetProduct( manufacturerId, productType, productId, &name, &config ) )
 		{
-			productName = pit->second->GetProductName();
-			configPath = pit->second->GetConfigPath();
+			productName = name;
+			configPath = config;
 		}
 	}
 
@@ -225,118 +261,33 @@ bool ManufacturerSpecific::LoadProductXML
 {
 	s_bXmlLoaded = true;
 
-	// Parse the Z-Wave manufacturer and product XML file.
+	// Use the compiled index of the Z-Wave manufacturer and product XML file,
+	// preferring one written to the user path over one shipped with the config
 	string configPath;
 	Options::Get()->GetOptionAsString( "ConfigPath", &configPath );
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
 
 	string filename =  configPath + "manufacturer_specific.xml";
+	string indexName = "manufacturer_specific.bin";
 
-	TiXmlDocument* pDoc = new TiXmlDocument();
-	if( !pDoc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	s_productIndex = ProductIndex::Open( userPath + indexName, filename );
+	if( s_productIndex == NULL )
 	{
-		delete pDoc;
-		Log::Write( LogLevel_Info, "Unable to load %s", filename.c_str() );
-		return false;
+		s_productIndex = ProductIndex::Open( configPath + indexName, filename );
 	}
-
-	TiXmlElement const* root = pDoc->RootElement();
-
-	char const* str;
-	char* pStopChar;
-
-	TiXmlElement const* manufacturerElement = root->FirstChildElement();
-	while( manufacturerElement )
+	if( s_productIndex == NULL )
 	{
-		str = manufacturerElement->Value();
-		if( str && !strcmp( str, "Manufacturer" ) )
+		// Compile the XML, and keep the index for next time
+		Log::Write( LogLevel_Info, "Compiling %s", filename.c_str() );
+		s_productIndex = ProductIndex::Create( filename, userPath + indexName );
+		if( s_productIndex == NULL )
 		{
-			// Read in the manufacturer attributes
-			str = manufacturerElement->Attribute( "id" );
-			if( !str )
-			{
-				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer id attribute", manufacturerElement->Row() );
-				delete pDoc;
-				return false;
-			}
-			uint16 manufacturerId = (uint16)strtol( str, &pStopChar, 16 );
-
-			str = manufacturerElement->Attribute( "name" );
-			if( !str )
-			{
-				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer name attribute", manufacturerElement->Row() );
-				delete pDoc;
-				return false;
-			}
-
-			// Add this manufacturer to the map
-			s_manufacturerMap[manufacturerId] = str;
-
-			// Parse all the products for this manufacturer
-			TiXmlElement const* productElement = manufacturerElement->FirstChildElement();
-			while( productElement )
-			{
-				str = productElement->Value();
-				if( str && !strcmp( str, "Product" ) )
-				{
-					str = productElement->Attribute( "type" );
-					if( !str )
-					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product type attribute", productElement->Row() );
-						delete pDoc;
-						return false;
-					}
-					uint16 productType = (uint16)strtol( str, &pStopChar, 16 );
-
-					str = productElement->Attribute( "id" );
-					if( !str )
-					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product id attribute", productElement->Row() );
-						delete pDoc;
-						return false;
-					}
-					uint16 productId = (uint16)strtol( str, &pStopChar, 16 );
-
-					str = productElement->Attribute( "name" );
-					if( !str )
-					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product name attribute", productElement->Row() );
-						delete pDoc;
-						return false;
-					}
-					string productName = str;
-
-					// Optional config path
-					string configPath;
-					str = productElement->Attribute( "config" );
-					if( str )
-					{
-						configPath = str;
-					}
-
-					// Add the product to the map
-					Product* product = new Product( manufacturerId, productType, productId, productName, configPath );
-					if ( s_productMap[product->GetKey()] != NULL )
-					{
-						Product *c = s_productMap[product->GetKey()];
-						Log::Write( LogLevel_Info, "Product name collision: %s type %x id %x manufacturerid %x, collides with %s, type %x id %x manufacturerid %x", productName.c_str(), productType, productId, manufacturerId, c->GetProductName().c_str(), c->GetProductType(), c->GetProductId(), c->GetManufacturerId());
-						delete product;
-					}
-					else
-					{
-						s_productMap[product->GetKey()] = product;
-					}
-				}
-
-				// Move on to the next product.
-				productElement = productElement->NextSiblingElement();
-			}
+			return false;
 		}
-
-		// Move on to the next manufacturer.
-		manufacturerElement = manufacturerElement->NextSiblingElement();
 	}
 
-	delete pDoc;
+	Log::Write( LogLevel_Info, "Loaded %d manufacturers and %d products", s_productIndex->GetManufacturerCount(), s_productIndex->GetProductCount() );
 	return true;
 }
 
@@ -348,22 +299,17 @@ void ManufacturerSpecific::UnloadProductXML
 (
 )
 {
+	LockGuard LG( s_mutex );
 	if (s_bXmlLoaded)
 	{
-		map<int64,Product*>::iterator pit = s_productMap.begin();
-		while( !s_productMap.empty() )
-		{
-		  	delete pit->second;
-			s_productMap.erase( pit );
-			pit = s_productMap.begin();
-		}
+		delete s_productIndex;
+		s_productIndex = NULL;
 
-		map<uint16,string>::iterator mit = s_manufacturerMap.begin();
-		while( !s_manufacturerMap.empty() )
+		for( map<string,ConfigFile>::iterator cit = s_configCache.begin(); cit != s_configCache.end(); ++cit )
 		{
-			s_manufacturerMap.erase( mit );
-			mit = s_manufacturerMap.begin();
+			delete cit->second.m_doc;
 		}
+		s_configCache.clear();
 
 		s_bXmlLoaded = false;
 	}
@@ -384,29 +330,55 @@ bool ManufacturerSpecific::LoadConfigXML
 
 	string filename =  configPath + _configXML;
 
-	TiXmlDocument* doc = new TiXmlDocument();
-	Log::Write( LogLevel_Info, _node->GetNodeId(), "  Opening config param file %s", filename.c_str() );
-	if( !doc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	// Nodes of the same product share one parsed copy of the file while
+	// they are being interviewed.  A file that failed to load is not kept,
+	// so that a file added or fixed later is picked up.
+	LockGuard LG( s_mutex );
+	map<string,ConfigFile>::iterator cit = s_configCache.find( filename );
+	if( cit != s_configCache.end() )
 	{
-		delete doc;
-		Log::Write( LogLevel_Info, _node->GetNodeId(), "Unable to find or load Config Param file %s", filename.c_str() );
-		return false;
+		Log::Write( LogLevel_Info, _node->GetNodeId(), "  Using cached config param file %s", filename.c_str() );
+	}
+	else
+	{
+		TiXmlDocument* doc = new TiXmlDocument();
+		Log::Write( LogLevel_Info, _node->GetNodeId(), "  Opening config param file %s", filename.c_str() );
+		if( !doc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+		{
+			delete doc;
+			Log::Write( LogLevel_Info, _node->GetNodeId(), "Unable to find or load Config Param file %s", filename.c_str() );
+			return false;
+		}
+		cit = s_configCache.insert( pair<string,ConfigFile>( filename, ConfigFile() ) ).first;
+		cit->second.m_doc = doc;
 	}
+
+	ConfigFile& file = cit->second;
+	pair<uint32,uint8> key( _node->m_homeId, _node->GetNodeId() );
 	Node::QueryStage qs = _node->GetCurrentQueryStage();
 	if( qs == Node::QueryStage_ManufacturerSpecific1 )
 	{
-		_node->ReadDeviceProtocolXML( doc->RootElement() );
+		// The command classes are read from the file later in the interview
+		_node->ReadDeviceProtocolXML( file.m_doc->RootElement() );
+		file.m_nodes.insert( key );
 	}
 	else
 	{
 		if( !_node->m_manufacturerSpecificClassReceived )
 		{
-			_node->ReadDeviceProtocolXML( doc->RootElement() );
+			_node->ReadDeviceProtocolXML( file.m_doc->RootElement() );
+		}
+		_node->ReadCommandClassesXML( file.m_doc->RootElement() );
+
+		// This node is configured.  Free the file if no other node is waiting for it.
+		file.m_nodes.erase( key );
+		if( file.m_nodes.empty() )
+		{
+			delete file.m_doc;
+			s_configCache.erase( cit );
 		}
-		_node->ReadCommandClassesXML( doc->RootElement() );
 	}
 
-	delete doc;
 	return true;
 }
 
@@ -420,23 +392,20 @@ void ManufacturerSpecific::ReLoadConfigXML
 {
 	if( Node* node = GetNodeUnsafe() )
 	{
+		LockGuard LG( s_mutex );
 		if (!s_bXmlLoaded) LoadProductXML();
 
 		uint16 manufacturerId = (uint16)strtol( node->GetManufacturerId().c_str(), NULL, 16 );
 		uint16 productType = (uint16)strtol( node->GetProductType().c_str(), NULL, 16 );
 		uint16 productId = (uint16)strtol( node->GetProductId().c_str(), NULL, 16 );
 
-		map<uint16,string>::iterator mit = s_manufacturerMap.find( manufacturerId );
-		if( mit != s_manufacturerMap.end() )
+		char const* name;
+		char const* configPath;
+		if( s_productIndex && s_productIndex->GetProduct( manufacturerId, productType, productId, &name, &configPath ) )
 		{
-			map<int64,Product*>::iterator pit = s_productMap.find( Product::GetKey( manufacturerId, productType, productId ) );
-			if( pit != s_productMap.end() )
+			if( configPath[0] != 0 )
 			{
-				string configPath = pit->second->GetConfigPath();
-				if( configPath.size() > 0 )
-				{
-					LoadConfigXML( node, configPath );
-				}
+				LoadConfigXML( node, configPath );
 			}
 		}
 	}
@@ -29,17 +29,24 @@
 #define _ManufacturerSpecific_H
 
 #include <map>
+#include <set>
 #include "command_classes/CommandClass.h"
+#include "platform/Atomic.h"
+
+class TiXmlDocument;
 
 namespace OpenZWave
 {
+	class ProductIndex;
+	class Mutex;
+
 	/** \brief Implements COMMAND_CLASS_MANUFACTURER_SPECIFIC (0x72), a Z-Wave device command class.
 	 */
 	class ManufacturerSpecific: public CommandClass
 	{
 	public:
 		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new ManufacturerSpecific( _homeId, _nodeId ); }
-		virtual ~ManufacturerSpecific(){ UnloadProductXML(); }
+		virtual ~ManufacturerSpecific(){ if( AtomicDecrement( &s_instances ) == 0 ) UnloadProductXML(); }
 
 		static uint8 const StaticGetCommandClassId(){ return 0x72; }
 		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_MANUFACTURER_SPECIFIC"; }
@@ -57,57 +64,28 @@ namespace OpenZWave
 		void ReLoadConfigXML();
 
 	private:
-		ManufacturerSpecific( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){ SetStaticRequest( StaticRequest_Values ); }
+		friend class Manager;
+
+		ManufacturerSpecific( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){ AtomicIncrement( &s_instances ); SetStaticRequest( StaticRequest_Values ); }
+		static void CreateLock();
+		static void DestroyLock();
 		static bool LoadProductXML();
 		static void UnloadProductXML();
 
-		class Product
+		// A parsed device config file, and the nodes that have read its protocol
+		// details but not yet its command classes.  The file is freed once none
+		// are left, so only the interviews under way keep it in memory.
+		struct ConfigFile
 		{
-		public:
-			Product
-			( 
-				uint16 _manufacturerId,
-				uint16 _productType,
-				uint16 _productId,
-				string const& _productName,
-				string const& _configPath
-			):	
-				m_manufacturerId( _manufacturerId ),
-				m_productType( _productType ),
-				m_productId( _productId ),
-				m_productName( _productName ),
-				m_configPath( _configPath )
-			{
-			}
-
-			int64 GetKey()const
-			{
-				return( GetKey( m_manufacturerId, m_productType, m_productId ) );
-			}
-
-			static int64 GetKey( uint16 _manufacturerId, uint16 _productType, uint16 _productId )
-			{
-				int64 key = (((int64)_manufacturerId)<<32) | (((int64)_productType)<<16) | (int64)_productId;
-				return key;
-			}
-
-			uint16 GetManufacturerId()const{ return m_manufacturerId; }
-			uint16 GetProductType()const{ return m_productType; }
-			uint16 GetProductId()const{ return m_productId; }
-			string GetProductName()const{ return m_productName; }
-			string GetConfigPath()const{ return m_configPath; }
-
-		private:
-			uint16	m_manufacturerId;
-			uint16	m_productType;
-			uint16	m_productId;
-			string	m_productName;
-			string	m_configPath;
+			TiXmlDocument*				m_doc;
+			set< pair<uint32,uint8> >	m_nodes;		// Home and node ids
 		};
 
-		static map<uint16,string>	s_manufacturerMap;
-		static map<int64,Product*>	s_productMap;
+		static Mutex*				s_mutex;				// Protects the product index and the config cache
+		static ProductIndex*		s_productIndex;			// Manufacturer and product names, and config paths
 		static bool					s_bXmlLoaded;
+		static map<string,ConfigFile>	s_configCache;		// Parsed device config files, by path
+		static int32 volatile		s_instances;			// The product data is unloaded when the last instance is deleted
 	};
 
 } // namespace OpenZWave
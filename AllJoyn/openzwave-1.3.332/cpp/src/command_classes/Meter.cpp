@@ -151,7 +151,7 @@ bool Meter::RequestState
 	bool res = false;
 	if( GetVersion() > 1 )
 	{
-		if( _requestFlags & RequestFlag_Static )
+		if( ( _requestFlags & RequestFlag_Static ) && HasStaticRequest( StaticRequest_Values ) )
 		{
  			Msg* msg = new Msg( "MeterCmd_SupportedGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
 			msg->SetInstance( this, _instance );
@@ -259,6 +259,7 @@ bool Meter::HandleSupportedReport
 
 
 	ClearStaticRequest( StaticRequest_Version );
+	ClearStaticRequest( StaticRequest_Values );
 	if( Node* node = GetNodeUnsafe() )
 	{
 		string msg;
@@ -380,7 +381,9 @@ bool Meter::HandleReport
 	// Get the value and scale
 	uint8 scale;
 	uint8 precision = 0;
-	string valueStr = ExtractValue( &_data[2], &scale, &precision );
+	int32 reading = ExtractDecimal( &_data[2], &scale, &precision );
+	char valueStr[ValueDecimal::MaxFormatted];
+	ValueDecimal::Format( ValueDecimal::Decimal( reading, precision ), valueStr, sizeof(valueStr) );
 
 	if (scale > 7) /* size of c_electricityLabels, c_electricityUnits, c_gasUnits, c_waterUnits */
 	{
@@ -432,14 +435,10 @@ bool Meter::HandleReport
 
 		if( ValueDecimal* value = static_cast<ValueDecimal*>( GetValue( _instance, 0 ) ) )
 		{
-			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s=%s%s", GetNodeId(), label.c_str(), valueStr.c_str(), units.c_str() );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s=%s%s", GetNodeId(), label.c_str(), valueStr, units.c_str() );
 			value->SetLabel( label );
 			value->SetUnits( units );
-			value->OnValueRefreshed( valueStr );
-			if( value->GetPrecision() != precision )
-			{
-				value->SetPrecision( precision );
-			}
+			value->OnValueRefreshed( reading, precision );
 			value->Release();
 		}
 	}
@@ -456,12 +455,8 @@ bool Meter::HandleReport
 
 		if( ValueDecimal* value = static_cast<ValueDecimal*>( GetValue( _instance, baseIndex ) ) )
 		{
-			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s%s=%s%s", GetNodeId(), exporting ? "Exporting ": "", value->GetLabel().c_str(), valueStr.c_str(), value->GetUnits().c_str() );
-			value->OnValueRefreshed( valueStr );
-			if( value->GetPrecision() != precision )
-			{
-				value->SetPrecision( precision );
-			}
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s%s=%s%s", GetNodeId(), exporting ? "Exporting ": "", value->GetLabel().c_str(), valueStr, value->GetUnits().c_str() );
+			value->OnValueRefreshed( reading, precision );
 			value->Release();
 
 			// Read any previous value and time delta
@@ -484,13 +479,10 @@ bool Meter::HandleReport
 				if( previous )
 				{
 					precision = 0;
-					valueStr = ExtractValue( &_data[2], &scale, &precision, 3+size );
-					Log::Write( LogLevel_Info, GetNodeId(), "    Previous value was %s%s, received %d seconds ago.", valueStr.c_str(), previous->GetUnits().c_str(), delta );
-					previous->OnValueRefreshed( valueStr );
-					if( previous->GetPrecision() != precision )
-					{
-						previous->SetPrecision( precision );
-					}
+					reading = ExtractDecimal( &_data[2], &scale, &precision, 3+size );
+					ValueDecimal::Format( ValueDecimal::Decimal( reading, precision ), valueStr, sizeof(valueStr) );
+					Log::Write( LogLevel_Info, GetNodeId(), "    Previous value was %s%s, received %d seconds ago.", valueStr, previous->GetUnits().c_str(), delta );
+					previous->OnValueRefreshed( reading, precision );
 					previous->Release();
 				}
 
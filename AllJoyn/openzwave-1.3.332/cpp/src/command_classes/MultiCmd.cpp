@@ -35,6 +35,11 @@
 
 using namespace OpenZWave;
 
+// Largest command that can be sent in a single frame over a fully routed path
+static uint32 const c_maxEncapLength = 46;
+
+// Command class id, command and count bytes at the start of an encapsulated command
+static uint32 const c_encapHeaderLength = 3;
 
 //-----------------------------------------------------------------------------
 // <MultiCmd::HandleMsg>
@@ -75,3 +80,122 @@ bool MultiCmd::HandleMsg
 	return false;
 }
 
+
+//-----------------------------------------------------------------------------
+// <MultiCmd::CanEncapsulate>
+// Check that a message may be added to a multi-command frame
+//-----------------------------------------------------------------------------
+bool MultiCmd::CanEncapsulate
+(
+	Msg* _msg,
+	uint32* _encapLength
+)
+{
+	if( _msg->isEncrypted() || _msg->IsWakeUpNoMoreInformationCommand() || _msg->IsNoOperation() )
+	{
+		return false;
+	}
+
+	uint8 const* buffer = _msg->GetBuffer();
+	if( buffer[3] != FUNC_ID_ZW_SEND_DATA || buffer[6] == StaticGetCommandClassId() )
+	{
+		return false;
+	}
+
+	// Each command is preceded by its length
+	uint32 length = ( *_encapLength ? *_encapLength : c_encapHeaderLength ) + 1 + buffer[5];
+	if( length > c_maxEncapLength )
+	{
+		return false;
+	}
+
+	*_encapLength = length;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <MultiCmd::Encapsulate>
+// Pack several messages for one node into a single multi-command message
+//-----------------------------------------------------------------------------
+Msg* MultiCmd::Encapsulate
+(
+	uint32 const _homeId,
+	list<Msg*> const& _msgs
+)
+{
+	Msg* first = _msgs.front();
+	uint8 nodeId = first->GetTargetNodeId();
+	uint8 transmitOptions = first->GetBuffer()[6+first->GetBuffer()[5]];
+
+	// Wait for the last report that any of the commands asks for
+	uint8 expectedReply = FUNC_ID_ZW_SEND_DATA;
+	uint8 expectedCommandClassId = 0;
+	uint8 maxSendAttempts = first->GetMaxSendAttempts();
+	uint32 length = c_encapHeaderLength;
+	list<Msg*>::const_iterator it;
+	for( it = _msgs.begin(); it != _msgs.end(); ++it )
+	{
+		if( (*it)->GetExpectedReply() == FUNC_ID_APPLICATION_COMMAND_HANDLER )
+		{
+			expectedReply = FUNC_ID_APPLICATION_COMMAND_HANDLER;
+			expectedCommandClassId = (*it)->GetExpectedCommandClassId();
+		}
+		if( (*it)->GetMaxSendAttempts() > maxSendAttempts )
+		{
+			maxSendAttempts = (*it)->GetMaxSendAttempts();
+		}
+		length += 1 + (*it)->GetBuffer()[5];
+	}
+
+	char str[64];
+	snprintf( str, sizeof(str), "MultiCmdCmd_Encap (%d commands)", (int)_msgs.size() );
+
+	Msg* msg = new Msg( string( str ), nodeId, REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, expectedReply, expectedCommandClassId );
+	msg->Append( nodeId );
+	msg->Append( (uint8)length );
+	msg->Append( StaticGetCommandClassId() );
+	msg->Append( MultiCmdCmd_Encap );
+	msg->Append( (uint8)_msgs.size() );
+	for( it = _msgs.begin(); it != _msgs.end(); ++it )
+	{
+		uint8 const* buffer = (*it)->GetBuffer();
+		msg->Append( buffer[5] );
+		for( uint8 i=0; i<buffer[5]; ++i )
+		{
+			msg->Append( buffer[6+i] );
+		}
+	}
+	msg->Append( transmitOptions );
+	msg->SetMaxSendAttempts( maxSendAttempts );
+	msg->SetHomeId( _homeId );
+	msg->Finalize();
+	return msg;
+}
+
+//-----------------------------------------------------------------------------
+// <MultiCmd::Contains>
+// Look for a command class among the commands in a multi-command frame
+//-----------------------------------------------------------------------------
+bool MultiCmd::Contains
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint8 const _commandClassId
+)
+{
+	if( _length < 2 || MultiCmdCmd_Encap != (MultiCmdCmd)_data[0] )
+	{
+		return false;
+	}
+
+	uint32 base = 2;
+	for( uint8 i=0; i<_data[1] && base+1 < _length; ++i )
+	{
+		if( _data[base+1] == _commandClassId )
+		{
+			return true;
+		}
+		base += ( _data[base] + 1 );
+	}
+	return false;
+}
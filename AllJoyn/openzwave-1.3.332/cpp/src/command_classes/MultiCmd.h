@@ -32,7 +32,13 @@
 
 namespace OpenZWave
 {
+	class Msg;
+
 	/** \brief Implements COMMAND_CLASS_MULTI_CMD (0x8f), a Z-Wave device command class.
+	 *
+	 * As well as unpacking encapsulated commands from a device, this class can pack
+	 * several queued messages for the same device into a single frame, so that a
+	 * sleeping or routed node is sent one frame instead of many.
 	 */
 	class MultiCmd: public CommandClass
 	{
@@ -53,6 +59,33 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 
+		/**
+		 * Determine whether a queued message can be added to a Multi Command Encapsulation frame.
+		 * Only unencrypted ZW_SEND_DATA messages are eligible, and never a Wake Up No More
+		 * Information or No Operation, since those must be sent on their own.
+		 * \param _msg the finalized message.
+		 * \param _encapLength the length of the encapsulated command so far, or zero for an
+		 * empty frame.  It is updated if the message fits.
+		 * \return true if the message is eligible and fits in the frame.
+		 */
+		static bool CanEncapsulate( Msg* _msg, uint32* _encapLength );
+
+		/**
+		 * Pack several messages for the same node into a Multi Command Encapsulation message.
+		 * Each message must have passed CanEncapsulate.  The messages are not deleted.
+		 * The new message expects the report requested by the last message that expects one.
+		 * \return the new, finalized, message.
+		 */
+		static Msg* Encapsulate( uint32 const _homeId, list<Msg*> const& _msgs );
+
+		/**
+		 * Determine whether an encapsulated command from a device contains a command of a given class.
+		 * \param _data the encapsulated command, starting at the MultiCmdCmd_Encap byte.
+		 * \param _length the number of bytes in _data.
+		 * \param _commandClassId the command class to look for.
+		 */
+		static bool Contains( uint8 const* _data, uint32 const _length, uint8 const _commandClassId );
+
 	private:
 		MultiCmd( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){}
 	};
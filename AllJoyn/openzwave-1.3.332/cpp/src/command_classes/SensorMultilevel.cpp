@@ -184,7 +184,7 @@ bool SensorMultilevel::RequestState
 	bool res = false;
 	if( GetVersion() > 4 )
 	{
-		if( _requestFlags & RequestFlag_Static )
+		if( ( _requestFlags & RequestFlag_Static ) && HasStaticRequest( StaticRequest_Values ) )
 		{
 			Msg* msg = new Msg( "SensorMultilevelCmd_SupportedGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
 			msg->SetInstance( this, _instance );
@@ -301,13 +301,14 @@ bool SensorMultilevel::HandleMsg
 			}
 		}
 		Log::Write( LogLevel_Info, GetNodeId(), "Received SensorMultiLevel supported report from node %d: %s", GetNodeId(), msg.c_str() );
+		ClearStaticRequest( StaticRequest_Values );
 	}
 	else if (SensorMultilevelCmd_Report == (SensorMultilevelCmd)_data[0])
 	{
 		uint8 scale;
 		uint8 precision = 0;
 		uint8 sensorType = _data[1];
-		string valueStr = ExtractValue( &_data[2], &scale, &precision );
+		int32 reading = ExtractDecimal( &_data[2], &scale, &precision );
 
 		Node* node = GetNodeUnsafe();
 		if( node != NULL )
@@ -431,12 +432,10 @@ bool SensorMultilevel::HandleMsg
 				value->SetUnits(units);
 			}
 
-			Log::Write( LogLevel_Info, GetNodeId(), "Received SensorMultiLevel report from node %d, instance %d, %s: value=%s%s", GetNodeId(), _instance, c_sensorTypeNames[sensorType], valueStr.c_str(), value->GetUnits().c_str() );
-			if( value->GetPrecision() != precision )
-			{
-				value->SetPrecision( precision );
-			}
-			value->OnValueRefreshed( valueStr );
+			char valueStr[ValueDecimal::MaxFormatted];
+			ValueDecimal::Format( ValueDecimal::Decimal( reading, precision ), valueStr, sizeof(valueStr) );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received SensorMultiLevel report from node %d, instance %d, %s: value=%s%s", GetNodeId(), _instance, c_sensorTypeNames[sensorType], valueStr, value->GetUnits().c_str() );
+			value->OnValueRefreshed( reading, precision );
 			value->Release();
 			return true;
 		}
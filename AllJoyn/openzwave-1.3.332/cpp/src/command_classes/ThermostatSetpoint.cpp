@@ -228,17 +228,15 @@ bool ThermostatSetpoint::HandleMsg
 		{
 			uint8 scale;
 			uint8 precision = 0;
-			string temperature = ExtractValue( &_data[2], &scale, &precision );
+			int32 temperature = ExtractDecimal( &_data[2], &scale, &precision );
 
 			value->SetUnits( scale ? "F" : "C" );
-			value->OnValueRefreshed( temperature );
-			if( value->GetPrecision() != precision )
-			{
-				value->SetPrecision( precision );
-			}
-			value->Release();
+			value->OnValueRefreshed( temperature, precision );
 
-			Log::Write( LogLevel_Info, GetNodeId(), "Received thermostat setpoint report: Setpoint %s = %s%s", value->GetLabel().c_str(), value->GetValue().c_str(), value->GetUnits().c_str() );
+			char valueStr[ValueDecimal::MaxFormatted];
+			ValueDecimal::Format( value->GetDecimal(), valueStr, sizeof(valueStr) );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received thermostat setpoint report: Setpoint %s = %s%s", value->GetLabel().c_str(), valueStr, value->GetUnits().c_str() );
+			value->Release();
 		}
 		return true;
 	}
@@ -43,7 +43,13 @@ enum UserCodeCmd
 	UserCodeCmd_Get			= 0x02,
 	UserCodeCmd_Report		= 0x03,
 	UserNumberCmd_Get		= 0x04,
-	UserNumberCmd_Report		= 0x05
+	UserNumberCmd_Report		= 0x05,
+	UserCodeCmd_CapabilitiesGet	= 0x06,
+	UserCodeCmd_CapabilitiesReport	= 0x07,
+	UserCodeCmd_ExtendedGet		= 0x0c,
+	UserCodeCmd_ExtendedReport	= 0x0d,
+	UserCodeCmd_ChecksumGet		= 0x11,
+	UserCodeCmd_ChecksumReport	= 0x12
 };
 
 enum
@@ -67,7 +73,12 @@ UserCode::UserCode
 	m_queryAll( false ),
 	m_currentCode( 0 ),
 	m_userCodeCount( 0 ),
-	m_refreshUserCodes(false)
+	m_refreshUserCodes(false),
+	m_checksumSupported( false ),
+	m_checksumValid( false ),
+	m_checksumPending( false ),
+	m_checksum( 0 ),
+	m_pendingChecksum( 0 )
 {
 	SetStaticRequest( StaticRequest_Values );
 	memset( m_userCodesStatus, 0xff, sizeof(m_userCodesStatus) );
@@ -89,7 +100,36 @@ void UserCode::ReadXML
 	CommandClass::ReadXML( _ccElement );
 	if( TIXML_SUCCESS == _ccElement->QueryIntAttribute( "codes", &intVal ) )
 	{
-		m_userCodeCount = intVal;
+		m_userCodeCount = ( intVal > 254 ) ? 254 : (uint8)intVal;
+	}
+
+	// The status of each slot, which is not fetched again while the checksum is unchanged
+	char const* status = _ccElement->Attribute( "status" );
+	if( status )
+	{
+		for( uint32 i=0; i<=m_userCodeCount; ++i )
+		{
+			char* ep = NULL;
+			uint32 val = (uint32)strtol( status, &ep, 16 );
+			if( status == ep || val >= 256 )
+			{
+				break;
+			}
+			m_userCodesStatus[i] = (uint8)val;
+			status = ep;
+		}
+	}
+
+	char const* str = _ccElement->Attribute( "checksum_support" );
+	if( str )
+	{
+		m_checksumSupported = !strcmp( str, "true" );
+	}
+
+	if( TIXML_SUCCESS == _ccElement->QueryIntAttribute( "checksum", &intVal ) )
+	{
+		m_checksum = (uint16)intVal;
+		m_checksumValid = true;
 	}
 }
 
@@ -107,6 +147,28 @@ void UserCode::WriteXML
 	CommandClass::WriteXML( _ccElement );
 	snprintf( str, sizeof(str), "%d", m_userCodeCount );
 	_ccElement->SetAttribute( "codes", str);
+
+	if( m_userCodeCount > 0 )
+	{
+		string status;
+		for( uint32 i=0; i<=m_userCodeCount; ++i )
+		{
+			snprintf( str, sizeof(str), i ? " 0x%.2x" : "0x%.2x", m_userCodesStatus[i] );
+			status += str;
+		}
+		_ccElement->SetAttribute( "status", status.c_str() );
+	}
+
+	if( m_checksumSupported )
+	{
+		_ccElement->SetAttribute( "checksum_support", "true" );
+	}
+
+	if( m_checksumValid )
+	{
+		snprintf( str, sizeof(str), "%d", m_checksum );
+		_ccElement->SetAttribute( "checksum", str );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -124,6 +186,18 @@ bool UserCode::RequestState
 	if( ( _requestFlags & RequestFlag_Static ) && HasStaticRequest( StaticRequest_Values ) )
 	{
 		requests |= RequestValue( _requestFlags, UserCodeIndex_Count, _instance, _queue );
+		if( ( GetVersion() >= 2 ) && IsGetSupported() && ( _instance == 1 ) )
+		{
+			// Find out whether the device can report a checksum of its codes
+			Msg* msg = new Msg( "UserCodeCmd_CapabilitiesGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+			msg->Append( GetNodeId() );
+			msg->Append( 2 );
+			msg->Append( GetCommandClassId() );
+			msg->Append( UserCodeCmd_CapabilitiesGet );
+			msg->Append( GetDriver()->GetTransmitOptions() );
+			GetDriver()->SendMsg( msg, _queue );
+			requests = true;
+		}
 	}
 
 	if( _requestFlags & RequestFlag_Session )
@@ -132,7 +206,15 @@ bool UserCode::RequestState
 		{
 			m_queryAll = true;
 			m_currentCode = 1;
-			requests |= RequestValue( _requestFlags, m_currentCode, _instance, _queue );
+			if( ( GetVersion() >= 2 ) && m_checksumSupported )
+			{
+				// The codes are only fetched if the checksum shows they have changed
+				requests |= RequestChecksum( _instance, _queue );
+			}
+			else
+			{
+				requests |= RequestCodes( _instance, _queue );
+			}
 		}
 	}
 
@@ -249,20 +331,7 @@ bool UserCode::HandleMsg
 	else if( UserCodeCmd_Report == (UserCodeCmd)_data[0] )
 	{
 		int i = _data[1];
-		if( ValueRaw* value = static_cast<ValueRaw*>( GetValue( _instance, i ) ) )
-		{
-			uint8 data[UserCodeLength];
-			uint8 size = _length - 4;
-			if( size > UserCodeLength )
-			{
-				Log::Write( LogLevel_Warning, GetNodeId(), "User Code length %d is larger then maximum %d", size, UserCodeLength );
-				size = UserCodeLength;
-			}
-			m_userCodesStatus[i] = _data[2];
-			memcpy( data, &_data[3], size );
-			value->OnValueRefreshed( data, size );
-			value->Release();
-		}
+		StoreCode( _instance, i, _data[2], &_data[3], _length - 4 );
 		Log::Write( LogLevel_Info, GetNodeId(), "Received User Code Report from node %d for User Code %d (%s)", GetNodeId(), i, CodeStatus( _data[2] ).c_str() );
 		if( m_queryAll && i == m_currentCode )
 		{
@@ -270,8 +339,8 @@ bool UserCode::HandleMsg
 			if (m_refreshUserCodes || (_data[2] != UserCode_Available)) {
 				if( ++i <= m_userCodeCount )
 				{
-					m_currentCode = i;
-					RequestValue( 0, m_currentCode, _instance, Driver::MsgQueue_Query );
+					m_currentCode = (uint16)i;
+					RequestValue( 0, (uint8)m_currentCode, _instance, Driver::MsgQueue_Query );
 				}
 				else
 				{
@@ -286,10 +355,256 @@ bool UserCode::HandleMsg
 		}
 		return true;
 	}
+	else if( UserCodeCmd_CapabilitiesReport == (UserCodeCmd)_data[0] )
+	{
+		// The checksum flag follows the master code flags and the status bitmask
+		uint32 pos = 2 + ( _data[1] & 0x1f );
+		m_checksumSupported = ( pos < _length-1 ) && ( ( _data[pos] & 0x80 ) != 0 );
+		Log::Write( LogLevel_Info, GetNodeId(), "Received User Code Capabilities report from node %d: Checksum %s", GetNodeId(), m_checksumSupported ? "supported" : "not supported" );
+		return true;
+	}
+	else if( UserCodeCmd_ChecksumReport == (UserCodeCmd)_data[0] )
+	{
+		uint16 checksum = (((uint16)_data[1])<<8) | (uint16)_data[2];
+		if( !m_queryAll )
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received User Code Checksum report from node %d: 0x%.4x", GetNodeId(), checksum );
+		}
+		else if( m_checksumValid && ( checksum == m_checksum ) )
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received User Code Checksum report from node %d: 0x%.4x, codes unchanged", GetNodeId(), checksum );
+			m_queryAll = false;
+		}
+		else
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received User Code Checksum report from node %d: 0x%.4x, codes have changed", GetNodeId(), checksum );
+			m_pendingChecksum = checksum;
+			m_checksumPending = true;
+			RequestCodes( _instance, Driver::MsgQueue_Query );
+		}
+		return true;
+	}
+	else if( UserCodeCmd_ExtendedReport == (UserCodeCmd)_data[0] )
+	{
+		// Each code is its user id, status, length and the code itself
+		uint8 count = _data[1];
+		uint32 pos = 2;
+		for( uint8 c=0; c<count; ++c )
+		{
+			if( pos+4 > _length-1 )
+			{
+				break;
+			}
+			uint16 id = (((uint16)_data[pos])<<8) | (uint16)_data[pos+1];
+			uint8 status = _data[pos+2];
+			uint8 size = _data[pos+3] & 0x0f;
+			pos += 4;
+			if( pos+size > _length-1 )
+			{
+				Log::Write( LogLevel_Warning, GetNodeId(), "Extended User Code Report from node %d is truncated", GetNodeId() );
+				break;
+			}
+
+			StoreCode( _instance, id, status, &_data[pos], size );
+			if( m_queryAll && ( id >= m_currentCode ) && ( id <= m_userCodeCount ) )
+			{
+				// Slots skipped over by the device are available.  Once the last
+				// slot is reached, m_currentCode is past the end and the query ends.
+				ClearCodes( _instance, m_currentCode, id );
+				m_currentCode = id+1;
+			}
+			pos += size;
+		}
+
+		uint16 next = 0;
+		if( pos+2 <= _length-1 )
+		{
+			next = (((uint16)_data[pos])<<8) | (uint16)_data[pos+1];
+		}
+		Log::Write( LogLevel_Info, GetNodeId(), "Received Extended User Code Report from node %d: %d codes, next code %d", GetNodeId(), count, next );
+
+		if( m_queryAll )
+		{
+			if( ( m_currentCode <= m_userCodeCount ) && ( next != 0 ) && ( next >= m_currentCode ) && ( next <= m_userCodeCount ) )
+			{
+				ClearCodes( _instance, m_currentCode, next );
+				m_currentCode = next;
+				RequestCodes( _instance, Driver::MsgQueue_Query );
+			}
+			else
+			{
+				// There are no more codes
+				ClearCodes( _instance, m_currentCode, (uint16)m_userCodeCount + 1 );
+				QueryAllDone();
+			}
+		}
+		return true;
+	}
 
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <UserCode::RequestCodes>
+// Request the codes from m_currentCode on, several at a time if possible
+//-----------------------------------------------------------------------------
+bool UserCode::RequestCodes
+(
+	uint8 const _instance,
+	Driver::MsgQueue const _queue
+)
+{
+	if( GetVersion() < 2 )
+	{
+		return RequestValue( 0, (uint8)m_currentCode, _instance, _queue );
+	}
+
+	if( _instance != 1 )
+	{
+		// This command class doesn't work with multiple instances
+		return false;
+	}
+	if( !IsGetSupported() )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "UserCodeCmd_ExtendedGet Not Supported on this node" );
+		return false;
+	}
+
+	// Ask for as many codes as the device can fit in its report
+	Msg* msg = new Msg( "UserCodeCmd_ExtendedGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( 5 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( UserCodeCmd_ExtendedGet );
+	msg->Append( (uint8)( m_currentCode >> 8 ) );
+	msg->Append( (uint8)( m_currentCode & 0xff ) );
+	msg->Append( 0x01 );		// Report more
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, _queue );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::RequestChecksum>
+// Request the checksum of the device's codes
+//-----------------------------------------------------------------------------
+bool UserCode::RequestChecksum
+(
+	uint8 const _instance,
+	Driver::MsgQueue const _queue
+)
+{
+	if( ( _instance != 1 ) || !IsGetSupported() )
+	{
+		return false;
+	}
+
+	Msg* msg = new Msg( "UserCodeCmd_ChecksumGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( 2 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( UserCodeCmd_ChecksumGet );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, _queue );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::StoreCode>
+// Update the value of a code reported by the device
+//-----------------------------------------------------------------------------
+void UserCode::StoreCode
+(
+	uint8 const _instance,
+	uint16 const _id,
+	uint8 const _status,
+	uint8 const* _code,
+	uint8 _size
+)
+{
+	if( _id > 0xff )
+	{
+		return;
+	}
+
+	if( ValueRaw* value = static_cast<ValueRaw*>( GetValue( _instance, (uint8)_id ) ) )
+	{
+		uint8 data[UserCodeLength];
+		if( _size > UserCodeLength )
+		{
+			Log::Write( LogLevel_Warning, GetNodeId(), "User Code length %d is larger then maximum %d", _size, UserCodeLength );
+			_size = UserCodeLength;
+		}
+		if( m_userCodesStatus[_id] != _status )
+		{
+			m_userCodesStatus[_id] = _status;
+			ConfigChanged();
+		}
+		memcpy( data, _code, _size );
+		value->OnValueRefreshed( data, _size );
+		value->Release();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::ClearCodes>
+// Mark a range of slots as available
+//-----------------------------------------------------------------------------
+void UserCode::ClearCodes
+(
+	uint8 const _instance,
+	uint16 const _first,
+	uint16 const _end
+)
+{
+	uint8 data[UserCodeLength];
+	memset( data, 0, UserCodeLength );
+
+	for( uint16 i=_first; i<_end; ++i )
+	{
+		if( m_userCodesStatus[i] != UserCode_Available )
+		{
+			m_userCodesStatus[i] = UserCode_Available;
+			ConfigChanged();
+		}
+		if( ValueRaw* value = static_cast<ValueRaw*>( GetValue( _instance, (uint8)i ) ) )
+		{
+			// Only a slot that held a code needs its value changing
+			uint8 const* code = value->GetValue();
+			for( uint8 j=0; j<value->GetLength(); ++j )
+			{
+				if( code[j] != 0 )
+				{
+					value->OnValueRefreshed( data, UserCodeLength );
+					break;
+				}
+			}
+			value->Release();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::QueryAllDone>
+// All of the codes have been fetched
+//-----------------------------------------------------------------------------
+void UserCode::QueryAllDone
+(
+)
+{
+	m_queryAll = false;
+	if( m_checksumPending )
+	{
+		// The codes we hold are now those the checksum was taken from
+		m_checksum = m_pendingChecksum;
+		m_checksumValid = true;
+		m_checksumPending = false;
+		ConfigChanged();
+	}
+	/* we might have reset this as part of the RefreshValues Button Value */
+	Options::Get()->GetOptionAsBool("RefreshAllUserCodes", &m_refreshUserCodes );
+}
+
 //-----------------------------------------------------------------------------
 // <UserCode::SetValue>
 // Set a User Code value
@@ -331,7 +646,8 @@ bool UserCode::SetValue
 		m_refreshUserCodes = true;
 		m_currentCode = 1;
 		m_queryAll = true;
-		RequestValue( 0, m_currentCode, _value.GetID().GetInstance(), Driver::MsgQueue_Query );
+		m_checksumPending = false;
+		RequestCodes( _value.GetID().GetInstance(), Driver::MsgQueue_Query );
 		return true;
 	}
 	return false;
@@ -33,6 +33,13 @@
 namespace OpenZWave
 {
 	/** \brief Implements COMMAND_CLASS_USER_CODE (0x63), a Z-Wave device command class.
+	 *
+	 * Version 1 devices are asked for their codes one slot at a time.  Version 2
+	 * devices are asked with Extended User Code Gets, which return as many codes
+	 * as fit in a frame, and skip the slots that are available.  If the device
+	 * reports a checksum of its codes, the codes are only fetched at the start
+	 * of a session if the checksum differs from the one they were last fetched
+	 * with.
 	 */
 	class UserCode: public CommandClass
 	{
@@ -62,12 +69,20 @@ namespace OpenZWave
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
 
+		virtual uint8 GetMaxVersion(){ return 2; }
+
 	protected:
 		virtual void CreateVars( uint8 const _instance );
 
 	private:
 		UserCode( uint32 const _homeId, uint8 const _nodeId );
 
+		bool RequestCodes( uint8 const _instance, Driver::MsgQueue const _queue );			// Request the codes from m_currentCode on
+		bool RequestChecksum( uint8 const _instance, Driver::MsgQueue const _queue );
+		void StoreCode( uint8 const _instance, uint16 const _id, uint8 const _status, uint8 const* _code, uint8 _size );
+		void ClearCodes( uint8 const _instance, uint16 const _first, uint16 const _end );		// Mark the slots from _first up to _end as available
+		void QueryAllDone();
+
 		string CodeStatus( uint8 const _byte )
 		{
 			switch( _byte )
@@ -100,10 +115,15 @@ namespace OpenZWave
 		}
 
 		bool		m_queryAll;				// True while we are requesting all the user codes.
-		uint8		m_currentCode;
+		uint16		m_currentCode;			// The next slot to fetch.  Past m_userCodeCount once they have all been fetched.
 		uint8		m_userCodeCount;
 		uint8		m_userCodesStatus[256];
 		bool		m_refreshUserCodes;
+		bool		m_checksumSupported;		// Whether the device reports a checksum of its codes
+		bool		m_checksumValid;			// Whether m_checksum is that of the codes we hold
+		bool		m_checksumPending;			// Whether m_pendingChecksum is to become m_checksum when all of the codes have been fetched
+		uint16		m_checksum;
+		uint16		m_pendingChecksum;
 	};
 
 } // namespace OpenZWave
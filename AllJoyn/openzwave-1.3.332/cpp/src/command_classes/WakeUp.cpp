@@ -63,6 +63,7 @@ WakeUp::WakeUp
 ):
 	CommandClass( _homeId, _nodeId ),
 	m_mutex( new Mutex() ),
+	m_pendingQueue( false, SendQueue::Merge_All ),
 	m_pollRequired( false ),
 	m_notification( false )
 {
@@ -81,9 +82,9 @@ WakeUp::~WakeUp
 )
 {
 	m_mutex->Release();
-	while( !m_pendingQueue.empty() )
+	while( !m_pendingQueue.IsEmpty() )
 	{
-		Driver::MsgQueueItem const& item = m_pendingQueue.front();
+		Driver::MsgQueueItem const& item = m_pendingQueue.Front();
 		if( Driver::MsgQueueCmd_SendMsg == item.m_command )
 		{
 			delete item.m_msg;
@@ -92,7 +93,7 @@ WakeUp::~WakeUp
 		{
 			delete item.m_cci;
 		}
-		m_pendingQueue.pop_front();
+		m_pendingQueue.PopFront();
 	}
 }
 
@@ -382,34 +383,26 @@ void WakeUp::QueueMsg
 {
 	m_mutex->Lock();
 
-	// See if there is already a copy of this message in the queue.  If so,
-	// we delete it.  This is to prevent duplicates building up if the
+	// If there is already a copy of this message in the queue, the queue
+	// deletes it.  This is to prevent duplicates building up if the
 	// device does not wake up very often.  Deleting the original and
 	// adding the copy to the end avoids problems with the order of
 	// commands such as on and off.
-	list<Driver::MsgQueueItem>::iterator it = m_pendingQueue.begin();
-	while( it != m_pendingQueue.end() )
-	{
-		Driver::MsgQueueItem const& item = *it;
-		if( item == _item )
-		{
-			// Duplicate found
-			if( Driver::MsgQueueCmd_SendMsg == item.m_command )
-			{
-				delete item.m_msg;
-			}
-			else if( Driver::MsgQueueCmd_Controller == item.m_command )
-			{
-				delete item.m_cci;
-			}
-			m_pendingQueue.erase( it++ );
-		}
-		else
-		{
-			++it;
-		}
-	}
-	m_pendingQueue.push_back( _item );
+	m_pendingQueue.PushBack( _item );
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <WakeUp::RemoveValueMsgs>
+// Remove the pending messages that a newer Set of the same value supersedes
+//-----------------------------------------------------------------------------
+void WakeUp::RemoveValueMsgs
+(
+	Msg const* _msg
+)
+{
+	m_mutex->Lock();
+	m_pendingQueue.RemoveValueMsgs( _msg );
 	m_mutex->Unlock();
 }
 
@@ -424,10 +417,10 @@ void WakeUp::SendPending
 	m_awake = true;
 
 	m_mutex->Lock();
-	list<Driver::MsgQueueItem>::iterator it = m_pendingQueue.begin();
-	while( it != m_pendingQueue.end() )
+	while( !m_pendingQueue.IsEmpty() )
 	{
-		Driver::MsgQueueItem const& item = *it;
+		Driver::MsgQueueItem item = m_pendingQueue.Front();
+		m_pendingQueue.PopFront();
 		if( Driver::MsgQueueCmd_SendMsg == item.m_command )
 		{
 			GetDriver()->SendMsg( item.m_msg, Driver::MsgQueue_WakeUp );
@@ -440,7 +433,6 @@ void WakeUp::SendPending
 			GetDriver()->BeginControllerCommand( item.m_cci->m_controllerCommand, item.m_cci->m_controllerCallback, item.m_cci->m_controllerCallbackContext, item.m_cci->m_highPower, item.m_cci->m_controllerCommandNode, item.m_cci->m_controllerCommandArg );
 			delete item.m_cci;
 		}
-		it = m_pendingQueue.erase( it );
 	}
 	m_mutex->Unlock();
 
@@ -31,6 +31,7 @@
 #include <list>
 #include "command_classes/CommandClass.h"
 #include "Driver.h"
+#include "SendQueue.h"
 
 namespace OpenZWave
 {
@@ -51,6 +52,7 @@ namespace OpenZWave
 
 		void Init();	// Starts the process of requesting node state from a sleeping device.
 		void QueueMsg( Driver::MsgQueueItem const& _item );
+		void RemoveValueMsgs( Msg const* _msg );			// Remove the pending messages that a newer Set of the same value supersedes
 		void SendPending();
 		bool IsAwake()const{ return m_awake; }
 		void SetAwake( bool _state );
@@ -74,7 +76,7 @@ namespace OpenZWave
 		WakeUp( uint32 const _homeId, uint8 const _nodeId );
 
 		Mutex*						m_mutex;			// Serialize access to the pending queue
-		list<Driver::MsgQueueItem>	m_pendingQueue;		// Messages waiting to be sent when the device wakes up
+		SendQueue					m_pendingQueue;		// Messages waiting to be sent when the device wakes up
 		bool						m_awake;
 		bool						m_pollRequired;
 		bool						m_notification;
@@ -0,0 +1,117 @@
+//-----------------------------------------------------------------------------
+//
+//	Atomic.h
+//
+//	Cross-platform atomic operations on 32 bit integers
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _Atomic_H
+#define _Atomic_H
+
+#include "Defs.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace OpenZWave
+{
+	/**
+	 * Atomically increment a value.
+	 * \return the incremented value.
+	 */
+	inline int32 AtomicIncrement( int32 volatile* _value )
+	{
+#ifdef WIN32
+		return (int32)InterlockedIncrement( (LONG volatile*)_value );
+#else
+		return __sync_add_and_fetch( _value, 1 );
+#endif
+	}
+
+	/**
+	 * Atomically decrement a value.
+	 * \return the decremented value.
+	 */
+	inline int32 AtomicDecrement( int32 volatile* _value )
+	{
+#ifdef WIN32
+		return (int32)InterlockedDecrement( (LONG volatile*)_value );
+#else
+		return __sync_sub_and_fetch( _value, 1 );
+#endif
+	}
+
+	/**
+	 * Atomically replace a value if it still holds an expected value.
+	 * \param _value the value to update.
+	 * \param _exchange the new value.
+	 * \param _comparand the value that _value must hold for it to be replaced.
+	 * \return the value held before the call.  The exchange happened if this equals _comparand.
+	 */
+	inline int32 AtomicCompareExchange( int32 volatile* _value, int32 _exchange, int32 _comparand )
+	{
+#ifdef WIN32
+		return (int32)InterlockedCompareExchange( (LONG volatile*)_value, (LONG)_exchange, (LONG)_comparand );
+#else
+		return __sync_val_compare_and_swap( _value, _comparand, _exchange );
+#endif
+	}
+
+	/**
+	 * Full memory barrier.  No loads or stores are moved across the call,
+	 * by either the compiler or the processor.
+	 */
+	inline void AtomicFence()
+	{
+#ifdef WIN32
+		MemoryBarrier();
+#else
+		__sync_synchronize();
+#endif
+	}
+
+	/**
+	 * Read a value written by another thread.  Loads that follow the call
+	 * are not performed before it.
+	 */
+	inline int32 AtomicLoad( int32 volatile const* _value )
+	{
+		int32 value = *_value;
+		AtomicFence();
+		return value;
+	}
+
+	/**
+	 * Publish a value to other threads.  Stores that precede the call
+	 * are visible before the new value.
+	 */
+	inline void AtomicStore( int32 volatile* _value, int32 _newValue )
+	{
+		AtomicFence();
+		*_value = _newValue;
+	}
+
+} // namespace OpenZWave
+
+#endif //_Atomic_H
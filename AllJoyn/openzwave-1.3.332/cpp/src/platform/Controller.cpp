@@ -46,23 +46,3 @@ void Controller::PlayInitSequence
 	_driver->SendMsg( new Msg( "FUNC_ID_ZW_GET_SUC_NODE_ID", 0xff, REQUEST, FUNC_ID_ZW_GET_SUC_NODE_ID, false ), Driver::MsgQueue_Command );
 	// FUNC_ID_ZW_GET_VIRTUAL_NODES & FUNC_ID_SERIAL_API_GET_INIT_DATA has moved into the handler for FUNC_ID_SERIAL_API_GET_CAPABILITIES
 }
-
-//-----------------------------------------------------------------------------
-//	<Controller::Read>
-//	Read from a controller
-//-----------------------------------------------------------------------------
-uint32 Controller::Read
-(
-	uint8* _buffer,
-	uint32 _length
-)
-{
-	// Fetch the data from the ring buffer (which is an all or nothing read)
-	if( Get( _buffer, _length ) )
-	{
-		return _length;
-	}
-
-	return 0;
-}
-
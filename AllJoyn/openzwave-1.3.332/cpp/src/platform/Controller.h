@@ -32,24 +32,24 @@
 #include <list>
 #include "Defs.h"
 #include "Driver.h"
-#include "platform/Stream.h"
+#include "platform/FrameQueue.h"
 
 namespace OpenZWave
 {
 	class Driver;
 
-	class Controller: public Stream
+	class Controller: public FrameQueue
 	{
-		// Controller is derived from Stream rather than containing one, so that
+		// Controller is derived from FrameQueue rather than containing one, so that
 		// we can use its Wait abilities without having to duplicate them here.
-		// The stream is used for input.  Buffering of output is handled by the OS. 
+		// The queue is used for input.  Buffering of output is handled by the OS. 
 
 	public:
 		/**
 		 * Consructor.
 		 * Creates the controller object.
 		 */
-		Controller():Stream( 2048 ){}
+		Controller(){}
 
 		/**
 		 * Destructor.
@@ -68,7 +68,7 @@ namespace OpenZWave
 		 * Open a controller.
 		 * Attempts to open a controller and initialize it with the specified paramters.
 		 * @param _controllerName The name of the port to open.  For example, ttyS1 on Linux, or \\.\COM2 in Windows.
-		 * @see Close, Read, Write
+		 * @see Close, Write
 		 */
 		virtual bool Open( string const& _controllerName ) = 0;
 
@@ -86,19 +86,9 @@ namespace OpenZWave
 		 * @param _buffer Pointer to a block of memory containing the data to be written.
 		 * @param _length Length in bytes of the data.
 		 * @return The number of bytes written.
-		 * @see Read, Open, Close
+		 * @see Open, Close
 		 */
 		virtual uint32 Write( uint8* _buffer, uint32 _length ) = 0;
-
-		/**
-		 * Read from a controller.
-		 * Attempts to read data from an open controller.
-		 * @param _buffer Pointer to a block of memory large enough to hold the requested data.
-		 * @param _length Length in bytes of the data to be read.
-		 * @return The number of bytes read.
-		 * @see Write, Open, Close
-		 */
-		uint32 Read( uint8* _buffer, uint32 _length );
 	};
 
 } // namespace OpenZWave
@@ -82,6 +82,56 @@ bool FileOps::FolderExists
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+//	<FileOps::MapFile>
+//	Static method to map a file into memory
+//-----------------------------------------------------------------------------
+void const* FileOps::MapFile
+(
+	const string &_fileName,
+	uint32* o_size
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->MapFile( _fileName, o_size );
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::UnmapFile>
+//	Static method to release a mapped file
+//-----------------------------------------------------------------------------
+void FileOps::UnmapFile
+(
+	void const* _data,
+	uint32 const _size
+)
+{
+	if( s_instance != NULL )
+	{
+		s_instance->m_pImpl->UnmapFile( _data, _size );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::RenameFile>
+//	Static method to rename a file over any existing one
+//-----------------------------------------------------------------------------
+bool FileOps::RenameFile
+(
+	const string &_from,
+	const string &_to
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->RenameFile( _from, _to );
+	}
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 //	<FileOps::FileOps>
 //	Constructor
@@ -61,6 +61,31 @@ namespace OpenZWave
 		 */
 		static bool FolderExists( const string &_folderName );
 
+		/**
+		 * MapFile. Map the contents of a file into memory, read-only.
+		 * \param string. File name.
+		 * \param o_size Receives the size of the file in bytes.
+		 * \return Pointer to the contents, or NULL if the file could not be mapped.
+		 * \see UnmapFile.
+		 */
+		static void const* MapFile( const string &_fileName, uint32* o_size );
+
+		/**
+		 * UnmapFile. Release a file mapped by MapFile.
+		 * \param _data Pointer returned by MapFile.
+		 * \param _size Size returned by MapFile.
+		 * \see MapFile.
+		 */
+		static void UnmapFile( void const* _data, uint32 const _size );
+
+		/**
+		 * RenameFile. Rename a file, replacing any file that already has the new name.
+		 * \param _from Current file name.
+		 * \param _to New file name.
+		 * \return True if the file was renamed.
+		 */
+		static bool RenameFile( const string &_from, const string &_to );
+
 	private:
 		FileOps();
 		~FileOps();
@@ -0,0 +1,320 @@
+//-----------------------------------------------------------------------------
+//
+//	FrameQueue.cpp
+//
+//	Assembles Serial API frames, and queues them for the driver
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "platform/FrameQueue.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+#include <string.h>
+
+#include <cstdio>
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::FrameQueue>
+//	Constructor
+//-----------------------------------------------------------------------------
+FrameQueue::FrameQueue
+(
+):
+	m_head( NULL ),
+	m_tail( NULL ),
+	m_queued( 0 ),
+	m_partial( NULL ),
+	m_free( NULL ),
+	m_freeCount( 0 ),
+	m_mutex( new Mutex() )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::~FrameQueue>
+//	Destructor
+//-----------------------------------------------------------------------------
+FrameQueue::~FrameQueue
+(
+)
+{
+	Purge();
+	while( m_free != NULL )
+	{
+		Frame* frame = m_free;
+		m_free = frame->m_next;
+		delete frame;
+	}
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::Put>
+//	Assemble frames from data received from the controller
+//-----------------------------------------------------------------------------
+bool FrameQueue::Put
+(
+	uint8* _buffer,
+	uint32 _size
+)
+{
+	m_mutex->Lock();
+	if( m_queued >= c_maxQueued )
+	{
+		// The driver is not keeping up
+		Log::Write( LogLevel_Error, "ERROR: Not enough space in frame queue" );
+		m_mutex->Unlock();
+		return false;
+	}
+
+	LogData( _buffer, _size, "      Read (controller->buffer):  " );
+
+	uint32 queued = m_queued;
+	if( ( m_partial != NULL ) && ( m_partialDeadline.TimeRemaining() <= 0 ) )
+	{
+		// The rest of the frame never came.  Hand over what there is, so
+		// the driver can count the abort, and start again with this data.
+		m_partial->m_status = Frame::Status_Aborted;
+		Enqueue( m_partial );
+		m_partial = NULL;
+	}
+
+	for( uint32 i=0; i<_size; ++i )
+	{
+		if( m_partial == NULL )
+		{
+			Frame* frame = AllocFrame();
+			frame->m_data[0] = _buffer[i];
+			frame->m_length = 1;
+			frame->m_status = Frame::Status_Ok;
+			if( SOF == _buffer[i] )
+			{
+				m_partial = frame;
+				m_partialDeadline.SetTime( c_frameTimeout );
+			}
+			else
+			{
+				// ACK, NAK, CAN, or a byte that is out of frame, for the driver to deal with
+				Enqueue( frame );
+			}
+			continue;
+		}
+
+		Frame* frame = m_partial;
+		frame->m_data[frame->m_length++] = _buffer[i];
+		if( ( frame->m_length < 2 ) || ( frame->m_length < (uint32)frame->m_data[1] + 2 ) )
+		{
+			continue;
+		}
+
+		// The frame is complete.  It must hold at least a type, a function and
+		// the checksum, which is over everything between the SOF and itself.
+		uint8 checksum = 0xff;
+		for( uint32 j=1; j<(frame->m_length-1); ++j )
+		{
+			checksum ^= frame->m_data[j];
+		}
+		bool valid = ( frame->m_data[1] >= 3 ) && ( frame->m_data[frame->m_length-1] == checksum );
+		frame->m_status = valid ? Frame::Status_Ok : Frame::Status_BadChecksum;
+
+		// Message handlers may look past the end of a short message, so they
+		// must find zeros there rather than an earlier frame
+		memset( &frame->m_data[frame->m_length], 0, c_maxFrameSize - frame->m_length );
+		Enqueue( frame );
+		m_partial = NULL;
+	}
+
+	if( m_queued != queued )
+	{
+		// Wake the driver once for all of the frames
+		Notify();
+	}
+	m_mutex->Unlock();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::GetFrame>
+//	Remove the oldest frame from the queue
+//-----------------------------------------------------------------------------
+FrameQueue::Frame* FrameQueue::GetFrame
+(
+)
+{
+	m_mutex->Lock();
+	Frame* frame = m_head;
+	if( frame != NULL )
+	{
+		m_head = frame->m_next;
+		if( m_head == NULL )
+		{
+			m_tail = NULL;
+		}
+		--m_queued;
+	}
+	m_mutex->Unlock();
+	return frame;
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::ReleaseFrame>
+//	Return a frame to the pool
+//-----------------------------------------------------------------------------
+void FrameQueue::ReleaseFrame
+(
+	Frame* _frame
+)
+{
+	m_mutex->Lock();
+	FreeFrame( _frame );
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::Purge>
+//	Discard the queued frames and any partial frame
+//-----------------------------------------------------------------------------
+void FrameQueue::Purge
+(
+)
+{
+	m_mutex->Lock();
+	while( m_head != NULL )
+	{
+		Frame* frame = m_head;
+		m_head = frame->m_next;
+		FreeFrame( frame );
+	}
+	m_tail = NULL;
+	m_queued = 0;
+
+	if( m_partial != NULL )
+	{
+		FreeFrame( m_partial );
+		m_partial = NULL;
+	}
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::IsSignalled>
+//	Test whether a frame is ready
+//-----------------------------------------------------------------------------
+bool FrameQueue::IsSignalled
+(
+)
+{
+	return( m_head != NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::AllocFrame>
+//	Take a frame from the pool
+//-----------------------------------------------------------------------------
+FrameQueue::Frame* FrameQueue::AllocFrame
+(
+)
+{
+	Frame* frame = m_free;
+	if( frame == NULL )
+	{
+		return new Frame();
+	}
+
+	m_free = frame->m_next;
+	--m_freeCount;
+	return frame;
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::FreeFrame>
+//	Return a frame to the pool, unless it is already full
+//-----------------------------------------------------------------------------
+void FrameQueue::FreeFrame
+(
+	Frame* _frame
+)
+{
+	if( m_freeCount >= c_maxFree )
+	{
+		delete _frame;
+		return;
+	}
+
+	_frame->m_next = m_free;
+	m_free = _frame;
+	++m_freeCount;
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::Enqueue>
+//	Add a frame to the back of the queue
+//-----------------------------------------------------------------------------
+void FrameQueue::Enqueue
+(
+	Frame* _frame
+)
+{
+	_frame->m_next = NULL;
+	if( m_tail != NULL )
+	{
+		m_tail->m_next = _frame;
+	}
+	else
+	{
+		m_head = _frame;
+	}
+	m_tail = _frame;
+	++m_queued;
+}
+
+//-----------------------------------------------------------------------------
+//	<FrameQueue::LogData>
+//	Format data for log output
+//-----------------------------------------------------------------------------
+void FrameQueue::LogData
+(
+	uint8* _buffer,
+	uint32 _length,
+	const string &_function
+)
+{
+	if( !_length ) return;
+
+	string str = "";
+	for( uint32 i=0; i<_length; ++i )
+	{
+		if( i )
+		{
+			str += ", ";
+		}
+
+		char byteStr[8];
+		snprintf( byteStr, sizeof(byteStr), "0x%.2x", _buffer[i] );
+		str += byteStr;
+	}
+	Log::Write( LogLevel_StreamDetail, "%s%s", _function.c_str(), str.c_str() );
+}
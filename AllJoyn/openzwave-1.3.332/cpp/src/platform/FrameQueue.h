@@ -0,0 +1,141 @@
+//-----------------------------------------------------------------------------
+//
+//	FrameQueue.h
+//
+//	Assembles Serial API frames, and queues them for the driver
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _FrameQueue_H
+#define _FrameQueue_H
+
+#include <string>
+#include "Defs.h"
+#include "platform/Wait.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief Assembles the bytes received from a controller into Serial API frames.
+	 *
+	 * The thread reading from the controller passes whatever it receives to
+	 * Put, which finds the SOF, ACK, NAK and CAN framing, checks the checksum
+	 * of each data frame, and queues each frame once it is complete.  The
+	 * queue is only signalled when a frame is ready, so the driver thread
+	 * wakes once per frame, and never has to wait for the rest of one.
+	 *
+	 * Frames are assembled in place in buffers taken from a pool, and handed
+	 * to the driver without copying.  The driver returns each frame to the
+	 * pool with ReleaseFrame when it has finished with it.
+	 */
+	class FrameQueue: public Wait
+	{
+	public:
+		static uint32 const c_maxFrameSize = 257;			// SOF, length byte, and up to 255 bytes counted by it
+		static int32 const c_frameTimeout = 500;			// Milliseconds allowed from a SOF to the end of its frame
+
+		struct Frame
+		{
+			enum Status
+			{
+				Status_Ok = 0,								/**< A single byte, or a data frame with a correct checksum */
+				Status_BadChecksum,							/**< A data frame with an incorrect checksum, or too short to hold a message */
+				Status_Aborted								/**< A data frame that was not completed in time */
+			};
+
+			uint8	m_data[c_maxFrameSize];					// A data frame from the SOF to the checksum, or the single byte received
+			uint32	m_length;
+			Status	m_status;
+			Frame*	m_next;
+		};
+
+		/**
+		 * Constructor.
+		 */
+		FrameQueue();
+
+		/**
+		 * Add data received from the controller.  Frames completed by the data are queued.
+		 * \param _buffer pointer to the data.
+		 * \param _size the amount of data in bytes.
+		 * \return false if the queue is full, in which case none of the data is used.
+		 */
+		bool Put( uint8* _buffer, uint32 _size );
+
+		/**
+		 * Remove the oldest frame from the queue.
+		 * \return the frame, which must be passed to ReleaseFrame, or NULL if no frame is ready.
+		 */
+		Frame* GetFrame();
+
+		/**
+		 * Return a frame taken by GetFrame to the pool.
+		 */
+		void ReleaseFrame( Frame* _frame );
+
+ 		/**
+		 * Discard the queued frames, and any frame being assembled.
+		 * This is called when the library gets out of sync with the controller and sends a "NAK"
+		 * to the controller.
+		 */
+		void Purge();
+
+	protected:
+		/**
+		 * Formats data for output to the log.
+		 */
+		void LogData( uint8* _buffer, uint32 _size, const string &_function );
+
+		/**
+		 * Used by the Wait class to test whether a frame is ready.
+		 */
+		virtual bool IsSignalled();
+
+		virtual ~FrameQueue();
+
+	private:
+		FrameQueue( FrameQueue const& );					// prevent copy
+		FrameQueue& operator = ( FrameQueue const& );		// prevent assignment
+
+		Frame* AllocFrame();								// Called with m_mutex held
+		void FreeFrame( Frame* _frame );					// Called with m_mutex held
+		void Enqueue( Frame* _frame );						// Called with m_mutex held
+
+		Frame*		m_head;									// Oldest queued frame
+		Frame*		m_tail;
+		uint32		m_queued;
+		Frame*		m_partial;								// Frame being assembled, or NULL between frames
+		TimeStamp	m_partialDeadline;
+		Frame*		m_free;									// Pool of unused frames
+		uint32		m_freeCount;
+		Mutex*		m_mutex;
+
+		static uint32 const c_maxQueued = 64;				// Put refuses data while this many frames are waiting
+		static uint32 const c_maxFree = 16;					// Frames kept in the pool
+	};
+
+} // namespace OpenZWave
+
+#endif //_FrameQueue_H
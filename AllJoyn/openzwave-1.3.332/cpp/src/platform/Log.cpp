@@ -26,9 +26,16 @@
 //
 //-----------------------------------------------------------------------------
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "Defs.h"
 #include "platform/Mutex.h"
+#include "platform/Event.h"
+#include "platform/Thread.h"
+#include "platform/TimeStamp.h"
+#include "platform/WaitSet.h"
+#include "platform/Atomic.h"
 #include "platform/Log.h"
 
 #ifdef WIN32
@@ -61,8 +68,61 @@ char const *OpenZWave::LogLevelString[] =
 
 Log* Log::s_instance = NULL;
 i_LogImpl* Log::m_pImpl = NULL;
+LogLevel Log::s_saveLevel = LogLevel_Internal;
+LogLevel Log::s_queueLevel = LogLevel_Internal;
+LogLevel Log::s_dumpTrigger = LogLevel_None;
 static bool s_dologging;
 
+static uint32 const c_logQueueSize = 256;		// Number of records in the asynchronous queue (a power of two)
+static uint32 const c_logRecordText = 1024;		// Matches the line buffer of the logging implementations
+static uint32 const c_logRecordFrame = 260;		// Largest Serial API frame, with room to spare
+static int32 const c_logWriterInterval = 20;	// Longest time in ms that a record waits to be written
+
+//-----------------------------------------------------------------------------
+//	A record in the asynchronous queue.  The sequence number tells producers
+//	and the writer whose turn it is to use the record.
+//-----------------------------------------------------------------------------
+struct Log::LogRecord
+{
+	int32 volatile	m_sequence;
+	LogLevel		m_level;
+	uint8			m_nodeId;
+	uint16			m_frameLength;					// Raw bytes to render after the text
+	int32			m_time;							// Milliseconds since the log was created
+	uint32			m_threadId;						// Thread that logged the record
+	char			m_text[c_logRecordText];		// The formatted message, or the prefix of a frame
+	uint8			m_frame[c_logRecordFrame];
+};
+
+//-----------------------------------------------------------------------------
+//	<FrameToString>
+//	Render bytes as "0x01, 0x02, ..." without going through snprintf
+//-----------------------------------------------------------------------------
+static void FrameToString
+(
+	uint8 const* _data,
+	uint32 const _length,
+	char* _buffer,
+	uint32 const _size
+)
+{
+	static char const c_hex[] = "0123456789abcdef";
+	uint32 pos = 0;
+	for( uint32 i=0; ( i<_length ) && ( pos+7 <= _size ); ++i )
+	{
+		if( i )
+		{
+			_buffer[pos++] = ',';
+			_buffer[pos++] = ' ';
+		}
+		_buffer[pos++] = '0';
+		_buffer[pos++] = 'x';
+		_buffer[pos++] = c_hex[_data[i] >> 4];
+		_buffer[pos++] = c_hex[_data[i] & 0x0f];
+	}
+	_buffer[pos] = 0;
+}
+
 //-----------------------------------------------------------------------------
 //	<Log::Create>
 //	Static creation of the singleton
@@ -177,6 +237,10 @@ void Log::SetLoggingState
 	if( _dumpTrigger >= _queueLevel )
 		Log::Write( LogLevel_Warning, "The trigger for dumping queued messages must be a higher-priority message than the level that is queued." );
 
+	s_saveLevel = _saveLevel;
+	s_queueLevel = _queueLevel;
+	s_dumpTrigger = _dumpTrigger;
+
 	bool prevLogging = s_dologging;
 	// s_dologging is true if any messages are to be saved in file or queue
 	if( (_saveLevel > LogLevel_Always) ||
@@ -192,6 +256,7 @@ void Log::SetLoggingState
 	if( s_instance && s_dologging && s_instance->m_pImpl )
 	{
 	  	s_instance->m_logMutex->Lock();
+		s_instance->Drain();
 		s_instance->m_pImpl->SetLoggingState( _saveLevel, _queueLevel, _dumpTrigger );
 		s_instance->m_logMutex->Unlock();
 	}
@@ -221,9 +286,19 @@ void Log::Write
 	...
 )
 {
-	if( s_instance && s_dologging && s_instance->m_pImpl )
+	if( s_instance && s_dologging && s_instance->m_pImpl && IsEnabled( _level ) )
 	{
+		if( s_instance->m_async && ( _level != LogLevel_Internal ) )
+		{
+			va_list args;
+			va_start( args, _format );
+			s_instance->Enqueue( _level, 0, _format, &args, NULL, 0 );
+			va_end( args );
+			return;
+		}
+
 		s_instance->m_logMutex->Lock(); // double locks if recursive
+		s_instance->Drain();
 		va_list args;
 		va_start( args, _format );
 		s_instance->m_pImpl->Write( _level, 0, _format, args );
@@ -244,10 +319,22 @@ void Log::Write
 	...
 )
 {
-	if( s_instance && s_dologging && s_instance->m_pImpl )
+	if( s_instance && s_dologging && s_instance->m_pImpl && IsEnabled( _level ) )
 	{
+		if( s_instance->m_async && ( _level != LogLevel_Internal ) )
+		{
+			va_list args;
+			va_start( args, _format );
+			s_instance->Enqueue( _level, _nodeId, _format, &args, NULL, 0 );
+			va_end( args );
+			return;
+		}
+
 		if( _level != LogLevel_Internal )
+		{
 		  	s_instance->m_logMutex->Lock();
+			s_instance->Drain();
+		}
 		va_list args;
 		va_start( args, _format );
 		s_instance->m_pImpl->Write( _level, _nodeId, _format, args );
@@ -257,6 +344,45 @@ void Log::Write
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	<Log::WriteFrame>
+//	Write a frame of raw bytes to the log, rendering them only if they will be seen
+//-----------------------------------------------------------------------------
+void Log::WriteFrame
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _prefix,
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	if( s_instance && s_dologging && s_instance->m_pImpl && IsEnabled( _level ) )
+	{
+		if( s_instance->m_async && ( _level != LogLevel_Internal ) )
+		{
+			s_instance->Enqueue( _level, _nodeId, _prefix, NULL, _data, _length );
+			return;
+		}
+
+		char frameStr[c_logRecordFrame*6];
+		FrameToString( _data, _length, frameStr, sizeof(frameStr) );
+		Write( _level, _nodeId, "%s%s", _prefix, frameStr );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::IsEnabled>
+//	Determine whether a message at this level will be saved or queued
+//-----------------------------------------------------------------------------
+bool Log::IsEnabled
+(
+	LogLevel _level
+)
+{
+	return( ( _level <= s_saveLevel ) || ( _level <= s_queueLevel ) || ( _level <= s_dumpTrigger ) || ( _level == LogLevel_Internal ) );
+}
+
 //-----------------------------------------------------------------------------
 //	<Log::QueueDump>
 //	Send queued messages to the log (and empty the queue)
@@ -268,6 +394,7 @@ void Log::QueueDump
 	if( s_instance && s_dologging && s_instance->m_pImpl )
 	{
 	  	s_instance->m_logMutex->Lock();
+		s_instance->Drain();
 		s_instance->m_pImpl->QueueDump();
 		s_instance->m_logMutex->Unlock();
 	}
@@ -284,6 +411,7 @@ void Log::QueueClear
 	if( s_instance && s_dologging && s_instance->m_pImpl )
 	{
 	  	s_instance->m_logMutex->Lock();
+		s_instance->Drain();
 		s_instance->m_pImpl->QueueClear();
 		s_instance->m_logMutex->Unlock();
 	}
@@ -301,11 +429,34 @@ void Log::SetLogFileName
 	if( s_instance && s_dologging && s_instance->m_pImpl )
 	{
 	  	s_instance->m_logMutex->Lock();
+		s_instance->Drain();
 		s_instance->m_pImpl->SetLogFileName( _filename );
 		s_instance->m_logMutex->Unlock();
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	<Log::SetAsync>
+//	Start or stop the asynchronous writer
+//-----------------------------------------------------------------------------
+void Log::SetAsync
+(
+	bool _async
+)
+{
+	if( s_instance )
+	{
+		if( _async )
+		{
+			s_instance->StartWriter();
+		}
+		else
+		{
+			s_instance->StopWriter();
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 //	<Log::Log>
 //	Constructor
@@ -319,8 +470,19 @@ Log::Log
 	LogLevel const _queueLevel,
 	LogLevel const _dumpTrigger
 ):
-	m_logMutex( new Mutex() )
+	m_logMutex( new Mutex() ),
+	m_records( NULL ),
+	m_async( false ),
+	m_head( 0 ),
+	m_tail( 0 ),
+	m_queueEvent( NULL ),
+	m_writerThread( NULL ),
+	m_startTime( NULL )
 {
+	s_saveLevel = _saveLevel;
+	s_queueLevel = _queueLevel;
+	s_dumpTrigger = _dumpTrigger;
+
         if (NULL == m_pImpl)
         	m_pImpl = new LogImpl( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger );
 }
@@ -333,7 +495,301 @@ Log::~Log
 (
 )
 {
+	StopWriter();
+	if( m_records )
+	{
+		delete [] m_records;
+		m_queueEvent->Release();
+		delete m_startTime;
+	}
 	m_logMutex->Release();
 	delete m_pImpl;
 	m_pImpl = NULL;
 }
+
+//-----------------------------------------------------------------------------
+//	<Log::StartWriter>
+//	Allocate the record queue if need be and start the background writer
+//-----------------------------------------------------------------------------
+void Log::StartWriter
+(
+)
+{
+	m_logMutex->Lock();
+	if( m_async )
+	{
+		m_logMutex->Unlock();
+		return;
+	}
+
+	if( NULL == m_records )
+	{
+		m_records = new LogRecord[c_logQueueSize];
+		for( uint32 i=0; i<c_logQueueSize; ++i )
+		{
+			m_records[i].m_sequence = (int32)i;
+		}
+		m_head = 0;
+		m_tail = 0;
+		m_startTime = new TimeStamp();
+		m_queueEvent = new Event();
+	}
+	m_writerThread = new Thread( "log" );
+	m_writerThread->Start( Log::WriterThreadEntryPoint, this );
+	m_async = true;
+	m_logMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::StopWriter>
+//	Write out anything still queued and stop the background writer.  The
+//	queue is kept, since other threads may still be adding records to it.
+//	Anything they add is written by the next synchronous write.
+//-----------------------------------------------------------------------------
+void Log::StopWriter
+(
+)
+{
+	m_logMutex->Lock();
+	if( !m_async )
+	{
+		m_logMutex->Unlock();
+		return;
+	}
+	m_async = false;
+	Thread* writerThread = m_writerThread;
+	m_writerThread = NULL;
+	m_logMutex->Unlock();
+
+	// The writer takes the mutex to drain, so it must be stopped without it
+	writerThread->Stop();
+	writerThread->Release();
+
+	m_logMutex->Lock();
+	Drain();
+	m_logMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::WriterThreadEntryPoint>
+//	Entry point of the thread that writes queued records
+//-----------------------------------------------------------------------------
+void Log::WriterThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	Log* log = (Log*)_context;
+	if( log )
+	{
+		log->WriterThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::WriterThreadProc>
+//	Write queued records in batches until told to exit
+//-----------------------------------------------------------------------------
+void Log::WriterThreadProc
+(
+	Event* _exitEvent
+)
+{
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;		// Thread must exit.
+	waitObjects[1] = m_queueEvent;		// Records have been queued.
+	WaitSet waitSet( waitObjects, 2 );
+
+	while( true )
+	{
+		// Producers only wake us when the queue is filling up or something
+		// important has been logged.  Otherwise write whatever has built up
+		// at regular intervals.
+		int32 res = waitSet.Any( c_logWriterInterval );
+		m_queueEvent->Reset();
+
+		m_logMutex->Lock();
+		Drain();
+		m_logMutex->Unlock();
+
+		if( 0 == res )
+		{
+			return;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::Enqueue>
+//	Queue a record for the writer, draining the queue ourselves if it is full
+//-----------------------------------------------------------------------------
+void Log::Enqueue
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list* _args,
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	while( !Push( _level, _nodeId, _format, _args, _data, _length ) )
+	{
+		// The writer has fallen behind.  Help it out rather than drop the record.
+		m_logMutex->Lock();
+		Drain();
+		m_logMutex->Unlock();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::Push>
+//	Claim a record, fill it in and publish it to the writer
+//-----------------------------------------------------------------------------
+bool Log::Push
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list* _args,
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	LogRecord* record;
+	uint32 pos = (uint32)AtomicLoad( &m_head );
+	while( true )
+	{
+		record = &m_records[pos & ( c_logQueueSize-1 )];
+		int32 diff = (int32)( (uint32)AtomicLoad( &record->m_sequence ) - pos );
+		if( 0 == diff )
+		{
+			// The record is free.  Try to claim it.
+			uint32 head = (uint32)AtomicCompareExchange( &m_head, (int32)( pos+1 ), (int32)pos );
+			if( head == pos )
+			{
+				break;
+			}
+			pos = head;
+		}
+		else if( diff < 0 )
+		{
+			// The writer has not finished with this record yet.  The queue is full.
+			return false;
+		}
+		else
+		{
+			// Another producer got here first
+			pos = (uint32)AtomicLoad( &m_head );
+		}
+	}
+
+	record->m_level = _level;
+	record->m_nodeId = _nodeId;
+	record->m_time = -m_startTime->TimeRemaining();
+	record->m_threadId = m_pImpl->GetCallingThreadId();
+	if( _args )
+	{
+		vsnprintf( record->m_text, sizeof(record->m_text), _format, *_args );
+		record->m_frameLength = 0;
+	}
+	else
+	{
+		size_t textLength = strlen( _format );
+		if( textLength >= sizeof(record->m_text) )
+		{
+			textLength = sizeof(record->m_text) - 1;
+		}
+		memcpy( record->m_text, _format, textLength );
+		record->m_text[textLength] = 0;
+		record->m_frameLength = (uint16)( ( _length < c_logRecordFrame ) ? _length : c_logRecordFrame );
+		memcpy( record->m_frame, _data, record->m_frameLength );
+	}
+
+	AtomicStore( &record->m_sequence, (int32)( pos+1 ) );
+
+	// Wake the writer each time another quarter of the queue has been used,
+	// and straight away for warnings and errors (which may also trigger a dump).
+	if( ( 0 == ( ( pos+1 ) & ( c_logQueueSize/4 - 1 ) ) ) || ( _level <= LogLevel_Warning ) )
+	{
+		m_queueEvent->Set();
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::Drain>
+//	Pass all published records to the logging implementation in one batch.
+//	Must be called with m_logMutex held.
+//-----------------------------------------------------------------------------
+void Log::Drain
+(
+)
+{
+	if( NULL == m_records )
+	{
+		return;
+	}
+
+	bool batch = false;
+	int32 now = 0;
+	while( true )
+	{
+		LogRecord* record = &m_records[m_tail & ( c_logQueueSize-1 )];
+		if( (int32)( (uint32)AtomicLoad( &record->m_sequence ) - ( m_tail+1 ) ) < 0 )
+		{
+			// Not yet published
+			break;
+		}
+
+		if( !batch )
+		{
+			m_pImpl->BeginBatch();
+			now = -m_startTime->TimeRemaining();
+			batch = true;
+		}
+
+		int32 age = now - record->m_time;
+		if( record->m_frameLength )
+		{
+			// Render the frame now that we know it will be written
+			char frameStr[c_logRecordFrame*6];
+			FrameToString( record->m_frame, record->m_frameLength, frameStr, sizeof(frameStr) );
+			WriteRecord( record->m_level, record->m_nodeId, age, record->m_threadId, "%s%s", record->m_text, frameStr );
+		}
+		else
+		{
+			WriteRecord( record->m_level, record->m_nodeId, age, record->m_threadId, "%s", record->m_text );
+		}
+
+		// Hand the record back to the producers for the next lap of the ring
+		AtomicStore( &record->m_sequence, (int32)( m_tail + c_logQueueSize ) );
+		++m_tail;
+	}
+
+	if( batch )
+	{
+		m_pImpl->EndBatch();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::WriteRecord>
+//	Pass a queued record to the logging implementation
+//-----------------------------------------------------------------------------
+void Log::WriteRecord
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	int32 const _age,
+	uint32 const _threadId,
+	char const* _format,
+	...
+)
+{
+	va_list args;
+	va_start( args, _format );
+	m_pImpl->Write( _level, _nodeId, _age, _threadId, _format, args );
+	va_end( args );
+}
@@ -37,6 +37,9 @@
 namespace OpenZWave
 {
 	class Mutex;
+	class Event;
+	class Thread;
+	class TimeStamp;
 	extern char const *LogLevelString[];
 	enum LogLevel
 	{
@@ -65,6 +68,25 @@ namespace OpenZWave
 		virtual void QueueClear() = 0;
 		virtual void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger ) = 0;
 		virtual void SetLogFileName( const string &_filename ) = 0;
+
+		/**
+		 * Write an entry queued by the asynchronous writer _age milliseconds ago.
+		 * Implementations that timestamp entries can use _age to backdate them,
+		 * and _threadId to name the thread that logged the entry.
+		 */
+		virtual void Write( LogLevel _level, uint8 const _nodeId, int32 const _age, uint32 const _threadId, char const* _format, va_list _args ){ Write( _level, _nodeId, _format, _args ); }
+
+		/**
+		 * Identify the calling thread, for entries that are written by another thread.
+		 */
+		virtual uint32 GetCallingThreadId() { return 0; } ;
+
+		/**
+		 * Called around each batch of entries written by the asynchronous writer,
+		 * so that an implementation can keep its output open for the whole batch.
+		 */
+		virtual void BeginBatch() { } ;
+		virtual void EndBatch() { } ;
 	};
 
 	/** \brief Implements a platform-independent log...written to the console and, optionally, a file.
@@ -144,6 +166,22 @@ namespace OpenZWave
 		*/
 		static void SetLogFileName( const string &_filename );
 
+		/**
+		 * \brief Enable or disable the asynchronous writer.  When enabled, Write formats each message
+		 * into a preallocated record on a lock-free queue and returns without taking the log mutex.
+		 * A background thread passes the records to the logging implementation in batches.
+		 * This should be called before any other threads start writing to the log.
+		 * \param _async If true, log entries are written by the background thread.
+		*/
+		static void SetAsync( bool _async );
+
+		/**
+		 * \brief Determine whether a message at the given level would be saved or queued.
+		 * Callers can use this to skip building expensive log messages.
+		 * \param _level	LogLevel of the message
+		*/
+		static bool IsEnabled( LogLevel _level );
+
 		/**
 		 * Write an entry to the log.
 		 * Writes a formatted string to the log.
@@ -165,6 +203,20 @@ namespace OpenZWave
 		 */
 		static void Write( LogLevel _level, uint8 const _nodeId, char const* _format, ... );
 
+		/**
+		 * Write a frame of raw bytes to the log.
+		 * The bytes are rendered in hex after the prefix, but only if the level is enabled.
+		 * With the asynchronous writer the bytes are copied into the queued record and
+		 * rendered by the background thread.
+		 * \param _level	Specifies the type of log message (Error, Warning, Debug, etc.)
+		 * \param _nodeId	Node Id this entry is about.
+		 * \param _prefix	Text to write before the bytes.
+		 * \param _data	The bytes to write.
+		 * \param _length	Number of bytes.
+		 * \see Write
+		 */
+		static void WriteFrame( LogLevel _level, uint8 const _nodeId, char const* _prefix, uint8 const* _data, uint32 const _length );
+
 		/**
 		 * Send the queued log messages to the log output.
 		 */
@@ -179,9 +231,32 @@ namespace OpenZWave
 		Log( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
 		~Log();
 
+		struct LogRecord;
+
+		static void WriterThreadEntryPoint( Event* _exitEvent, void* _context );
+		void WriterThreadProc( Event* _exitEvent );
+		void StartWriter();
+		void StopWriter();
+		void Enqueue( LogLevel _level, uint8 const _nodeId, char const* _format, va_list* _args, uint8 const* _data, uint32 const _length );
+		bool Push( LogLevel _level, uint8 const _nodeId, char const* _format, va_list* _args, uint8 const* _data, uint32 const _length );
+		void Drain();
+		void WriteRecord( LogLevel _level, uint8 const _nodeId, int32 const _age, uint32 const _threadId, char const* _format, ... );
+
 		static i_LogImpl*	m_pImpl;		/**< Pointer to an object that encapsulates the platform-specific logging implementation. */
 		static Log*	s_instance;
+		static LogLevel	s_saveLevel;		/**< Copies of the levels, so that filtered messages can be dropped before they are formatted */
+		static LogLevel	s_queueLevel;
+		static LogLevel	s_dumpTrigger;
 		Mutex*		m_logMutex;
+
+		// Asynchronous writer
+		LogRecord*		m_records;		/**< Ring of preallocated records, NULL until the writer is first started.  Kept until the log is destroyed. */
+		bool volatile	m_async;		/**< Entries are queued for the writer thread */
+		int32 volatile	m_head;			/**< Position of the next record to be claimed by a producer */
+		uint32			m_tail;			/**< Position of the next record to be written.  Protected by m_logMutex */
+		Event*			m_queueEvent;
+		Thread*			m_writerThread;
+		TimeStamp*		m_startTime;	/**< Records are timestamped relative to this */
 	};
 } // namespace OpenZWave
 
@@ -54,14 +54,14 @@ namespace OpenZWave
 		 * \return True if the lock was obtained.
 		 * \see Unlock
 		 */
-		bool Lock( bool const _bWait = true );
+		virtual bool Lock( bool const _bWait = true );
 
 		/**
 		 * Releases the lock on the mutex.
 		 * There must be a matching call to Release for every call to Lock.
 		 * \see Lock
 		 */
-		void Unlock();
+		virtual void Unlock();
 
 		/**
 		 * Used by the Wait class to test whether the mutex is free.
@@ -73,7 +73,7 @@ namespace OpenZWave
 		 * Destructor.
 		 * Destroys the mutex object.
 		 */
-		~Mutex();
+		virtual ~Mutex();
 
 	private:
 		Mutex( Mutex const&	);					// prevent copy
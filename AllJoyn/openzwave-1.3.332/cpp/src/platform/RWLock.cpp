@@ -0,0 +1,105 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLock.cpp
+//
+//	Cross-platform reader/writer lock
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include "Defs.h"
+#include "platform/RWLock.h"
+
+#ifdef WIN32
+#include "platform/windows/RWLockImpl.h"	// Platform-specific implementation of a reader/writer lock
+#else
+#include "platform/unix/RWLockImpl.h"		// Platform-specific implementation of a reader/writer lock
+#endif
+
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<RWLock::RWLock>
+//	Constructor
+//-----------------------------------------------------------------------------
+RWLock::RWLock
+(
+):
+	m_pImpl( new RWLockImpl() )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::~RWLock>
+//	Destructor
+//-----------------------------------------------------------------------------
+RWLock::~RWLock
+(
+)
+{
+	delete m_pImpl;
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::LockRead>
+//	Lock for reading
+//-----------------------------------------------------------------------------
+void RWLock::LockRead
+(
+)
+{
+	m_pImpl->LockRead();
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::UnlockRead>
+//	Release a read lock
+//-----------------------------------------------------------------------------
+void RWLock::UnlockRead
+(
+)
+{
+	m_pImpl->UnlockRead();
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::LockWrite>
+//	Lock for writing
+//-----------------------------------------------------------------------------
+bool RWLock::LockWrite
+(
+	bool const _bWait // = true;
+)
+{
+	return m_pImpl->LockWrite( _bWait );
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::UnlockWrite>
+//	Release a write lock
+//-----------------------------------------------------------------------------
+void RWLock::UnlockWrite
+(
+)
+{
+	m_pImpl->UnlockWrite();
+}
@@ -0,0 +1,97 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLock.h
+//
+//	Cross-platform reader/writer lock
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _RWLock_H
+#define _RWLock_H
+
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	class RWLockImpl;
+
+	/** \brief Implements a platform-independent reader/writer lock.
+	 *
+	 *  Any number of threads may hold the lock for reading at the same time,
+	 *  but a thread holding it for writing has it to itself.  The lock is not
+	 *  recursive: a thread must not lock it again while holding it, in either mode.
+	 */
+	class RWLock
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates an unlocked reader/writer lock.
+		 */
+		RWLock();
+
+		/**
+		 * Destructor.
+		 * Destroys the lock, which must not be held.
+		 */
+		~RWLock();
+
+		/**
+		 * Lock for reading, waiting while another thread holds the lock for writing.
+		 * There must be a matching call to UnlockRead.
+		 * \see UnlockRead
+		 */
+		void LockRead();
+
+		/**
+		 * Release a read lock.
+		 * \see LockRead
+		 */
+		void UnlockRead();
+
+		/**
+		 * Lock for writing.
+		 * There must be a matching call to UnlockWrite for every successful call.
+		 * \param _bWait Defaults to true.  Set this argument to false if the method should return
+		 * immediately, even if the lock is not available.
+		 * \return True if the lock was obtained.
+		 * \see UnlockWrite
+		 */
+		bool LockWrite( bool const _bWait = true );
+
+		/**
+		 * Release a write lock.
+		 * \see LockWrite
+		 */
+		void UnlockWrite();
+
+	private:
+		RWLock( RWLock const& );					// prevent copy
+		RWLock& operator = ( RWLock const& );		// prevent assignment
+
+		RWLockImpl*	m_pImpl;					// Pointer to an object that encapsulates the platform-specific implementation of the lock.
+	};
+
+} // namespace OpenZWave
+
+#endif //_RWLock_H
+
@@ -0,0 +1,1094 @@
+//-----------------------------------------------------------------------------
+//
+//	SimulatorController.cpp
+//
+//	In-process emulation of a Z-Wave Serial API controller
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Defs.h"
+#include "Options.h"
+#include "Utils.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+#include "platform/WaitSet.h"
+#include "platform/SimulatorController.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+static uint32 const c_simHomeId = 0x00c0ffee;		// Home ID reported by the simulated stick
+static uint8 const c_simNodeId = 1;					// Node ID of the simulated stick
+static uint32 const c_simMaxNodeId = NUM_NODE_BITFIELD_BYTES * 8;
+
+// Serial API functions answered by the simulator.  These are the only
+// bits set in the reply to FUNC_ID_SERIAL_API_GET_CAPABILITIES.
+static uint8 const c_simFunctions[] =
+{
+	FUNC_ID_SERIAL_API_GET_INIT_DATA,
+	FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION,
+	FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES,
+	FUNC_ID_SERIAL_API_SET_TIMEOUTS,
+	FUNC_ID_SERIAL_API_GET_CAPABILITIES,
+	FUNC_ID_ZW_SEND_DATA,
+	FUNC_ID_ZW_SEND_DATA_MULTI,
+	FUNC_ID_ZW_GET_VERSION,
+	FUNC_ID_ZW_MEMORY_GET_ID,
+	FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO,
+	FUNC_ID_ZW_GET_SUC_NODE_ID,
+	FUNC_ID_ZW_REQUEST_NODE_INFO,
+	FUNC_ID_ZW_GET_ROUTING_INFO
+};
+
+// Command classes advertised by every virtual node
+static uint8 const c_simCommandClasses[] =
+{
+	0x26,	// COMMAND_CLASS_SWITCH_MULTILEVEL
+	0x8f	// COMMAND_CLASS_MULTI_CMD
+};
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::SimulatorController>
+//	Constructor
+//-----------------------------------------------------------------------------
+SimulatorController::SimulatorController
+(
+):
+	m_thread( NULL ),
+	m_mutex( new Mutex() ),
+	m_pendingEvent( new Event() ),
+	m_bOpen( false ),
+	m_nodeCount( 0 ),
+	m_nextReportNode( 0 ),
+	m_nextReport( 0 ),
+	m_replayIndex( 0 ),
+	m_nextReplay( 0 ),
+	m_replayLoop( false ),
+	m_homeId( c_simHomeId ),
+	m_ackLatency( 0 ),
+	m_responseLatency( 0 ),
+	m_callbackLatency( 0 ),
+	m_reportLatency( 0 ),
+	m_reportInterval( 0 ),
+	m_CANRate( 0 ),
+	m_NAKRate( 0 ),
+	m_seed( 1 ),
+	m_statsStart( 0 ),
+	m_statsCpuStart( 0 ),
+	m_transactionStart( -1 ),
+	m_finalDelivered( false )
+{
+	int32 nodeCount = 10;
+	int32 ackLatency = 2;
+	int32 responseLatency = 5;
+	int32 callbackLatency = 20;
+	int32 reportLatency = 15;
+	int32 reportInterval = 0;
+	int32 canRate = 0;
+	int32 nakRate = 0;
+
+	Options::Get()->GetOptionAsInt( "SimulatorNodes", &nodeCount );
+	Options::Get()->GetOptionAsInt( "SimulatorAckLatency", &ackLatency );
+	Options::Get()->GetOptionAsInt( "SimulatorResponseLatency", &responseLatency );
+	Options::Get()->GetOptionAsInt( "SimulatorCallbackLatency", &callbackLatency );
+	Options::Get()->GetOptionAsInt( "SimulatorReportLatency", &reportLatency );
+	Options::Get()->GetOptionAsInt( "SimulatorReportInterval", &reportInterval );
+	Options::Get()->GetOptionAsInt( "SimulatorCANRate", &canRate );
+	Options::Get()->GetOptionAsInt( "SimulatorNAKRate", &nakRate );
+	Options::Get()->GetOptionAsBool( "SimulatorReplayLoop", &m_replayLoop );
+
+	m_ackLatency = ( ackLatency > 0 ) ? ackLatency : 0;
+	m_responseLatency = ( responseLatency > 0 ) ? responseLatency : 0;
+	m_callbackLatency = ( callbackLatency > 0 ) ? callbackLatency : 0;
+	m_reportLatency = ( reportLatency > 0 ) ? reportLatency : 0;
+	m_reportInterval = ( reportInterval > 0 ) ? reportInterval : 0;
+	m_CANRate = ( canRate > 0 ) ? canRate : 0;
+	m_NAKRate = ( nakRate > 0 ) ? nakRate : 0;
+
+	// Node 1 is the stick itself, the virtual nodes follow it
+	if( nodeCount < 0 )
+	{
+		nodeCount = 0;
+	}
+	if( nodeCount > (int32)( c_simMaxNodeId - 1 ) )
+	{
+		nodeCount = c_simMaxNodeId - 1;
+	}
+	m_nodeCount = (uint8)nodeCount;
+
+	memset( m_nodes, 0, sizeof(m_nodes) );
+	m_nodes[c_simNodeId].m_listening = true;
+	m_nodes[c_simNodeId].m_generic = 0x02;			// Generic Static Controller
+	m_nodes[c_simNodeId].m_specific = 0x01;			// Specific Static PC Controller
+	for( uint32 i=0; i<m_nodeCount; ++i )
+	{
+		SimNode& node = m_nodes[c_simNodeId+1+i];
+		node.m_listening = true;
+		node.m_generic = 0x11;						// Generic Multilevel Switch
+		node.m_specific = 0x01;						// Specific Multilevel Power Switch
+	}
+
+	memset( &m_stats, 0, sizeof(m_stats) );
+	memset( m_rttHistogram, 0, sizeof(m_rttHistogram) );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::~SimulatorController>
+//	Destructor
+//-----------------------------------------------------------------------------
+SimulatorController::~SimulatorController
+(
+)
+{
+	if( m_bOpen )
+	{
+		Close();
+	}
+
+	m_pendingEvent->Release();
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::Open>
+//	Start the simulated stick
+//-----------------------------------------------------------------------------
+bool SimulatorController::Open
+(
+	string const& _replayFileName
+)
+{
+	if( m_bOpen )
+	{
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, "    Open simulated controller with %d virtual nodes", m_nodeCount );
+
+	m_replay.clear();
+	m_replayIndex = 0;
+	if( !_replayFileName.empty() && !ReadReplayFile( _replayFileName ) )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Cannot read simulator replay file %s", _replayFileName.c_str() );
+		return false;
+	}
+
+	m_startTime.SetTime();
+	m_pending.clear();
+	m_rxBuffer.clear();
+	m_nextReport = m_reportInterval;
+	m_nextReplay = m_replay.empty() ? 0 : m_replay[0].m_delay;
+	ResetStatistics();
+
+	m_bOpen = true;
+	m_thread = new Thread( "SimulatorController" );
+	m_thread->Start( ThreadEntryPoint, this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::Close>
+//	Stop the simulated stick
+//-----------------------------------------------------------------------------
+bool SimulatorController::Close
+(
+)
+{
+	if( !m_bOpen )
+	{
+		return false;
+	}
+
+	if( m_thread )
+	{
+		m_thread->Stop();
+		m_thread->Release();
+		m_thread = NULL;
+	}
+
+	LogStatistics();
+
+	m_mutex->Lock();
+	m_pending.clear();
+	m_rxBuffer.clear();
+	m_mutex->Unlock();
+
+	m_bOpen = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::Write>
+//	Accept data from the driver
+//-----------------------------------------------------------------------------
+uint32 SimulatorController::Write
+(
+	uint8* _buffer,
+	uint32 _length
+)
+{
+	if( !m_bOpen )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Simulated controller is not open" );
+		return 0;
+	}
+
+	LockGuard LG( m_mutex );
+	int32 now = Now();
+	for( uint32 i=0; i<_length; ++i )
+	{
+		uint8 byte = _buffer[i];
+		if( m_rxBuffer.empty() )
+		{
+			if( SOF == byte )
+			{
+				m_rxBuffer.push_back( byte );
+			}
+			else if( ACK == byte && m_finalDelivered )
+			{
+				// The driver has acknowledged the last frame of the transaction
+				uint32 rtt = now - m_transactionStart;
+				++m_rttHistogram[( rtt < c_rttBuckets ) ? rtt : ( c_rttBuckets - 1 )];
+				if( 0 == m_stats.m_transactions++ || rtt < m_stats.m_rttMin )
+				{
+					m_stats.m_rttMin = rtt;
+				}
+				if( rtt > m_stats.m_rttMax )
+				{
+					m_stats.m_rttMax = rtt;
+				}
+				m_transactionStart = -1;
+				m_finalDelivered = false;
+			}
+			// NAK and CAN from the driver are ignored.  The driver resends on its own timeout.
+			continue;
+		}
+
+		m_rxBuffer.push_back( byte );
+		if( m_rxBuffer.size() >= 2 && m_rxBuffer.size() == (size_t)m_rxBuffer[1] + 2 )
+		{
+			ProcessFrame( &m_rxBuffer[0], (uint32)m_rxBuffer.size() );
+			m_rxBuffer.clear();
+		}
+	}
+
+	return _length;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::GetStatistics>
+//	Retrieve the benchmark statistics
+//-----------------------------------------------------------------------------
+void SimulatorController::GetStatistics
+(
+	SimulatorData* _data
+)
+{
+	LockGuard LG( m_mutex );
+
+	*_data = m_stats;
+	_data->m_elapsed = Now() - m_statsStart;
+
+	uint32 frames = m_stats.m_framesReceived + m_stats.m_framesSent;
+	if( _data->m_elapsed )
+	{
+		_data->m_msgsPerSec = (uint32)( ( (uint64)frames * 1000 ) / _data->m_elapsed );
+	}
+	if( frames )
+	{
+		double cpu = (double)( clock() - m_statsCpuStart ) / CLOCKS_PER_SEC;
+		_data->m_cpuPerMsg = (uint32)( ( cpu * 1000000.0 ) / frames );
+	}
+
+	// Percentiles are read from the one millisecond buckets
+	uint32 p50 = ( m_stats.m_transactions + 1 ) / 2;
+	uint32 p99 = m_stats.m_transactions - ( m_stats.m_transactions / 100 );
+	uint32 count = 0;
+	for( uint32 i=0; i<c_rttBuckets && count<p99; ++i )
+	{
+		if( count < p50 && ( count + m_rttHistogram[i] ) >= p50 )
+		{
+			_data->m_rttP50 = i;
+		}
+		count += m_rttHistogram[i];
+		if( count >= p99 )
+		{
+			_data->m_rttP99 = i;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::ResetStatistics>
+//	Clear the benchmark statistics
+//-----------------------------------------------------------------------------
+void SimulatorController::ResetStatistics
+(
+)
+{
+	LockGuard LG( m_mutex );
+
+	memset( &m_stats, 0, sizeof(m_stats) );
+	memset( m_rttHistogram, 0, sizeof(m_rttHistogram) );
+	m_statsStart = Now();
+	m_statsCpuStart = clock();
+	m_transactionStart = -1;
+	m_finalDelivered = false;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatorController::LogStatistics>
+//	Write the benchmark statistics to the log
+//-----------------------------------------------------------------------------
+void SimulatorController::LogStatistics
+(
+)
+{
+	SimulatorData data;
+	GetStatistics( &data );
+
+	Log::Write( LogLevel_Always, "***************************************************************************" );
+	Log::Write( LogLevel_Always, "*********************  Cumulative Simulator Statistics  *******************" );
+	Log::Write( LogLevel_Always, "*** Elapsed time (ms)                         %d", data.m_elapsed );
+	Log::Write( LogLevel_Always, "*** Frames received from the driver           %d", data.m_framesReceived );
+	Log::Write( LogLevel_Always, "*** Frames sent to the driver                 %d", data.m_framesSent );
+	Log::Write( LogLevel_Always, "*** Unsolicited reports injected              %d", data.m_reportsInjected );
+	Log::Write( LogLevel_Always, "*** CAN frames injected                       %d", data.m_CANInjected );
+	Log::Write( LogLevel_Always, "*** NAK frames injected                       %d", data.m_NAKInjected );
+	Log::Write( LogLevel_Always, "*** Frames with bad checksums                 %d", data.m_badChecksum );
+	Log::Write( LogLevel_Always, "*** Messages per second                       %d", data.m_msgsPerSec );
+	Log::Write( LogLevel_Always, "*** CPU per message (us)                      %d", data.m_cpuPerMsg );
+	Log::Write( LogLevel_Always, "*** Completed transactions                    %d", data.m_transactions );
+	Log::Write( LogLevel_Always, "*** Round trip min/p50/p99/max (ms)           %d/%d/%d/%d", data.m_rttMin, data.m_rttP50, data.m_rttP99, data.m_rttMax );
+	Log::Write( LogLevel_Always, "***************************************************************************" );
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ThreadEntryPoint>
+// Entry point of the thread that delivers frames to the driver
+//-----------------------------------------------------------------------------
+void SimulatorController::ThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	SimulatorController* sc = (SimulatorController*)_context;
+	if( sc )
+	{
+		sc->ThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ThreadProc>
+// Deliver queued frames once they fall due
+//-----------------------------------------------------------------------------
+void SimulatorController::ThreadProc
+(
+	Event* _exitEvent
+)
+{
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;
+	waitObjects[1] = m_pendingEvent;
+	WaitSet waitSet( waitObjects, 2 );
+
+	while( true )
+	{
+		int32 timeout = -1;
+
+		m_mutex->Lock();
+		int32 now = Now();
+		InjectReports( now );
+
+		while( !m_pending.empty() && m_pending.front().m_due <= now )
+		{
+			PendingFrame& frame = m_pending.front();
+			if( !Put( &frame.m_data[0], (uint32)frame.m_data.size() ) )
+			{
+				// The driver is not keeping up.  Try again shortly.
+				timeout = 1;
+				break;
+			}
+			if( frame.m_data.size() > 1 )
+			{
+				++m_stats.m_framesSent;
+			}
+			if( frame.m_final )
+			{
+				m_finalDelivered = true;
+			}
+			m_pending.pop_front();
+		}
+		m_pendingEvent->Reset();
+
+		// Sleep until the next frame or report is due
+		if( timeout < 0 && !m_pending.empty() )
+		{
+			timeout = m_pending.front().m_due - now;
+		}
+		if( m_reportInterval && m_nodeCount && ( timeout < 0 || ( m_nextReport - now ) < timeout ) )
+		{
+			timeout = m_nextReport - now;
+		}
+		if( m_replayIndex < m_replay.size() && ( timeout < 0 || ( m_nextReplay - now ) < timeout ) )
+		{
+			timeout = m_nextReplay - now;
+		}
+		m_mutex->Unlock();
+
+		if( waitSet.Any( timeout ) == 0 )
+		{
+			// Exit signalled.
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ProcessFrame>
+// Answer a complete frame written by the driver
+//-----------------------------------------------------------------------------
+void SimulatorController::ProcessFrame
+(
+	uint8 const* _frame,
+	uint32 _length
+)
+{
+	int32 now = Now();
+	++m_stats.m_framesReceived;
+
+	uint8 checksum = 0xff;
+	for( uint32 i=1; i<_length-1; ++i )
+	{
+		checksum ^= _frame[i];
+	}
+	if( checksum != _frame[_length-1] )
+	{
+		++m_stats.m_badChecksum;
+		QueueByte( NAK, now + m_ackLatency );
+		return;
+	}
+
+	if( InjectError( m_CANRate ) )
+	{
+		++m_stats.m_CANInjected;
+		QueueByte( CAN, now + m_ackLatency );
+		return;
+	}
+	if( InjectError( m_NAKRate ) )
+	{
+		++m_stats.m_NAKInjected;
+		QueueByte( NAK, now + m_ackLatency );
+		return;
+	}
+
+	QueueByte( ACK, now + m_ackLatency );
+	if( _length < 5 || REQUEST != _frame[2] )
+	{
+		return;
+	}
+
+	int32 due = now + m_ackLatency + m_responseLatency;
+	uint8 const* data = &_frame[4];
+	uint8 reply[64];
+	uint32 length = 0;
+
+	switch( _frame[3] )
+	{
+		case FUNC_ID_ZW_GET_VERSION:
+		{
+			char const* version = "Z-Wave 3.95";
+			length = (uint32)strlen( version ) + 1;
+			memcpy( reply, version, length );
+			reply[length++] = 0x01;		// Static Controller library
+			QueueFrame( RESPONSE, FUNC_ID_ZW_GET_VERSION, reply, length, due );
+			break;
+		}
+		case FUNC_ID_ZW_MEMORY_GET_ID:
+		{
+			reply[length++] = (uint8)( m_homeId >> 24 );
+			reply[length++] = (uint8)( m_homeId >> 16 );
+			reply[length++] = (uint8)( m_homeId >> 8 );
+			reply[length++] = (uint8)m_homeId;
+			reply[length++] = c_simNodeId;
+			QueueFrame( RESPONSE, FUNC_ID_ZW_MEMORY_GET_ID, reply, length, due );
+			break;
+		}
+		case FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:
+		{
+			reply[length++] = 0x14;		// SIS and SUC
+			QueueFrame( RESPONSE, FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES, reply, length, due );
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_CAPABILITIES:
+		{
+			reply[length++] = 0x05;		// Serial API version
+			reply[length++] = 0x07;
+			reply[length++] = 0x00;		// Manufacturer ID
+			reply[length++] = 0x00;
+			reply[length++] = 0x00;		// Product Type
+			reply[length++] = 0x00;
+			reply[length++] = 0x00;		// Product ID
+			reply[length++] = 0x00;
+			memset( &reply[length], 0, 32 );
+			for( uint32 i=0; i<sizeof(c_simFunctions); ++i )
+			{
+				uint8 bit = c_simFunctions[i] - 1;
+				reply[length+(bit>>3)] |= ( 0x01 << ( bit & 0x07 ) );
+			}
+			length += 32;
+			QueueFrame( RESPONSE, FUNC_ID_SERIAL_API_GET_CAPABILITIES, reply, length, due );
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_INIT_DATA:
+		{
+			reply[length++] = 0x05;		// Init version
+			reply[length++] = 0x08;		// SUC
+			reply[length++] = NUM_NODE_BITFIELD_BYTES;
+			memset( &reply[length], 0, NUM_NODE_BITFIELD_BYTES );
+			for( uint32 nodeId=1; nodeId<=c_simMaxNodeId; ++nodeId )
+			{
+				if( m_nodes[nodeId].m_generic )
+				{
+					reply[length+((nodeId-1)>>3)] |= ( 0x01 << ( ( nodeId - 1 ) & 0x07 ) );
+				}
+			}
+			length += NUM_NODE_BITFIELD_BYTES;
+			reply[length++] = 0x05;		// Chip type
+			reply[length++] = 0x00;		// Chip version
+			QueueFrame( RESPONSE, FUNC_ID_SERIAL_API_GET_INIT_DATA, reply, length, due );
+			break;
+		}
+		case FUNC_ID_SERIAL_API_SET_TIMEOUTS:
+		{
+			reply[length++] = ACK_TIMEOUT / 10;
+			reply[length++] = BYTE_TIMEOUT / 10;
+			QueueFrame( RESPONSE, FUNC_ID_SERIAL_API_SET_TIMEOUTS, reply, length, due );
+			break;
+		}
+		case FUNC_ID_ZW_GET_SUC_NODE_ID:
+		{
+			reply[length++] = c_simNodeId;
+			QueueFrame( RESPONSE, FUNC_ID_ZW_GET_SUC_NODE_ID, reply, length, due );
+			break;
+		}
+		case FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO:
+		{
+			SimNode const& node = m_nodes[data[0]];
+			memset( reply, 0, 6 );
+			if( node.m_generic )
+			{
+				reply[0] = ( node.m_listening ? 0x80 : 0x00 ) | 0x40 | 0x10 | 0x03;	// Listening, routing, 40kbps, version 4
+				reply[1] = 0x10;														// Beaming
+				reply[3] = ( c_simNodeId == data[0] ) ? 0x02 : 0x04;					// Static Controller or Routing Slave
+				reply[4] = node.m_generic;
+				reply[5] = node.m_specific;
+			}
+			QueueFrame( RESPONSE, FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO, reply, 6, due );
+			break;
+		}
+		case FUNC_ID_ZW_REQUEST_NODE_INFO:
+		{
+			uint8 nodeId = data[0];
+			SimNode const& node = m_nodes[nodeId];
+			reply[length++] = 0x01;
+			QueueFrame( RESPONSE, FUNC_ID_ZW_REQUEST_NODE_INFO, reply, length, due );
+
+			length = 0;
+			if( node.m_generic && node.m_listening )
+			{
+				reply[length++] = UPDATE_STATE_NODE_INFO_RECEIVED;
+				reply[length++] = nodeId;
+				reply[length++] = 0;
+				reply[length++] = ( c_simNodeId == nodeId ) ? 0x02 : 0x04;
+				reply[length++] = node.m_generic;
+				reply[length++] = node.m_specific;
+				if( c_simNodeId != nodeId )
+				{
+					memcpy( &reply[length], c_simCommandClasses, sizeof(c_simCommandClasses) );
+					length += sizeof(c_simCommandClasses);
+				}
+				reply[2] = (uint8)( length - 3 );
+			}
+			else
+			{
+				reply[length++] = UPDATE_STATE_NODE_INFO_REQ_FAILED;
+				reply[length++] = 0;
+				reply[length++] = 0;
+			}
+			QueueFrame( REQUEST, FUNC_ID_ZW_APPLICATION_UPDATE, reply, length, due + m_callbackLatency );
+			break;
+		}
+		case FUNC_ID_ZW_GET_ROUTING_INFO:
+		{
+			// Every virtual node can hear every other one
+			memset( reply, 0, NUM_NODE_BITFIELD_BYTES );
+			for( uint32 nodeId=1; nodeId<=c_simMaxNodeId; ++nodeId )
+			{
+				if( m_nodes[nodeId].m_generic && nodeId != data[0] )
+				{
+					reply[(nodeId-1)>>3] |= ( 0x01 << ( ( nodeId - 1 ) & 0x07 ) );
+				}
+			}
+			QueueFrame( RESPONSE, FUNC_ID_ZW_GET_ROUTING_INFO, reply, NUM_NODE_BITFIELD_BYTES, due );
+			break;
+		}
+		case FUNC_ID_ZW_SEND_DATA:
+		{
+			ProcessSendData( _frame, now );
+			break;
+		}
+		case FUNC_ID_ZW_SEND_DATA_MULTI:
+		{
+			ProcessSendDataMulti( _frame, now );
+			break;
+		}
+		case FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION:
+		{
+			// No response is sent for this one
+			break;
+		}
+		default:
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Simulated controller does not support function 0x%.2x", _frame[3] );
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ProcessSendData>
+// Answer a ZW_SEND_DATA request with a response, a callback and any report
+//-----------------------------------------------------------------------------
+void SimulatorController::ProcessSendData
+(
+	uint8 const* _frame,
+	int32 _now
+)
+{
+	// SOF, length, REQUEST, FUNC_ID_ZW_SEND_DATA, node, command length, command..., options, [callback id], checksum
+	uint8 nodeId = _frame[4];
+	uint8 commandLength = _frame[5];
+	uint8 const* command = &_frame[6];
+	uint8 callbackId = 0;
+	if( (uint32)_frame[1] + 2 >= (uint32)commandLength + 9 )
+	{
+		callbackId = _frame[commandLength+7];
+	}
+
+	m_transactionStart = _now;
+	m_finalDelivered = false;
+
+	int32 due = _now + m_ackLatency + m_responseLatency;
+	uint8 reply[2];
+	reply[0] = 0x01;		// Delivered to the Z-Wave stack
+	QueueFrame( RESPONSE, FUNC_ID_ZW_SEND_DATA, reply, 1, due, 0 == callbackId );
+
+	SimNode& node = m_nodes[nodeId];
+	bool delivered = ( 0 != node.m_generic ) && node.m_listening && ( c_simNodeId != nodeId );
+	uint8 report[64];
+	uint32 reportLength = 0;
+	if( delivered )
+	{
+		if( commandLength >= 3 && 0x8f == command[0] && 0x01 == command[1] )
+		{
+			// Multi Command Encapsulation.  Any reports are returned encapsulated in the same way.
+			uint8 count = 0;
+			uint32 base = 3;
+			reportLength = 3;
+			for( uint8 i=0; i<command[2] && base < commandLength; ++i )
+			{
+				uint32 length = command[base];
+				if( ( base + 1 + length > commandLength ) || ( reportLength + 1 >= (uint32)sizeof(report) ) )
+				{
+					// The command runs past the frame, or there is no room for another report
+					break;
+				}
+				uint8 partLength = ProcessNodeCommand( nodeId, &command[base+1], (uint8)length, &report[reportLength+1], (uint32)sizeof(report) - reportLength - 1 );
+				if( partLength )
+				{
+					report[reportLength] = partLength;
+					reportLength += partLength + 1;
+					++count;
+				}
+				base += length + 1;
+			}
+			report[0] = 0x8f;
+			report[1] = 0x01;
+			report[2] = count;
+			if( 0 == count )
+			{
+				reportLength = 0;
+			}
+		}
+		else
+		{
+			reportLength = ProcessNodeCommand( nodeId, command, commandLength, report, (uint32)sizeof(report) );
+		}
+	}
+
+	// A real controller always delivers the callback before the node's report
+	if( 0 != callbackId )
+	{
+		due += m_callbackLatency;
+		reply[0] = callbackId;
+		reply[1] = delivered ? TRANSMIT_COMPLETE_OK : TRANSMIT_COMPLETE_NO_ACK;
+		QueueFrame( REQUEST, FUNC_ID_ZW_SEND_DATA, reply, 2, due, 0 == reportLength );
+	}
+
+	if( reportLength )
+	{
+		QueueReport( nodeId, report, (uint8)reportLength, due + m_reportLatency, true );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ProcessSendDataMulti>
+// Answer a ZW_SEND_DATA_MULTI request with a response and a callback
+//-----------------------------------------------------------------------------
+void SimulatorController::ProcessSendDataMulti
+(
+	uint8 const* _frame,
+	int32 _now
+)
+{
+	// SOF, length, REQUEST, FUNC_ID_ZW_SEND_DATA_MULTI, node count, nodes..., command length, command..., options, [callback id], checksum
+	uint8 nodeCount = _frame[4];
+	uint8 const* nodes = &_frame[5];
+	uint8 commandLength = _frame[nodeCount+5];
+	uint8 const* command = &_frame[nodeCount+6];
+	uint8 callbackId = 0;
+	if( (uint32)_frame[1] + 2 >= (uint32)nodeCount + commandLength + 9 )
+	{
+		callbackId = _frame[nodeCount+commandLength+7];
+	}
+
+	m_transactionStart = _now;
+	m_finalDelivered = false;
+
+	int32 due = _now + m_ackLatency + m_responseLatency;
+	uint8 reply[2];
+	reply[0] = 0x01;		// Delivered to the Z-Wave stack
+	QueueFrame( RESPONSE, FUNC_ID_ZW_SEND_DATA_MULTI, reply, 1, due, 0 == callbackId );
+
+	// Multicast frames are not acknowledged by the nodes, and any reports they would cause are not sent
+	uint8 report[64];
+	for( uint8 i=0; i<nodeCount; ++i )
+	{
+		SimNode& node = m_nodes[nodes[i]];
+		if( ( 0 != node.m_generic ) && node.m_listening && ( c_simNodeId != nodes[i] ) )
+		{
+			ProcessNodeCommand( nodes[i], command, commandLength, report, (uint32)sizeof(report) );
+		}
+	}
+
+	if( 0 != callbackId )
+	{
+		reply[0] = callbackId;
+		reply[1] = TRANSMIT_COMPLETE_OK;
+		QueueFrame( REQUEST, FUNC_ID_ZW_SEND_DATA_MULTI, reply, 2, due + m_callbackLatency, true );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ProcessNodeCommand>
+// Apply a command to a virtual node, returning the length of any report.
+// A report that does not fit in _reportSize bytes is not written.
+//-----------------------------------------------------------------------------
+uint8 SimulatorController::ProcessNodeCommand
+(
+	uint8 const _nodeId,
+	uint8 const* _command,
+	uint8 const _length,
+	uint8* _report,
+	uint32 const _reportSize
+)
+{
+	if( _length < 2 )
+	{
+		// NoOperation and friends
+		return 0;
+	}
+
+	uint8 commandClassId = _command[0];
+	if( commandClassId != 0x20 && commandClassId != 0x25 && commandClassId != 0x26 )
+	{
+		// Only Basic, Binary Switch and Multilevel Switch are emulated
+		return 0;
+	}
+
+	SimNode& node = m_nodes[_nodeId];
+	switch( _command[1] )
+	{
+		case 0x01:	// Set
+		{
+			if( _length >= 3 )
+			{
+				node.m_level = ( 0xff == _command[2] ) ? 0x63 : _command[2];
+			}
+			return 0;
+		}
+		case 0x02:	// Get
+		{
+			if( _reportSize < 3 )
+			{
+				return 0;
+			}
+			_report[0] = commandClassId;
+			_report[1] = 0x03;
+			_report[2] = ( 0x25 == commandClassId ) ? ( node.m_level ? 0xff : 0x00 ) : node.m_level;
+			return 3;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::QueueByte>
+// Queue a single byte frame (ACK, NAK or CAN) for the driver
+//-----------------------------------------------------------------------------
+void SimulatorController::QueueByte
+(
+	uint8 const _byte,
+	int32 _due
+)
+{
+	QueueFrame( _byte, 0, NULL, 0, _due );
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::QueueFrame>
+// Queue a frame for the driver.  A zero function means a single byte frame.
+//-----------------------------------------------------------------------------
+void SimulatorController::QueueFrame
+(
+	uint8 const _type,
+	uint8 const _function,
+	uint8 const* _payload,
+	uint32 _length,
+	int32 _due,
+	bool _final
+)
+{
+	PendingFrame frame;
+	frame.m_due = _due;
+	frame.m_final = _final;
+
+	if( 0 == _function )
+	{
+		frame.m_data.push_back( _type );
+	}
+	else
+	{
+		frame.m_data.reserve( _length + 5 );
+		frame.m_data.push_back( SOF );
+		frame.m_data.push_back( (uint8)( _length + 3 ) );
+		frame.m_data.push_back( _type );
+		frame.m_data.push_back( _function );
+		frame.m_data.insert( frame.m_data.end(), _payload, _payload + _length );
+
+		uint8 checksum = 0xff;
+		for( uint32 i=1; i<frame.m_data.size(); ++i )
+		{
+			checksum ^= frame.m_data[i];
+		}
+		frame.m_data.push_back( checksum );
+	}
+
+	// Keep the list ordered by due time, preserving the order of frames due together
+	list<PendingFrame>::iterator it = m_pending.end();
+	while( it != m_pending.begin() )
+	{
+		list<PendingFrame>::iterator prev = it;
+		--prev;
+		if( prev->m_due <= _due )
+		{
+			break;
+		}
+		it = prev;
+	}
+	m_pending.insert( it, frame );
+	m_pendingEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::QueueReport>
+// Queue an application command from a virtual node
+//-----------------------------------------------------------------------------
+void SimulatorController::QueueReport
+(
+	uint8 const _nodeId,
+	uint8 const* _command,
+	uint8 const _length,
+	int32 _due,
+	bool _final
+)
+{
+	uint8 payload[256];
+	payload[0] = 0x00;		// Receive status
+	payload[1] = _nodeId;
+	payload[2] = _length;
+	memcpy( &payload[3], _command, _length );
+	QueueFrame( REQUEST, FUNC_ID_APPLICATION_COMMAND_HANDLER, payload, _length + 3, _due, _final );
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::InjectReports>
+// Queue any periodic or replayed unsolicited reports that are due
+//-----------------------------------------------------------------------------
+void SimulatorController::InjectReports
+(
+	int32 _now
+)
+{
+	if( m_reportInterval && m_nodeCount )
+	{
+		while( m_nextReport <= _now )
+		{
+			// Walk the virtual nodes, reporting a slowly changing level
+			uint8 nodeId = c_simNodeId + 1 + m_nextReportNode;
+			m_nextReportNode = ( m_nextReportNode + 1 ) % m_nodeCount;
+
+			SimNode& node = m_nodes[nodeId];
+			node.m_level = ( node.m_level + 1 ) % 100;
+
+			uint8 report[3];
+			report[0] = 0x26;
+			report[1] = 0x03;
+			report[2] = node.m_level;
+			QueueReport( nodeId, report, 3, _now );
+			++m_stats.m_reportsInjected;
+
+			m_nextReport += m_reportInterval;
+			if( m_nextReport < _now )
+			{
+				// Don't try to catch up after a stall
+				m_nextReport = _now + m_reportInterval;
+			}
+		}
+	}
+
+	while( m_replayIndex < m_replay.size() && m_nextReplay <= _now )
+	{
+		ReplayEntry const& entry = m_replay[m_replayIndex];
+		QueueReport( entry.m_nodeId, &entry.m_command[0], (uint8)entry.m_command.size(), _now );
+		++m_stats.m_reportsInjected;
+
+		if( ++m_replayIndex == m_replay.size() && m_replayLoop )
+		{
+			m_replayIndex = 0;
+		}
+		if( m_replayIndex < m_replay.size() )
+		{
+			m_nextReplay += m_replay[m_replayIndex].m_delay;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::ReadReplayFile>
+// Load a script of unsolicited reports
+//-----------------------------------------------------------------------------
+bool SimulatorController::ReadReplayFile
+(
+	string const& _fileName
+)
+{
+	FILE* file = fopen( _fileName.c_str(), "r" );
+	if( !file )
+	{
+		return false;
+	}
+
+	char line[1024];
+	uint32 lineNumber = 0;
+	while( fgets( line, sizeof(line), file ) )
+	{
+		++lineNumber;
+
+		char* pos = line;
+		while( *pos == ' ' || *pos == '\t' )
+		{
+			++pos;
+		}
+		if( *pos == '#' || *pos == '\r' || *pos == '\n' || *pos == 0 )
+		{
+			continue;
+		}
+
+		ReplayEntry entry;
+		char* end;
+		entry.m_delay = (int32)strtol( pos, &end, 10 );
+		pos = end;
+		entry.m_nodeId = (uint8)strtol( pos, &end, 16 );
+		while( end != pos )
+		{
+			pos = end;
+			long byte = strtol( pos, &end, 16 );
+			if( end != pos )
+			{
+				entry.m_command.push_back( (uint8)byte );
+			}
+		}
+
+		if( entry.m_delay < 0 || 0 == entry.m_nodeId || entry.m_command.size() < 2 || entry.m_command.size() > 250 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Ignoring malformed line %d in simulator replay file %s", lineNumber, _fileName.c_str() );
+			continue;
+		}
+		m_replay.push_back( entry );
+	}
+
+	fclose( file );
+	Log::Write( LogLevel_Info, "    Loaded %d reports from simulator replay file %s", (int)m_replay.size(), _fileName.c_str() );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <SimulatorController::InjectError>
+// Decide whether to fail the current frame, given a rate per thousand
+//-----------------------------------------------------------------------------
+bool SimulatorController::InjectError
+(
+	uint32 const _rate
+)
+{
+	if( 0 == _rate )
+	{
+		return false;
+	}
+
+	// A fixed seed keeps runs repeatable
+	m_seed = m_seed * 1103515245 + 12345;
+	return ( ( m_seed >> 16 ) % 1000 ) < _rate;
+}
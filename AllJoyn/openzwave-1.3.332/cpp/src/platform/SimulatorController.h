@@ -0,0 +1,223 @@
+//-----------------------------------------------------------------------------
+//
+//	SimulatorController.h
+//
+//	In-process emulation of a Z-Wave Serial API controller
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _SimulatorController_H
+#define _SimulatorController_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <ctime>
+#include "Defs.h"
+#include "platform/Controller.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Driver;
+	class Event;
+	class Mutex;
+	class Thread;
+
+	/**
+	 * Simulator benchmark statistics.
+	 * Round trip times are measured from the arrival of a ZW_SEND_DATA
+	 * frame to the driver's ACK of the last frame of that transaction.
+	 */
+	struct SimulatorData
+	{
+		uint32 m_framesReceived;	// Number of SOF frames written by the driver
+		uint32 m_framesSent;		// Number of SOF frames delivered to the driver
+		uint32 m_transactions;		// Number of completed ZW_SEND_DATA transactions
+		uint32 m_reportsInjected;	// Number of unsolicited reports (periodic and replayed)
+		uint32 m_CANInjected;		// Number of frames answered with a CAN
+		uint32 m_NAKInjected;		// Number of frames answered with a NAK
+		uint32 m_badChecksum;		// Number of frames from the driver with a bad checksum
+		uint32 m_elapsed;			// Milliseconds since the statistics were reset
+		uint32 m_msgsPerSec;		// Frames (in both directions) per second
+		uint32 m_cpuPerMsg;			// Process CPU time per frame, in microseconds
+		uint32 m_rttMin;			// Round trip times in milliseconds
+		uint32 m_rttP50;
+		uint32 m_rttP99;
+		uint32 m_rttMax;
+	};
+
+	/** \brief Emulates a Z-Wave Serial API stick so that the driver can be
+	 *  exercised (and benchmarked) without any hardware attached.
+	 *
+	 *  Frames written by the driver are parsed and answered with ACKs,
+	 *  responses, callbacks and reports after configurable latencies.
+	 *  CAN and NAK frames can be injected at a fixed rate, and unsolicited
+	 *  reports can be generated periodically or replayed from a script.
+	 *
+	 *  The replay script named in Open contains one frame per line:
+	 *  \code
+	 *  <delay in ms> <node id> <command class> <command> [payload bytes...]
+	 *  \endcode
+	 *  with all bytes written in hex.  Lines starting with '#' are ignored.
+	 */
+	class SimulatorController: public Controller
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates a simulated controller.  Latencies, error rates and the
+		 * virtual nodes are read from the Simulator* options.
+		 */
+		SimulatorController();
+
+		/**
+		 * Destructor.
+		 * Destroys the simulated controller.
+		 */
+		virtual ~SimulatorController();
+
+		/**
+		 * Open the simulator.
+		 * Starts the thread that delivers frames back to the driver.
+		 * @param _replayFileName Optional path to a script of unsolicited reports to replay.
+		 * @return True if the simulator was started.
+		 * @see Close, Write
+		 */
+		bool Open( string const& _replayFileName );
+
+		/**
+		 * Close the simulator.
+		 * Stops the simulator thread and logs the benchmark statistics.
+		 * @return True if the simulator was closed, false if it was not open.
+		 * @see Open
+		 */
+		bool Close();
+
+		/**
+		 * Write to the simulator.
+		 * The data is parsed as Serial API traffic from the host and answered
+		 * after the configured latencies.
+		 * @param _buffer Pointer to a block of memory containing the data to be written.
+		 * @param _length Length in bytes of the data.
+		 * @return The number of bytes written.
+		 */
+		uint32 Write( uint8* _buffer, uint32 _length );
+
+		/**
+		 * Retrieve the benchmark statistics.
+		 * @param _data Pointer to a structure to receive the statistics.
+		 * @see ResetStatistics, LogStatistics
+		 */
+		void GetStatistics( SimulatorData* _data );
+
+		/**
+		 * Clear the benchmark statistics and restart the measurement period.
+		 */
+		void ResetStatistics();
+
+		/**
+		 * Write the benchmark statistics to the log.
+		 */
+		void LogStatistics();
+
+	private:
+		static uint32 const c_rttBuckets = 1024;
+
+		struct SimNode
+		{
+			bool	m_listening;
+			uint8	m_generic;
+			uint8	m_specific;
+			uint8	m_level;
+		};
+
+		struct PendingFrame
+		{
+			int32			m_due;		// Time at which to deliver, in ms since Open
+			bool			m_final;	// Last frame of a ZW_SEND_DATA transaction
+			vector<uint8>	m_data;
+		};
+
+		struct ReplayEntry
+		{
+			int32			m_delay;
+			uint8			m_nodeId;
+			vector<uint8>	m_command;
+		};
+
+		static void ThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ThreadProc( Event* _exitEvent );
+
+		void ProcessFrame( uint8 const* _frame, uint32 _length );
+		void ProcessSendData( uint8 const* _frame, int32 _now );
+		void ProcessSendDataMulti( uint8 const* _frame, int32 _now );
+		uint8 ProcessNodeCommand( uint8 const _nodeId, uint8 const* _command, uint8 const _length, uint8* _report, uint32 const _reportSize );
+		void QueueByte( uint8 const _byte, int32 _due );
+		void QueueFrame( uint8 const _type, uint8 const _function, uint8 const* _payload, uint32 _length, int32 _due, bool _final = false );
+		void QueueReport( uint8 const _nodeId, uint8 const* _command, uint8 const _length, int32 _due, bool _final = false );
+		void InjectReports( int32 _now );
+		bool ReadReplayFile( string const& _fileName );
+		bool InjectError( uint32 const _rate );
+		int32 Now(){ return -m_startTime.TimeRemaining(); }
+
+		Thread*					m_thread;
+		Mutex*					m_mutex;			// Protects the pending frames and statistics
+		Event*					m_pendingEvent;		// Set when a new frame has been queued
+		bool					m_bOpen;
+		TimeStamp				m_startTime;
+
+		list<PendingFrame>		m_pending;			// Frames awaiting delivery, ordered by due time
+		vector<uint8>			m_rxBuffer;			// Partially received frame from the driver
+
+		SimNode					m_nodes[256];
+		uint8					m_nodeCount;
+		uint8					m_nextReportNode;
+		int32					m_nextReport;
+
+		vector<ReplayEntry>		m_replay;
+		uint32					m_replayIndex;
+		int32					m_nextReplay;
+		bool					m_replayLoop;
+
+		uint32					m_homeId;
+		uint32					m_ackLatency;
+		uint32					m_responseLatency;
+		uint32					m_callbackLatency;
+		uint32					m_reportLatency;
+		uint32					m_reportInterval;
+		uint32					m_CANRate;			// Per thousand frames
+		uint32					m_NAKRate;			// Per thousand frames
+		uint32					m_seed;
+
+		// Benchmark statistics
+		SimulatorData			m_stats;
+		int32					m_statsStart;
+		clock_t					m_statsCpuStart;
+		int32					m_transactionStart;	// Arrival of the current ZW_SEND_DATA, or -1
+		bool					m_finalDelivered;	// Awaiting the driver's ACK of the final frame
+		uint32					m_rttHistogram[c_rttBuckets];	// One bucket per millisecond, the last also counts overflows
+	};
+
+} // namespace OpenZWave
+
+#endif //_SimulatorController_H
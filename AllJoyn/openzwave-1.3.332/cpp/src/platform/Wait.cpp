@@ -136,7 +136,6 @@ int32 Wait::Multiple
 	}
 
 	int32 res = -1;	// Default to timeout result
-	string str = "";
 	if( waitEvent->Wait( _timeout ) )
 	{
 		// An object was signalled.  Run through the list 
@@ -145,15 +144,11 @@ int32 Wait::Multiple
 		{
 			if( _objects[i]->IsSignalled() )
 			{
-				if( res == -1 )
-					res = (int32)i;
-				char buf[15];
-				snprintf(buf, sizeof(buf), "%d, ", i);
-				str += buf;
+				res = (int32)i;
+				break;
 			}
 		}
 	}
-	//Log::Write( LogLevel_Debug, "Wait::Multiple res=%d num=%d >%s", res, _numObjects, str.c_str() );
 
 	// Remove the watchers
 	for( i=0; i<_numObjects; ++i )
@@ -42,6 +42,7 @@ namespace OpenZWave
 	{
 		friend class WaitImpl;
 		friend class ThreadImpl;
+		friend class WaitSet;
 
 	public:
 		enum
@@ -83,6 +84,7 @@ namespace OpenZWave
 		 * \param _numObjects number of objects in the array.
 		 * \param _timeout optional maximum time to wait.  Defaults to -1, which means wait forever.
 		 * \return index into the array of the object that was signalled, -1 if the wait timed out.
+		 * \see WaitSet, which avoids the per-call setup when the same objects are waited on repeatedly.
 		 */												 
 		static int32 Multiple( Wait** _objects, uint32 _numObjects, int32 _timeout = -1 );
 
@@ -0,0 +1,149 @@
+//-----------------------------------------------------------------------------
+//
+//	WaitSet.cpp
+//
+//	Reusable set of objects that can be waited on repeatedly.
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include "Defs.h"
+#include "platform/Wait.h"
+#include "platform/WaitSet.h"
+#include "platform/Event.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::WaitSet>
+//	Constructor
+//-----------------------------------------------------------------------------
+WaitSet::WaitSet
+(
+	Wait** _objects,
+	uint32 _numObjects
+):
+	m_numObjects( 0 ),
+	m_event( new Event() )
+{
+	if( _numObjects > MaxObjects )
+	{
+		assert(0);
+		_numObjects = MaxObjects;
+	}
+
+	// Every object shares the one event, so any of them becoming signalled wakes the waiter
+	for( m_numObjects=0; m_numObjects<_numObjects; ++m_numObjects )
+	{
+		m_objects[m_numObjects] = _objects[m_numObjects];
+		m_objects[m_numObjects]->AddWatcher( WaitSetCallback, m_event );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::~WaitSet>
+//	Destructor
+//-----------------------------------------------------------------------------
+WaitSet::~WaitSet
+(
+)
+{
+	for( uint32 i=0; i<m_numObjects; ++i )
+	{
+		m_objects[i]->RemoveWatcher( WaitSetCallback, m_event );
+	}
+
+	m_event->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::Multiple>
+//	Wait for one of the first _numObjects objects to become signalled.
+//-----------------------------------------------------------------------------
+int32 WaitSet::Multiple
+(
+	uint32 _numObjects,
+	int32 _timeout // = -1
+)
+{
+	if( _numObjects > m_numObjects )
+	{
+		_numObjects = m_numObjects;
+	}
+
+	if( _timeout > 0 )
+	{
+		m_deadline.SetTime( _timeout );
+	}
+
+	int32 remaining = _timeout;
+	while( true )
+	{
+		// Reset the event before testing the objects.  Anything signalled
+		// after the test will set it again, so no wake up can be lost.
+		m_event->Reset();
+		for( uint32 i=0; i<_numObjects; ++i )
+		{
+			if( m_objects[i]->IsSignalled() )
+			{
+				return (int32)i;
+			}
+		}
+
+		if( remaining == 0 || !m_event->Wait( remaining ) )
+		{
+			// Timed out.  Check once more in case we raced with a signal.
+			for( uint32 i=0; i<_numObjects; ++i )
+			{
+				if( m_objects[i]->IsSignalled() )
+				{
+					return (int32)i;
+				}
+			}
+			return -1;
+		}
+
+		// Something was signalled, but it may have been an object outside
+		// the first _numObjects.  Go round again and see, waiting only for
+		// whatever is left of the timeout.
+		if( _timeout > 0 )
+		{
+			remaining = m_deadline.TimeRemaining();
+			if( remaining < 0 )
+			{
+				remaining = 0;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::WaitSetCallback>
+//	Callback handler for the watchers added by the WaitSet
+//-----------------------------------------------------------------------------
+void WaitSet::WaitSetCallback
+(
+	void* _context
+)
+{
+	Event* waitEvent = (Event*)_context;
+	waitEvent->Set();
+}
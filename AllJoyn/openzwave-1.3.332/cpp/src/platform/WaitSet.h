@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+//
+//	WaitSet.h
+//
+//	Reusable set of objects that can be waited on repeatedly.
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _WaitSet_H
+#define _WaitSet_H
+
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Wait;
+	class Event;
+
+	/** \brief A persistent set of Wait objects.
+	 *
+	 *  Wait::Multiple creates an event and adds and removes a watcher on
+	 *  every object each time it is called.  A WaitSet registers its
+	 *  watchers once, when it is constructed, and shares a single event
+	 *  between them, so that waiting on the set does not allocate.  This
+	 *  makes it suitable for the loops at the heart of the worker threads.
+	 *
+	 *  A WaitSet must only be waited on by one thread at a time.
+	 */
+	class WaitSet
+	{
+	public:
+		enum
+		{
+			MaxObjects = 16
+		};
+
+		/**
+		 * Constructor.
+		 * Registers a watcher on each of the objects.
+		 * \param _objects array of pointers to the objects to wait on.
+		 * \param _numObjects number of objects in the array (at most MaxObjects).
+		 */
+		WaitSet( Wait** _objects, uint32 _numObjects );
+
+		/**
+		 * Destructor.
+		 * Removes the watchers from the objects.
+		 */
+		~WaitSet();
+
+		/**
+		 * Wait for one of the objects to become signalled.  If more than one object is in
+		 * a signalled state, the lowest index will be returned.
+		 * \param _numObjects only the first _numObjects objects in the set are considered.
+		 * \param _timeout optional maximum time to wait.  Defaults to -1, which means wait forever.
+		 * \return index of the object that was signalled, -1 if the wait timed out.
+		 */
+		int32 Multiple( uint32 _numObjects, int32 _timeout = -1 );
+
+		/**
+		 * Wait for any of the objects in the set to become signalled.
+		 * \param _timeout optional maximum time to wait.  Defaults to -1, which means wait forever.
+		 * \return index of the object that was signalled, -1 if the wait timed out.
+		 */
+		int32 Any( int32 _timeout = -1 ){ return Multiple( m_numObjects, _timeout ); }
+
+	private:
+		WaitSet( WaitSet const& );					// prevent copy
+		WaitSet& operator = ( WaitSet const& );		// prevent assignment
+
+		static void WaitSetCallback( void* _context );
+
+		Wait*		m_objects[MaxObjects];
+		uint32		m_numObjects;
+		Event*		m_event;					// Set by the watchers whenever any object becomes signalled
+		TimeStamp	m_deadline;					// Kept here so that timed waits don't construct a TimeStamp
+	};
+
+} // namespace OpenZWave
+
+#endif //_WaitSet_H
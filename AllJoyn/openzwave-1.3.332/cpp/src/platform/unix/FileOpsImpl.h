@@ -44,6 +44,9 @@ namespace OpenZWave
 		~FileOpsImpl();
 
 		bool FolderExists( string _filename );
+		void const* MapFile( const string &_fileName, uint32* o_size );
+		void UnmapFile( void const* _data, uint32 const _size );
+		bool RenameFile( const string &_from, const string &_to );
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLockImpl.h
+//
+//	POSIX implementation of the cross-platform reader/writer lock
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _RWLockImpl_H
+#define _RWLockImpl_H
+
+#include <pthread.h>
+
+namespace OpenZWave
+{
+	class RWLockImpl
+	{
+	private:
+		friend class RWLock;
+
+		RWLockImpl();
+		~RWLockImpl();
+
+		void LockRead();
+		void UnlockRead();
+		bool LockWrite( bool const _bWait = true );
+		void UnlockWrite();
+
+		pthread_rwlock_t	m_lock;
+	};
+
+} // namespace OpenZWave
+
+#endif //_RWLockImpl_H
+
@@ -67,3 +67,65 @@ bool FileOpsImpl::FolderExists(
 
 	return false;
 }
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::MapFile>
+//	Map the contents of a file into memory
+//-----------------------------------------------------------------------------
+void const* FileOpsImpl::MapFile
+(
+	const string &_fileName,
+	uint32* o_size
+)
+{
+	HANDLE file = CreateFileA( _fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return NULL;			// no such file
+
+	void const* data = NULL;
+	DWORD sizeHigh = 0;
+	DWORD size = GetFileSize( file, &sizeHigh );
+	if( ( size != INVALID_FILE_SIZE ) && ( sizeHigh == 0 ) && ( size != 0 ) )
+	{
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( mapping != NULL )
+		{
+			// The view keeps the mapping open until it is unmapped
+			data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+
+	if( data != NULL )
+	{
+		*o_size = (uint32)size;
+	}
+	return data;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::UnmapFile>
+//	Release a file mapped by MapFile
+//-----------------------------------------------------------------------------
+void FileOpsImpl::UnmapFile
+(
+	void const* _data,
+	uint32 const _size
+)
+{
+	UnmapViewOfFile( _data );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::RenameFile>
+//	Rename a file, replacing any existing file of the new name
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::RenameFile
+(
+	const string &_from,
+	const string &_to
+)
+{
+	return( MoveFileExA( _from.c_str(), _to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0 );
+}
@@ -79,7 +79,8 @@ LogImpl::LogImpl
 	m_bConsoleOutput( _bConsoleOutput ),		// true to provide a copy of output to console
 	m_saveLevel( _saveLevel ),					// level of messages to log to file
 	m_queueLevel( _queueLevel ),				// level of messages to log to queue
-	m_dumpTrigger( _dumpTrigger )				// dump queued messages when this level is seen
+	m_dumpTrigger( _dumpTrigger ),				// dump queued messages when this level is seen
+	m_pBatchFile( NULL )						// only open while the asynchronous writer is writing a batch
 {
 	string accessType;
 
@@ -111,6 +112,7 @@ LogImpl::~LogImpl
 (
 )
 {
+	EndBatch();
 }
 
 //-----------------------------------------------------------------------------
@@ -124,9 +126,26 @@ void LogImpl::Write
 	char const* _format,
 	va_list _args
 )
+{
+	Write( _logLevel, _nodeId, 0, GetCallingThreadId(), _format, _args );
+}
+
+//-----------------------------------------------------------------------------
+//	<LogImpl::Write>
+//	Write to the log an entry that was queued _age milliseconds ago by another thread
+//-----------------------------------------------------------------------------
+void LogImpl::Write
+(
+	LogLevel _logLevel,
+	uint8 const _nodeId,
+	int32 const _age,
+	uint32 const _threadId,
+	char const* _format,
+	va_list _args
+)
 {
 	// create a timestamp string
-	string timeStr = GetTimeStampString();
+	string timeStr = GetTimeStampString( _age );
 	string nodeStr = GetNodeString( _nodeId );
 	string logLevelStr = GetLogLevelString(_logLevel);
 
@@ -146,9 +165,9 @@ void LogImpl::Write
 		// should this message be saved to file (and possibly written to console?)
 		if( (_logLevel <= m_saveLevel) || (_logLevel == LogLevel_Internal) )
 		{
-			// save to file
-			FILE* pFile = NULL;
-			if( !fopen_s( &pFile, m_filename.c_str(), "a" ) || m_bConsoleOutput )
+			// save to file, reusing the file opened for a batch
+			FILE* pFile = m_pBatchFile;
+			if( pFile != NULL || !fopen_s( &pFile, m_filename.c_str(), "a" ) || m_bConsoleOutput )
 			{
 				if( _logLevel != LogLevel_Internal )						// don't add a second timestamp to display of queued messages
 				{
@@ -167,7 +186,10 @@ void LogImpl::Write
 				{
 					fprintf( pFile, "%s", lineBuf );
 					fprintf( pFile, "\n" );
-					fclose( pFile );
+					if( pFile != m_pBatchFile )
+					{
+						fclose( pFile );
+					}
 				}
 				if( m_bConsoleOutput )
 				{
@@ -181,7 +203,7 @@ void LogImpl::Write
 		if( _logLevel != LogLevel_Internal )
 		{
 			char queueBuf[1024];
-			string threadStr = GetThreadId();
+			string threadStr = GetThreadId( _threadId );
 			sprintf_s( queueBuf, sizeof(queueBuf), "%s%s%s", timeStr.c_str(), threadStr.c_str(), lineBuf );
 			Queue( queueBuf );
 		}
@@ -194,6 +216,38 @@ void LogImpl::Write
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	<LogImpl::BeginBatch>
+//	Open the log file once for a batch of writes
+//-----------------------------------------------------------------------------
+void LogImpl::BeginBatch
+(
+)
+{
+	if( m_pBatchFile == NULL )
+	{
+		if( fopen_s( &m_pBatchFile, m_filename.c_str(), "a" ) )
+		{
+			m_pBatchFile = NULL;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<LogImpl::EndBatch>
+//	Close the log file at the end of a batch
+//-----------------------------------------------------------------------------
+void LogImpl::EndBatch
+(
+)
+{
+	if( m_pBatchFile != NULL )
+	{
+		fclose( m_pBatchFile );
+		m_pBatchFile = NULL;
+	}
+}
+
 //-----------------------------------------------------------------------------
 //	<LogImpl::Queue>
 //	Write to the log queue
@@ -266,11 +320,29 @@ void LogImpl::SetLoggingState
 //-----------------------------------------------------------------------------
 string LogImpl::GetTimeStampString
 (
+	int32 const _age
 )
 {
-	// Get a timestamp
+	// Get a timestamp, backdated for entries that waited in the asynchronous queue
 	SYSTEMTIME time;
-	::GetLocalTime( &time );
+	if( _age > 0 )
+	{
+		ULARGE_INTEGER stamp;
+		FILETIME utc;
+		FILETIME local;
+		::GetSystemTimeAsFileTime( &utc );
+		stamp.LowPart = utc.dwLowDateTime;
+		stamp.HighPart = utc.dwHighDateTime;
+		stamp.QuadPart -= ((ULONGLONG)_age) * 10000ULL;		// FILETIME is in 100ns steps
+		utc.dwLowDateTime = stamp.LowPart;
+		utc.dwHighDateTime = stamp.HighPart;
+		::FileTimeToLocalFileTime( &utc, &local );
+		::FileTimeToSystemTime( &local, &time );
+	}
+	else
+	{
+		::GetLocalTime( &time );
+	}
 
 	// create a time stamp string for the log message
 	char buf[100];
@@ -305,17 +377,28 @@ string LogImpl::GetNodeString
 		}
 }
 
+//-----------------------------------------------------------------------------
+//	<LogImpl::GetCallingThreadId>
+//	Identify the calling thread
+//-----------------------------------------------------------------------------
+uint32 LogImpl::GetCallingThreadId
+(
+)
+{
+	return (uint32)::GetCurrentThreadId();
+}
+
 //-----------------------------------------------------------------------------
 //	<LogImpl::GetThreadId>
 //	Generate a string with formatted thread id
 //-----------------------------------------------------------------------------
 string LogImpl::GetThreadId
 (
+	uint32 const _threadId
 )
 {
 	char buf[20];
-	DWORD dwThread = ::GetCurrentThreadId();
-	sprintf_s( buf, sizeof(buf), "%04d ", dwThread );
+	sprintf_s( buf, sizeof(buf), "%04d ", _threadId );
 	string str = buf;
 	return str;
 }
@@ -329,6 +412,7 @@ void LogImpl::SetLogFileName
 	const string &_filename
 )
 {
+	EndBatch();
 	m_filename = _filename;
 }
 //-----------------------------------------------------------------------------
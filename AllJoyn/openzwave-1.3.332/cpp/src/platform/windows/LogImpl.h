@@ -46,15 +46,19 @@ namespace OpenZWave
 		~LogImpl();
 
 		void Write( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args );
+		void Write( LogLevel _level, uint8 const _nodeId, int32 const _age, uint32 const _threadId, char const* _format, va_list _args );
+		uint32 GetCallingThreadId();
+		void BeginBatch();
+		void EndBatch();
 		void Queue( char const* _buffer );
 		void QueueDump();
 		void QueueClear();
 		void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
 		void SetLogFileName( const string &_filename );
 
-		string GetTimeStampString();
+		string GetTimeStampString( int32 const _age = 0 );
 		string GetNodeString( uint8 const _nodeId );
-		string GetThreadId();
+		string GetThreadId( uint32 const _threadId );
 		string GetLogLevelString(LogLevel _level);
 
 		string m_filename;						/**< filename specified by user (default is ozw_log.txt) */
@@ -64,6 +68,7 @@ namespace OpenZWave
 		LogLevel m_saveLevel;
 		LogLevel m_queueLevel;
 		LogLevel m_dumpTrigger;
+		FILE* m_pBatchFile;						/**< log file held open between BeginBatch and EndBatch */
 	};
 
 } // namespace OpenZWave
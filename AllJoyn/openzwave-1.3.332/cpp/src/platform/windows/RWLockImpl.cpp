@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLockImpl.cpp
+//
+//	Windows Implementation of the cross-platform reader/writer lock
+//
+//	Copyright (c) 2010 Mal Lansell <mal@lansell.org>
+//	All rights reserved.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include "Defs.h"
+#include "RWLockImpl.h"
+
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::RWLockImpl>
+//	Constructor
+//-----------------------------------------------------------------------------
+RWLockImpl::RWLockImpl
+(
+)
+{
+	InitializeSRWLock( &m_lock );
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::~RWLockImpl>
+//	Destructor
+//-----------------------------------------------------------------------------
+RWLockImpl::~RWLockImpl
+(
+)
+{
+	// Slim reader/writer locks have nothing to free
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::LockRead>
+//	Lock for reading
+//-----------------------------------------------------------------------------
+void RWLockImpl::LockRead
+(
+)
+{
+	AcquireSRWLockShared( &m_lock );
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::UnlockRead>
+//	Release a read lock
+//-----------------------------------------------------------------------------
+void RWLockImpl::UnlockRead
+(
+)
+{
+	ReleaseSRWLockShared( &m_lock );
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::LockWrite>
+//	Lock for writing
+//-----------------------------------------------------------------------------
+bool RWLockImpl::LockWrite
+(
+	bool const _bWait // = true;
+)
+{
+	if( _bWait )
+	{
+		AcquireSRWLockExclusive( &m_lock );
+		return true;
+	}
+
+	// Returns immediately, even if the lock was not available.
+	return( TryAcquireSRWLockExclusive( &m_lock ) != 0 );
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLockImpl::UnlockWrite>
+//	Release a write lock
+//-----------------------------------------------------------------------------
+void RWLockImpl::UnlockWrite
+(
+)
+{
+	ReleaseSRWLockExclusive( &m_lock );
+}
@@ -32,7 +32,9 @@
 #include "Notification.h"
 #include "Msg.h"
 #include "value_classes/Value.h"
+#include "value_classes/ValueDecimal.h"
 #include "platform/Log.h"
+#include "Utils.h"
 #include "command_classes/CommandClass.h"
 #include <ctime>
 #include "Options.h"
@@ -360,12 +362,22 @@ bool Value::Set
 	Node* node = NULL;
 	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
 	{
-		node = driver->GetNodeUnsafe( m_id.GetNodeId() );
+		// Held while the messages are queued, so that only this value's messages are tagged with its key
+		NodeLockGuard NLG( driver->m_nodeMutex, m_id.GetNodeId(), true );
+		node = NLG.IsLocked() ? driver->GetNodeUnsafe( m_id.GetNodeId() ) : NULL;
 		if( node != NULL )
 		{
 			if( CommandClass* cc = node->GetCommandClass( m_id.GetCommandClassId() ) )
 			{
 				Log::Write(LogLevel_Info, m_id.GetNodeId(), "Value::Set - %s - %s - %d - %d - %s", cc->GetCommandClassName().c_str(), this->GetLabel().c_str(), m_id.GetIndex(), m_id.GetInstance(), this->GetAsString().c_str());
+
+				// A queued Set of this value with an older payload is replaced by the one
+				// queued now.  Each press and release of a button is a command of its own.
+				if( ValueID::ValueType_Button != m_id.GetType() )
+				{
+					node->m_setValueKey = m_id.GetValueStoreKey();
+				}
+
 				// flag value as set and queue a "Set Value" message for transmission to the device
 				res = cc->SetValue( *this );
 
@@ -396,6 +408,7 @@ bool Value::Set
 						}
 					}
 				}
+				node->m_setValueKey = 0;
 			}
 		}
 	}
@@ -403,6 +416,20 @@ bool Value::Set
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <Value::Publish>
+// Copy the current state of the value to the driver's snapshot table
+//-----------------------------------------------------------------------------
+void Value::Publish
+(
+)
+{
+	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
+	{
+		driver->m_valueSnapshots->Publish( this );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Value::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -420,6 +447,12 @@ void Value::OnValueRefreshed
 	{
 		m_isSet = true;
 
+		// Let the poll scheduler know that the value is fresh
+		if( IsPolled() )
+		{
+			driver->PollValueRefreshed( m_id );
+		}
+
 		bool bSuppress;
 		Options::Get()->GetOptionAsBool( "SuppressValueRefresh", &bSuppress );
 		if( !bSuppress )
@@ -450,6 +483,12 @@ void Value::OnValueChanged
 	{
 		m_isSet = true;
 
+		// Let the poll scheduler know that the value is fresh
+		if( IsPolled() )
+		{
+			driver->PollValueRefreshed( m_id );
+		}
+
 		// Notify the watchers
 		Notification* notification = new Notification( Notification::Type_ValueChanged );
 		notification->SetValueId( m_id );
@@ -608,6 +647,15 @@ int Value::VerifyRefreshedValue
 				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%x, new value=%x, type=raw", _originalValue, _newValue );
 				break;
 			}
+			case 7:			// decimal
+			{
+				char originalStr[ValueDecimal::MaxFormatted];
+				char newStr[ValueDecimal::MaxFormatted];
+				ValueDecimal::Format( *((ValueDecimal::Decimal*)_originalValue), originalStr, sizeof(originalStr) );
+				ValueDecimal::Format( *((ValueDecimal::Decimal*)_newValue), newStr, sizeof(newStr) );
+				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", originalStr, newStr, "decimal" );
+				break;
+			}
 			default:
 			{
 				break;
@@ -649,6 +697,9 @@ int Value::VerifyRefreshedValue
 	case 6:			// raw
 		bOriginalEqual = ( memcmp( _originalValue, _newValue, _length ) == 0 );
 		break;
+	case 7:			// decimal
+		bOriginalEqual = ( *((ValueDecimal::Decimal*)_originalValue) == *((ValueDecimal::Decimal*)_newValue) );
+		break;
 	}
 
 		// if this is the first refresh of the value, test to see if the value has changed
@@ -691,6 +742,9 @@ int Value::VerifyRefreshedValue
 		case 6:
 			bCheckEqual = ( memcmp( _checkValue, _newValue, _length ) == 0 );
 			break;
+		case 7:			// decimal
+			bCheckEqual = ( *((ValueDecimal::Decimal*)_checkValue) == *((ValueDecimal::Decimal*)_newValue) );
+			break;
 		}
 		if( bCheckEqual )
 		{
@@ -84,6 +84,7 @@ namespace OpenZWave
 		virtual bool SetFromString( string const& _value ) { return false; }
 
 		bool Set();							// For the user to change a value in a device
+		void Publish();						// Copy the current state of the value to the driver's snapshot table, where it can be read without locking the node
 
 		// Helpers
 		static ValueID::ValueGenre GetGenreEnumFromName( char const* _name );
@@ -25,6 +25,9 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <ctype.h>
+#include <locale.h>
+#include <string.h>
 #include "tinyxml.h"
 #include "value_classes/ValueDecimal.h"
 #include "Msg.h"
@@ -34,6 +37,10 @@
 
 using namespace OpenZWave;
 
+static double const c_powersOfTen[ValueDecimal::MaxPrecision+1] =
+{
+	1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0, 10000000.0, 100000000.0, 1000000000.0
+};
 
 //-----------------------------------------------------------------------------
 // <ValueDecimal::ValueDecimal>
@@ -54,12 +61,9 @@ ValueDecimal::ValueDecimal
 	string const& _value,
 	uint8 const _pollIntensity
 ):
-  	Value( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, ValueID::ValueType_Decimal, _label, _units, _readOnly, _writeOnly, false, _pollIntensity ),
-	m_value( _value ),
-	m_valueCheck( "" ),
-	m_newValue( "" ),
-	m_precision( 0 )
+  	Value( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, ValueID::ValueType_Decimal, _label, _units, _readOnly, _writeOnly, false, _pollIntensity )
 {
+	Parse( _value.c_str(), &m_value );
 }
 
 //-----------------------------------------------------------------------------
@@ -79,7 +83,10 @@ void ValueDecimal::ReadXML
 	char const* str = _valueElement->Attribute( "value" );
 	if( str )
 	{
-		m_value = str;
+		if( !Parse( str, &m_value ) )
+		{
+			Log::Write( LogLevel_Info, "Invalid decimal value \"%s\" in xml configuration: node %d, class 0x%02x, instance %d, index %d", str, _nodeId,  _commandClassId, GetID().GetInstance(), GetID().GetIndex() );
+		}
 	}
 	else
 	{
@@ -97,7 +104,10 @@ void ValueDecimal::WriteXML
 )
 {
 	Value::WriteXML( _valueElement );
-	_valueElement->SetAttribute( "value", m_value.c_str() );
+
+	char str[MaxFormatted];
+	Format( m_value, str, sizeof(str) );
+	_valueElement->SetAttribute( "value", str );
 }
 
 //-----------------------------------------------------------------------------
@@ -109,9 +119,16 @@ bool ValueDecimal::Set
 	string const& _value
 )
 {
+	Decimal value;
+	if( !Parse( _value.c_str(), &value ) )
+	{
+		Log::Write( LogLevel_Warning, GetID().GetNodeId(), "Cannot set decimal value to \"%s\"", _value.c_str() );
+		return false;
+	}
+
 	// create a temporary copy of this value to be submitted to the Set() call and set its value to the function param
   	ValueDecimal* tempValue = new ValueDecimal( *this );
-	tempValue->m_value = _value;
+	tempValue->m_value = value;
 
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
@@ -131,17 +148,195 @@ void ValueDecimal::OnValueRefreshed
 	string const& _value
 )
 {
-	switch( VerifyRefreshedValue( (void*) &m_value, (void*) &m_valueCheck, (void*) &_value, 1) )
+	Decimal value;
+	if( Parse( _value.c_str(), &value ) )
+	{
+		OnValueRefreshed( value.m_value, value.m_precision );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::OnValueRefreshed>
+// A value in a device has been refreshed
+//-----------------------------------------------------------------------------
+void ValueDecimal::OnValueRefreshed
+(
+	int32 const _value,
+	uint8 const _precision
+)
+{
+	Decimal value( _value, _precision );
+	switch( VerifyRefreshedValue( (void*) &m_value, (void*) &m_valueCheck, (void*) &value, 7) )
 	{
 	case 0:		// value hasn't changed, nothing to do
 		break;
 	case 1:		// value has changed (not confirmed yet), save _value in m_valueCheck
-		m_valueCheck = _value;
+		m_valueCheck = value;
 		break;
 	case 2:		// value has changed (confirmed), save _value in m_value
-		m_value = _value;
+		m_value = value;
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+
+	Publish();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::GetValue>
+// Get the value as a decimal string
+//-----------------------------------------------------------------------------
+string ValueDecimal::GetValue
+(
+)const
+{
+	char str[MaxFormatted];
+	Format( m_value, str, sizeof(str) );
+	return string( str );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::ToFloat>
+// Convert a decimal to a float
+//-----------------------------------------------------------------------------
+float ValueDecimal::ToFloat
+(
+	Decimal const& _value
+)
+{
+	uint8 precision = _value.m_precision;
+	if( precision > MaxPrecision )
+	{
+		precision = MaxPrecision;
+	}
+	return (float)( (double)_value.m_value / c_powersOfTen[precision] );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::Parse>
+// Convert a decimal string into an integer and precision
+//-----------------------------------------------------------------------------
+bool ValueDecimal::Parse
+(
+	char const* _str,
+	Decimal* o_value
+)
+{
+	char const* p = _str;
+	while( isspace( *p ) )
+	{
+		++p;
+	}
+
+	bool negative = false;
+	if( ( *p == '-' ) || ( *p == '+' ) )
+	{
+		negative = ( *p == '-' );
+		++p;
+	}
+
+	// Accumulate the magnitude, which may be one more than the largest int32 if negative
+	uint32 magnitude = 0;
+	uint8 precision = 0;
+	bool point = false;
+	bool digits = false;
+	for( ; *p; ++p )
+	{
+		if( ( *p >= '0' ) && ( *p <= '9' ) )
+		{
+			if( magnitude > 214748364 )
+			{
+				return false;
+			}
+			magnitude = magnitude*10 + (uint32)( *p - '0' );
+			if( point && ( ++precision > MaxPrecision ) )
+			{
+				return false;
+			}
+			digits = true;
+		}
+		else if( ( ( *p == '.' ) || ( *p == ',' ) ) && !point )
+		{
+			point = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	while( isspace( *p ) )
+	{
+		++p;
+	}
+
+	if( !digits || ( *p != 0 ) || ( magnitude > ( negative ? 0x80000000u : 0x7fffffffu ) ) )
+	{
+		return false;
+	}
+
+	o_value->m_value = negative ? (int32)( 0u - magnitude ) : (int32)magnitude;
+	o_value->m_precision = precision;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::Format>
+// Write a decimal as a string
+//-----------------------------------------------------------------------------
+uint32 ValueDecimal::Format
+(
+	Decimal const& _value,
+	char* o_buffer,
+	uint32 const _size
+)
+{
+	if( _size == 0 )
+	{
+		return 0;
+	}
+
+	uint8 precision = _value.m_precision;
+	if( precision > MaxPrecision )
+	{
+		precision = MaxPrecision;
+	}
+
+	// Work with the magnitude so that the most negative int32 is handled too
+	uint32 magnitude = ( _value.m_value < 0 ) ? ( 0u - (uint32)_value.m_value ) : (uint32)_value.m_value;
+
+	// Collect the digits in reverse, with at least one in front of the decimal point
+	char digits[MaxFormatted];
+	uint32 count = 0;
+	do
+	{
+		digits[count++] = (char)( '0' + ( magnitude % 10 ) );
+		magnitude /= 10;
+	}
+	while( ( magnitude != 0 ) || ( count <= precision ) );
+
+	char str[MaxFormatted];
+	uint32 length = 0;
+	if( _value.m_value < 0 )
+	{
+		str[length++] = '-';
+	}
+	while( count > 0 )
+	{
+		if( count == precision )
+		{
+			struct lconv const* locale = localeconv();
+			str[length++] = *(locale->decimal_point);
+		}
+		str[length++] = digits[--count];
+	}
+
+	if( length >= _size )
+	{
+		length = _size - 1;
+	}
+	memcpy( o_buffer, str, length );
+	o_buffer[length] = 0;
+	return length;
 }
@@ -40,21 +40,41 @@ namespace OpenZWave
 	class Node;
 
 	/** \brief Decimal value sent to/received from a node.
+	 *
+	 * The value is held as an integer and a precision, the way it is sent over
+	 * the network, and is only converted to text when it is asked for as a string.
 	 */
 	class ValueDecimal: public Value
 	{
-		friend class EnergyProduction;
-		friend class Meter;
-		friend class SensorMultilevel;
-		friend class ThermostatSetpoint;
-
 	public:
+		/** \brief A decimal number held as an integer and the count of digits after the decimal point.
+		 * 21.50 is held as 2150 with a precision of 2.
+		 */
+		struct Decimal
+		{
+			Decimal(): m_value( 0 ), m_precision( 0 ){}
+			Decimal( int32 const _value, uint8 const _precision ): m_value( _value ), m_precision( _precision ){}
+
+			bool operator == ( Decimal const& _other )const{ return( ( m_value == _other.m_value ) && ( m_precision == _other.m_precision ) ); }
+			bool operator != ( Decimal const& _other )const{ return !( *this == _other ); }
+
+			int32	m_value;
+			uint8	m_precision;
+		};
+
+		enum
+		{
+			MaxPrecision = 9,		// Largest precision that can be held in an int32
+			MaxFormatted = 13		// Buffer size needed by Format, including the terminating null
+		};
+
 		ValueDecimal( uint32 const _homeId, uint8 const _nodeId, ValueID::ValueGenre const _genre, uint8 const _commandClassId, uint8 const _instance, uint8 const _index, string const& _label, string const& _units, bool const _readOnly, bool const _writeOnly, string const& _value, uint8 const _pollIntensity );
-		ValueDecimal(): m_precision( 0 ){}
+		ValueDecimal(){}
 		virtual ~ValueDecimal(){}
 
 		bool Set( string const& _value );
 		void OnValueRefreshed( string const& _value );
+		void OnValueRefreshed( int32 const _value, uint8 const _precision );
 
 		// From Value
 		virtual string const GetAsString() const { return GetValue(); }
@@ -62,16 +82,33 @@ namespace OpenZWave
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
 
-		string GetValue()const{ return m_value; }
-		uint8 GetPrecision()const{ return m_precision; }
+		string GetValue()const;
+		Decimal const& GetDecimal()const{ return m_value; }
+		float GetAsFloat()const{ return ToFloat( m_value ); }
+		uint8 GetPrecision()const{ return m_value.m_precision; }
+
+		/**
+		 * Convert a decimal string such as "-21.50" into a Decimal.  Either '.' or ',' may be used as the decimal point.
+		 * \return false if the string is not a number, or has too many digits to be held in an int32.
+		 */
+		static bool Parse( char const* _str, Decimal* o_value );
+
+		/**
+		 * Write a Decimal as a string, using the decimal point of the current locale.
+		 * \param o_buffer Receives the string.  It should be at least MaxFormatted characters long.
+		 * \return the length of the string.
+		 */
+		static uint32 Format( Decimal const& _value, char* o_buffer, uint32 const _size );
+
+		/**
+		 * Convert a Decimal to a float.
+		 */
+		static float ToFloat( Decimal const& _value );
 
 	private:
-		void SetPrecision( uint8 _precision ){ m_precision = _precision; }
-
-		string	m_value;				// the current value
-		string	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
-		string	m_newValue;				// a new value to be set on the appropriate device
-	        uint8	m_precision;
+		Decimal	m_value;				// the current value
+		Decimal	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
+		Decimal	m_newValue;				// a new value to be set on the appropriate device
 	};
 
 } // namespace OpenZWave
@@ -61,6 +61,9 @@ namespace OpenZWave
 		friend class ValueStore;
 		friend class Notification;
 		friend class ManufacturerSpecific;
+		friend class PollScheduler;
+		friend class ValueSnapshot;
+		friend class ConfigWriter;
 
 	public:
 		/** 
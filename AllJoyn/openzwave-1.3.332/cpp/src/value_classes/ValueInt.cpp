@@ -185,4 +185,6 @@ void ValueInt::OnValueRefreshed
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+
+	Publish();
 }
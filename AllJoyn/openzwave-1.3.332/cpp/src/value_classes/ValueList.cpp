@@ -286,6 +286,8 @@ void ValueList::OnValueRefreshed
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+
+	Publish();
 }
 
 //-----------------------------------------------------------------------------
@@ -69,6 +69,7 @@ namespace OpenZWave
 		virtual void WriteXML( TiXmlElement* _valueElement );
 
 		Item const& GetItem()const{ return m_items[m_valueIdx]; }
+		bool HasItem()const{ return( m_valueIdx >= 0 && m_valueIdx < (int32)m_items.size() ); }		// True if an item is selected
 		Item const& GetNewItem()const{ return m_items[m_newValueIdx]; }
 
 		int32 const GetItemIdxByLabel( string const& _label );
@@ -282,4 +282,6 @@ void ValueRaw::OnValueRefreshed
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+
+	Publish();
 }
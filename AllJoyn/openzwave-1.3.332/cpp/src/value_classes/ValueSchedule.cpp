@@ -181,6 +181,8 @@ void ValueSchedule::OnValueRefreshed
 	// TODO:  do schedules ever report spurious values and need rechecking like other value types?
 	// See, for example, ValueShort::OnValueRefreshed
 	Value::OnValueChanged();
+
+	Publish();
 }
 
 //-----------------------------------------------------------------------------
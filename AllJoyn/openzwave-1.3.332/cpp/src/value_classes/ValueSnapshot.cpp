@@ -0,0 +1,557 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueSnapshot.cpp
+//
+//	Copies of value state that can be read without locking the node
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <string.h>
+#include "value_classes/ValueSnapshot.h"
+#include "value_classes/ValueBool.h"
+#include "value_classes/ValueButton.h"
+#include "value_classes/ValueByte.h"
+#include "value_classes/ValueDecimal.h"
+#include "value_classes/ValueInt.h"
+#include "value_classes/ValueList.h"
+#include "value_classes/ValueRaw.h"
+#include "value_classes/ValueSchedule.h"
+#include "value_classes/ValueShort.h"
+#include "value_classes/ValueString.h"
+#include "platform/Atomic.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <SnapshotLess>
+// Orders snapshots by ValueID
+//-----------------------------------------------------------------------------
+static bool SnapshotLess
+(
+	ValueSnapshot const& _a,
+	ValueSnapshot const& _b
+)
+{
+	return( _a.m_id < _b.m_id );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::ValueSnapshotTable>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueSnapshotTable::ValueSnapshotTable
+(
+):
+	m_mutex( new Mutex() )
+{
+	for( int i=0; i<256; ++i )
+	{
+		m_nodes[i] = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::~ValueSnapshotTable>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueSnapshotTable::~ValueSnapshotTable
+(
+)
+{
+	for( int i=0; i<256; ++i )
+	{
+		if( m_nodes[i] )
+		{
+			delete [] m_nodes[i]->m_slots;
+			delete m_nodes[i];
+		}
+	}
+
+	for( vector<NodeTable*>::iterator it = m_retired.begin(); it != m_retired.end(); ++it )
+	{
+		delete [] (*it)->m_slots;
+		delete *it;
+	}
+
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Publish>
+// Copy the current state of a value into the table
+//-----------------------------------------------------------------------------
+void ValueSnapshotTable::Publish
+(
+	Value* _value
+)
+{
+	Record record;
+	record.m_time = time( NULL );
+	record.m_int = 0;
+	record.m_precision = 0;
+	record.m_valid = true;
+
+	char str[16];
+	string text;
+	ValueID const& valueId = _value->GetID();
+	switch( valueId.GetType() )
+	{
+		case ValueID::ValueType_Bool:
+		{
+			record.m_int = static_cast<ValueBool*>( _value )->GetValue() ? 1 : 0;
+			text = record.m_int ? "True" : "False";
+			break;
+		}
+		case ValueID::ValueType_Button:
+		{
+			record.m_int = static_cast<ValueButton*>( _value )->IsPressed() ? 1 : 0;
+			text = record.m_int ? "True" : "False";
+			break;
+		}
+		case ValueID::ValueType_Byte:
+		{
+			record.m_int = static_cast<ValueByte*>( _value )->GetValue();
+			snprintf( str, sizeof(str), "%u", record.m_int );
+			text = str;
+			break;
+		}
+		case ValueID::ValueType_Decimal:
+		{
+			ValueDecimal::Decimal const& decimal = static_cast<ValueDecimal*>( _value )->GetDecimal();
+			record.m_int = decimal.m_value;
+			record.m_precision = decimal.m_precision;
+			ValueDecimal::Format( decimal, str, sizeof(str) );
+			text = str;
+			break;
+		}
+		case ValueID::ValueType_Int:
+		{
+			record.m_int = static_cast<ValueInt*>( _value )->GetValue();
+			snprintf( str, sizeof(str), "%d", record.m_int );
+			text = str;
+			break;
+		}
+		case ValueID::ValueType_List:
+		{
+			ValueList* value = static_cast<ValueList*>( _value );
+			if( !value->HasItem() )
+			{
+				// Nothing has been selected yet
+				return;
+			}
+			ValueList::Item const& item = value->GetItem();
+			record.m_int = item.m_value;
+			text = item.m_label;
+			break;
+		}
+		case ValueID::ValueType_Short:
+		{
+			record.m_int = static_cast<ValueShort*>( _value )->GetValue();
+			snprintf( str, sizeof(str), "%d", record.m_int );
+			text = str;
+			break;
+		}
+		case ValueID::ValueType_String:
+		{
+			text = static_cast<ValueString*>( _value )->GetValue();
+			break;
+		}
+		case ValueID::ValueType_Raw:
+		case ValueID::ValueType_Schedule:
+		{
+			text = _value->GetAsString();
+			break;
+		}
+	}
+
+	record.m_truncated = ( text.length() > MaxText );
+	record.m_length = record.m_truncated ? 0 : (uint8)text.length();
+	memcpy( record.m_text, text.c_str(), record.m_length );
+
+	uint64 key = valueId.GetId();
+	m_mutex->Lock();
+	Slot* slot = Insert( valueId.GetNodeId(), (uint32)key, (uint32)( key >> 32 ) );
+	record.m_version = slot->m_record.m_version + 1;
+	Write( slot, record );
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Remove>
+// Mark a value as no longer existing
+//-----------------------------------------------------------------------------
+void ValueSnapshotTable::Remove
+(
+	ValueID const& _id
+)
+{
+	uint64 key = _id.GetId();
+	m_mutex->Lock();
+	if( NodeTable* table = m_nodes[_id.GetNodeId()] )
+	{
+		if( Slot* slot = const_cast<Slot*>( Find( table, (uint32)key, (uint32)( key >> 32 ) ) ) )
+		{
+			Record record = slot->m_record;
+			record.m_valid = false;
+			++record.m_version;
+			Write( slot, record );
+		}
+	}
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::GetInt>
+// Read the integer form of a value
+//-----------------------------------------------------------------------------
+bool ValueSnapshotTable::GetInt
+(
+	ValueID const& _id,
+	int32* o_value,
+	uint8* o_precision // = NULL
+)const
+{
+	NodeTable const* table = m_nodes[_id.GetNodeId()];
+	AtomicFence();
+	if( table == NULL )
+	{
+		return false;
+	}
+
+	uint64 key = _id.GetId();
+	Slot const* slot = Find( table, (uint32)key, (uint32)( key >> 32 ) );
+	if( slot == NULL )
+	{
+		return false;
+	}
+
+	Record record;
+	Read( slot, &record );
+	if( !record.m_valid )
+	{
+		return false;
+	}
+
+	*o_value = record.m_int;
+	if( o_precision )
+	{
+		*o_precision = record.m_precision;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::GetString>
+// Read the string form of a value
+//-----------------------------------------------------------------------------
+bool ValueSnapshotTable::GetString
+(
+	ValueID const& _id,
+	string* o_value
+)const
+{
+	NodeTable const* table = m_nodes[_id.GetNodeId()];
+	AtomicFence();
+	if( table == NULL )
+	{
+		return false;
+	}
+
+	uint64 key = _id.GetId();
+	Slot const* slot = Find( table, (uint32)key, (uint32)( key >> 32 ) );
+	if( slot == NULL )
+	{
+		return false;
+	}
+
+	Record record;
+	Read( slot, &record );
+	if( !record.m_valid || record.m_truncated )
+	{
+		return false;
+	}
+
+	o_value->assign( record.m_text, record.m_length );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Get>
+// Read a snapshot of a value
+//-----------------------------------------------------------------------------
+bool ValueSnapshotTable::Get
+(
+	ValueID const& _id,
+	ValueSnapshot* o_snapshot
+)const
+{
+	NodeTable const* table = m_nodes[_id.GetNodeId()];
+	AtomicFence();
+	if( table == NULL )
+	{
+		return false;
+	}
+
+	uint64 key = _id.GetId();
+	Slot const* slot = Find( table, (uint32)key, (uint32)( key >> 32 ) );
+	if( slot == NULL )
+	{
+		return false;
+	}
+
+	Record record;
+	Read( slot, &record );
+	if( !record.m_valid )
+	{
+		return false;
+	}
+
+	o_snapshot->m_id = _id;
+	o_snapshot->m_version = record.m_version;
+	o_snapshot->m_time = record.m_time;
+	o_snapshot->m_int = record.m_int;
+	o_snapshot->m_precision = record.m_precision;
+	if( record.m_truncated )
+	{
+		o_snapshot->m_string.clear();
+		return false;
+	}
+	o_snapshot->m_string.assign( record.m_text, record.m_length );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::GetNode>
+// Read snapshots of all of a node's values
+//-----------------------------------------------------------------------------
+void ValueSnapshotTable::GetNode
+(
+	uint32 const _homeId,
+	uint8 const _nodeId,
+	vector<ValueSnapshot>* o_snapshots,
+	vector<uint32>* o_incomplete
+)const
+{
+	o_snapshots->clear();
+	o_incomplete->clear();
+
+	NodeTable const* table = m_nodes[_nodeId];
+	AtomicFence();
+	if( table == NULL )
+	{
+		return;
+	}
+
+	o_snapshots->reserve( table->m_count );
+	vector<uint64> truncated;
+	Record record;
+	for( uint32 i=0; i<table->m_size; ++i )
+	{
+		Slot const* slot = &table->m_slots[i];
+		uint32 id = slot->m_id;
+		AtomicFence();
+		if( id == 0 )
+		{
+			continue;
+		}
+
+		Read( slot, &record );
+		if( !record.m_valid )
+		{
+			continue;
+		}
+
+		uint64 key = ( (uint64)slot->m_id1 << 32 ) | id;
+		if( record.m_truncated )
+		{
+			truncated.push_back( key );
+		}
+
+		ValueSnapshot snapshot;
+		snapshot.m_id = ValueID( _homeId, key );
+		snapshot.m_version = record.m_version;
+		snapshot.m_time = record.m_time;
+		snapshot.m_int = record.m_int;
+		snapshot.m_precision = record.m_precision;
+		snapshot.m_string.assign( record.m_text, record.m_length );
+		o_snapshots->push_back( snapshot );
+	}
+
+	sort( o_snapshots->begin(), o_snapshots->end(), SnapshotLess );
+
+	// Find the values whose strings were too long, now that they are in order
+	if( !truncated.empty() )
+	{
+		for( uint32 i=0; i<o_snapshots->size(); ++i )
+		{
+			if( find( truncated.begin(), truncated.end(), (*o_snapshots)[i].m_id.GetId() ) != truncated.end() )
+			{
+				o_incomplete->push_back( i );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Find>
+// Find the slot holding a value.  Safe to call without the mutex.
+//-----------------------------------------------------------------------------
+ValueSnapshotTable::Slot const* ValueSnapshotTable::Find
+(
+	NodeTable const* _table,
+	uint32 const _id,
+	uint32 const _id1
+)const
+{
+	uint32 mask = _table->m_size - 1;
+	uint32 i = Hash( _id, _id1 ) & mask;
+	for( ;; )
+	{
+		Slot const* slot = &_table->m_slots[i];
+		uint32 id = slot->m_id;
+		AtomicFence();
+		if( id == 0 )
+		{
+			return NULL;
+		}
+		if( id == _id && slot->m_id1 == _id1 )
+		{
+			return slot;
+		}
+		i = ( i + 1 ) & mask;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Insert>
+// Find the slot for a value, adding one if necessary.  Called with the mutex held.
+//-----------------------------------------------------------------------------
+ValueSnapshotTable::Slot* ValueSnapshotTable::Insert
+(
+	uint8 const _nodeId,
+	uint32 const _id,
+	uint32 const _id1
+)
+{
+	NodeTable* table = m_nodes[_nodeId];
+	if( table != NULL )
+	{
+		if( Slot const* slot = Find( table, _id, _id1 ) )
+		{
+			return const_cast<Slot*>( slot );
+		}
+	}
+
+	// Keep the table no more than half full
+	if( table == NULL || ( table->m_count + 1 ) * 2 > table->m_size )
+	{
+		NodeTable* newTable = new NodeTable();
+		newTable->m_size = table ? table->m_size * 2 : ( 1 << MinSlots );
+		newTable->m_count = 0;
+		newTable->m_slots = new Slot[newTable->m_size];
+		memset( newTable->m_slots, 0, sizeof(Slot) * newTable->m_size );
+
+		if( table != NULL )
+		{
+			uint32 mask = newTable->m_size - 1;
+			for( uint32 i=0; i<table->m_size; ++i )
+			{
+				Slot const& slot = table->m_slots[i];
+				if( slot.m_id != 0 )
+				{
+					uint32 j = Hash( slot.m_id, slot.m_id1 ) & mask;
+					while( newTable->m_slots[j].m_id != 0 )
+					{
+						j = ( j + 1 ) & mask;
+					}
+					newTable->m_slots[j].m_id1 = slot.m_id1;
+					newTable->m_slots[j].m_record = slot.m_record;
+					newTable->m_slots[j].m_id = slot.m_id;
+					++newTable->m_count;
+				}
+			}
+			m_retired.push_back( table );
+		}
+
+		// Everything in the new table must be visible before the table itself
+		AtomicFence();
+		m_nodes[_nodeId] = newTable;
+		table = newTable;
+	}
+
+	uint32 mask = table->m_size - 1;
+	uint32 i = Hash( _id, _id1 ) & mask;
+	while( table->m_slots[i].m_id != 0 )
+	{
+		i = ( i + 1 ) & mask;
+	}
+
+	Slot* slot = &table->m_slots[i];
+	slot->m_id1 = _id1;
+	AtomicFence();
+	slot->m_id = _id;
+	++table->m_count;
+	return slot;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Write>
+// Update the record in a slot.  Called with the mutex held.
+//-----------------------------------------------------------------------------
+void ValueSnapshotTable::Write
+(
+	Slot* _slot,
+	Record const& _record
+)
+{
+	// An odd count tells readers that the record is changing
+	AtomicIncrement( &_slot->m_sequence );
+	_slot->m_record = _record;
+	AtomicIncrement( &_slot->m_sequence );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshotTable::Read>
+// Take a consistent copy of the record in a slot.  Safe to call without the mutex.
+//-----------------------------------------------------------------------------
+void ValueSnapshotTable::Read
+(
+	Slot const* _slot,
+	Record* o_record
+)const
+{
+	for( ;; )
+	{
+		int32 sequence = AtomicLoad( &_slot->m_sequence );
+		if( ( sequence & 1 ) == 0 )
+		{
+			*o_record = _slot->m_record;
+			AtomicFence();
+			if( sequence == _slot->m_sequence )
+			{
+				return;
+			}
+		}
+	}
+}
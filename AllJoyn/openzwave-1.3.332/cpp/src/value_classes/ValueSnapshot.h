@@ -0,0 +1,168 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueSnapshot.h
+//
+//	Copies of value state that can be read without locking the node
+//
+//	Copyright (c) 2010 Mal Lansell <openzwave@lansell.org>
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueSnapshot_H
+#define _ValueSnapshot_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+	class Value;
+
+	/** \brief A copy of the state of a value at one moment.
+	 *
+	 * Snapshots are returned by Manager::GetValueSnapshot and Manager::GetValues.
+	 * They are read without locking the node, so they never wait for the driver.
+	 */
+	class OPENZWAVE_EXPORT ValueSnapshot
+	{
+	public:
+		ValueSnapshot(): m_version( 0 ), m_time( 0 ), m_int( 0 ), m_precision( 0 ){}
+
+		ValueID		m_id;
+		uint32		m_version;			// Incremented each time the value is refreshed
+		time_t		m_time;				// Time of the last refresh
+		int32		m_int;				// The value of a bool, button, byte, short or int, the value of the selected list item, or a decimal scaled by 10^m_precision
+		uint8		m_precision;		// Digits after the decimal point of a decimal value
+		string		m_string;			// The value as returned by Manager::GetValueAsString
+	};
+
+	/** \brief The latest state of every value of a driver's nodes, readable without locks.
+	 *
+	 * Whenever a value changes, the thread that changed it publishes a copy here.
+	 * Each copy is guarded by a sequence count: a writer makes the count odd while
+	 * it updates the copy, and a reader retries if the count was odd or changed
+	 * while it was reading.  Writers are serialised by a mutex of their own, so
+	 * readers never take a lock and never block the driver.
+	 *
+	 * Each node has its own open-addressed table of copies.  Entries are never
+	 * deleted, only marked invalid, and when a table fills up it is replaced by a
+	 * larger one.  Replaced tables are kept until the driver is deleted, so a reader
+	 * that is still using one is never left with a dangling pointer.
+	 */
+	class ValueSnapshotTable
+	{
+	public:
+		ValueSnapshotTable();
+		~ValueSnapshotTable();
+
+		/**
+		 * Copy the current state of a value into the table.
+		 */
+		void Publish( Value* _value );
+
+		/**
+		 * Mark a value as no longer existing.
+		 */
+		void Remove( ValueID const& _id );
+
+		/**
+		 * Read the integer form of a value.  A decimal is read as an integer scaled by 10^precision.
+		 * \param o_precision If not NULL, receives the precision of a decimal, or zero for other types.
+		 * \return false if the value has not been published.
+		 */
+		bool GetInt( ValueID const& _id, int32* o_value, uint8* o_precision = NULL )const;
+
+		/**
+		 * Read the string form of a value.
+		 * \return false if the value has not been published, or its string was too long to be copied.
+		 */
+		bool GetString( ValueID const& _id, string* o_value )const;
+
+		/**
+		 * Read a snapshot of a value.
+		 * \return false if the value has not been published, or its string was too long to be copied.
+		 * In the latter case every field but m_string is still filled in.
+		 */
+		bool Get( ValueID const& _id, ValueSnapshot* o_snapshot )const;
+
+		/**
+		 * Read snapshots of all the published values of a node, in ValueID order.
+		 * \param o_snapshots receives the snapshots.
+		 * \param o_incomplete receives the positions in o_snapshots of any values whose string
+		 * was too long to be copied.  Their m_string is empty.
+		 */
+		void GetNode( uint32 const _homeId, uint8 const _nodeId, vector<ValueSnapshot>* o_snapshots, vector<uint32>* o_incomplete )const;
+
+	private:
+		ValueSnapshotTable( ValueSnapshotTable const& );					// prevent copy
+		ValueSnapshotTable& operator = ( ValueSnapshotTable const& );		// prevent assignment
+
+		enum
+		{
+			MaxText = 47,						// Longest string that is copied
+			MinSlots = 4						// log2 of the smallest table size
+		};
+
+		// The copy of a value, guarded by the sequence count of its slot
+		struct Record
+		{
+			uint32	m_version;
+			time_t	m_time;
+			int32	m_int;
+			uint8	m_precision;
+			bool	m_valid;					// False if the value has been removed
+			bool	m_truncated;				// m_text was too long to copy
+			uint8	m_length;					// Length of m_text
+			char	m_text[MaxText];
+		};
+
+		struct Slot
+		{
+			uint32 volatile	m_id;				// Low half of ValueID::GetId(), or zero for an empty slot.  Set last, so readers never see a half-written slot.
+			uint32 volatile	m_id1;				// High half of ValueID::GetId()
+			int32 volatile	m_sequence;			// Odd while m_record is being written
+			Record			m_record;
+		};
+
+		struct NodeTable
+		{
+			uint32	m_size;						// Number of slots, always a power of two
+			uint32	m_count;					// Number of slots in use
+			Slot*	m_slots;
+		};
+
+		static uint32 Hash( uint32 const _id, uint32 const _id1 ){ return( ( _id ^ ( _id1 >> 19 ) ) * 2654435761U ); }
+		Slot const* Find( NodeTable const* _table, uint32 const _id, uint32 const _id1 )const;
+		Slot* Insert( uint8 const _nodeId, uint32 const _id, uint32 const _id1 );
+		void Write( Slot* _slot, Record const& _record );
+		void Read( Slot const* _slot, Record* o_record )const;
+
+		Mutex*						m_mutex;				// Serialises writers.  Readers never lock.
+		NodeTable* volatile			m_nodes[256];
+		vector<NodeTable*>			m_retired;				// Tables that have been replaced, kept for readers still using them
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueSnapshot_H
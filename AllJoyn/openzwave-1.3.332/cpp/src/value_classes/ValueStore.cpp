@@ -25,6 +25,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include "value_classes/ValueStore.h"
 #include "value_classes/Value.h"
 #include "Manager.h"
@@ -32,22 +33,47 @@
 
 using namespace OpenZWave;
 
+// Smallest hash index, as a power of two
+static uint32 const c_minIndexBits = 4;
+
+//-----------------------------------------------------------------------------
+// <KeyLess>
+// Orders the entries in the store by key
+//-----------------------------------------------------------------------------
+static bool KeyLess
+(
+	pair<uint32,Value*> const& _entry,
+	uint32 const _key
+)
+{
+	return( _entry.first < _key );
+}
 
 //-----------------------------------------------------------------------------
 // <ValueStore::ValueStore>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueStore::ValueStore
+(
+):
+	m_indexShift( 32 - c_minIndexBits )
+{
+	m_index.resize( 1 << c_minIndexBits, 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::~ValueStore>
 // Destructor
 //-----------------------------------------------------------------------------
 ValueStore::~ValueStore
 (
 )
 {
-	map<uint32,Value*>::iterator it = m_values.begin();
-	while( !m_values.empty() )
+	for( vector< pair<uint32,Value*> >::iterator it = m_values.begin(); it != m_values.end(); ++it )
 	{
-		ValueID const& valueId = it->second->GetID();
-		RemoveValue( valueId.GetValueStoreKey() );
-		it = m_values.begin();
+		ReleaseValue( it->second );
 	}
+	m_values.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -65,15 +91,17 @@ bool ValueStore::AddValue
 	}
 
 	uint32 key = _value->GetID().GetValueStoreKey();
-	map<uint32,Value*>::iterator it = m_values.find( key );
-	if( it != m_values.end() )
+	if( Find( key ) != c_noHandle )
 	{
 		// There is already a value in the store with this key, so we give up.
 		return false;
 	}
 
-	m_values[key] = _value;
+	vector< pair<uint32,Value*> >::iterator it = lower_bound( m_values.begin(), m_values.end(), key, KeyLess );
+	m_values.insert( it, pair<uint32,Value*>( key, _value ) );
+	Reindex();
 	_value->AddRef();
+	_value->Publish();
 
 	// Notify the watchers of the new value
 	if( Driver* driver = Manager::Get()->GetDriver( _value->GetID().GetHomeId() ) )
@@ -95,24 +123,14 @@ bool ValueStore::RemoveValue
 	uint32 const& _key
 )
 {
-	map<uint32,Value*>::iterator it = m_values.find( _key );
-	if( it != m_values.end() )
+	uint32 pos = Find( _key );
+	if( pos != c_noHandle )
 	{
-		Value* value = it->second;
-		ValueID const& valueId = value->GetID();
-
-		// First notify the watchers
-		if( Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() ) )
-		{
-			Notification* notification = new Notification( Notification::Type_ValueRemoved );
-			notification->SetValueId( valueId );
-			driver->QueueNotification( notification ); 
-		}
-
-		// Now release and remove the value from the store
-		value->Release();
-		m_values.erase( it );
+		Value* value = m_values[pos].second;
+		m_values.erase( m_values.begin() + pos );
+		Reindex();
 
+		ReleaseValue( value );
 		return true;
 	}
 
@@ -120,16 +138,6 @@ bool ValueStore::RemoveValue
 	return false;
 }
 
-////-----------------------------------------------------------------------------
-//// <ValueStore::RemoveValue>
-//// Remove a value from the store
-////-----------------------------------------------------------------------------
-//bool ValueStore::RemoveValue
-//(
-//	ValueID const& _id
-//)
-
-
 //-----------------------------------------------------------------------------
 // <ValueStore::RemoveCommandClassValues>
 // Remove all the values associated with a command class from the store
@@ -139,32 +147,25 @@ void ValueStore::RemoveCommandClassValues
 	uint8 const _commandClassId
 )
 {
-	map<uint32,Value*>::iterator it = m_values.begin();
-	while( it != m_values.end() )
+	vector< pair<uint32,Value*> >::iterator dest = m_values.begin();
+	for( vector< pair<uint32,Value*> >::iterator it = m_values.begin(); it != m_values.end(); ++it )
 	{
-		Value* value = it->second;
-		ValueID const& valueId = value->GetID();
-		if( _commandClassId == valueId.GetCommandClassId() )
+		if( _commandClassId == it->second->GetID().GetCommandClassId() )
 		{
 			// The value belongs to the specified command class
-			
-			// First notify the watchers
-			if( Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() ) )
-			{
-				Notification* notification = new Notification( Notification::Type_ValueRemoved );
-				notification->SetValueId( valueId );
-				driver->QueueNotification( notification ); 
-			}
-
-			// Now release and remove the value from the store
-			value->Release();
-			m_values.erase( it++ );
+			ReleaseValue( it->second );
 		}
 		else
 		{
-			++it;
+			*dest++ = *it;
 		}
 	}
+
+	if( dest != m_values.end() )
+	{
+		m_values.erase( dest, m_values.end() );
+		Reindex();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -176,29 +177,122 @@ Value* ValueStore::GetValue
 	uint32 const& _key
 )const
 {
-	Value* value = NULL;
+	uint32 pos = Find( _key );
+	if( pos == c_noHandle )
+	{
+		return NULL;
+	}
+
+	Value* value = m_values[pos].second;
+
+	// Add a reference to the value.  The caller must
+	// call Release on the value when they are done with it.
+	value->AddRef();
+	return value;
+}
 
-	map<uint32,Value*>::const_iterator it = m_values.find( _key );
-	if( it != m_values.end() )
+//-----------------------------------------------------------------------------
+// <ValueStore::GetValue>
+// Get a value from the store, trying a saved position first
+//-----------------------------------------------------------------------------
+Value* ValueStore::GetValue
+(
+	uint32 const& _key,
+	uint32* _handle
+)const
+{
+	uint32 pos = *_handle;
+	if( pos >= m_values.size() || m_values[pos].first != _key )
 	{
-		value = it->second;
-		if( value )
+		pos = Find( _key );
+		if( pos == c_noHandle )
 		{
-			// Add a reference to the value.  The caller must
-			// call Release on the value when they are done with it.
-			value->AddRef();
+			return NULL;
 		}
+		*_handle = pos;
 	}
 
+	Value* value = m_values[pos].second;
+
+	// Add a reference to the value.  The caller must
+	// call Release on the value when they are done with it.
+	value->AddRef();
 	return value;
 }
 
-////-----------------------------------------------------------------------------
-//// <ValueStore::GetValue>
-//// Get a value from the store
-////-----------------------------------------------------------------------------
-//Value* ValueStore::GetValue
-//(
-//	ValueID const& _id
-//)const
+//-----------------------------------------------------------------------------
+// <ValueStore::Find>
+// Look a key up in the hash index
+//-----------------------------------------------------------------------------
+uint32 ValueStore::Find
+(
+	uint32 const _key
+)const
+{
+	uint32 mask = (uint32)m_index.size() - 1;
+	for( uint32 slot = Hash( _key ); m_index[slot] != 0; slot = ( slot + 1 ) & mask )
+	{
+		uint32 pos = m_index[slot] - 1;
+		if( m_values[pos].first == _key )
+		{
+			return pos;
+		}
+	}
+	return c_noHandle;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::Reindex>
+// Rebuild the hash index.  Values are only added and removed while a node is
+// being interviewed or loaded, so this is not worth doing incrementally.
+//-----------------------------------------------------------------------------
+void ValueStore::Reindex
+(
+)
+{
+	// Keep the index no more than half full
+	uint32 bits = c_minIndexBits;
+	while( ( 1U << bits ) < m_values.size() * 2 )
+	{
+		++bits;
+	}
+
+	m_index.assign( 1 << bits, 0 );
+	m_indexShift = 32 - bits;
 
+	uint32 mask = (uint32)m_index.size() - 1;
+	for( uint32 pos = 0; pos < m_values.size(); ++pos )
+	{
+		uint32 slot = Hash( m_values[pos].first );
+		while( m_index[slot] != 0 )
+		{
+			slot = ( slot + 1 ) & mask;
+		}
+		m_index[slot] = pos + 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::ReleaseValue>
+// Notify the watchers that a value has been removed, and release it
+//-----------------------------------------------------------------------------
+void ValueStore::ReleaseValue
+(
+	Value* _value
+)
+{
+	ValueID const& valueId = _value->GetID();
+
+	// First notify the watchers
+	if( Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() ) )
+	{
+		driver->m_valueSnapshots->Remove( valueId );
+
+		Notification* notification = new Notification( Notification::Type_ValueRemoved );
+		notification->SetValueId( valueId );
+		driver->QueueNotification( notification ); 
+	}
+
+	// Now release the value
+	_value->Release();
+}
@@ -28,7 +28,8 @@
 #ifndef _ValueStore_H
 #define _ValueStore_H
 
-#include <map>
+#include <vector>
+#include <utility>
 #include "Defs.h"
 #include "value_classes/ValueID.h"
 
@@ -39,27 +40,58 @@ namespace OpenZWave
 	class Value;
 
 	/** \brief Container that holds all of the values associated with a given node.
+	 *
+	 * The values are held in a single array sorted by key, so they are iterated in the
+	 * same order as before (which is the order they are written to the XML file).  They
+	 * are found through an open-addressed hash index into that array, so a lookup costs
+	 * one hash and usually one probe, whatever the number of values.
 	 */
 	class ValueStore
 	{
 	public:
 		
-		typedef map<uint32,Value*>::const_iterator Iterator;
+		typedef vector< pair<uint32,Value*> >::const_iterator Iterator;
 
 		Iterator Begin(){ return m_values.begin(); }
 		Iterator End(){ return m_values.end(); }
 		
-		ValueStore(){}
+		ValueStore();
 		~ValueStore();
 
 		bool AddValue( Value* _value );
 		bool RemoveValue( uint32 const& _key );
 		Value* GetValue( uint32 const& _key )const;
 
+		/**
+		 * Get a value, using a handle saved from an earlier lookup to avoid searching for it.
+		 * The handle stays valid until a value is added to or removed from the store.  If it
+		 * is no longer valid the value is looked up normally and the handle is updated.
+		 * \param _key the value store key of the value.
+		 * \param _handle the saved handle.  Initialise it to ValueStore::c_noHandle.
+		 * \return the value, with a reference added, or NULL if it is not in the store.
+		 */
+		Value* GetValue( uint32 const& _key, uint32* _handle )const;
+
+		/**
+		 * Determine whether the store holds a value, without adding a reference to it.
+		 */
+		bool Contains( uint32 const& _key )const{ return( Find( _key ) != c_noHandle ); }
+
+		uint32 Size()const{ return (uint32)m_values.size(); }
+
 		void RemoveCommandClassValues( uint8 const _commandClassId );		// Remove all the values associated with a command class
 
+		static uint32 const c_noHandle = 0xffffffff;
+
 	private:
-		map<uint32,Value*>	m_values;
+		uint32 Find( uint32 const _key )const;								// Get the position of a value in m_values, or c_noHandle
+		uint32 Hash( uint32 const _key )const{ return( ( _key * 2654435761U ) >> m_indexShift ); }
+		void Reindex();														// Rebuild m_index after m_values has changed
+		void ReleaseValue( Value* _value );									// Notify the watchers that a value is going, and release it
+
+		vector< pair<uint32,Value*> >	m_values;						// Sorted by key
+		vector<uint32>					m_index;						// Position in m_values plus one, or zero for an empty slot
+		uint32							m_indexShift;					// 32 minus log2 of the index size
 	};
 
 } // namespace OpenZWave
@@ -67,4 +99,3 @@ namespace OpenZWave
 #endif
 
 
-
@@ -93,7 +93,8 @@ namespace OpenZWaveDotNet
 	{
 		Unknown		= Driver::ControllerInterface_Unknown,
 		Serial		= Driver::ControllerInterface_Serial,
-		Hid			= Driver::ControllerInterface_Hid
+		Hid			= Driver::ControllerInterface_Hid,
+		Simulator	= Driver::ControllerInterface_Simulator
 	};
 
 	public enum class ZWControllerCommand
@@ -508,6 +509,15 @@ namespace OpenZWaveDotNet
 		 */
 		uint8 GetPollIntensity( ZWValueID^ valueId ) { return Manager::Get()->GetPollIntensity( valueId->CreateUnmanagedValueID()); }
 
+		/**
+		 * \brief Give a polled value its own polling period.
+		 * \param valueId The ID of a value that is being polled.
+		 * \param period Milliseconds between polls, or zero to go back to the poll interval and intensity.
+		 * \param jitter Up to this many milliseconds are added at random to each period.
+		 * \return True if the period was set, false if the value is not being polled.
+		 */
+		bool SetPollPeriod( ZWValueID^ valueId, int32 period, int32 jitter ) { return Manager::Get()->SetPollPeriod( valueId->CreateUnmanagedValueID(), period, jitter ); }
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------